@@ -4,13 +4,14 @@
 #include <string.h>
 #include <unistd.h>
 
-#include "serial.h"
+#include "easysxb.h"
 
 int main(int argc, char *argv[])
 {
   FILE *out;
+  uint8_t buffer[1];
   int count;
-  int fd;
+  easysxb_session *session;
   int n;
 
   if (argc != 2)
@@ -27,15 +28,24 @@ int main(int argc, char *argv[])
     exit(1);
   }
 
-  fd = serial_open("/dev/ttyUSB1");
+  session = easysxb_open("/dev/ttyUSB1", EASYSXB_265);
+
+  if (session == NULL)
+  {
+    printf("Couldn't open serial device.\n");
+    exit(1);
+  }
+
+  // the data is binary
+  easysxb_set_flow_control(session, 0);
 
   count = 0;
 
   while(1)
   {
-    n = serial_read(fd);
+    if (easysxb_read(session, buffer, 1, -1) != 1) { break; }
 
-    if (n < 0) { break; }
+    n = buffer[0];
 
     putc(n, out);
     fflush(out);
@@ -47,7 +57,7 @@ int main(int argc, char *argv[])
     //if ((count % 100) == 0) { printf("bytes transferred: %d\n", count); }
   }
 
-  serial_close(fd);
+  easysxb_close(session);
   fclose(out);
 
   return 0;
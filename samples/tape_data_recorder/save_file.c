@@ -4,14 +4,14 @@
 #include <string.h>
 #include <unistd.h>
 
-#include "serial.h"
+#include "easysxb.h"
 
 int main(int argc, char *argv[])
 {
   FILE *in;
   uint8_t buffer[1];
   int count;
-  int fd;
+  easysxb_session *session;
   int ch, n;
 
   if (argc != 2)
@@ -28,7 +28,16 @@ int main(int argc, char *argv[])
     exit(1);
   }
 
-  fd = serial_open("/dev/ttyUSB1");
+  session = easysxb_open("/dev/ttyUSB1", EASYSXB_265);
+
+  if (session == NULL)
+  {
+    printf("Couldn't open serial device.\n");
+    exit(1);
+  }
+
+  // the data is binary
+  easysxb_set_flow_control(session, 0);
 
   count = 0;
 
@@ -39,8 +48,8 @@ int main(int argc, char *argv[])
 
     buffer[0] = (uint32_t)ch;
 
-    serial_send(fd, buffer, 1);
-    n = serial_read(fd);
+    easysxb_write(session, buffer, 1);
+    n = easysxb_read(session, buffer, 1, -1);
 
     if (n < 0) { break; }
 
@@ -48,7 +57,7 @@ int main(int argc, char *argv[])
     if ((count % 100) == 0) { printf("bytes transferred: %d\n", count); }
   }
 
-  serial_close(fd);
+  easysxb_close(session);
   fclose(in);
 
   return 0;
@@ -0,0 +1,923 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "Agent.H"
+#include "Dialog.H"
+#include "Gui.H"
+#include "Harness.H"
+#include "Monitor.H"
+#include "Terminal.H"
+
+namespace
+{
+  // commands, each answered with data or 'K'
+  const int CMD_PING = 'P';
+  const int CMD_READ = 'R';
+  const int CMD_WRITE = 'W';
+  const int CMD_FILL = 'F';
+  const int CMD_CRC = 'C';
+  const int CMD_GET = 'G';
+  const int CMD_SET = 'S';
+  const int CMD_CALL = 'X';
+  const int CMD_QUIT = 'Q';
+
+  const int ACK = 'K';
+  const int HELLO = 'A';
+
+  // largest transfer per command, so a lost byte costs little
+  const int CHUNK = 1024;
+
+  // time allowed between received bytes
+  const int TIMEOUT = 500;
+
+  // milliseconds to send a number of bytes at 9600 baud, with margin
+  int transmit(int count)
+  {
+    return count * 2;
+  }
+
+  bool resident = false;
+  bool active = false;
+  int location = 0;
+  int length = 0;
+
+  // XON/XOFF is off while the agent has the line
+  void deactivate()
+  {
+    active = false;
+    Terminal::updateFlowControl();
+  }
+
+  // save the caller's registers into the frame, 65816
+  void save816(Harness::Code &c, int base, bool stack)
+  {
+    c.op(0x08);                             // php
+    c.op8(0xC2, 0x30);                      // rep #$30
+    c.op24(0x8F, base + Agent::FRAME + 0);  // sta >A
+    c.op(0x8A);                             // txa
+    c.op24(0x8F, base + Agent::FRAME + 2);  // sta >X
+    c.op(0x98);                             // tya
+    c.op24(0x8F, base + Agent::FRAME + 4);  // sta >Y
+    c.op(0x7B);                             // tdc
+    c.op24(0x8F, base + Agent::FRAME + 6);  // sta >D
+
+    // stack pointer before the JSL and PHP
+    if(stack == true)
+    {
+      c.op(0x3B);                           // tsc
+      c.op(0x18);                           // clc
+      c.op16(0x69, 4);                      // adc #4
+      c.op24(0x8F, base + Agent::FRAME + 10); // sta >S
+    }
+
+    c.op(0x8B);                             // phb
+    c.op8(0xE2, 0x20);                      // sep #$20
+    c.op(0x68);                             // pla
+    c.op24(0x8F, base + Agent::FRAME + 8);  // sta >B
+    c.op(0x68);                             // pla
+    c.op24(0x8F, base + Agent::FRAME + 9);  // sta >P
+  }
+
+  // load the registers from the frame, 65816
+  void load816(Harness::Code &c, int base)
+  {
+    c.op8(0xE2, 0x20);                      // sep #$20
+    c.op24(0xAF, base + Agent::FRAME + 8);  // lda >B
+    c.op(0x48);                             // pha
+    c.op(0xAB);                             // plb
+    c.op24(0xAF, base + Agent::FRAME + 9);  // lda >P
+    c.op(0x48);                             // pha
+    c.op8(0xC2, 0x30);                      // rep #$30
+    c.op24(0xAF, base + Agent::FRAME + 6);  // lda >D
+    c.op(0x5B);                             // tcd
+    c.op24(0xAF, base + Agent::FRAME + 2);  // lda >X
+    c.op(0xAA);                             // tax
+    c.op24(0xAF, base + Agent::FRAME + 4);  // lda >Y
+    c.op(0xA8);                             // tay
+    c.op24(0xAF, base + Agent::FRAME + 0);  // lda >A
+    c.op(0x28);                             // plp
+  }
+
+  // point the load/store instructions at a block and set the count
+  void point816(Harness::Code &c, int base, int address, int count)
+  {
+    for(int i = 0; i < 3; i++)
+    {
+      c.op8(0xA9, address >> (i * 8));      // lda #
+      c.op24(0x8F, c.at("ld") + 1 + i);     // sta >LD+1+i
+      c.op24(0x8F, c.at("st") + 1 + i);     // sta >ST+1+i
+    }
+
+    c.op8(0xA9, count);                     // lda #count
+    c.op24(0x8F, base + Agent::COUNT);      // sta >COUNT
+    c.op8(0xA9, 0);                         // lda #0
+    c.op24(0x8F, base + Agent::COUNT + 1);  // sta >COUNT+1
+  }
+
+  // the W65C265 agent, entered with JSL from the monitor; only long
+  // addressing is used so the caller's direct page and data bank stay put,
+  // and the data pointer lives in self-modified LDA/STA instructions
+  void emit816(Harness::Code &c, int base, int get, int put)
+  {
+    const char *names[] = { "ping", "read", "write", "fill", "crc",
+                            "get", "set", "call", "quit" };
+    const int commands[] = { CMD_PING, CMD_READ, CMD_WRITE, CMD_FILL,
+                             CMD_CRC, CMD_GET, CMD_SET, CMD_CALL,
+                             CMD_QUIT };
+
+    save816(c, base, true);
+
+    c.label("loop");
+    c.op16(0x20, c.at("getb"));             // jsr getb
+
+    for(int i = 0; i < 9; i++)
+    {
+      c.op8(0xC9, commands[i]);             // cmp #command
+      c.op8(0xD0, 3);                       // bne next
+      c.op16(0x4C, c.at(names[i]));         // jmp handler
+    }
+
+    c.op8(0xA9, '?');                       // lda #'?'
+    c.op16(0x20, c.at("putb"));             // jsr putb
+    c.op16(0x4C, c.at("loop"));             // jmp loop
+
+    // monitor calls, any widths on return
+    c.label("getb");
+    c.op24(0x22, get);                      // jsl GET_BYTE_FROM_PC
+    c.op8(0xE2, 0x30);                      // sep #$30
+    c.op(0x60);                             // rts
+
+    c.label("putb");
+    c.op24(0x22, put);                      // jsl SEND_BYTE_TO_PC
+    c.op8(0xE2, 0x30);                      // sep #$30
+    c.op(0x60);                             // rts
+
+    // 24-bit address and 16-bit count
+    c.label("args");
+
+    for(int i = 0; i < 3; i++)
+    {
+      c.op16(0x20, c.at("getb"));           // jsr getb
+      c.op24(0x8F, c.at("ld") + 1 + i);     // sta >LD+1+i
+      c.op24(0x8F, c.at("st") + 1 + i);     // sta >ST+1+i
+    }
+
+    c.op16(0x20, c.at("getb"));             // jsr getb
+    c.op24(0x8F, base + Agent::COUNT);      // sta >COUNT
+    c.op16(0x20, c.at("getb"));             // jsr getb
+    c.op24(0x8F, base + Agent::COUNT + 1);  // sta >COUNT+1
+    c.op(0x60);                             // rts
+
+    // advance the pointer, Z set once the count runs out
+    c.label("next");
+    c.op8(0xC2, 0x20);                      // rep #$20
+    c.op24(0xAF, c.at("ld") + 1);           // lda >LD+1
+    c.op(0x1A);                             // inc
+    c.op24(0x8F, c.at("ld") + 1);           // sta >LD+1
+    c.op24(0x8F, c.at("st") + 1);           // sta >ST+1
+    c.op8(0xE2, 0x20);                      // sep #$20
+    c.branch(0xD0, "same");                 // bne same
+    c.op24(0xAF, c.at("ld") + 3);           // lda >LD+3
+    c.op(0x1A);                             // inc
+    c.op24(0x8F, c.at("ld") + 3);           // sta >LD+3
+    c.op24(0x8F, c.at("st") + 3);           // sta >ST+3
+    c.label("same");
+    c.op8(0xC2, 0x20);                      // rep #$20
+    c.op24(0xAF, base + Agent::COUNT);      // lda >COUNT
+    c.op(0x3A);                             // dec
+    c.op24(0x8F, base + Agent::COUNT);      // sta >COUNT
+    c.op8(0xE2, 0x30);                      // sep #$30
+    c.op(0x60);                             // rts
+
+    c.label("ld");
+    c.op24(0xAF, 0);                        // lda >0
+    c.op(0x60);                             // rts
+
+    c.label("st");
+    c.op24(0x8F, 0);                        // sta >0
+    c.op(0x60);                             // rts
+
+    c.label("ping");
+    c.op8(0xA9, HELLO);                     // lda #'A'
+    c.op16(0x20, c.at("putb"));             // jsr putb
+    c.op16(0x4C, c.at("loop"));             // jmp loop
+
+    c.label("read");
+    c.op16(0x20, c.at("args"));             // jsr args
+    c.label("rloop");
+    c.op16(0x20, c.at("ld"));               // jsr ld
+    c.op16(0x20, c.at("putb"));             // jsr putb
+    c.op16(0x20, c.at("next"));             // jsr next
+    c.branch(0xD0, "rloop");                // bne rloop
+    c.op16(0x4C, c.at("loop"));             // jmp loop
+
+    c.label("write");
+    c.op16(0x20, c.at("args"));             // jsr args
+    c.label("wloop");
+    c.op16(0x20, c.at("getb"));             // jsr getb
+    c.op16(0x20, c.at("st"));               // jsr st
+    c.op16(0x20, c.at("next"));             // jsr next
+    c.branch(0xD0, "wloop");                // bne wloop
+    c.label("ack");
+    c.op8(0xA9, ACK);                       // lda #'K'
+    c.op16(0x20, c.at("putb"));             // jsr putb
+    c.op16(0x4C, c.at("loop"));             // jmp loop
+
+    c.label("fill");
+    c.op16(0x20, c.at("args"));             // jsr args
+    c.op16(0x20, c.at("getb"));             // jsr getb
+    c.op24(0x8F, base + Agent::TMP);        // sta >TMP
+    c.label("floop");
+    c.op24(0xAF, base + Agent::TMP);        // lda >TMP
+    c.op16(0x20, c.at("st"));               // jsr st
+    c.op16(0x20, c.at("next"));             // jsr next
+    c.branch(0xD0, "floop");                // bne floop
+    c.op16(0x4C, c.at("ack"));              // jmp ack
+
+    // CRC-16/CCITT, one bit at a time
+    c.label("crc");
+    c.op16(0x20, c.at("args"));             // jsr args
+    c.op8(0xC2, 0x20);                      // rep #$20
+    c.op16(0xA9, 0xFFFF);                   // lda #$FFFF
+    c.op24(0x8F, base + Agent::CRC);        // sta >CRC
+    c.op8(0xE2, 0x20);                      // sep #$20
+    c.label("cloop");
+    c.op16(0x20, c.at("ld"));               // jsr ld
+    c.op24(0x4F, base + Agent::CRC + 1);    // eor >CRC+1
+    c.op24(0x8F, base + Agent::CRC + 1);    // sta >CRC+1
+    c.op8(0xC2, 0x20);                      // rep #$20
+    c.op24(0xAF, base + Agent::CRC);        // lda >CRC
+    c.op8(0xA2, 8);                         // ldx #8
+    c.label("bits");
+    c.op(0x0A);                             // asl
+    c.branch(0x90, "zero");                 // bcc zero
+    c.op16(0x49, 0x1021);                   // eor #$1021
+    c.label("zero");
+    c.op(0xCA);                             // dex
+    c.branch(0xD0, "bits");                 // bne bits
+    c.op24(0x8F, base + Agent::CRC);        // sta >CRC
+    c.op16(0x20, c.at("next"));             // jsr next
+    c.branch(0xD0, "cloop");                // bne cloop
+    c.op24(0xAF, base + Agent::CRC);        // lda >CRC
+    c.op16(0x20, c.at("putb"));             // jsr putb
+    c.op24(0xAF, base + Agent::CRC + 1);    // lda >CRC+1
+    c.op16(0x20, c.at("putb"));             // jsr putb
+    c.op16(0x4C, c.at("loop"));             // jmp loop
+
+    // the frame is read and written like any other memory
+    c.label("get");
+    point816(c, base, base + Agent::FRAME, 12);
+    c.op16(0x4C, c.at("rloop"));            // jmp rloop
+
+    c.label("set");
+    point816(c, base, base + Agent::FRAME, 10);
+    c.op16(0x4C, c.at("wloop"));            // jmp wloop
+
+    c.label("call");
+
+    for(int i = 0; i < 3; i++)
+    {
+      c.op16(0x20, c.at("getb"));           // jsr getb
+      c.op24(0x8F, c.at("jsl") + 1 + i);    // sta >JSL+1+i
+    }
+
+    load816(c, base);
+    c.label("jsl");
+    c.op24(0x22, 0);                        // jsl 0
+    save816(c, base, false);
+    c.op8(0xE2, 0x30);                      // sep #$30
+    c.op16(0x4C, c.at("ack"));              // jmp ack
+
+    c.label("quit");
+    c.op8(0xA9, ACK);                       // lda #'K'
+    c.op16(0x20, c.at("putb"));             // jsr putb
+    load816(c, base);
+    c.op(0x6B);                             // rtl
+  }
+
+  void save02(Harness::Code &c, int base)
+  {
+    c.op(0x08);                             // php
+    c.op16(0x8D, base + Agent::FRAME + 0);  // sta A
+    c.op16(0x8E, base + Agent::FRAME + 1);  // stx X
+    c.op16(0x8C, base + Agent::FRAME + 2);  // sty Y
+    c.op(0x68);                             // pla
+    c.op16(0x8D, base + Agent::FRAME + 3);  // sta P
+  }
+
+  void load02(Harness::Code &c, int base)
+  {
+    c.op16(0xAD, base + Agent::FRAME + 3);  // lda P
+    c.op(0x48);                             // pha
+    c.op16(0xAD, base + Agent::FRAME + 0);  // lda A
+    c.op16(0xAE, base + Agent::FRAME + 1);  // ldx X
+    c.op16(0xAC, base + Agent::FRAME + 2);  // ldy Y
+    c.op(0x28);                             // plp
+  }
+
+  void point02(Harness::Code &c, int base, int address, int count)
+  {
+    for(int i = 0; i < 2; i++)
+    {
+      c.op8(0xA9, address >> (i * 8));      // lda #
+      c.op16(0x8D, c.at("ld") + 1 + i);     // sta LD+1+i
+      c.op16(0x8D, c.at("st") + 1 + i);     // sta ST+1+i
+    }
+
+    c.op8(0xA9, count);                     // lda #count
+    c.op16(0x8D, base + Agent::COUNT);      // sta COUNT
+    c.op8(0xA9, 0);                         // lda #0
+    c.op16(0x8D, base + Agent::COUNT + 1);  // sta COUNT+1
+  }
+
+  // the W65C134 agent, a 65C02 entered with JSR; the bank byte of
+  // each address is read and ignored so both boards share the protocol
+  void emit02(Harness::Code &c, int base, int get, int put)
+  {
+    const char *names[] = { "ping", "read", "write", "fill", "crc",
+                            "get", "set", "call", "quit" };
+    const int commands[] = { CMD_PING, CMD_READ, CMD_WRITE, CMD_FILL,
+                             CMD_CRC, CMD_GET, CMD_SET, CMD_CALL,
+                             CMD_QUIT };
+
+    save02(c, base);
+    c.op(0xBA);                             // tsx
+    c.op16(0x8E, base + Agent::FRAME + 4);  // stx S
+
+    c.label("loop");
+    c.op16(0x20, get);                      // jsr get
+
+    for(int i = 0; i < 9; i++)
+    {
+      c.op8(0xC9, commands[i]);             // cmp #command
+      c.op8(0xD0, 3);                       // bne next
+      c.op16(0x4C, c.at(names[i]));         // jmp handler
+    }
+
+    c.op8(0xA9, '?');                       // lda #'?'
+    c.op16(0x20, put);                      // jsr put
+    c.op16(0x4C, c.at("loop"));             // jmp loop
+
+    c.label("args");
+
+    for(int i = 0; i < 2; i++)
+    {
+      c.op16(0x20, get);                    // jsr get
+      c.op16(0x8D, c.at("ld") + 1 + i);     // sta LD+1+i
+      c.op16(0x8D, c.at("st") + 1 + i);     // sta ST+1+i
+    }
+
+    c.op16(0x20, get);                      // jsr get, bank
+    c.op16(0x20, get);                      // jsr get
+    c.op16(0x8D, base + Agent::COUNT);      // sta COUNT
+    c.op16(0x20, get);                      // jsr get
+    c.op16(0x8D, base + Agent::COUNT + 1);  // sta COUNT+1
+    c.op(0x60);                             // rts
+
+    c.label("next");
+    c.op16(0xEE, c.at("ld") + 1);           // inc LD+1
+    c.op16(0xEE, c.at("st") + 1);           // inc ST+1
+    c.branch(0xD0, "same");                 // bne same
+    c.op16(0xEE, c.at("ld") + 2);           // inc LD+2
+    c.op16(0xEE, c.at("st") + 2);           // inc ST+2
+    c.label("same");
+    c.op16(0xAD, base + Agent::COUNT);      // lda COUNT
+    c.branch(0xD0, "low");                  // bne low
+    c.op16(0xCE, base + Agent::COUNT + 1);  // dec COUNT+1
+    c.label("low");
+    c.op16(0xCE, base + Agent::COUNT);      // dec COUNT
+    c.op16(0xAD, base + Agent::COUNT);      // lda COUNT
+    c.op16(0x0D, base + Agent::COUNT + 1);  // ora COUNT+1
+    c.op(0x60);                             // rts
+
+    c.label("ld");
+    c.op16(0xAD, 0);                        // lda 0
+    c.op(0x60);                             // rts
+
+    c.label("st");
+    c.op16(0x8D, 0);                        // sta 0
+    c.op(0x60);                             // rts
+
+    c.label("ping");
+    c.op8(0xA9, HELLO);                     // lda #'A'
+    c.op16(0x20, put);                      // jsr put
+    c.op16(0x4C, c.at("loop"));             // jmp loop
+
+    c.label("read");
+    c.op16(0x20, c.at("args"));             // jsr args
+    c.label("rloop");
+    c.op16(0x20, c.at("ld"));               // jsr ld
+    c.op16(0x20, put);                      // jsr put
+    c.op16(0x20, c.at("next"));             // jsr next
+    c.branch(0xD0, "rloop");                // bne rloop
+    c.op16(0x4C, c.at("loop"));             // jmp loop
+
+    c.label("write");
+    c.op16(0x20, c.at("args"));             // jsr args
+    c.label("wloop");
+    c.op16(0x20, get);                      // jsr get
+    c.op16(0x20, c.at("st"));               // jsr st
+    c.op16(0x20, c.at("next"));             // jsr next
+    c.branch(0xD0, "wloop");                // bne wloop
+    c.label("ack");
+    c.op8(0xA9, ACK);                       // lda #'K'
+    c.op16(0x20, put);                      // jsr put
+    c.op16(0x4C, c.at("loop"));             // jmp loop
+
+    c.label("fill");
+    c.op16(0x20, c.at("args"));             // jsr args
+    c.op16(0x20, get);                      // jsr get
+    c.op16(0x8D, base + Agent::TMP);        // sta TMP
+    c.label("floop");
+    c.op16(0xAD, base + Agent::TMP);        // lda TMP
+    c.op16(0x20, c.at("st"));               // jsr st
+    c.op16(0x20, c.at("next"));             // jsr next
+    c.branch(0xD0, "floop");                // bne floop
+    c.op16(0x4C, c.at("ack"));              // jmp ack
+
+    c.label("crc");
+    c.op16(0x20, c.at("args"));             // jsr args
+    c.op8(0xA9, 0xFF);                      // lda #$FF
+    c.op16(0x8D, base + Agent::CRC);        // sta CRC
+    c.op16(0x8D, base + Agent::CRC + 1);    // sta CRC+1
+    c.label("cloop");
+    c.op16(0x20, c.at("ld"));               // jsr ld
+    c.op16(0x4D, base + Agent::CRC + 1);    // eor CRC+1
+    c.op16(0x8D, base + Agent::CRC + 1);    // sta CRC+1
+    c.op8(0xA2, 8);                         // ldx #8
+    c.label("bits");
+    c.op16(0x0E, base + Agent::CRC);        // asl CRC
+    c.op16(0x2E, base + Agent::CRC + 1);    // rol CRC+1
+    c.branch(0x90, "zero");                 // bcc zero
+    c.op16(0xAD, base + Agent::CRC);        // lda CRC
+    c.op8(0x49, 0x21);                      // eor #$21
+    c.op16(0x8D, base + Agent::CRC);        // sta CRC
+    c.op16(0xAD, base + Agent::CRC + 1);    // lda CRC+1
+    c.op8(0x49, 0x10);                      // eor #$10
+    c.op16(0x8D, base + Agent::CRC + 1);    // sta CRC+1
+    c.label("zero");
+    c.op(0xCA);                             // dex
+    c.branch(0xD0, "bits");                 // bne bits
+    c.op16(0x20, c.at("next"));             // jsr next
+    c.branch(0xD0, "cloop");                // bne cloop
+    c.op16(0xAD, base + Agent::CRC);        // lda CRC
+    c.op16(0x20, put);                      // jsr put
+    c.op16(0xAD, base + Agent::CRC + 1);    // lda CRC+1
+    c.op16(0x20, put);                      // jsr put
+    c.op16(0x4C, c.at("loop"));             // jmp loop
+
+    c.label("get");
+    point02(c, base, base + Agent::FRAME, 5);
+    c.op16(0x4C, c.at("rloop"));            // jmp rloop
+
+    c.label("set");
+    point02(c, base, base + Agent::FRAME, 4);
+    c.op16(0x4C, c.at("wloop"));            // jmp wloop
+
+    c.label("call");
+
+    for(int i = 0; i < 2; i++)
+    {
+      c.op16(0x20, get);                    // jsr get
+      c.op16(0x8D, c.at("jsr") + 1 + i);    // sta JSR+1+i
+    }
+
+    c.op16(0x20, get);                      // jsr get, bank
+    load02(c, base);
+    c.label("jsr");
+    c.op16(0x20, 0);                        // jsr 0
+    save02(c, base);
+    c.op16(0x4C, c.at("ack"));              // jmp ack
+
+    c.label("quit");
+    c.op8(0xA9, ACK);                       // lda #'K'
+    c.op16(0x20, put);                      // jsr put
+    load02(c, base);
+    c.op(0x60);                             // rts
+  }
+
+  bool sendCommand(int command, int address, int count)
+  {
+    unsigned char s[6];
+
+    s[0] = command;
+    s[1] = address & 0xFF;
+    s[2] = (address >> 8) & 0xFF;
+    s[3] = (address >> 16) & 0xFF;
+    s[4] = count & 0xFF;
+    s[5] = (count >> 8) & 0xFF;
+
+    return Terminal::sendData(s, 6);
+  }
+
+  bool acknowledged(int timeout)
+  {
+    unsigned char c = 0;
+
+    if(Terminal::receiveData(&c, 1, timeout) != 1 || c != ACK)
+    {
+      // lost our place in the protocol, let the monitor have the line
+      deactivate();
+      return false;
+    }
+
+    return true;
+  }
+
+  // pieces that neither cross a bank nor exceed a chunk
+  int piece(int address, int count)
+  {
+    const int left = 0x10000 - (address & 0xFFFF);
+
+    if(count > CHUNK)
+      count = CHUNK;
+
+    if(count > left)
+      count = left;
+
+    return count;
+  }
+
+  bool is134()
+  {
+    return Gui::getMode() == Gui::MODE_134;
+  }
+}
+
+// assemble the agent for a load address and the monitor's byte I/O calls
+void Agent::build(std::vector<unsigned char> &data, int address,
+                  int get, int put, bool cpu02)
+{
+  Harness::Code code;
+
+  for(int pass = 0; pass < 2; pass++)
+  {
+    code.bytes.clear();
+    code.base = address + CODE;
+
+    if(cpu02 == true)
+      emit02(code, address, get, put);
+    else
+      emit816(code, address, get, put);
+  }
+
+  data.assign(CODE, 0);
+  data.insert(data.end(), code.bytes.begin(), code.bytes.end());
+}
+
+bool Agent::install(int address, int get, int put)
+{
+  if(Terminal::isConnected() == false)
+  {
+    Dialog::message("Error", "Not Connected.");
+    return false;
+  }
+
+  std::vector<unsigned char> data;
+
+  leave();
+  resident = false;
+  build(data, address, get, put, is134());
+
+  if(Terminal::uploadData(address, &data[0], data.size()) == false)
+    return false;
+
+  location = address;
+  length = data.size();
+  resident = true;
+
+  if(enter() == false)
+  {
+    resident = false;
+    Dialog::message("Error", "The agent did not answer.");
+    return false;
+  }
+
+  char s[256];
+
+  sprintf(s, "\nAgent installed at %02X:%04X, %d bytes.\n",
+          address >> 16, address & 0xFFFF, (int)data.size());
+  Gui::append(s);
+
+  return true;
+}
+
+void Agent::remove()
+{
+  leave();
+  resident = false;
+  Gui::append("\nAgent removed, using the monitor.\n");
+}
+
+// the board was reset or disconnected
+void Agent::forget()
+{
+  resident = false;
+  active = false;
+}
+
+bool Agent::isResident()
+{
+  return resident;
+}
+
+bool Agent::isActive()
+{
+  return active;
+}
+
+// true for addresses the resident agent occupies
+bool Agent::contains(int address)
+{
+  return resident == true && address >= location &&
+         address < location + length;
+}
+
+// saved and restored when switching between boards
+Agent::State Agent::getState()
+{
+  State state;
+
+  state.resident = resident;
+  state.active = active;
+  state.location = location;
+  state.length = length;
+
+  return state;
+}
+
+void Agent::setState(const State &state)
+{
+  resident = state.resident;
+  active = state.active;
+  location = state.location;
+  length = state.length;
+}
+
+// start the agent from the monitor prompt if it isn't running
+bool Agent::enter()
+{
+  if(resident == false || Terminal::isConnected() == false)
+    return false;
+
+  if(active == true)
+    return true;
+
+  unsigned char c = CMD_PING;
+
+  Terminal::jsl(location + CODE);
+
+  // drop the monitor's echo of the command
+  Terminal::getData();
+
+  active = true;
+  Terminal::updateFlowControl();
+
+  for(int i = 0; i < 2; i++)
+  {
+    if(Terminal::sendData(&c, 1) == true &&
+       Terminal::receiveData(&c, 1, TIMEOUT) == 1 && c == HELLO)
+    {
+      return true;
+    }
+
+    c = CMD_PING;
+  }
+
+  deactivate();
+  return false;
+}
+
+// hand the line back to the monitor
+void Agent::leave()
+{
+  if(active == false)
+    return;
+
+  unsigned char c = CMD_QUIT;
+
+  Terminal::sendData(&c, 1);
+  Terminal::receiveData(&c, 1, TIMEOUT);
+  deactivate();
+}
+
+// returns the number of bytes received
+int Agent::read(int address, unsigned char *data, int count)
+{
+  int done = 0;
+
+  while(done < count && active == true)
+  {
+    const int size = piece(address + done, count - done);
+
+    if(sendCommand(CMD_READ, address + done, size) == false)
+      break;
+
+    const int got = Terminal::receiveData(data + done, size, TIMEOUT);
+
+    done += got;
+
+    if(got < size)
+    {
+      deactivate();
+      break;
+    }
+  }
+
+  return done;
+}
+
+bool Agent::write(int address, const unsigned char *data, int count)
+{
+  int done = 0;
+
+  while(done < count && active == true)
+  {
+    const int size = piece(address + done, count - done);
+
+    if(sendCommand(CMD_WRITE, address + done, size) == false ||
+       Terminal::sendData(data + done, size) == false ||
+       acknowledged(TIMEOUT + transmit(size)) == false)
+    {
+      return false;
+    }
+
+    done += size;
+  }
+
+  return done == count;
+}
+
+bool Agent::fill(int address, int count, int value)
+{
+  int done = 0;
+
+  while(done < count && active == true)
+  {
+    const int size = piece(address + done, count - done);
+    unsigned char c = value;
+
+    if(sendCommand(CMD_FILL, address + done, size) == false ||
+       Terminal::sendData(&c, 1) == false ||
+       acknowledged(TIMEOUT + transmit(1)) == false)
+    {
+      return false;
+    }
+
+    done += size;
+  }
+
+  return done >= count;
+}
+
+// checksum of a range on the board, -1 when it can't be had
+int Agent::crc(int address, int count)
+{
+  if(active == false || count <= 0 ||
+     count > 0x10000 - (address & 0xFFFF))
+  {
+    return -1;
+  }
+
+  unsigned char s[2];
+
+  // about 200 cycles per byte at 3.58 MHz
+  if(sendCommand(CMD_CRC, address, count) == false ||
+     Terminal::receiveData(s, 2, TIMEOUT + count / 16) != 2)
+  {
+    deactivate();
+    return -1;
+  }
+
+  return s[0] | (s[1] << 8);
+}
+
+// the same CRC-16/CCITT the agent computes
+int Agent::crc16(const unsigned char *data, int count)
+{
+  int crc = 0xFFFF;
+
+  for(int i = 0; i < count; i++)
+  {
+    crc ^= data[i] << 8;
+
+    for(int j = 0; j < 8; j++)
+      crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+
+    crc &= 0xFFFF;
+  }
+
+  return crc;
+}
+
+// registers the agent was entered with, PC is not part of the frame
+bool Agent::getRegs(int *regs)
+{
+  unsigned char s[12];
+  unsigned char c = CMD_GET;
+  const int size = is134() ? 5 : 12;
+
+  if(active == false || Terminal::sendData(&c, 1) == false ||
+     Terminal::receiveData(s, size, TIMEOUT) != size)
+  {
+    deactivate();
+    return false;
+  }
+
+  regs[Monitor::REG_PC] = 0;
+
+  if(is134())
+  {
+    regs[Monitor::REG_A] = s[0];
+    regs[Monitor::REG_X] = s[1];
+    regs[Monitor::REG_Y] = s[2];
+    regs[Monitor::REG_SR] = s[3];
+    regs[Monitor::REG_SP] = (s[4] + 2) & 0xFF;
+    regs[Monitor::REG_DP] = 0;
+    regs[Monitor::REG_DB] = 0;
+  }
+  else
+  {
+    regs[Monitor::REG_A] = s[0] | (s[1] << 8);
+    regs[Monitor::REG_X] = s[2] | (s[3] << 8);
+    regs[Monitor::REG_Y] = s[4] | (s[5] << 8);
+    regs[Monitor::REG_DP] = s[6] | (s[7] << 8);
+    regs[Monitor::REG_DB] = s[8];
+    regs[Monitor::REG_SR] = s[9];
+    regs[Monitor::REG_SP] = s[10] | (s[11] << 8);
+  }
+
+  return true;
+}
+
+bool Agent::setRegs(const int *regs)
+{
+  unsigned char s[11];
+  int size;
+
+  s[0] = CMD_SET;
+
+  if(is134())
+  {
+    s[1] = regs[Monitor::REG_A];
+    s[2] = regs[Monitor::REG_X];
+    s[3] = regs[Monitor::REG_Y];
+    s[4] = regs[Monitor::REG_SR];
+    size = 5;
+  }
+  else
+  {
+    s[1] = regs[Monitor::REG_A];
+    s[2] = regs[Monitor::REG_A] >> 8;
+    s[3] = regs[Monitor::REG_X];
+    s[4] = regs[Monitor::REG_X] >> 8;
+    s[5] = regs[Monitor::REG_Y];
+    s[6] = regs[Monitor::REG_Y] >> 8;
+    s[7] = regs[Monitor::REG_DP];
+    s[8] = regs[Monitor::REG_DP] >> 8;
+    s[9] = regs[Monitor::REG_DB];
+    s[10] = regs[Monitor::REG_SR];
+    size = 11;
+  }
+
+  return active == true && Terminal::sendData(s, size) == true &&
+         acknowledged(TIMEOUT + transmit(size)) == true;
+}
+
+// call a subroutine with the frame's registers, keeping the results;
+// returns false if it hasn't come back within a few seconds
+bool Agent::call(int address)
+{
+  unsigned char s[4];
+
+  s[0] = CMD_CALL;
+  s[1] = address & 0xFF;
+  s[2] = (address >> 8) & 0xFF;
+  s[3] = (address >> 16) & 0xFF;
+
+  return active == true && Terminal::sendData(s, 4) == true &&
+         acknowledged(5000) == true;
+}
+
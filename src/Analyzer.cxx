@@ -0,0 +1,921 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Analyzer.H"
+#include "Emulator.H"
+#include "Listing.H"
+#include "Opcodes.H"
+
+namespace
+{
+  // possible values of a processor flag
+  enum
+  {
+    IS_SET = 1,
+    IS_CLEAR = 2,
+    UNKNOWN = IS_SET | IS_CLEAR
+  };
+
+  // what may be true before an instruction runs
+  struct State
+  {
+    int m;
+    int x;
+    int e;
+    int c;
+    bool dp;
+    bool valid;
+  };
+
+  struct Insn
+  {
+    int address;
+    int length;
+    int op;
+    int target;
+    State state;
+    int block;
+    int min;
+    int max;
+  };
+
+  struct Edge
+  {
+    int to;
+    int min;
+    int max;
+    bool back;
+  };
+
+  struct Block
+  {
+    int first;
+    int last;
+    int min;
+    int max;
+    std::vector<Edge> edges;
+    std::vector<int> preds;
+    std::vector<int> calls;
+    int color;
+    bool busy;
+    bool done;
+    long long best;
+    long long worst;
+  };
+
+  struct Loop
+  {
+    int head;
+    int tail;
+    long long best;
+    long long worst;
+  };
+
+  std::vector<Insn> insns;
+  std::vector<Block> blocks;
+  std::map<int, int> by_address;
+
+  // instructions that change the carry flag
+  const char *carry_ops[] =
+  {
+    "ADC", "SBC", "CMP", "CPX", "CPY", "ASL", "LSR", "ROL", "ROR", 0
+  };
+
+  bool compareInsn(const Insn &a, const Insn &b)
+  {
+    return a.address < b.address;
+  }
+
+  int find(int address)
+  {
+    std::map<int, int>::iterator i = by_address.find(address);
+
+    return i == by_address.end() ? -1 : i->second;
+  }
+
+  bool isTerminal(int op)
+  {
+    return (Opcodes::table[op].flags &
+            (Opcodes::FLAG_JUMP | Opcodes::FLAG_RETURN |
+             Opcodes::FLAG_STOP)) != 0;
+  }
+
+  // static branch, jump or call destination, -1 if computed at run time
+  int destination(const Emulator &emu, int address, int op)
+  {
+    const int next = address + Opcodes::length(op, true, true);
+    Emulator &mem = const_cast<Emulator &>(emu);
+    const int bank = address & 0xFF0000;
+
+    switch(op)
+    {
+      case 0x4C:
+      case 0x20:
+        return bank | mem.read8(address + 1) | (mem.read8(address + 2) << 8);
+      case 0x5C:
+      case 0x22:
+        return mem.read8(address + 1) | (mem.read8(address + 2) << 8) |
+               (mem.read8(address + 3) << 16);
+    }
+
+    if(Opcodes::table[op].mode == Opcodes::MODE_REL)
+      return bank | ((next + (signed char)mem.read8(address + 1)) & 0xFFFF);
+
+    if(Opcodes::table[op].mode == Opcodes::MODE_RELL)
+    {
+      const int offset = (short)(mem.read8(address + 1) |
+                                 (mem.read8(address + 2) << 8));
+
+      return bank | ((next + offset) & 0xFFFF);
+    }
+
+    return -1;
+  }
+
+  State transfer(const Insn &insn, const Emulator &emu)
+  {
+    State out = insn.state;
+    const int op = insn.op;
+    const int imm = const_cast<Emulator &>(emu).read8(insn.address + 1);
+
+    switch(op)
+    {
+      case 0xC2:
+        if(imm & 0x20)
+          out.m = IS_CLEAR;
+        if(imm & 0x10)
+          out.x = IS_CLEAR;
+        if(imm & 0x01)
+          out.c = IS_CLEAR;
+        break;
+      case 0xE2:
+        if(imm & 0x20)
+          out.m = IS_SET;
+        if(imm & 0x10)
+          out.x = IS_SET;
+        if(imm & 0x01)
+          out.c = IS_SET;
+        break;
+      case 0x18:
+        out.c = IS_CLEAR;
+        break;
+      case 0x38:
+        out.c = IS_SET;
+        break;
+      case 0xFB:
+        out.e = insn.state.c;
+        out.c = insn.state.e;
+        break;
+      case 0x28:
+      case 0x40:
+        out.m = UNKNOWN;
+        out.x = UNKNOWN;
+        out.c = UNKNOWN;
+        break;
+      case 0x2B:
+      case 0x5B:
+        out.dp = true;
+        break;
+      default:
+        for(int i = 0; carry_ops[i] != 0; i++)
+        {
+          if(strcmp(Opcodes::table[op].name, carry_ops[i]) == 0)
+            out.c = UNKNOWN;
+        }
+        break;
+    }
+
+    // emulation mode forces 8-bit registers
+    if(out.e == IS_SET)
+    {
+      out.m = IS_SET;
+      out.x = IS_SET;
+    }
+    else if(out.e & IS_SET)
+    {
+      out.m |= IS_SET;
+      out.x |= IS_SET;
+    }
+
+    return out;
+  }
+
+  // returns true if the state grew
+  bool join(State &to, const State &from)
+  {
+    if(to.valid == false)
+    {
+      to = from;
+      to.valid = true;
+      return true;
+    }
+
+    State old = to;
+
+    to.m |= from.m;
+    to.x |= from.x;
+    to.e |= from.e;
+    to.c |= from.c;
+    to.dp |= from.dp;
+
+    return old.m != to.m || old.x != to.x || old.e != to.e ||
+           old.c != to.c || old.dp != to.dp;
+  }
+
+  // cycle range over every state the instruction might run in
+  void cost(const Insn &insn, bool taken, int *min, int *max)
+  {
+    const State &s = insn.state;
+    const int flags = Opcodes::table[insn.op].flags;
+    bool fixed_cross = false;
+    bool known_cross = false;
+
+    // branch penalties depend only on the addresses
+    if(insn.target >= 0 && (flags & Opcodes::FLAG_BRANCH ||
+       Opcodes::table[insn.op].mode == Opcodes::MODE_REL))
+    {
+      known_cross = true;
+      fixed_cross = ((insn.address + insn.length) & 0xFF00) !=
+                    (insn.target & 0xFF00);
+    }
+
+    *min = 1 << 30;
+    *max = 0;
+
+    for(int m = 0; m < 2; m++)
+    {
+      if((s.m & (m ? IS_SET : IS_CLEAR)) == 0)
+        continue;
+
+      for(int x = 0; x < 2; x++)
+      {
+        if((s.x & (x ? IS_SET : IS_CLEAR)) == 0)
+          continue;
+
+        for(int e = 0; e < 2; e++)
+        {
+          if((s.e & (e ? IS_SET : IS_CLEAR)) == 0)
+            continue;
+
+          for(int dp = 0; dp < (s.dp ? 2 : 1); dp++)
+          {
+            for(int cross = 0; cross < 2; cross++)
+            {
+              if(known_cross == true && cross != (fixed_cross ? 1 : 0))
+                continue;
+
+              if(known_cross == false && cross == 1 &&
+                 (flags & Opcodes::FLAG_READ) == 0)
+              {
+                continue;
+              }
+
+              const int count = Opcodes::cycles(insn.op, m, x, e, dp,
+                                                cross, taken);
+
+              *min = std::min(*min, count);
+              *max = std::max(*max, count);
+            }
+          }
+        }
+      }
+    }
+
+    if(*min > *max)
+      *min = *max = 0;
+  }
+
+  void addEdge(int from, int to_insn, int min, int max)
+  {
+    const int to = find(to_insn);
+
+    if(to < 0)
+      return;
+
+    Edge edge;
+
+    edge.to = insns[to].block;
+    edge.min = min;
+    edge.max = max;
+    edge.back = false;
+    blocks[from].edges.push_back(edge);
+    blocks[edge.to].preds.push_back(from);
+  }
+
+  // edges to blocks still on the dfs stack close a loop
+  void markBackEdges(int b)
+  {
+    blocks[b].color = 1;
+
+    for(size_t i = 0; i < blocks[b].edges.size(); i++)
+    {
+      Edge &edge = blocks[b].edges[i];
+
+      if(blocks[edge.to].color == 1)
+        edge.back = true;
+      else if(blocks[edge.to].color == 0)
+        markBackEdges(edge.to);
+    }
+
+    blocks[b].color = 2;
+  }
+
+  void paths(int b);
+
+  // a call costs its own cycles plus the callee's best/worst path
+  void callCost(int b, long long *best, long long *worst)
+  {
+    *best = 0;
+    *worst = 0;
+
+    for(size_t i = 0; i < blocks[b].calls.size(); i++)
+    {
+      const int target = find(insns[blocks[b].calls[i]].target);
+
+      if(target < 0)
+        continue;
+
+      const int callee = insns[target].block;
+
+      // recursion counts once
+      if(blocks[callee].busy == true)
+        continue;
+
+      paths(callee);
+      *best += blocks[callee].best;
+      *worst += blocks[callee].worst;
+    }
+  }
+
+  // shortest and longest way out of a block, loops taken once
+  void paths(int b)
+  {
+    Block &block = blocks[b];
+
+    if(block.done == true || block.busy == true)
+      return;
+
+    block.busy = true;
+
+    long long call_best, call_worst;
+    long long best = -1;
+    long long worst = 0;
+
+    callCost(b, &call_best, &call_worst);
+
+    for(size_t i = 0; i < block.edges.size(); i++)
+    {
+      const Edge &edge = block.edges[i];
+
+      if(edge.back == true || blocks[edge.to].busy == true)
+        continue;
+
+      paths(edge.to);
+
+      const long long lo = edge.min + blocks[edge.to].best;
+      const long long hi = edge.max + blocks[edge.to].worst;
+
+      if(best < 0 || lo < best)
+        best = lo;
+
+      worst = std::max(worst, hi);
+    }
+
+    if(best < 0)
+      best = 0;
+
+    block.best = block.min + call_best + best;
+    block.worst = block.max + call_worst + worst;
+    block.busy = false;
+    block.done = true;
+  }
+
+  // natural loop of a back edge: blocks that reach the tail without
+  // passing through the head
+  void loopBody(int head, int tail, std::vector<bool> &body)
+  {
+    std::vector<int> stack;
+
+    body.assign(blocks.size(), false);
+    body[head] = true;
+
+    if(body[tail] == false)
+    {
+      body[tail] = true;
+      stack.push_back(tail);
+    }
+
+    while(stack.size() > 0)
+    {
+      const int b = stack.back();
+
+      stack.pop_back();
+
+      for(size_t i = 0; i < blocks[b].preds.size(); i++)
+      {
+        const int p = blocks[b].preds[i];
+
+        if(body[p] == false)
+        {
+          body[p] = true;
+          stack.push_back(p);
+        }
+      }
+    }
+  }
+
+  // one iteration: head to tail inside the body, then the back edge
+  void iteration(int b, int tail, const Edge &back,
+                 const std::vector<bool> &body,
+                 std::vector<long long> &best,
+                 std::vector<long long> &worst)
+  {
+    if(best[b] != -2)
+      return;
+
+    // on the current path
+    best[b] = -1;
+
+    long long call_best, call_worst;
+    long long lo = -1, hi = -1;
+
+    callCost(b, &call_best, &call_worst);
+
+    if(b == tail)
+    {
+      lo = back.min;
+      hi = back.max;
+    }
+    else
+    {
+      for(size_t i = 0; i < blocks[b].edges.size(); i++)
+      {
+        const Edge &edge = blocks[b].edges[i];
+
+        if(edge.back == true || body[edge.to] == false)
+          continue;
+
+        iteration(edge.to, tail, back, body, best, worst);
+
+        if(best[edge.to] < 0)
+          continue;
+
+        if(lo < 0 || edge.min + best[edge.to] < lo)
+          lo = edge.min + best[edge.to];
+
+        hi = std::max(hi, edge.max + worst[edge.to]);
+      }
+    }
+
+    if(lo < 0)
+    {
+      best[b] = -3;
+      return;
+    }
+
+    best[b] = blocks[b].min + call_best + lo;
+    worst[b] = blocks[b].max + call_worst + hi;
+  }
+
+  std::string name(const Listing &listing, int address)
+  {
+    char s[256];
+    int offset = 0;
+    const Listing::Symbol *sym = listing.symbolize(address, &offset);
+
+    if(sym == NULL)
+      return "";
+
+    if(offset != 0)
+      snprintf(s, sizeof(s), "%s+%d", sym->name.c_str(), offset);
+    else
+      snprintf(s, sizeof(s), "%s", sym->name.c_str());
+
+    return s;
+  }
+
+  // the listing's source line for the instruction at an address
+  void printSource(const Listing &listing, int address)
+  {
+    const int index = listing.find(address);
+
+    if(index < 0 || listing.instructions[index].line < 0)
+      return;
+
+    const Listing::Line &line =
+      listing.lines[listing.instructions[index].line];
+    std::string text = line.text;
+
+    const size_t start = text.find_first_not_of(" \t");
+    const size_t end = text.find_last_not_of(" \t\r\n");
+
+    if(start == std::string::npos)
+      return;
+
+    text = text.substr(start, end - start + 1);
+    printf("           %5d: %.60s\n", line.number, text.c_str());
+  }
+
+  const char *width(int mask, const char *set, const char *clear,
+                    const char *both)
+  {
+    if(mask == IS_SET)
+      return set;
+    else if(mask == IS_CLEAR)
+      return clear;
+
+    return both;
+  }
+
+  // image next to the listing
+  bool loadImage(Emulator &emu, const char *filename)
+  {
+    const char *exts[] = { ".hex", ".srec", 0 };
+    char s[1024];
+
+    for(int i = 0; exts[i] != 0; i++)
+    {
+      snprintf(s, sizeof(s), "%s", filename);
+
+      char *dot = strrchr(s, '.');
+      char *slash = strrchr(s, '/');
+
+      if(dot != NULL && (slash == NULL || dot > slash))
+        *dot = '\0';
+
+      strncat(s, exts[i], sizeof(s) - strlen(s) - 1);
+
+      if(emu.upload(s) == true)
+        return true;
+    }
+
+    return false;
+  }
+}
+
+// prints block, loop and path estimates, returns a process exit code
+int Analyzer::run(const char *filename)
+{
+  Listing listing;
+  Emulator *emu = new Emulator();
+
+  if(listing.load(filename) == false)
+  {
+    printf("Could not open listing \"%s\".\n", filename);
+    delete emu;
+    return 1;
+  }
+
+  if(loadImage(*emu, filename) == false)
+  {
+    printf("No .hex or .srec image next to \"%s\".\n", filename);
+    delete emu;
+    return 1;
+  }
+
+  insns.clear();
+  blocks.clear();
+  by_address.clear();
+
+  for(size_t i = 0; i < listing.instructions.size(); i++)
+  {
+    const Listing::Instruction &ins = listing.instructions[i];
+
+    if(ins.data == true || by_address.count(ins.address) > 0)
+      continue;
+
+    Insn insn;
+
+    insn.address = ins.address;
+    insn.length = ins.length;
+    insn.op = emu->read8(ins.address);
+    insn.target = destination(*emu, ins.address, insn.op);
+    insn.state.valid = false;
+    insn.block = -1;
+    insns.push_back(insn);
+    by_address[ins.address] = 0;
+  }
+
+  if(insns.size() == 0)
+  {
+    printf("No instructions in \"%s\".\n", filename);
+    delete emu;
+    return 1;
+  }
+
+  std::sort(insns.begin(), insns.end(), compareInsn);
+
+  for(size_t i = 0; i < insns.size(); i++)
+    by_address[insns[i].address] = i;
+
+  // register widths, emulation mode and dp alignment by data flow,
+  // starting from the state the monitor leaves
+  std::vector<int> work;
+  State entry;
+
+  entry.m = IS_SET;
+  entry.x = IS_SET;
+  entry.e = IS_CLEAR;
+  entry.c = UNKNOWN;
+  entry.dp = false;
+  entry.valid = true;
+  insns[0].state = entry;
+  work.push_back(0);
+
+  while(work.size() > 0)
+  {
+    const int i = work.back();
+    const Insn &insn = insns[i];
+    const int flags = Opcodes::table[insn.op].flags;
+    const State out = transfer(insn, *emu);
+    std::vector<int> next;
+
+    work.pop_back();
+
+    if(isTerminal(insn.op) == false)
+      next.push_back(find(insn.address + insn.length));
+
+    if(flags & (Opcodes::FLAG_BRANCH | Opcodes::FLAG_JUMP |
+                Opcodes::FLAG_CALL))
+    {
+      next.push_back(find(insn.target));
+    }
+
+    for(size_t j = 0; j < next.size(); j++)
+    {
+      if(next[j] >= 0 && join(insns[next[j]].state, out) == true)
+        work.push_back(next[j]);
+    }
+  }
+
+  // basic blocks start at labels, targets and after control transfers
+  std::vector<bool> leader(insns.size(), false);
+
+  leader[0] = true;
+
+  for(size_t i = 0; i < insns.size(); i++)
+  {
+    const int flags = Opcodes::table[insns[i].op].flags;
+
+    if(flags & (Opcodes::FLAG_BRANCH | Opcodes::FLAG_JUMP |
+                Opcodes::FLAG_RETURN | Opcodes::FLAG_STOP))
+    {
+      if(i + 1 < insns.size())
+        leader[i + 1] = true;
+    }
+
+    if((flags & (Opcodes::FLAG_BRANCH | Opcodes::FLAG_JUMP |
+                 Opcodes::FLAG_CALL)) && find(insns[i].target) >= 0)
+    {
+      leader[find(insns[i].target)] = true;
+    }
+
+    if(i > 0 && insns[i - 1].address + insns[i - 1].length != insns[i].address)
+      leader[i] = true;
+  }
+
+  for(size_t i = 0; i < listing.symbols.size(); i++)
+  {
+    if(listing.symbols[i].label == true && find(listing.symbols[i].address) >= 0)
+      leader[find(listing.symbols[i].address)] = true;
+  }
+
+  for(size_t i = 0; i < insns.size(); i++)
+  {
+    if(leader[i] == true)
+    {
+      Block block;
+
+      block.first = i;
+      block.min = 0;
+      block.max = 0;
+      block.color = 0;
+      block.busy = false;
+      block.done = false;
+      blocks.push_back(block);
+    }
+
+    Block &block = blocks.back();
+    Insn &insn = insns[i];
+
+    block.last = i;
+    insn.block = blocks.size() - 1;
+
+    if(insn.state.valid == false)
+      continue;
+
+    if(Opcodes::table[insn.op].flags & Opcodes::FLAG_BRANCH)
+      continue;
+
+    cost(insn, false, &insn.min, &insn.max);
+    block.min += insn.min;
+    block.max += insn.max;
+
+    if(Opcodes::table[insn.op].flags & Opcodes::FLAG_CALL)
+      block.calls.push_back(i);
+  }
+
+  for(size_t b = 0; b < blocks.size(); b++)
+  {
+    const Insn &insn = insns[blocks[b].last];
+    const int flags = Opcodes::table[insn.op].flags;
+    const int next = insn.address + insn.length;
+
+    if(insn.state.valid == false)
+      continue;
+
+    if(flags & Opcodes::FLAG_BRANCH)
+    {
+      int min, max;
+
+      cost(insn, true, &min, &max);
+      addEdge(b, insn.target, min, max);
+      cost(insn, false, &min, &max);
+      addEdge(b, next, min, max);
+    }
+    else if(flags & Opcodes::FLAG_JUMP)
+    {
+      addEdge(b, insn.target, 0, 0);
+    }
+    else if(isTerminal(insn.op) == false)
+    {
+      addEdge(b, next, 0, 0);
+    }
+  }
+
+  // entry and subroutines first so back edges are found from the top
+  std::vector<int> roots;
+
+  roots.push_back(0);
+
+  for(size_t i = 0; i < insns.size(); i++)
+  {
+    if((Opcodes::table[insns[i].op].flags & Opcodes::FLAG_CALL) &&
+       find(insns[i].target) >= 0)
+    {
+      roots.push_back(insns[find(insns[i].target)].block);
+    }
+  }
+
+  for(size_t i = 0; i < roots.size(); i++)
+  {
+    if(blocks[roots[i]].color == 0)
+      markBackEdges(roots[i]);
+  }
+
+  for(size_t b = 0; b < blocks.size(); b++)
+  {
+    if(blocks[b].color == 0 && insns[blocks[b].first].state.valid == true)
+      markBackEdges(b);
+  }
+
+  printf("Cycle estimate for %s, entry %02X:%04X\n",
+         filename, insns[0].address >> 16, insns[0].address & 0xFFFF);
+  printf("Widths assume the monitor's state (native, 8-bit A and X) at entry.\n");
+  printf("Ranges cover page crossings, unknown widths and dp alignment.\n");
+
+  printf("\nBlocks:\n");
+
+  for(size_t b = 0; b < blocks.size(); b++)
+  {
+    const Block &block = blocks[b];
+    const Insn &first = insns[block.first];
+    char range[64];
+
+    if(first.state.valid == false)
+    {
+      printf("  %02X:%04X %-24.24s unreachable\n",
+             first.address >> 16, first.address & 0xFFFF,
+             name(listing, first.address).c_str());
+      printSource(listing, first.address);
+      continue;
+    }
+
+    if(block.min == block.max)
+      sprintf(range, "%d", block.max);
+    else
+      sprintf(range, "%d..%d", block.min, block.max);
+
+    printf("  %02X:%04X %-24.24s %3d insn%s %9s cycles  %s %s%s%s\n",
+           first.address >> 16, first.address & 0xFFFF,
+           name(listing, first.address).c_str(),
+           block.last - block.first + 1,
+           block.last == block.first ? " " : "s", range,
+           width(first.state.m, "m8 ", "m16", "m* "),
+           width(first.state.x, "x8 ", "x16", "x* "),
+           first.state.e & IS_SET ? " emulation" : "",
+           first.state.dp ? " dp?" : "");
+
+    printSource(listing, first.address);
+
+    const Insn &last = insns[block.last];
+
+    if(Opcodes::table[last.op].flags & Opcodes::FLAG_BRANCH)
+    {
+      for(size_t i = 0; i < block.edges.size(); i++)
+      {
+        const Edge &edge = block.edges[i];
+        const int to = insns[blocks[edge.to].first].address;
+
+        printf("           %s %02X:%04X +%d%s\n",
+               to == last.target ? "taken    " : "not taken",
+               to >> 16, to & 0xFFFF, edge.max,
+               edge.back ? " (loop)" : "");
+      }
+    }
+  }
+
+  printf("\nLoops (one iteration, calls included):\n");
+
+  int loops = 0;
+
+  for(size_t b = 0; b < blocks.size(); b++)
+  {
+    for(size_t i = 0; i < blocks[b].edges.size(); i++)
+    {
+      const Edge &edge = blocks[b].edges[i];
+
+      if(edge.back == false)
+        continue;
+
+      std::vector<bool> body;
+      std::vector<long long> best(blocks.size(), -2);
+      std::vector<long long> worst(blocks.size(), 0);
+
+      loopBody(edge.to, b, body);
+      iteration(edge.to, b, edge, body, best, worst);
+
+      const int head = insns[blocks[edge.to].first].address;
+      const int tail = insns[blocks[b].last].address;
+
+      printf("  %02X:%04X-%02X:%04X %-24.24s ",
+             head >> 16, head & 0xFFFF, tail >> 16, tail & 0xFFFF,
+             name(listing, head).c_str());
+
+      if(best[edge.to] < 0)
+        printf("no path\n");
+      else if(best[edge.to] == worst[edge.to])
+        printf("%lld cycles\n", worst[edge.to]);
+      else
+        printf("%lld..%lld cycles\n", best[edge.to], worst[edge.to]);
+
+      printSource(listing, head);
+      loops++;
+    }
+  }
+
+  if(loops == 0)
+    printf("  none\n");
+
+  printf("\nPaths to return or stop (loops once, calls included):\n");
+
+  std::vector<bool> shown(blocks.size(), false);
+
+  for(size_t i = 0; i < roots.size(); i++)
+  {
+    const int b = roots[i];
+
+    if(shown[b] == true)
+      continue;
+
+    shown[b] = true;
+    paths(b);
+
+    const int address = insns[blocks[b].first].address;
+
+    printf("  %02X:%04X %-24.24s best %lld, worst %lld cycles (%.1f us)\n",
+           address >> 16, address & 0xFFFF, name(listing, address).c_str(),
+           blocks[b].best, blocks[b].worst,
+           blocks[b].worst * 1000000.0 / Emulator::FCLK);
+    printSource(listing, address);
+  }
+
+  delete emu;
+  return 0;
+}
+
@@ -0,0 +1,175 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "Audio.H"
+#include "Emulator.H"
+
+namespace
+{
+  // each generator divides the clock by 16 then by its divisor
+  const double TONE_CLOCK = Emulator::FCLK / 16.0;
+
+  // per-generator level, leaves headroom when both are on
+  const double LEVEL = 0.4;
+
+  struct Voice
+  {
+    double phase;
+    double step;
+  };
+
+  // polynomial correction for a unit step at phase 0,
+  // removes most of the aliasing of a naive square wave
+  double polyBlep(double t, double dt)
+  {
+    if(t < dt)
+    {
+      t /= dt;
+      return t + t - t * t - 1.0;
+    }
+    else if(t > 1.0 - dt)
+    {
+      t = (t - 1.0) / dt;
+      return t * t + t + t + 1.0;
+    }
+
+    return 0.0;
+  }
+
+  double square(Voice &voice)
+  {
+    if(voice.step <= 0.0)
+      return 0.0;
+
+    const double dt = voice.step;
+    double value = voice.phase < 0.5 ? 1.0 : -1.0;
+    double half = voice.phase + 0.5;
+
+    if(half >= 1.0)
+      half -= 1.0;
+
+    value += polyBlep(voice.phase, dt);
+    value -= polyBlep(half, dt);
+
+    voice.phase += dt;
+
+    if(voice.phase >= 1.0)
+      voice.phase -= 1.0;
+
+    return value;
+  }
+
+  void setDivisor(Voice &voice, int divisor, int rate)
+  {
+    voice.step = 0.0;
+
+    if(divisor > 0)
+    {
+      const double freq = TONE_CLOCK / divisor;
+
+      // above Nyquist the output is inaudible and would only alias
+      if(freq < rate / 2)
+        voice.step = freq / rate;
+    }
+  }
+
+  void put16(FILE *fp, int value)
+  {
+    fputc(value & 0xFF, fp);
+    fputc((value >> 8) & 0xFF, fp);
+  }
+
+  void put32(FILE *fp, int value)
+  {
+    put16(fp, value & 0xFFFF);
+    put16(fp, (value >> 16) & 0xFFFF);
+  }
+}
+
+// 16-bit mono wav of tone events from cycle 0 to the end cycle
+bool Audio::render(const std::vector<Emulator::Event> &events,
+                   long long end, const char *filename, int rate)
+{
+  FILE *fp = fopen(filename, "wb");
+
+  if(fp == NULL)
+    return false;
+
+  const long long samples = end * rate / Emulator::FCLK;
+  const int data_size = samples * 2;
+
+  fwrite("RIFF", 1, 4, fp);
+  put32(fp, 36 + data_size);
+  fwrite("WAVEfmt ", 1, 8, fp);
+  put32(fp, 16);
+  put16(fp, 1);
+  put16(fp, 1);
+  put32(fp, rate);
+  put32(fp, rate * 2);
+  put16(fp, 2);
+  put16(fp, 16);
+  fwrite("data", 1, 4, fp);
+  put32(fp, data_size);
+
+  Voice voice[2] = { { 0.0, 0.0 }, { 0.0, 0.0 } };
+  std::vector<unsigned char> buffer;
+  size_t next = 0;
+
+  buffer.reserve(65536);
+
+  for(long long i = 0; i < samples; i++)
+  {
+    const long long cycle = i * Emulator::FCLK / rate;
+
+    while(next < events.size() && events[next].cycle <= cycle)
+    {
+      const Emulator::Event &ev = events[next++];
+
+      if(ev.type == Emulator::EVENT_TONE &&
+         ev.address >= 0 && ev.address <= 1)
+      {
+        setDivisor(voice[ev.address], ev.value, rate);
+      }
+    }
+
+    const double mix = (square(voice[0]) + square(voice[1])) * LEVEL;
+    const int value = (int)lrint(mix * 32767.0);
+
+    buffer.push_back(value & 0xFF);
+    buffer.push_back((value >> 8) & 0xFF);
+
+    if(buffer.size() >= 65536)
+    {
+      fwrite(&buffer[0], 1, buffer.size(), fp);
+      buffer.clear();
+    }
+  }
+
+  if(buffer.size() > 0)
+    fwrite(&buffer[0], 1, buffer.size(), fp);
+
+  return fclose(fp) == 0;
+}
+
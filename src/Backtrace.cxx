@@ -0,0 +1,265 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <cstdio>
+#include <map>
+#include <string>
+
+#include <FL/Fl.H>
+#include <FL/Fl_Double_Window.H>
+#include <FL/Fl_Input.H>
+#include <FL/Fl_Text_Buffer.H>
+#include <FL/Fl_Text_Display.H>
+
+#include "Backtrace.H"
+#include "Dialog.H"
+#include "Gui.H"
+#include "Listing.H"
+#include "Monitor.H"
+#include "Terminal.H"
+
+namespace
+{
+  // frames shown
+  const int DEPTH = 16;
+
+  // bytes read above the stack pointer
+  const int STACK = 256;
+
+  // code bytes fetched from the board per refresh, outside the listing
+  const int FETCHES = 24;
+
+  Fl_Double_Window *window = 0;
+  Fl_Input *input_listing;
+  Fl_Text_Buffer *text;
+  Fl_Text_Display *display;
+
+  Listing listing;
+  bool have_listing = false;
+
+  int last[8];
+  bool have_regs = false;
+
+  // code bytes read during this refresh, -1 for unreadable
+  std::map<int, int> cache;
+
+  // opcode at an address: from the listing when it covers it,
+  // otherwise from the board
+  int opcodeAt(int address)
+  {
+    if(have_listing == true)
+    {
+      const int i = listing.find(address);
+
+      if(i >= 0)
+      {
+        const Listing::Instruction &ins = listing.instructions[i];
+
+        if(ins.address != address || ins.data == true)
+          return -1;
+
+        return ins.opcode;
+      }
+    }
+
+    if(cache.count(address) > 0)
+      return cache[address];
+
+    if((int)cache.size() >= FETCHES)
+      return -1;
+
+    unsigned char c;
+    const int value = Terminal::readMemory(address, &c, 1) == 1 ? c : -1;
+
+    cache[address] = value;
+    return value;
+  }
+
+  std::string describe(int number, int address, const char *how)
+  {
+    char s[256];
+    std::string name;
+    int offset = 0;
+    const Listing::Symbol *sym =
+      have_listing == true ? listing.symbolize(address, &offset) : 0;
+
+    if(sym != 0)
+    {
+      char o[32];
+
+      name = sym->name;
+
+      if(offset > 0)
+      {
+        sprintf(o, "+%d", offset);
+        name += o;
+      }
+    }
+    else if((address & 0xFFFF) >= 0xE000)
+    {
+      name = "(monitor)";
+    }
+
+    snprintf(s, sizeof(s), "#%-2d %02X:%04X  %-20s %s\n", number,
+             address >> 16, address & 0xFFFF, name.c_str(), how);
+
+    return s;
+  }
+
+  // walk up the stack, keeping words that return just past a call
+  std::string walk(const int *regs)
+  {
+    const bool is134 = Gui::getMode() == Gui::MODE_134;
+    const int pc = regs[Monitor::REG_PC];
+    unsigned char stack[STACK];
+    int first, count;
+    std::string result;
+
+    if(is134 == true)
+    {
+      first = 0x100 + ((regs[Monitor::REG_SP] + 1) & 0xFF);
+      count = 0x200 - first;
+    }
+    else
+    {
+      first = (regs[Monitor::REG_SP] + 1) & 0xFFFF;
+      count = STACK;
+
+      if(first + count > 0x10000)
+        count = 0x10000 - first;
+    }
+
+    result = describe(0, pc, "");
+    cache.clear();
+
+    // one transfer for the whole stack
+    count = Terminal::readMemory(first, stack, count);
+
+    int bank = pc & 0xFF0000;
+    int frames = 1;
+    int i = 0;
+
+    while(i < count - 1 && frames < DEPTH)
+    {
+      char how[64];
+
+      // JSL pushes the bank and the address of its last byte
+      if(is134 == false && i < count - 2)
+      {
+        const int ret = stack[i] | (stack[i + 1] << 8) | (stack[i + 2] << 16);
+        const int site = (ret & 0xFF0000) | ((ret - 3) & 0xFFFF);
+
+        if(opcodeAt(site) == 0x22)
+        {
+          sprintf(how, "JSL, S=%04X", first + i - 1);
+          result += describe(frames++, site, how);
+          bank = site & 0xFF0000;
+          i += 3;
+          continue;
+        }
+      }
+
+      // JSR stays in the caller's bank
+      const int ret = stack[i] | (stack[i + 1] << 8);
+      const int site = bank | ((ret - 2) & 0xFFFF);
+      const int op = opcodeAt(site);
+
+      if(op == 0x20 || (op == 0xFC && is134 == false))
+      {
+        sprintf(how, "JSR, S=%04X", first + i - 1);
+        result += describe(frames++, site, how);
+        i += 2;
+        continue;
+      }
+
+      i++;
+    }
+
+    if(count <= 0)
+      result += "(stack not readable)\n";
+
+    return result;
+  }
+
+  void loadListing()
+  {
+    have_listing = false;
+
+    if(input_listing->value()[0] == 0)
+      return;
+
+    if(listing.load(input_listing->value()) == false)
+    {
+      Dialog::message("Error", "Could not load listing.");
+      return;
+    }
+
+    have_listing = true;
+
+    if(have_regs == true)
+      Backtrace::update(last);
+  }
+
+  void init()
+  {
+    window = new Fl_Double_Window(384, 256, "Backtrace");
+    input_listing = new Fl_Input(64, 8, 384 - 64 - 8, 24, "Listing:");
+    input_listing->when(FL_WHEN_ENTER_KEY | FL_WHEN_NOT_CHANGED);
+    input_listing->callback((Fl_Callback *)loadListing);
+    input_listing->tooltip("naken_asm listing for symbols, Enter loads it");
+    text = new Fl_Text_Buffer();
+    display = new Fl_Text_Display(8, 40, 384 - 16, 256 - 48);
+    display->buffer(text);
+    display->textfont(FL_COURIER);
+    display->textsize(12);
+    window->resizable(display);
+    window->end();
+  }
+}
+
+void Backtrace::show()
+{
+  if(window == 0)
+    init();
+
+  window->show();
+
+  if(have_regs == true)
+    update(last);
+}
+
+// called on every register refresh, quiet unless the window is open
+void Backtrace::update(const int *regs)
+{
+  for(int i = 0; i < 8; i++)
+    last[i] = regs[i];
+
+  have_regs = true;
+
+  if(window == 0 || window->shown() == 0 ||
+     Terminal::isConnected() == false)
+  {
+    return;
+  }
+
+  text->text(walk(regs).c_str());
+}
+
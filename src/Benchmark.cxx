@@ -0,0 +1,564 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <FL/Fl.H>
+#include <FL/Fl_Native_File_Chooser.H>
+
+#include "Benchmark.H"
+#include "Dialog.H"
+#include "Emulator.H"
+#include "Gui.H"
+#include "Harness.H"
+#include "Listing.H"
+#include "Terminal.H"
+
+#if defined(_MSC_VER)
+#define strcasecmp _stricmp
+#endif
+
+namespace
+{
+  // harness variables at the start of the buffer
+  const int RUN = 0;
+  const int LEFT = 2;
+  const int INDEX = 4;
+  const int TMP = 6;
+  const int SAVE = 10;
+  const int CODE = 0x10;
+
+  // past the two empty routines
+  const int ENTRY = CODE + 2;
+
+  // timer registers
+  const int TCR = 0xDF42;
+  const int TER = 0xDF43;
+  const int TIFR = 0xDF44;
+  const int T2LL = 0xDF54;
+  const int T2CL = 0xDF64;
+  const int T2CH = 0xDF65;
+
+  // timer 2 counts FCLK / 16
+  const int T2_PRESCALE = 16;
+
+  const int MAX_ROUTINES = 32;
+  const int MAX_RUNS = 256;
+
+  struct Routine
+  {
+    std::string name;
+    int address;
+    bool jsr;
+  };
+
+  struct Plan
+  {
+    char image[1024];
+    char listing[1024];
+    std::vector<std::string> names;
+    std::vector<bool> jsr;
+    int buffer;
+    int count;
+    int runs;
+    int seconds;
+  };
+
+  char load_dir[256];
+
+  // plan files:
+  //   image bench.hex     (optional, relative to the plan)
+  //   listing bench.lst   (optional, names routines)
+  //   buffer 006000       (free RAM for the harness and results)
+  //   count 100           (calls per run)
+  //   runs 10             (runs per routine, for the variance)
+  //   timeout 30          (seconds to wait for the harness)
+  //   jsr delay           (label or address, returns with RTS)
+  //   jsl 002000          (returns with RTL)
+  bool parsePlan(const char *filename, Plan &plan)
+  {
+    FILE *fp = fopen(filename, "r");
+
+    if(fp == NULL)
+      return false;
+
+    plan.image[0] = '\0';
+    plan.listing[0] = '\0';
+    plan.buffer = 0x6000;
+    plan.count = 100;
+    plan.runs = 10;
+    plan.seconds = 30;
+
+    char line[1024];
+    char dir[1024];
+
+    strcpy(dir, filename);
+
+    char *slash = strrchr(dir, '/');
+
+    if(slash != NULL)
+      slash[1] = '\0';
+    else
+      dir[0] = '\0';
+
+    while(fgets(line, sizeof(line), fp) != NULL)
+    {
+      char *comment = strchr(line, '#');
+
+      if(comment != NULL)
+        *comment = '\0';
+
+      char word[256];
+      char arg[768];
+      int value;
+
+      if(sscanf(line, "%255s", word) != 1 ||
+         sscanf(line, "%*s %767s", arg) != 1)
+      {
+        continue;
+      }
+
+      if(strcmp(word, "image") == 0 || strcmp(word, "listing") == 0)
+      {
+        char *dest = word[0] == 'i' ? plan.image : plan.listing;
+
+        if(arg[0] == '/')
+          snprintf(dest, sizeof(plan.image), "%s", arg);
+        else
+          snprintf(dest, sizeof(plan.image), "%s%s", dir, arg);
+      }
+      else if(strcmp(word, "buffer") == 0 && sscanf(arg, "%x", &value) == 1)
+      {
+        plan.buffer = value & 0xFFFFFF;
+      }
+      else if(strcmp(word, "count") == 0)
+      {
+        plan.count = atoi(arg);
+      }
+      else if(strcmp(word, "runs") == 0)
+      {
+        plan.runs = atoi(arg);
+      }
+      else if(strcmp(word, "timeout") == 0)
+      {
+        plan.seconds = atoi(arg);
+      }
+      else if(strcmp(word, "jsr") == 0 || strcmp(word, "jsl") == 0)
+      {
+        plan.names.push_back(arg);
+        plan.jsr.push_back(strcmp(word, "jsr") == 0);
+      }
+    }
+
+    fclose(fp);
+    return true;
+  }
+
+  // labels from the listing, otherwise hex addresses
+  bool resolve(const Plan &plan, const Listing *listing,
+               std::vector<Routine> &routines)
+  {
+    for(size_t i = 0; i < plan.names.size(); i++)
+    {
+      Routine routine;
+      char *end;
+
+      routine.name = plan.names[i];
+      routine.jsr = plan.jsr[i];
+      routine.address = -1;
+
+      if(listing != NULL)
+      {
+        for(size_t j = 0; j < listing->symbols.size(); j++)
+        {
+          if(listing->symbols[j].name == routine.name)
+          {
+            routine.address = listing->symbols[j].address;
+            break;
+          }
+        }
+      }
+
+      if(routine.address < 0)
+      {
+        routine.address = strtol(routine.name.c_str(), &end, 16);
+
+        if(*end != '\0')
+        {
+          char s[256];
+
+          snprintf(s, sizeof(s), "Unknown routine %s.", routine.name.c_str());
+          Dialog::message("Error", s);
+          return false;
+        }
+      }
+
+      routines.push_back(routine);
+    }
+
+    return true;
+  }
+
+  // time count calls to one routine, runs times, with 16-bit registers;
+  // each run stores the timer and its underflow flag in the results
+  void emitRoutine(Harness::Code &code, int base, const Routine &routine,
+                   int count, int runs, int results)
+  {
+    code.op8(0xC2, 0x30);                   // rep #$30
+    code.op16(0xA9, runs);                  // lda #runs
+    code.op24(0x8F, base + RUN);            // sta >RUN
+
+    const int run = code.here();
+
+    code.op8(0xE2, 0x20);                   // sep #$20
+    code.op8(0xA9, 0xFF);                   // lda #$FF
+    code.op24(0x8F, T2LL);                  // sta >T2LL
+    code.op24(0x8F, T2CH);                  // sta >T2CH, reloads T2
+    code.op8(0xA9, 0x04);                   // lda #$04
+    code.op24(0x8F, TIFR);                  // sta >TIFR
+    code.op8(0xC2, 0x20);                   // rep #$20
+    code.op16(0xA9, count);                 // lda #count
+    code.op24(0x8F, base + LEFT);           // sta >LEFT
+
+    const int call = code.here();
+
+    if(routine.jsr == true)
+      code.op16(0x20, routine.address);     // jsr routine
+    else
+      code.op24(0x22, routine.address);     // jsl routine
+
+    code.op8(0xC2, 0x30);                   // rep #$30
+    code.op24(0xAF, base + LEFT);           // lda >LEFT
+    code.op(0x3A);                          // dec
+    code.op24(0x8F, base + LEFT);           // sta >LEFT
+    code.op8(0xD0, call - (code.here() + 2)); // bne call
+
+    // read the count before anything else
+    code.op24(0xAF, T2CL);                  // lda >T2CL
+    code.op24(0x8F, base + TMP);            // sta >TMP
+    code.op8(0xE2, 0x20);                   // sep #$20
+    code.op24(0xAF, TIFR);                  // lda >TIFR
+    code.op8(0x29, 0x04);                   // and #$04
+    code.op24(0x8F, base + TMP + 2);        // sta >TMP+2
+    code.op8(0xC2, 0x30);                   // rep #$30
+    code.op24(0xAF, base + INDEX);          // lda >INDEX
+    code.op(0xAA);                          // tax
+    code.op24(0xAF, base + TMP);            // lda >TMP
+    code.op24(0x9F, results);               // sta >RESULTS,x
+    code.op24(0xAF, base + TMP + 2);        // lda >TMP+2
+    code.op16(0x29, 0x00FF);                // and #$00FF
+    code.op24(0x9F, results + 2);           // sta >RESULTS+2,x
+    code.op(0x8A);                          // txa
+    code.op(0x18);                          // clc
+    code.op16(0x69, 4);                     // adc #4
+    code.op24(0x8F, base + INDEX);          // sta >INDEX
+    code.op24(0xAF, base + RUN);            // lda >RUN
+    code.op(0x3A);                          // dec
+    code.op24(0x8F, base + RUN);            // sta >RUN
+    code.op8(0xF0, 3);                      // beq done
+    code.op16(0x4C, run);                   // jmp run
+  }
+
+  // called with JSL, runs every routine with interrupts off and
+  // timer 2 set up as in the tape data recorder sample
+  int build(Harness::Code &code, int base, std::vector<Routine> &routines,
+            int count, int runs)
+  {
+    int results = 0;
+
+    for(int pass = 0; pass < 2; pass++)
+    {
+      code.bytes.assign(CODE, 0);
+      code.base = base;
+
+      // empty routines measure the harness itself
+      const int rtl = code.here();
+
+      code.op(0x6B);                        // rtl
+
+      const int rts = code.here();
+
+      code.op(0x60);                        // rts
+
+      routines[0].address = rtl;
+      routines[1].address = rts;
+
+      code.op(0x08);                        // php
+      code.op(0x78);                        // sei
+      code.op8(0xE2, 0x20);                 // sep #$20
+      code.op24(0xAF, TCR);                 // lda >TCR
+      code.op24(0x8F, base + SAVE);         // sta >SAVE
+      code.op24(0xAF, TER);                 // lda >TER
+      code.op24(0x8F, base + SAVE + 1);     // sta >SAVE+1
+      code.op8(0xA9, 0x18);                 // lda #$18
+      code.op24(0x8F, TCR);                 // sta >TCR
+      code.op24(0xAF, TER);                 // lda >TER
+      code.op8(0x09, 0x04);                 // ora #$04
+      code.op24(0x8F, TER);                 // sta >TER
+      code.op8(0xC2, 0x30);                 // rep #$30
+      code.op16(0xA9, 0);                   // lda #0
+      code.op24(0x8F, base + INDEX);        // sta >INDEX
+
+      for(size_t i = 0; i < routines.size(); i++)
+        emitRoutine(code, base, routines[i], count, runs, results);
+
+      code.op8(0xE2, 0x20);                 // sep #$20
+      code.op24(0xAF, base + SAVE);         // lda >SAVE
+      code.op24(0x8F, TCR);                 // sta >TCR
+      code.op24(0xAF, base + SAVE + 1);     // lda >SAVE+1
+      code.op24(0x8F, TER);                 // sta >TER
+      code.op(0x28);                        // plp
+      code.op(0x6B);                        // rtl
+
+      results = (code.here() + 1) & ~1;
+
+      if(pass == 1)
+        code.bytes.resize(results - base, 0);
+
+    }
+
+    return results;
+  }
+
+  struct Stats
+  {
+    double mean;
+    double low;
+    double high;
+    double deviation;
+    bool overflow;
+  };
+
+  // cycles per call for each run of one routine
+  Stats measure(const unsigned char *data, int count, int runs)
+  {
+    Stats stats;
+    std::vector<double> values;
+
+    stats.overflow = false;
+
+    for(int i = 0; i < runs; i++)
+    {
+      const unsigned char *p = data + i * 4;
+      const int ticks = 0xFFFF - (p[0] | (p[1] << 8));
+
+      if(p[2] != 0)
+        stats.overflow = true;
+
+      values.push_back((double)ticks * T2_PRESCALE / count);
+    }
+
+    stats.mean = 0;
+    stats.low = values[0];
+    stats.high = values[0];
+
+    for(int i = 0; i < runs; i++)
+    {
+      stats.mean += values[i];
+      stats.low = values[i] < stats.low ? values[i] : stats.low;
+      stats.high = values[i] > stats.high ? values[i] : stats.high;
+    }
+
+    stats.mean /= runs;
+    stats.deviation = 0;
+
+    for(int i = 0; i < runs; i++)
+      stats.deviation += (values[i] - stats.mean) * (values[i] - stats.mean);
+
+    stats.deviation = runs > 1 ? std::sqrt(stats.deviation / (runs - 1)) : 0;
+
+    return stats;
+  }
+}
+
+void Benchmark::begin()
+{
+  if(Terminal::isConnected() == false)
+  {
+    Dialog::message("Error", "Not Connected.");
+    return;
+  }
+
+  if(Gui::getMode() != Gui::MODE_265)
+  {
+    Dialog::message("Error", "Benchmarks use the W65C265 timers.");
+    return;
+  }
+
+  Fl_Native_File_Chooser fc;
+  fc.title("Benchmark");
+  fc.filter("Plan File\t*.txt\n");
+  fc.options(Fl_Native_File_Chooser::PREVIEW);
+  fc.type(Fl_Native_File_Chooser::BROWSE_FILE);
+  fc.directory(load_dir);
+
+  switch(fc.show())
+  {
+    case -1:
+    case 1:
+      return;
+    default:
+      strcpy(load_dir, fc.filename());
+      if(strrchr(load_dir, '/') != NULL)
+        strrchr(load_dir, '/')[1] = '\0';
+      break;
+  }
+
+  run(fc.filename());
+}
+
+bool Benchmark::run(const char *filename)
+{
+  Terminal::Hold hold;
+
+  Plan plan;
+
+  if(parsePlan(filename, plan) == false)
+  {
+    Dialog::message("Error", "Could not open plan file.");
+    return false;
+  }
+
+  if(plan.names.size() == 0 || (int)plan.names.size() > MAX_ROUTINES ||
+     plan.count < 1 || plan.count > 65535 ||
+     plan.runs < 1 || plan.runs > MAX_RUNS)
+  {
+    Dialog::message("Error", "Plan needs 1 to 32 routines, a count up to\n"
+                             "65535 and 1 to 256 runs.");
+    return false;
+  }
+
+  Listing listing;
+
+  if(plan.listing[0] != '\0' && listing.load(plan.listing) == false)
+  {
+    Dialog::message("Error", "Could not load listing.");
+    return false;
+  }
+
+  // the two empty routines come first
+  std::vector<Routine> routines(2);
+
+  routines[0].name = "(empty jsl)";
+  routines[0].jsr = false;
+  routines[1].name = "(empty jsr)";
+  routines[1].jsr = true;
+
+  if(resolve(plan, plan.listing[0] != '\0' ? &listing : NULL,
+             routines) == false)
+  {
+    return false;
+  }
+
+  for(size_t i = 2; i < routines.size(); i++)
+  {
+    if(routines[i].jsr == true &&
+       (routines[i].address & 0xFF0000) != (plan.buffer & 0xFF0000))
+    {
+      Dialog::message("Error", "JSR routines must be in the buffer's bank.");
+      return false;
+    }
+  }
+
+  Harness::Code code;
+  const int results = build(code, plan.buffer, routines,
+                            plan.count, plan.runs);
+  const int size = routines.size() * plan.runs * 4;
+
+  if(plan.image[0] != '\0')
+  {
+    const char *ext = strrchr(plan.image, '.');
+
+    if(ext != NULL && strcasecmp(ext, ".srec") == 0)
+      Terminal::uploadSrec(plan.image);
+    else
+      Terminal::uploadHex(plan.image);
+  }
+
+  Gui::append("\nInstalling benchmark harness.\n");
+
+  if(Harness::install(code) == false)
+    return false;
+
+  Gui::append("Running, ESC to stop waiting.\n");
+
+  if(Harness::call(plan.buffer + ENTRY, plan.seconds) == false)
+  {
+    Dialog::message("Error", "The harness did not return to the monitor.");
+    return false;
+  }
+
+  std::vector<unsigned char> data(size);
+
+  if(Terminal::readMemory(results, &data[0], size) != size)
+  {
+    Dialog::message("Error", "Could not read the results.");
+    return false;
+  }
+
+  // the cost of an empty routine is taken off each of its kind
+  const Stats empty[2] =
+  {
+    measure(&data[0], plan.count, plan.runs),
+    measure(&data[plan.runs * 4], plan.count, plan.runs)
+  };
+
+  std::string report;
+  char s[256];
+
+  snprintf(s, sizeof(s), "\n%d runs of %d calls, +/-%.2f cycles, "
+           "harness %.1f (JSL) %.1f (JSR) cycles per call\n",
+           plan.runs, plan.count, (double)T2_PRESCALE / plan.count,
+           empty[0].mean, empty[1].mean);
+  report += s;
+  snprintf(s, sizeof(s), "%-20s %10s %10s %10s %8s %10s\n", "routine",
+           "cycles", "min", "max", "stddev", "us");
+  report += s;
+
+  for(size_t i = 2; i < routines.size(); i++)
+  {
+    Stats stats = measure(&data[i * plan.runs * 4], plan.count, plan.runs);
+    const double base = empty[routines[i].jsr ? 1 : 0].mean;
+
+    if(stats.overflow == true)
+    {
+      snprintf(s, sizeof(s), "%-20s timer overflow, lower the count\n",
+               routines[i].name.c_str());
+      report += s;
+      continue;
+    }
+
+    snprintf(s, sizeof(s), "%-20s %10.1f %10.1f %10.1f %8.2f %10.2f\n",
+             routines[i].name.c_str(), stats.mean - base, stats.low - base,
+             stats.high - base, stats.deviation,
+             (stats.mean - base) * 1000000.0 / Emulator::FCLK);
+    report += s;
+  }
+
+  Gui::append(report.c_str());
+  return true;
+}
+
@@ -0,0 +1,471 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <FL/Fl.H>
+#include <FL/Fl_Native_File_Chooser.H>
+
+#include "Agent.H"
+#include "Checkpoint.H"
+#include "Dialog.H"
+#include "Gui.H"
+#include "Terminal.H"
+
+namespace
+{
+  const char MAGIC[4] = { 'S', 'X', 'B', 'C' };
+  const int VERSION = 1;
+
+  // unit compared with the agent's CRC before writing
+  const int PAGE = 256;
+
+  char load_dir[256];
+
+  // counts for the summary
+  int written;
+  int filled;
+  int unchanged;
+
+  void put32(FILE *fp, int value)
+  {
+    for(int i = 0; i < 4; i++)
+      fputc((value >> (i * 8)) & 0xFF, fp);
+  }
+
+  bool get32(FILE *fp, int *value)
+  {
+    *value = 0;
+
+    for(int i = 0; i < 4; i++)
+    {
+      const int c = fgetc(fp);
+
+      if(c == EOF)
+        return false;
+
+      *value |= c << (i * 8);
+    }
+
+    return true;
+  }
+
+  // PackBits: a count byte 0-127 is followed by count + 1 literal bytes,
+  // 129-255 repeats the next byte 257 - count times
+  void pack(const std::vector<unsigned char> &in,
+            std::vector<unsigned char> &out)
+  {
+    size_t i = 0;
+
+    out.clear();
+
+    while(i < in.size())
+    {
+      size_t run = 1;
+
+      while(i + run < in.size() && run < 128 && in[i + run] == in[i])
+        run++;
+
+      if(run >= 3)
+      {
+        out.push_back(257 - run);
+        out.push_back(in[i]);
+        i += run;
+        continue;
+      }
+
+      // literals until the next run of three
+      size_t end = i;
+
+      while(end < in.size() && end - i < 128)
+      {
+        if(end + 2 < in.size() &&
+           in[end] == in[end + 1] && in[end] == in[end + 2])
+        {
+          break;
+        }
+
+        end++;
+      }
+
+      out.push_back(end - i - 1);
+      out.insert(out.end(), in.begin() + i, in.begin() + end);
+      i = end;
+    }
+  }
+
+  bool unpack(const std::vector<unsigned char> &in,
+              std::vector<unsigned char> &out, size_t size)
+  {
+    size_t i = 0;
+
+    out.clear();
+
+    while(i < in.size() && out.size() < size)
+    {
+      const int count = in[i++];
+
+      if(count < 128)
+      {
+        if(i + count + 1 > in.size())
+          return false;
+
+        out.insert(out.end(), in.begin() + i, in.begin() + i + count + 1);
+        i += count + 1;
+      }
+      else if(count > 128)
+      {
+        if(i >= in.size())
+          return false;
+
+        out.insert(out.end(), 257 - count, in[i++]);
+      }
+    }
+
+    return out.size() == size;
+  }
+
+  // "start-end" pairs in hex, split at bank boundaries
+  bool parseRanges(const char *s, std::vector<std::pair<int, int> > &ranges)
+  {
+    while(*s != 0)
+    {
+      int first, last, used = 0;
+
+      while(*s == ' ' || *s == ',')
+        s++;
+
+      if(*s == 0)
+        break;
+
+      if(sscanf(s, "%x-%x%n", &first, &last, &used) != 2 ||
+         first > last || last > 0xFFFFFF)
+      {
+        return false;
+      }
+
+      s += used;
+
+      while(first <= last)
+      {
+        const int count = std::min(last, first | 0xFFFF) - first + 1;
+
+        ranges.push_back(std::make_pair(first, count));
+        first += count;
+      }
+    }
+
+    return ranges.size() > 0;
+  }
+
+  // upload around the agent's own block so it keeps running
+  bool put(int address, const unsigned char *data, int count)
+  {
+    int i = 0;
+
+    while(i < count)
+    {
+      if(Agent::contains(address + i) == true)
+      {
+        i++;
+        continue;
+      }
+
+      int end = i;
+
+      while(end < count && Agent::contains(address + end) == false)
+        end++;
+
+      if(Terminal::uploadData(address + i, data + i, end - i) == false)
+        return false;
+
+      i = end;
+    }
+
+    return true;
+  }
+
+  // pages the board already holds are skipped, pages of one value are
+  // filled, the rest go up together in as few uploads as possible
+  bool restoreRange(int address, const std::vector<unsigned char> &data)
+  {
+    const int count = data.size();
+    const bool agent = Agent::enter();
+    int pending = -1;
+
+    for(int pos = 0; pos <= count; pos += PAGE)
+    {
+      const int size = std::min(PAGE, count - pos);
+      bool skip = false;
+      bool fill = false;
+
+      if(size > 0 && agent == true)
+      {
+        bool inside = false;
+
+        for(int i = 0; i < size; i++)
+          inside |= Agent::contains(address + pos + i);
+
+        skip = Agent::crc(address + pos, size) ==
+               Agent::crc16(&data[pos], size);
+        fill = inside == false && Agent::isActive() == true &&
+               std::count(data.begin() + pos, data.begin() + pos + size,
+                          data[pos]) == size;
+      }
+
+      // send what has been collected before this page
+      if(pending >= 0 && (size <= 0 || skip == true || fill == true))
+      {
+        if(put(address + pending, &data[pending], pos - pending) == false)
+          return false;
+
+        pending = -1;
+      }
+
+      if(size <= 0)
+        break;
+
+      if(skip == true)
+      {
+        unchanged++;
+      }
+      else if(fill == true)
+      {
+        if(Agent::fill(address + pos, size, data[pos]) == false)
+          return false;
+
+        filled++;
+      }
+      else
+      {
+        if(pending < 0)
+          pending = pos;
+
+        written++;
+      }
+    }
+
+    return true;
+  }
+}
+
+// called by the dialog with the ranges to save
+void Checkpoint::save(const char *ranges)
+{
+  Fl_Native_File_Chooser fc;
+  fc.title("Save Checkpoint");
+  fc.filter("Checkpoint\t*.sxbc\n");
+  fc.options(Fl_Native_File_Chooser::SAVEAS_CONFIRM);
+  fc.type(Fl_Native_File_Chooser::BROWSE_SAVE_FILE);
+  fc.directory(load_dir);
+
+  switch(fc.show())
+  {
+    case -1:
+    case 1:
+      return;
+  }
+
+  write(fc.filename(), ranges);
+}
+
+void Checkpoint::restore()
+{
+  if(Terminal::isConnected() == false)
+  {
+    Dialog::message("Error", "Not Connected.");
+    return;
+  }
+
+  Fl_Native_File_Chooser fc;
+  fc.title("Load Checkpoint");
+  fc.filter("Checkpoint\t*.sxbc\n");
+  fc.options(Fl_Native_File_Chooser::PREVIEW);
+  fc.type(Fl_Native_File_Chooser::BROWSE_FILE);
+  fc.directory(load_dir);
+
+  switch(fc.show())
+  {
+    case -1:
+    case 1:
+      return;
+    default:
+      strcpy(load_dir, fc.filename());
+      if(strrchr(load_dir, '/') != NULL)
+        strrchr(load_dir, '/')[1] = '\0';
+      break;
+  }
+
+  read(fc.filename());
+}
+
+// file: magic, version, board model, eight registers in REG_ order, then
+// address, size and packed length of each range followed by its bytes
+bool Checkpoint::write(const char *filename, const char *text)
+{
+  std::vector<std::pair<int, int> > ranges;
+  int regs[8];
+
+  if(parseRanges(text, ranges) == false)
+  {
+    Dialog::message("Error", "Ranges are hex start-end pairs.");
+    return false;
+  }
+
+  if(Terminal::readRegs(regs) == false)
+  {
+    Dialog::message("Error", "Could not read the registers.");
+    return false;
+  }
+
+  FILE *fp = fopen(filename, "wb");
+
+  if(fp == NULL)
+  {
+    Dialog::message("Error", "Could not create checkpoint file.");
+    return false;
+  }
+
+  fwrite(MAGIC, 1, 4, fp);
+  fputc(VERSION, fp);
+  fputc(Gui::getMode(), fp);
+
+  for(int i = 0; i < 8; i++)
+    put32(fp, regs[i]);
+
+  int total = 0;
+
+  for(size_t i = 0; i < ranges.size(); i++)
+  {
+    std::vector<unsigned char> data(ranges[i].second);
+    std::vector<unsigned char> packed;
+
+    if(Terminal::readMemory(ranges[i].first, &data[0], data.size()) !=
+       (int)data.size())
+    {
+      fclose(fp);
+      Dialog::message("Error", "Could not read memory.");
+      return false;
+    }
+
+    pack(data, packed);
+    put32(fp, ranges[i].first);
+    put32(fp, data.size());
+    put32(fp, packed.size());
+    fwrite(&packed[0], 1, packed.size(), fp);
+    total += data.size();
+  }
+
+  fclose(fp);
+
+  char s[256];
+
+  snprintf(s, sizeof(s), "\nCheckpoint saved, %d bytes in %d ranges.\n",
+           total, (int)ranges.size());
+  Gui::append(s);
+
+  return true;
+}
+
+// memory first, through the agent when it is resident, then every
+// register in one monitor command
+bool Checkpoint::read(const char *filename)
+{
+  FILE *fp = fopen(filename, "rb");
+
+  if(fp == NULL)
+  {
+    Dialog::message("Error", "Could not open checkpoint file.");
+    return false;
+  }
+
+  char magic[4];
+  int regs[8];
+  bool ok = fread(magic, 1, 4, fp) == 4 &&
+            memcmp(magic, MAGIC, 4) == 0 && fgetc(fp) == VERSION;
+
+  if(ok == true && fgetc(fp) != Gui::getMode())
+  {
+    fclose(fp);
+    Dialog::message("Error", "Checkpoint is for another board.");
+    return false;
+  }
+
+  for(int i = 0; i < 8 && ok == true; i++)
+    ok = get32(fp, &regs[i]);
+
+  // a damaged file must not leave the board half restored
+  std::vector<std::pair<int, std::vector<unsigned char> > > ranges;
+  int address, size, length;
+
+  while(ok == true && get32(fp, &address) == true)
+  {
+    std::vector<unsigned char> packed;
+    std::vector<unsigned char> data;
+
+    ok = get32(fp, &size) == true && get32(fp, &length) == true &&
+         size > 0 && size <= 0x10000 && length > 0 && length <= 0x20000;
+
+    if(ok == false)
+      break;
+
+    packed.resize(length);
+    ok = (int)fread(&packed[0], 1, length, fp) == length &&
+         unpack(packed, data, size) == true;
+
+    if(ok == true)
+      ranges.push_back(std::make_pair(address, data));
+  }
+
+  fclose(fp);
+
+  if(ok == false)
+  {
+    Dialog::message("Error", "Not a valid checkpoint file.");
+    return false;
+  }
+
+  written = filled = unchanged = 0;
+
+  for(size_t i = 0; i < ranges.size(); i++)
+  {
+    if(restoreRange(ranges[i].first, ranges[i].second) == false)
+    {
+      Dialog::message("Error", "Could not write memory.");
+      return false;
+    }
+  }
+
+  Terminal::setRegs(regs);
+  Terminal::updateRegs();
+
+  char s[256];
+
+  snprintf(s, sizeof(s), "\nCheckpoint restored, %d pages written, "
+           "%d filled, %d unchanged.\n", written, filled, unchanged);
+  Gui::append(s);
+
+  return true;
+}
+
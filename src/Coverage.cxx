@@ -0,0 +1,262 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+#include "Coverage.H"
+#include "Listing.H"
+#include "Opcodes.H"
+
+namespace
+{
+  const int BITMAP_SIZE = 0x1000000 / 8;
+
+  bool testBit(const unsigned char *bits, int address)
+  {
+    return (bits[(address & 0xFFFFFF) >> 3] >> (address & 7)) & 1;
+  }
+
+  void orBits(unsigned char *dest, const unsigned char *src)
+  {
+    unsigned long long *d = (unsigned long long *)dest;
+    const unsigned long long *s = (const unsigned long long *)src;
+
+    for(int i = 0; i < BITMAP_SIZE / 8; i++)
+      d[i] |= s[i];
+  }
+
+  bool isBranch(const Listing::Instruction &ins)
+  {
+    return ins.data == false && ins.opcode >= 0 &&
+           (Opcodes::table[ins.opcode].flags & Opcodes::FLAG_BRANCH);
+  }
+
+  // summary of the instructions generated by one source line
+  struct LineState
+  {
+    bool code;
+    bool executed;
+    bool branch;
+    bool taken;
+    bool not_taken;
+  };
+
+  LineState lineState(const Coverage *cov, const Listing &listing,
+                      const Listing::Line &line)
+  {
+    LineState state;
+
+    memset(&state, 0, sizeof(state));
+
+    for(int i = line.first; i < line.first + line.count; i++)
+    {
+      const Listing::Instruction &ins = listing.instructions[i];
+
+      if(ins.data == true)
+        continue;
+
+      state.code = true;
+
+      if(cov->isExecuted(ins.address))
+        state.executed = true;
+
+      if(isBranch(ins))
+      {
+        state.branch = true;
+
+        if(cov->isTaken(ins.address))
+          state.taken = true;
+
+        if(cov->isNotTaken(ins.address))
+          state.not_taken = true;
+      }
+    }
+
+    return state;
+  }
+}
+
+// calloc leaves untouched pages unmapped, so idle bitmaps cost nothing
+Coverage::Coverage()
+{
+  executed = (unsigned char *)calloc(BITMAP_SIZE, 1);
+  branch_taken = (unsigned char *)calloc(BITMAP_SIZE, 1);
+  branch_not_taken = (unsigned char *)calloc(BITMAP_SIZE, 1);
+}
+
+Coverage::~Coverage()
+{
+  free(executed);
+  free(branch_taken);
+  free(branch_not_taken);
+}
+
+void Coverage::clear()
+{
+  memset(executed, 0, BITMAP_SIZE);
+  memset(branch_taken, 0, BITMAP_SIZE);
+  memset(branch_not_taken, 0, BITMAP_SIZE);
+}
+
+void Coverage::merge(const Coverage *other)
+{
+  orBits(executed, other->executed);
+  orBits(branch_taken, other->branch_taken);
+  orBits(branch_not_taken, other->branch_not_taken);
+}
+
+bool Coverage::isExecuted(int address) const
+{
+  return testBit(executed, address);
+}
+
+bool Coverage::isTaken(int address) const
+{
+  return testBit(branch_taken, address);
+}
+
+bool Coverage::isNotTaken(int address) const
+{
+  return testBit(branch_not_taken, address);
+}
+
+// source lines prefixed with "#####" (never executed), "+" (executed)
+// and T/N for the branch directions seen
+bool Coverage::writeListing(const Listing &listing, const char *filename) const
+{
+  int lines = 0, lines_hit = 0;
+  int branches = 0, branches_hit = 0;
+
+  for(size_t i = 0; i < listing.lines.size(); i++)
+  {
+    LineState state = lineState(this, listing, listing.lines[i]);
+
+    if(state.code)
+    {
+      lines++;
+      lines_hit += state.executed ? 1 : 0;
+    }
+
+    if(state.branch)
+    {
+      branches += 2;
+      branches_hit += (state.taken ? 1 : 0) + (state.not_taken ? 1 : 0);
+    }
+  }
+
+  FILE *fp = fopen(filename, "w");
+
+  if(fp == NULL)
+    return false;
+
+  fprintf(fp, "; %s\n", listing.source.c_str());
+  fprintf(fp, "; lines: %d of %d executed\n", lines_hit, lines);
+  fprintf(fp, "; branches: %d of %d directions taken\n\n",
+          branches_hit, branches);
+
+  for(size_t i = 0; i < listing.lines.size(); i++)
+  {
+    const Listing::Line &line = listing.lines[i];
+    LineState state = lineState(this, listing, line);
+    char mark[8] = "";
+
+    if(state.code && state.executed == false)
+    {
+      strcpy(mark, "#####");
+    }
+    else if(state.code)
+    {
+      strcpy(mark, "+");
+
+      if(state.taken)
+        strcat(mark, "T");
+
+      if(state.not_taken)
+        strcat(mark, "N");
+    }
+
+    fprintf(fp, "%6s %5d: %s\n", mark, line.number, line.text.c_str());
+  }
+
+  fclose(fp);
+  return true;
+}
+
+// one lcov tracefile record
+void Coverage::writeLcov(const Listing &listing, FILE *fp,
+                         const char *test) const
+{
+  int lines = 0, lines_hit = 0;
+  int branches = 0, branches_hit = 0;
+
+  fprintf(fp, "TN:");
+
+  // test names are limited to letters, digits and underscores
+  for(const char *p = test; *p; p++)
+    fputc(isalnum((unsigned char)*p) ? *p : '_', fp);
+
+  fprintf(fp, "\nSF:%s\n", listing.source.c_str());
+
+  for(size_t i = 0; i < listing.lines.size(); i++)
+  {
+    const Listing::Line &line = listing.lines[i];
+    LineState state = lineState(this, listing, line);
+
+    if(state.code == false)
+      continue;
+
+    for(int j = line.first; j < line.first + line.count; j++)
+    {
+      const Listing::Instruction &ins = listing.instructions[j];
+
+      if(isBranch(ins) == false)
+        continue;
+
+      bool taken = isTaken(ins.address);
+      bool not_taken = isNotTaken(ins.address);
+
+      if(state.executed)
+      {
+        fprintf(fp, "BRDA:%d,%d,0,%d\n", line.number, j, taken ? 1 : 0);
+        fprintf(fp, "BRDA:%d,%d,1,%d\n", line.number, j, not_taken ? 1 : 0);
+      }
+      else
+      {
+        fprintf(fp, "BRDA:%d,%d,0,-\n", line.number, j);
+        fprintf(fp, "BRDA:%d,%d,1,-\n", line.number, j);
+      }
+
+      branches += 2;
+      branches_hit += (taken ? 1 : 0) + (not_taken ? 1 : 0);
+    }
+
+    fprintf(fp, "DA:%d,%d\n", line.number, state.executed ? 1 : 0);
+    lines++;
+    lines_hit += state.executed ? 1 : 0;
+  }
+
+  fprintf(fp, "BRF:%d\nBRH:%d\n", branches, branches_hit);
+  fprintf(fp, "LF:%d\nLH:%d\n", lines, lines_hit);
+  fprintf(fp, "end_of_record\n");
+}
+
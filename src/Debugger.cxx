@@ -0,0 +1,645 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Debugger.H"
+#include "Dialog.H"
+#include "Gui.H"
+#include "Harness.H"
+#include "Monitor.H"
+#include "Opcodes.H"
+#include "Terminal.H"
+
+namespace
+{
+  const int BRK = 0x00;
+
+  // how long a single step may take before giving up
+  const double STEP_TIMEOUT = 10.0;
+
+  // user breakpoints and temporary ones planted for a step,
+  // each mapped to the byte it replaced
+  std::map<int, int> breakpoints;
+  std::map<int, int> temps;
+
+  int regs[8];
+
+  struct TraceEntry
+  {
+    int regs[8];
+    unsigned char bytes[4];
+  };
+
+  bool isRom(int address)
+  {
+    if(Gui::getMode() == Gui::MODE_134)
+      return address >= 0xF000 && address <= 0xFFFF;
+
+    return address >= 0xE000 && address <= 0xFFFF;
+  }
+
+  int peek(int address)
+  {
+    unsigned char value;
+
+    if(Terminal::readMemory(address, &value, 1) != 1)
+      return -1;
+
+    return value;
+  }
+
+  bool poke(int address, int value)
+  {
+    unsigned char data = value;
+
+    return Terminal::uploadData(address, &data, 1);
+  }
+
+  // remember the original bytes under new step breakpoints, reading
+  // them in one dump when they are close together, and add the BRKs
+  // to writes
+  bool plant(const std::vector<int> &next, std::map<int, int> &writes)
+  {
+    std::vector<int> wanted;
+
+    for(size_t i = 0; i < next.size(); i++)
+    {
+      if(temps.count(next[i]) == 0 && breakpoints.count(next[i]) == 0 &&
+         std::find(wanted.begin(), wanted.end(), next[i]) == wanted.end())
+      {
+        wanted.push_back(next[i]);
+      }
+    }
+
+    if(wanted.size() == 0)
+      return true;
+
+    const int low = *std::min_element(wanted.begin(), wanted.end());
+    const int high = *std::max_element(wanted.begin(), wanted.end());
+
+    if((low >> 16) == (high >> 16) && high - low < 256)
+    {
+      std::vector<unsigned char> data(high - low + 1);
+
+      if(Terminal::readMemory(low, &data[0], data.size()) != (int)data.size())
+        return false;
+
+      for(size_t i = 0; i < wanted.size(); i++)
+        temps[wanted[i]] = data[wanted[i] - low];
+    }
+    else
+    {
+      for(size_t i = 0; i < wanted.size(); i++)
+      {
+        const int value = peek(wanted[i]);
+
+        if(value < 0)
+          return false;
+
+        temps[wanted[i]] = value;
+      }
+    }
+
+    for(size_t i = 0; i < wanted.size(); i++)
+      writes[wanted[i]] = BRK;
+
+    return true;
+  }
+
+  void restoreTemps()
+  {
+    Terminal::uploadBytes(temps);
+    temps.clear();
+  }
+
+  // registers at the stop, with the PC moved back onto a BRK we planted
+  bool readStop()
+  {
+    if(Terminal::readRegs(regs) == false)
+      return false;
+
+    const int pc = regs[Monitor::REG_PC];
+    const int bank = pc & 0xFF0000;
+    const int before = bank | ((pc - 2) & 0xFFFF);
+
+    if(breakpoints.count(before) > 0 || temps.count(before) > 0)
+      regs[Monitor::REG_PC] = before;
+
+    return true;
+  }
+
+  std::string describe(const int *r, const unsigned char *bytes)
+  {
+    char s[256];
+    char code[64];
+    const bool m = Gui::getMode() == Gui::MODE_134 ||
+                   (r[Monitor::REG_SR] & 0x20) != 0;
+    const bool x = Gui::getMode() == Gui::MODE_134 ||
+                   (r[Monitor::REG_SR] & 0x10) != 0;
+    const int pc = r[Monitor::REG_PC];
+
+    Opcodes::disassemble(code, pc, bytes, m, x);
+    sprintf(s, "%02X:%04X  %-16s A=%04X X=%04X Y=%04X S=%04X D=%04X "
+               "B=%02X P=%02X\n",
+            pc >> 16, pc & 0xFFFF, code, r[Monitor::REG_A],
+            r[Monitor::REG_X], r[Monitor::REG_Y], r[Monitor::REG_SP],
+            r[Monitor::REG_DP], r[Monitor::REG_DB], r[Monitor::REG_SR]);
+
+    return s;
+  }
+
+  int read16(int address)
+  {
+    unsigned char data[2];
+
+    if(Terminal::readMemory(address, data, 2) != 2)
+      return -1;
+
+    return data[0] | (data[1] << 8);
+  }
+
+  int read24(int address)
+  {
+    unsigned char data[3];
+
+    if(Terminal::readMemory(address, data, 3) != 3)
+      return -1;
+
+    return data[0] | (data[1] << 8) | (data[2] << 16);
+  }
+
+  // where the instruction at pc can go next, calls are stepped over
+  // when asked to or when they lead into ROM
+  bool successors(const unsigned char *bytes, bool over,
+                  std::vector<int> &next, std::string &error)
+  {
+    const int pc = regs[Monitor::REG_PC];
+    const int bank = pc & 0xFF0000;
+    const int sp = regs[Monitor::REG_SP];
+    const int op = bytes[0];
+    const Opcodes::Opcode &code = Opcodes::table[op];
+    const bool m = Gui::getMode() == Gui::MODE_134 ||
+                   (regs[Monitor::REG_SR] & 0x20) != 0;
+    const bool x = Gui::getMode() == Gui::MODE_134 ||
+                   (regs[Monitor::REG_SR] & 0x10) != 0;
+    const int len = Opcodes::length(op, m, x);
+    const int fall = bank | ((pc + len) & 0xFFFF);
+    const int w = bytes[1] | (bytes[2] << 8);
+    int target = -1;
+
+    next.clear();
+
+    if(code.flags & Opcodes::FLAG_STOP)
+    {
+      error = "cannot step over BRK, COP, WAI or STP";
+      return false;
+    }
+
+    switch(code.mode)
+    {
+      case Opcodes::MODE_REL:
+        target = bank | ((pc + len + (signed char)bytes[1]) & 0xFFFF);
+        break;
+      case Opcodes::MODE_RELL:
+        target = bank | ((pc + len + (short)w) & 0xFFFF);
+        break;
+    }
+
+    switch(op)
+    {
+      case 0x4C:
+      case 0x20:
+        target = bank | w;
+        break;
+      case 0x5C:
+      case 0x22:
+        target = w | (bytes[3] << 16);
+        break;
+      case 0x6C:
+        target = bank | read16(w);
+        break;
+      case 0x7C:
+      case 0xFC:
+        target = bank | read16(bank | ((w + regs[Monitor::REG_X]) & 0xFFFF));
+        break;
+      case 0xDC:
+        target = read24(w);
+        break;
+      case 0x60:
+        target = bank | ((read16(sp + 1) + 1) & 0xFFFF);
+        break;
+      case 0x6B:
+      {
+        const int ret = read24(sp + 1);
+
+        target = (ret & 0xFF0000) | ((ret + 1) & 0xFFFF);
+        break;
+      }
+      case 0x40:
+        target = read16(sp + 2);
+
+        if(Gui::getMode() == Gui::MODE_265)
+          target |= peek(sp + 4) << 16;
+        break;
+    }
+
+    if(code.flags & Opcodes::FLAG_BRANCH)
+    {
+      next.push_back(fall);
+      next.push_back(target);
+    }
+    else if(code.flags & Opcodes::FLAG_CALL)
+    {
+      if(over == true || target < 0 || isRom(target))
+        next.push_back(fall);
+      else
+        next.push_back(target);
+    }
+    else if(code.flags & (Opcodes::FLAG_JUMP | Opcodes::FLAG_RETURN))
+    {
+      if(target < 0)
+      {
+        error = "could not read the destination";
+        return false;
+      }
+
+      if(isRom(target))
+      {
+        error = "returns to the monitor";
+        return false;
+      }
+
+      next.push_back(target);
+    }
+    else
+    {
+      next.push_back(fall);
+    }
+
+    return true;
+  }
+
+  // run one instruction (or call) and read the new state
+  bool stepOnce(bool over, TraceEntry *entry, std::string &error)
+  {
+    const int pc = regs[Monitor::REG_PC];
+    unsigned char bytes[4];
+    std::vector<int> next;
+
+    if(Terminal::readMemory(pc, bytes, 4) != 4)
+    {
+      error = "no response from the board";
+      return false;
+    }
+
+    // the byte under our own breakpoint is the original one
+    if(breakpoints.count(pc) > 0)
+      bytes[0] = breakpoints[pc];
+
+    if(entry != NULL)
+    {
+      memcpy(entry->regs, regs, sizeof(regs));
+      memcpy(entry->bytes, bytes, sizeof(bytes));
+    }
+
+    if(successors(bytes, over, next, error) == false)
+      return false;
+
+    std::map<int, int> writes;
+
+    if(plant(next, writes) == false)
+    {
+      restoreTemps();
+      error = "could not read memory for a breakpoint";
+      return false;
+    }
+
+    // lift our breakpoint at the PC while it runs, all in one write
+    if(breakpoints.count(pc) > 0)
+      writes[pc] = breakpoints[pc];
+
+    if(Terminal::uploadBytes(writes) == false)
+    {
+      restoreTemps();
+      error = "could not plant a breakpoint";
+      return false;
+    }
+
+    Terminal::jml(pc);
+
+    bool stopped = false;
+    std::chrono::steady_clock::time_point begin =
+      std::chrono::steady_clock::now();
+
+    while(stopped == false &&
+          std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - begin).count() < STEP_TIMEOUT)
+    {
+      if(Harness::wait(0.1) == false)
+        break;
+
+      stopped = readStop();
+    }
+
+    if(stopped == false)
+    {
+      error = "still running, use Debug/Refresh once it stops";
+      return false;
+    }
+
+    // the original bytes and our breakpoint at the PC go back together
+    writes = temps;
+    temps.clear();
+
+    if(breakpoints.count(pc) > 0)
+      writes[pc] = BRK;
+
+    Terminal::uploadBytes(writes);
+
+    return true;
+  }
+
+  void show()
+  {
+    unsigned char bytes[4];
+    const int pc = regs[Monitor::REG_PC];
+
+    Gui::setRegs(regs);
+
+    if(Terminal::readMemory(pc, bytes, 4) == 4)
+    {
+      if(breakpoints.count(pc) > 0)
+        bytes[0] = breakpoints[pc];
+
+      Gui::append(("\n" + describe(regs, bytes)).c_str());
+    }
+  }
+
+  bool ready()
+  {
+    if(Terminal::isConnected() == false)
+    {
+      Dialog::message("Error", "Not Connected.");
+      return false;
+    }
+
+    if(readStop() == false)
+    {
+      Dialog::message("Error", "No response from the monitor.");
+      return false;
+    }
+
+    restoreTemps();
+    return true;
+  }
+}
+
+// breakpoint at the address in the side panel
+void Debugger::toggleBreakpoint()
+{
+  if(Terminal::isConnected() == false)
+  {
+    Dialog::message("Error", "Not Connected.");
+    return;
+  }
+
+  const int address = Gui::getAddress();
+  char s[256];
+
+  if(breakpoints.count(address) > 0)
+  {
+    removeBreakpoint(address);
+    sprintf(s, "\nBreakpoint removed at %02X:%04X.\n",
+            address >> 16, address & 0xFFFF);
+    Gui::append(s);
+    return;
+  }
+
+  if(isRom(address))
+  {
+    Dialog::message("Error", "Breakpoints cannot be set in ROM.");
+    return;
+  }
+
+  if(addBreakpoint(address) == false)
+  {
+    Dialog::message("Error", "Could not set breakpoint.");
+    return;
+  }
+
+  sprintf(s, "\nBreakpoint set at %02X:%04X.\n",
+          address >> 16, address & 0xFFFF);
+  Gui::append(s);
+}
+
+void Debugger::clearBreakpoints()
+{
+  Terminal::uploadBytes(breakpoints);
+  breakpoints.clear();
+  Gui::append("\nBreakpoints cleared.\n");
+}
+
+// show where the program stopped
+void Debugger::refresh()
+{
+  Terminal::Hold hold;
+
+  if(ready() == true)
+    show();
+}
+
+// continue, stepping off a breakpoint at the PC first
+void Debugger::go()
+{
+  Terminal::Hold hold;
+
+  if(ready() == false)
+    return;
+
+  std::string error;
+
+  if(breakpoints.count(regs[Monitor::REG_PC]) > 0 &&
+     stepOnce(false, NULL, error) == false)
+  {
+    Dialog::message("Error", error.c_str());
+    return;
+  }
+
+  Terminal::jml(regs[Monitor::REG_PC]);
+  Gui::append("\nRunning, use Debug/Refresh after a breakpoint.\n");
+}
+
+void Debugger::stepInto()
+{
+  step(1);
+}
+
+void Debugger::stepOver()
+{
+  Terminal::Hold hold;
+
+  if(ready() == false)
+    return;
+
+  std::string error;
+
+  if(stepOnce(true, NULL, error) == false)
+    Dialog::message("Error", error.c_str());
+
+  show();
+}
+
+// several steps, the trace is collected first and shown at the end
+void Debugger::step(int count)
+{
+  Terminal::Hold hold;
+
+  if(ready() == false)
+    return;
+
+  std::vector<TraceEntry> trace;
+  std::string error;
+
+  for(int i = 0; i < count; i++)
+  {
+    TraceEntry entry;
+
+    if(stepOnce(false, &entry, error) == false)
+      break;
+
+    trace.push_back(entry);
+  }
+
+  if(count > 1)
+  {
+    std::string text = "\n";
+
+    for(size_t i = 0; i < trace.size(); i++)
+      text += describe(trace[i].regs, trace[i].bytes);
+
+    Gui::append(text.c_str());
+  }
+
+  if(error.size() > 0)
+  {
+    char s[256];
+
+    snprintf(s, sizeof(s), "Stopped after %d step%s: %s.",
+             (int)trace.size(), trace.size() == 1 ? "" : "s", error.c_str());
+    Dialog::message("Step", s);
+  }
+
+  show();
+}
+
+bool Debugger::addBreakpoint(int address)
+{
+  if(breakpoints.count(address) > 0)
+    return true;
+
+  if(isRom(address))
+    return false;
+
+  const int value = peek(address);
+
+  if(value < 0 || poke(address, BRK) == false)
+    return false;
+
+  breakpoints[address] = value;
+  return true;
+}
+
+bool Debugger::removeBreakpoint(int address)
+{
+  if(breakpoints.count(address) == 0)
+    return true;
+
+  const bool ok = poke(address, breakpoints[address]);
+
+  breakpoints.erase(address);
+  return ok;
+}
+
+// registers if the monitor answers, leftover step breakpoints are lifted
+bool Debugger::isStopped(int *r)
+{
+  if(readStop() == false)
+    return false;
+
+  restoreTemps();
+  memcpy(r, regs, sizeof(regs));
+  return true;
+}
+
+// continue from the registers last read by isStopped
+bool Debugger::resume()
+{
+  std::string error;
+
+  if(breakpoints.count(regs[Monitor::REG_PC]) > 0 &&
+     stepOnce(false, NULL, error) == false)
+  {
+    return false;
+  }
+
+  Terminal::jml(regs[Monitor::REG_PC]);
+  return true;
+}
+
+bool Debugger::stepInstruction(int *r)
+{
+  std::string error;
+
+  if(stepOnce(false, NULL, error) == false)
+    return false;
+
+  memcpy(r, regs, sizeof(regs));
+  return true;
+}
+
+// put back the bytes our breakpoints replaced in memory that was read
+void Debugger::unpatch(int address, unsigned char *data, int count)
+{
+  std::map<int, int>::iterator i = breakpoints.lower_bound(address);
+
+  for(; i != breakpoints.end() && i->first < address + count; ++i)
+    data[i->first - address] = i->second;
+
+  for(i = temps.lower_bound(address);
+      i != temps.end() && i->first < address + count; ++i)
+  {
+    data[i->first - address] = i->second;
+  }
+}
+
+void Debugger::swapBreakpoints(std::map<int, int> &other)
+{
+  restoreTemps();
+  breakpoints.swap(other);
+}
+
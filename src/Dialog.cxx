@@ -19,6 +19,8 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
 */
 
 #include <algorithm>
+#include <cstdio>
+#include <cstdlib>
 
 #include <FL/Fl.H>
 #include <FL/Fl_Box.H>
@@ -31,9 +33,14 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
 #include <FL/Fl_Progress.H>
 #include <FL/Fl_Widget.H>
 
+#include "Agent.H"
+#include "Checkpoint.H"
+#include "Debugger.H"
 #include "Dialog.H"
 #include "DialogWindow.H"
 #include "Gui.H"
+#include "Profiler.H"
+#include "RamTest.H"
 #include "Terminal.H"
 
 #if defined(_MSC_VER)
@@ -142,6 +149,362 @@ namespace Connect
   }
 }
 
+namespace Profile
+{
+  namespace Items
+  {
+    DialogWindow *dialog;
+    Fl_Input *address;
+    Fl_Int_Input *rate;
+    Fl_Int_Input *seconds;
+    Fl_Input *vector;
+    Fl_Input *buffer;
+    Fl_Input *listing;
+    Fl_Button *ok;
+    Fl_Button *cancel;
+  }
+
+  void begin()
+  {
+    if(Terminal::isConnected() == false)
+    {
+      Dialog::message("Error", "Not Connected.");
+      return;
+    }
+
+    Items::dialog->show();
+  }
+
+  void close()
+  {
+    int address = 0, vector = -1, buffer = 0;
+
+    sscanf(Items::address->value(), "%06X", &address);
+    sscanf(Items::vector->value(), "%06X", &vector);
+    sscanf(Items::buffer->value(), "%06X", &buffer);
+
+    if(vector < 0)
+    {
+      Dialog::message("Error", "Enter the RAM vector used for timer 2.");
+      return;
+    }
+
+    Items::dialog->hide();
+    Profiler::run(address, atoi(Items::rate->value()),
+                  atoi(Items::seconds->value()), vector, buffer,
+                  Items::listing->value());
+  }
+
+  void quit()
+  {
+    Items::dialog->hide();
+  }
+
+  void init()
+  {
+    int y1 = 8;
+
+    Items::dialog = new DialogWindow(384, 0, "Profile");
+    Items::address = new Fl_Input(160, y1, 96, 24, "JSL Address: ");
+    Items::address->align(FL_ALIGN_LEFT);
+    Items::address->value("001000");
+    y1 += 32;
+    Items::rate = new Fl_Int_Input(160, y1, 96, 24, "Samples/Second: ");
+    Items::rate->align(FL_ALIGN_LEFT);
+    Items::rate->value("100");
+    y1 += 32;
+    Items::seconds = new Fl_Int_Input(160, y1, 96, 24, "Timeout (s): ");
+    Items::seconds->align(FL_ALIGN_LEFT);
+    Items::seconds->value("30");
+    y1 += 32;
+    Items::vector = new Fl_Input(160, y1, 96, 24, "Timer 2 Vector: ");
+    Items::vector->align(FL_ALIGN_LEFT);
+    Items::vector->tooltip("RAM address the monitor jumps through\n"
+                           "for the timer 2 interrupt");
+    y1 += 32;
+    Items::buffer = new Fl_Input(160, y1, 96, 24, "Buffer: ");
+    Items::buffer->align(FL_ALIGN_LEFT);
+    Items::buffer->value("006000");
+    Items::buffer->tooltip("4352 bytes of free RAM for the handler\n"
+                           "and the sample ring");
+    y1 += 32;
+    Items::listing = new Fl_Input(160, y1, 192, 24, "Listing: ");
+    Items::listing->align(FL_ALIGN_LEFT);
+    y1 += 48;
+    Items::dialog->addOkCancelButtons(&Items::ok, &Items::cancel, &y1);
+    Items::cancel->callback((Fl_Callback *)quit);
+    Items::ok->callback((Fl_Callback *)close);
+    Items::ok->shortcut(FL_Enter);
+    Items::dialog->set_modal();
+    Items::dialog->end(); 
+  }
+}
+
+namespace StepCount
+{
+  namespace Items
+  {
+    DialogWindow *dialog;
+    Fl_Int_Input *count;
+    Fl_Button *ok;
+    Fl_Button *cancel;
+  }
+
+  void begin()
+  {
+    if(Terminal::isConnected() == false)
+    {
+      Dialog::message("Error", "Not Connected.");
+      return;
+    }
+
+    Items::dialog->show();
+  }
+
+  void close()
+  {
+    const int count = atoi(Items::count->value());
+
+    if(count < 1)
+    {
+      Dialog::message("Error", "Enter the number of steps.");
+      return;
+    }
+
+    Items::dialog->hide();
+    Debugger::step(count);
+  }
+
+  void quit()
+  {
+    Items::dialog->hide();
+  }
+
+  void init()
+  {
+    int y1 = 8;
+
+    Items::dialog = new DialogWindow(384, 0, "Step");
+    Items::count = new Fl_Int_Input(160, y1, 96, 24, "Instructions: ");
+    Items::count->align(FL_ALIGN_LEFT);
+    Items::count->value("16");
+    y1 += 24 + 8;
+    Items::dialog->addOkCancelButtons(&Items::ok, &Items::cancel, &y1);
+    Items::cancel->callback((Fl_Callback *)quit);
+    Items::ok->callback((Fl_Callback *)close);
+    Items::ok->shortcut(FL_Enter);
+    Items::dialog->set_modal();
+    Items::dialog->end(); 
+  }
+}
+
+namespace Install
+{
+  namespace Items
+  {
+    DialogWindow *dialog;
+    Fl_Input *address;
+    Fl_Input *get;
+    Fl_Input *put;
+    Fl_Button *ok;
+    Fl_Button *cancel;
+  }
+
+  void begin()
+  {
+    if(Terminal::isConnected() == false)
+    {
+      Dialog::message("Error", "Not Connected.");
+      return;
+    }
+
+    // the 265 monitor's entry points are known, the 134's must be given
+    if(Gui::getMode() == Gui::MODE_265)
+    {
+      Items::get->value("00E033");
+      Items::put->value("00E063");
+    }
+    else
+    {
+      Items::get->value("");
+      Items::put->value("");
+    }
+
+    Items::dialog->show();
+  }
+
+  void close()
+  {
+    int address = 0, get = -1, put = -1;
+
+    sscanf(Items::address->value(), "%06X", &address);
+    sscanf(Items::get->value(), "%06X", &get);
+    sscanf(Items::put->value(), "%06X", &put);
+
+    if(get < 0 || put < 0)
+    {
+      Dialog::message("Error", "Enter the monitor's byte I/O routines.");
+      return;
+    }
+
+    Items::dialog->hide();
+    Agent::install(address, get, put);
+  }
+
+  void quit()
+  {
+    Items::dialog->hide();
+  }
+
+  void init()
+  {
+    int y1 = 8;
+
+    Items::dialog = new DialogWindow(384, 0, "Install Agent");
+    Items::address = new Fl_Input(160, y1, 96, 24, "Address: ");
+    Items::address->align(FL_ALIGN_LEFT);
+    Items::address->value("007C00");
+    Items::address->tooltip("1 KB of free RAM in bank 0");
+    y1 += 32;
+    Items::get = new Fl_Input(160, y1, 96, 24, "Get Byte Routine: ");
+    Items::get->align(FL_ALIGN_LEFT);
+    Items::get->tooltip("monitor routine that waits for a byte\n"
+                        "from the PC and returns it in A");
+    y1 += 32;
+    Items::put = new Fl_Input(160, y1, 96, 24, "Send Byte Routine: ");
+    Items::put->align(FL_ALIGN_LEFT);
+    Items::put->tooltip("monitor routine that sends A to the PC");
+    y1 += 24 + 8;
+    Items::dialog->addOkCancelButtons(&Items::ok, &Items::cancel, &y1);
+    Items::cancel->callback((Fl_Callback *)quit);
+    Items::ok->callback((Fl_Callback *)close);
+    Items::ok->shortcut(FL_Enter);
+    Items::dialog->set_modal();
+    Items::dialog->end(); 
+  }
+}
+
+namespace MemoryTest
+{
+  namespace Items
+  {
+    DialogWindow *dialog;
+    Fl_Input *start;
+    Fl_Input *end;
+    Fl_Input *buffer;
+    Fl_Button *ok;
+    Fl_Button *cancel;
+  }
+
+  void begin()
+  {
+    if(Terminal::isConnected() == false)
+    {
+      Dialog::message("Error", "Not Connected.");
+      return;
+    }
+
+    Items::dialog->show();
+  }
+
+  void close()
+  {
+    int start = 0, end = 0, buffer = 0;
+
+    sscanf(Items::start->value(), "%06X", &start);
+    sscanf(Items::end->value(), "%06X", &end);
+    sscanf(Items::buffer->value(), "%06X", &buffer);
+
+    Items::dialog->hide();
+    RamTest::run(start, end, buffer);
+  }
+
+  void quit()
+  {
+    Items::dialog->hide();
+  }
+
+  void init()
+  {
+    int y1 = 8;
+
+    Items::dialog = new DialogWindow(384, 0, "RAM Test");
+    Items::start = new Fl_Input(160, y1, 96, 24, "Start: ");
+    Items::start->align(FL_ALIGN_LEFT);
+    Items::start->value("001000");
+    Items::start->tooltip("the range is overwritten");
+    y1 += 32;
+    Items::end = new Fl_Input(160, y1, 96, 24, "End: ");
+    Items::end->align(FL_ALIGN_LEFT);
+    Items::end->value("005FFF");
+    y1 += 32;
+    Items::buffer = new Fl_Input(160, y1, 96, 24, "Tester: ");
+    Items::buffer->align(FL_ALIGN_LEFT);
+    Items::buffer->value("006000");
+    Items::buffer->tooltip("1 KB of RAM outside the range\n"
+                           "for the tester and its results");
+    y1 += 24 + 8;
+    Items::dialog->addOkCancelButtons(&Items::ok, &Items::cancel, &y1);
+    Items::cancel->callback((Fl_Callback *)quit);
+    Items::ok->callback((Fl_Callback *)close);
+    Items::ok->shortcut(FL_Enter);
+    Items::dialog->set_modal();
+    Items::dialog->end(); 
+  }
+}
+
+namespace SaveState
+{
+  namespace Items
+  {
+    DialogWindow *dialog;
+    Fl_Input *ranges;
+    Fl_Button *ok;
+    Fl_Button *cancel;
+  }
+
+  void begin()
+  {
+    if(Terminal::isConnected() == false)
+    {
+      Dialog::message("Error", "Not Connected.");
+      return;
+    }
+
+    Items::dialog->show();
+  }
+
+  void close()
+  {
+    Items::dialog->hide();
+    Checkpoint::save(Items::ranges->value());
+  }
+
+  void quit()
+  {
+    Items::dialog->hide();
+  }
+
+  void init()
+  {
+    int y1 = 8;
+
+    Items::dialog = new DialogWindow(384, 0, "Save Checkpoint");
+    Items::ranges = new Fl_Input(160, y1, 192, 24, "RAM Ranges: ");
+    Items::ranges->align(FL_ALIGN_LEFT);
+    Items::ranges->value("000200-007FFF");
+    Items::ranges->tooltip("hex start-end pairs separated by commas,\n"
+                           "the monitor's page zero and stack are left out");
+    y1 += 24 + 8;
+    Items::dialog->addOkCancelButtons(&Items::ok, &Items::cancel, &y1);
+    Items::cancel->callback((Fl_Callback *)quit);
+    Items::ok->callback((Fl_Callback *)close);
+    Items::ok->shortcut(FL_Enter);
+    Items::dialog->set_modal();
+    Items::dialog->end(); 
+  }
+}
+
 namespace Message
 {
   namespace Items
@@ -236,6 +599,11 @@ void Dialog::init()
 {
   About::init();
   Connect::init();
+  Profile::init();
+  StepCount::init();
+  Install::init();
+  MemoryTest::init();
+  SaveState::init();
   Message::init();
   Choice::init();
 }
@@ -250,8 +618,40 @@ void Dialog::connect()
   Connect::begin();
 }
 
+void Dialog::profile()
+{
+  Profile::begin();
+}
+
+void Dialog::stepCount()
+{
+  StepCount::begin();
+}
+
+void Dialog::installAgent()
+{
+  Install::begin();
+}
+
+void Dialog::ramTest()
+{
+  MemoryTest::begin();
+}
+
+void Dialog::checkpoint()
+{
+  SaveState::begin();
+}
+
 void Dialog::message(const char *title, const char *message)
 {
+  // no windows when running headless
+  if(Message::Items::dialog == 0)
+  {
+    fprintf(stderr, "%s: %s\n", title, message);
+    return;
+  }
+
   Message::begin(title, message);
 }
 
@@ -0,0 +1,1249 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "Coverage.H"
+#include "Emulator.H"
+#include "Image.H"
+#include "Opcodes.H"
+#include "Trace.H"
+
+namespace
+{
+  // on-chip I/O page and monitor ROM in bank 0
+  const int IO_BASE = 0xDF00;
+  const int ROM_BASE = 0xE000;
+
+  // monitor entry points used by the samples and Java Grinder
+  const int CONTROL_TONES = 0xE009;
+  const int GET_BYTE_FROM_PC = 0xE033;
+  const int SEND_BYTE_TO_PC = 0xE063;
+
+  // jsl() returns here, standing in for the monitor command loop
+  const int MONITOR_RETURN = 0xFF00;
+
+  // nominal cost of a monitor call including the RTL
+  const int MONITOR_CYCLES = 32;
+
+  // one byte at 9600 baud, 8N1
+  const int BYTE_CYCLES = Emulator::FCLK / 960;
+
+  // timer 2 is prescaled by 16
+  const int T2_PRESCALE = 16;
+
+  // I/O registers (offsets into the $DF00 page)
+  const int TER = 0x43;
+  const int TIFR = 0x44;
+  const int UIFR = 0x48;
+  const int T2LL = 0x54;
+  const int T2LH = 0x55;
+  const int T2CL = 0x64;
+  const int T2CH = 0x65;
+  const int ARTD0 = 0x71;
+
+  // low five opcode bits shared by ORA/AND/EOR/ADC/STA/LDA/CMP/SBC
+  const unsigned int GROUP1 = 0xA2AEA2AA;
+
+  bool receiveRecord(const char *s, void *data)
+  {
+    ((Emulator *)data)->receive(s);
+    return true;
+  }
+
+  // port data registers P0-P3 and P4-P7, direction registers follow
+  bool isPort(int reg)
+  {
+    return (reg >= 0x00 && reg <= 0x07) || (reg >= 0x20 && reg <= 0x27);
+  }
+}
+
+Emulator::Emulator()
+{
+  mem = (unsigned char *)calloc(0x1000000, 1);
+  max_events = 100000;
+  coverage = NULL;
+  trace = NULL;
+  reset();
+}
+
+Emulator::~Emulator()
+{
+  free(mem);
+}
+
+// power-on state as left by the monitor, memory is preserved
+void Emulator::reset()
+{
+  pc = 0;
+  pb = 0;
+  db = 0;
+  dp = 0;
+  sp = 0x01FF;
+  a = 0;
+  x = 0;
+  y = 0;
+  sr = FLAG_M | FLAG_X | FLAG_I;
+  e = false;
+
+  stop_reason = STOP_NONE;
+  stop_address = 0;
+  cycles = 0;
+  instructions = 0;
+
+  events.clear();
+  overflow = false;
+
+  tone[0] = 0;
+  tone[1] = 0;
+  port_input = 0xFF;
+
+  memset(io, 0, sizeof(io));
+
+  input_data.clear();
+  input_pos = 0;
+  input_start = 0;
+
+  t2_counter = 0xFFFF;
+  t2_latch = 0xFFFF;
+  t2_time = 0;
+}
+
+// feed a program through the same S-record conversion as a real upload
+bool Emulator::upload(const char *filename)
+{
+  return Image::convert(filename, receiveRecord, this);
+}
+
+// the monitor's S2 record loader
+void Emulator::receive(const char *s)
+{
+  if(s[0] != 'S' || s[1] != '2')
+    return;
+
+  int values[256];
+  int count = 0;
+
+  if(sscanf(s + 2, "%02X", &count) != 1 || count < 4)
+    return;
+
+  int checksum = 0;
+
+  for(int i = 0; i < count + 1; i++)
+  {
+    if(sscanf(s + 2 + i * 2, "%02X", &values[i]) != 1)
+      return;
+
+    checksum += values[i];
+  }
+
+  // count, address, data and checksum bytes sum to 0xFF
+  if((checksum & 0xFF) != 0xFF)
+    return;
+
+  int address = (values[1] << 16) | (values[2] << 8) | values[3];
+
+  for(int i = 0; i < count - 4; i++)
+    write8((address + i) & 0xFFFFFF, values[4 + i]);
+}
+
+void Emulator::jml(int address)
+{
+  pb = (address >> 16) & 0xFF;
+  pc = address & 0xFFFF;
+  stop_reason = STOP_NONE;
+}
+
+// call a subroutine that returns to the monitor with RTL
+void Emulator::jsl(int address)
+{
+  push8(0);
+  push16(MONITOR_RETURN - 1);
+  jml(address);
+}
+
+// bytes arriving on UART0, paced at 9600 baud
+void Emulator::input(const unsigned char *data, int length)
+{
+  if(input_pos >= (int)input_data.size())
+  {
+    input_data.clear();
+    input_pos = 0;
+    input_start = cycles;
+  }
+
+  input_data.insert(input_data.end(), data, data + length);
+}
+
+long long Emulator::run(long long budget)
+{
+  long long end = cycles + budget;
+
+  while(cycles < end && stop_reason == STOP_NONE)
+    step();
+
+  return cycles;
+}
+
+int Emulator::read8(int address)
+{
+  const int value = load(address);
+
+  if(trace != NULL)
+    trace->access(address, value, false);
+
+  return value;
+}
+
+void Emulator::write8(int address, int value)
+{
+  if(trace != NULL)
+    trace->access(address, value & 0xFF, true);
+
+  if((address & 0xFFFF00) == IO_BASE)
+    writeIO(address & 0xFF, value & 0xFF);
+  else if(address < ROM_BASE || address > 0xFFFF)
+    mem[address] = value;
+}
+
+void Emulator::event(int type, int address, int value)
+{
+  if((int)events.size() >= max_events)
+  {
+    overflow = true;
+    return;
+  }
+
+  Event ev;
+
+  ev.cycle = cycles;
+  ev.type = type;
+  ev.address = address;
+  ev.value = value;
+  events.push_back(ev);
+}
+
+bool Emulator::inputReady()
+{
+  return input_pos < (int)input_data.size() &&
+         cycles >= input_start + (long long)input_pos * BYTE_CYCLES;
+}
+
+int Emulator::nextInput()
+{
+  if(inputReady() == false)
+    return 0;
+
+  return input_data[input_pos++];
+}
+
+// bring timer 2 up to date with the cycle counter
+void Emulator::updateTimer()
+{
+  if((io[TER] & 0x04) == 0)
+  {
+    t2_time = cycles;
+    return;
+  }
+
+  long long ticks = (cycles - t2_time) / T2_PRESCALE;
+
+  t2_time += ticks * T2_PRESCALE;
+
+  if(ticks <= t2_counter)
+  {
+    t2_counter -= ticks;
+    return;
+  }
+
+  ticks -= t2_counter + 1;
+  t2_counter = t2_latch - (int)(ticks % (t2_latch + 1));
+  io[TIFR] |= 0x04;
+}
+
+int Emulator::readIO(int reg)
+{
+  switch(reg)
+  {
+    case UIFR:
+      return (io[UIFR] & 0xFC) | (inputReady() ? 0x01 : 0x00) | 0x02;
+    case ARTD0:
+      return nextInput();
+    case TIFR:
+      updateTimer();
+      return io[TIFR];
+    case T2CL:
+      updateTimer();
+      return t2_counter & 0xFF;
+    case T2CH:
+      updateTimer();
+      return t2_counter >> 8;
+  }
+
+  if(isPort(reg) && (reg & 0x04) == 0)
+  {
+    int ddr = io[reg + 4];
+
+    return (io[reg] & ddr) | (port_input & ~ddr & 0xFF);
+  }
+
+  return io[reg];
+}
+
+void Emulator::writeIO(int reg, int value)
+{
+  switch(reg)
+  {
+    case ARTD0:
+      event(EVENT_UART, 0, value);
+      return;
+    case TER:
+      updateTimer();
+      io[TER] = value;
+      t2_time = cycles;
+      return;
+    case TIFR:
+      // writing a one clears the flag
+      updateTimer();
+      io[TIFR] &= ~value;
+      return;
+    case T2LL:
+      t2_latch = (t2_latch & 0xFF00) | value;
+      return;
+    case T2LH:
+      t2_latch = (t2_latch & 0x00FF) | (value << 8);
+      return;
+    case T2CH:
+      t2_latch = (t2_latch & 0x00FF) | (value << 8);
+      t2_counter = t2_latch;
+      t2_time = cycles;
+      return;
+  }
+
+  if(isPort(reg))
+    event(EVENT_PORT, IO_BASE + reg, value);
+
+  io[reg] = value;
+}
+
+// high-level versions of the monitor ROM routines
+void Emulator::monitorCall()
+{
+  switch(pc)
+  {
+    case CONTROL_TONES:
+    {
+      // A selects the generators, X and Y hold the divisors
+      int value[2];
+
+      value[0] = (a & 1) ? x : 0;
+      value[1] = (a & 2) ? y : 0;
+
+      for(int i = 0; i < 2; i++)
+      {
+        if(tone[i] != value[i])
+        {
+          tone[i] = value[i];
+          event(EVENT_TONE, i, value[i]);
+        }
+      }
+
+      break;
+    }
+
+    case GET_BYTE_FROM_PC:
+      // wait for the next byte
+      if(inputReady() == false)
+      {
+        cycles += MONITOR_CYCLES;
+        return;
+      }
+
+      a = (a & 0xFF00) | nextInput();
+      break;
+
+    case SEND_BYTE_TO_PC:
+      event(EVENT_UART, 0, a & 0xFF);
+      break;
+
+    case MONITOR_RETURN:
+      stop_reason = STOP_RETURN;
+      stop_address = pc;
+      return;
+
+    default:
+      stop_reason = STOP_MONITOR;
+      stop_address = pc;
+      return;
+  }
+
+  // RTL back to the caller
+  pc = (pull16() + 1) & 0xFFFF;
+  pb = pull8();
+  cycles += MONITOR_CYCLES;
+  instructions++;
+}
+
+// read without tracing, used for instruction fetch
+int Emulator::load(int address)
+{
+  if((address & 0xFFFF00) == IO_BASE)
+    return readIO(address & 0xFF);
+
+  return mem[address];
+}
+
+int Emulator::fetch8()
+{
+  int value = load((pb << 16) | pc);
+
+  pc = (pc + 1) & 0xFFFF;
+  return value;
+}
+
+int Emulator::fetch16()
+{
+  int value = fetch8();
+
+  return value | (fetch8() << 8);
+}
+
+int Emulator::fetch24()
+{
+  int value = fetch16();
+
+  return value | (fetch8() << 16);
+}
+
+int Emulator::read16(int address)
+{
+  return read8(address) | (read8((address + 1) & 0xFFFFFF) << 8);
+}
+
+int Emulator::read24(int address)
+{
+  return read16(address) | (read8((address + 2) & 0xFFFFFF) << 16);
+}
+
+void Emulator::write16(int address, int value)
+{
+  write8(address, value & 0xFF);
+  write8((address + 1) & 0xFFFFFF, (value >> 8) & 0xFF);
+}
+
+// the stack stays in page one in emulation mode
+void Emulator::push8(int value)
+{
+  write8(sp, value & 0xFF);
+
+  if(e == true)
+    sp = 0x100 | ((sp - 1) & 0xFF);
+  else
+    sp = (sp - 1) & 0xFFFF;
+}
+
+void Emulator::push16(int value)
+{
+  push8(value >> 8);
+  push8(value);
+}
+
+int Emulator::pull8()
+{
+  if(e == true)
+    sp = 0x100 | ((sp + 1) & 0xFF);
+  else
+    sp = (sp + 1) & 0xFFFF;
+
+  return read8(sp);
+}
+
+int Emulator::pull16()
+{
+  int value = pull8();
+
+  return value | (pull8() << 8);
+}
+
+// effective address of a memory operand, sets cross on page crossings
+int Emulator::address(int mode)
+{
+  int base, ea;
+
+  switch(mode)
+  {
+    case Opcodes::MODE_DP:
+      return (dp + fetch8()) & 0xFFFF;
+    case Opcodes::MODE_DPX:
+    case Opcodes::MODE_DPY:
+    {
+      int index = mode == Opcodes::MODE_DPX ? x : y;
+
+      // 6502 zero page wrapping
+      if(e == true && (dp & 0xFF) == 0)
+        return dp | ((fetch8() + index) & 0xFF);
+
+      return (dp + fetch8() + index) & 0xFFFF;
+    }
+    case Opcodes::MODE_DPIND:
+      return (db << 16) | read16((dp + fetch8()) & 0xFFFF);
+    case Opcodes::MODE_DPINDX:
+      return (db << 16) | read16((dp + fetch8() + x) & 0xFFFF);
+    case Opcodes::MODE_DPINDY:
+      base = (db << 16) | read16((dp + fetch8()) & 0xFFFF);
+      ea = (base + y) & 0xFFFFFF;
+      cross = (base & 0xFFFF00) != (ea & 0xFFFF00);
+      return ea;
+    case Opcodes::MODE_DPINDL:
+      return read24((dp + fetch8()) & 0xFFFF);
+    case Opcodes::MODE_DPINDLY:
+      return (read24((dp + fetch8()) & 0xFFFF) + y) & 0xFFFFFF;
+    case Opcodes::MODE_ABS:
+      return (db << 16) | fetch16();
+    case Opcodes::MODE_ABSX:
+    case Opcodes::MODE_ABSY:
+      base = (db << 16) | fetch16();
+      ea = (base + (mode == Opcodes::MODE_ABSX ? x : y)) & 0xFFFFFF;
+      cross = (base & 0xFFFF00) != (ea & 0xFFFF00);
+      return ea;
+    case Opcodes::MODE_LONG:
+      return fetch24();
+    case Opcodes::MODE_LONGX:
+      return (fetch24() + x) & 0xFFFFFF;
+    case Opcodes::MODE_SR:
+      return (sp + fetch8()) & 0xFFFF;
+    case Opcodes::MODE_SRINDY:
+      base = (db << 16) | read16((sp + fetch8()) & 0xFFFF);
+      return (base + y) & 0xFFFFFF;
+  }
+
+  return 0;
+}
+
+int Emulator::readM(int address)
+{
+  return (sr & FLAG_M) ? read8(address) : read16(address);
+}
+
+int Emulator::readX(int address)
+{
+  return (sr & FLAG_X) ? read8(address) : read16(address);
+}
+
+void Emulator::writeM(int address, int value)
+{
+  if(sr & FLAG_M)
+    write8(address, value);
+  else
+    write16(address, value);
+}
+
+void Emulator::writeX(int address, int value)
+{
+  if(sr & FLAG_X)
+    write8(address, value);
+  else
+    write16(address, value);
+}
+
+int Emulator::operandM(int mode)
+{
+  if(mode == Opcodes::MODE_IMM_M)
+    return (sr & FLAG_M) ? fetch8() : fetch16();
+
+  return readM(address(mode));
+}
+
+int Emulator::operandX(int mode)
+{
+  if(mode == Opcodes::MODE_IMM_X)
+    return (sr & FLAG_X) ? fetch8() : fetch16();
+
+  return readX(address(mode));
+}
+
+void Emulator::setFlag(int flag, bool value)
+{
+  if(value == true)
+    sr |= flag;
+  else
+    sr &= ~flag;
+}
+
+void Emulator::setNZ(int value, bool byte)
+{
+  if(byte == true)
+  {
+    setFlag(FLAG_Z, (value & 0xFF) == 0);
+    setFlag(FLAG_N, (value & 0x80) != 0);
+  }
+  else
+  {
+    setFlag(FLAG_Z, (value & 0xFFFF) == 0);
+    setFlag(FLAG_N, (value & 0x8000) != 0);
+  }
+}
+
+// status register writes keep the width rules consistent
+void Emulator::setP(int value)
+{
+  sr = value & 0xFF;
+
+  if(e == true)
+    sr |= FLAG_M | FLAG_X;
+
+  if(sr & FLAG_X)
+  {
+    x &= 0xFF;
+    y &= 0xFF;
+  }
+}
+
+void Emulator::adc(int value)
+{
+  bool byte = (sr & FLAG_M) != 0;
+  int mask = byte ? 0xFF : 0xFFFF;
+  int top = byte ? 0x80 : 0x8000;
+  int acc = a & mask;
+  int carry = sr & FLAG_C;
+  int result;
+
+  if(sr & FLAG_D)
+  {
+    result = 0;
+
+    for(int shift = 0; shift < (byte ? 8 : 16); shift += 4)
+    {
+      int digit = ((acc >> shift) & 15) + ((value >> shift) & 15) + carry;
+
+      carry = digit > 9 ? 1 : 0;
+
+      if(carry)
+        digit -= 10;
+
+      result |= (digit & 15) << shift;
+    }
+
+    setFlag(FLAG_V, (~(acc ^ value) & (acc ^ result) & top) != 0);
+    setFlag(FLAG_C, carry != 0);
+  }
+  else
+  {
+    result = acc + value + carry;
+    setFlag(FLAG_V, (~(acc ^ value) & (acc ^ result) & top) != 0);
+    setFlag(FLAG_C, result > mask);
+    result &= mask;
+  }
+
+  a = byte ? ((a & 0xFF00) | result) : result;
+  setNZ(result, byte);
+}
+
+void Emulator::sbc(int value)
+{
+  bool byte = (sr & FLAG_M) != 0;
+  int mask = byte ? 0xFF : 0xFFFF;
+  int top = byte ? 0x80 : 0x8000;
+  int acc = a & mask;
+  int borrow = (sr & FLAG_C) ? 0 : 1;
+  int result;
+
+  if(sr & FLAG_D)
+  {
+    result = 0;
+
+    for(int shift = 0; shift < (byte ? 8 : 16); shift += 4)
+    {
+      int digit = ((acc >> shift) & 15) - ((value >> shift) & 15) - borrow;
+
+      borrow = digit < 0 ? 1 : 0;
+
+      if(borrow)
+        digit += 10;
+
+      result |= (digit & 15) << shift;
+    }
+
+    setFlag(FLAG_V, ((acc ^ value) & (acc ^ result) & top) != 0);
+    setFlag(FLAG_C, borrow == 0);
+  }
+  else
+  {
+    result = acc - value - borrow;
+    setFlag(FLAG_V, ((acc ^ value) & (acc ^ result) & top) != 0);
+    setFlag(FLAG_C, result >= 0);
+    result &= mask;
+  }
+
+  a = byte ? ((a & 0xFF00) | result) : result;
+  setNZ(result, byte);
+}
+
+void Emulator::compare(int reg, int value, bool byte)
+{
+  int mask = byte ? 0xFF : 0xFFFF;
+
+  reg &= mask;
+  value &= mask;
+  setFlag(FLAG_C, reg >= value);
+  setNZ(reg - value, byte);
+}
+
+// ASL/ROL/LSR/ROR/INC/DEC/TSB/TRB selected by the opcode's top bits
+int Emulator::shift(int op, int value)
+{
+  bool byte = (sr & FLAG_M) != 0;
+  int mask = byte ? 0xFF : 0xFFFF;
+  int top = byte ? 0x80 : 0x8000;
+  int carry = sr & FLAG_C;
+  int acc = a & mask;
+
+  value &= mask;
+
+  switch(op & 0xF0)
+  {
+    case 0x00:
+    case 0x10:
+      if((op & 0x0F) == 0x04 || (op & 0x0F) == 0x0C)
+      {
+        setFlag(FLAG_Z, (value & acc) == 0);
+        return (op & 0x10) ? (value & ~acc) : (value | acc);
+      }
+
+      setFlag(FLAG_C, (value & top) != 0);
+      value = (value << 1) & mask;
+      break;
+    case 0x20:
+    case 0x30:
+      setFlag(FLAG_C, (value & top) != 0);
+      value = ((value << 1) | carry) & mask;
+      break;
+    case 0x40:
+    case 0x50:
+      setFlag(FLAG_C, (value & 1) != 0);
+      value >>= 1;
+      break;
+    case 0x60:
+    case 0x70:
+      setFlag(FLAG_C, (value & 1) != 0);
+      value = (value >> 1) | (carry ? top : 0);
+      break;
+    case 0xC0:
+    case 0xD0:
+      value = (value - 1) & mask;
+      break;
+    case 0xE0:
+    case 0xF0:
+      value = (value + 1) & mask;
+      break;
+  }
+
+  setNZ(value, byte);
+  return value;
+}
+
+void Emulator::branch(bool condition)
+{
+  int offset = (signed char)fetch8();
+
+  if(condition == true)
+  {
+    int target = (pc + offset) & 0xFFFF;
+
+    cross = (target & 0xFF00) != (pc & 0xFF00);
+    taken = true;
+    pc = target;
+  }
+}
+
+// MVN/MVP move one byte per execution and repeat until A wraps
+void Emulator::blockMove(int step)
+{
+  int dest = fetch8();
+  int src = fetch8();
+  int mask = (sr & FLAG_X) ? 0xFF : 0xFFFF;
+
+  write8((dest << 16) | y, read8((src << 16) | x));
+  db = dest;
+  x = (x + step) & mask;
+  y = (y + step) & mask;
+  a = (a - 1) & 0xFFFF;
+
+  if(a != 0xFFFF)
+    pc = (pc - 3) & 0xFFFF;
+}
+
+void Emulator::step()
+{
+  if(pb == 0 && pc >= ROM_BASE)
+  {
+    monitorCall();
+    return;
+  }
+
+  const int start = (pb << 16) | pc;
+
+  if(trace != NULL)
+    trace->begin(cycles);
+
+  const int op = fetch8();
+  const int mode = Opcodes::table[op].mode;
+  const bool m8 = (sr & FLAG_M) != 0;
+  const bool x8 = (sr & FLAG_X) != 0;
+  const bool old_e = e;
+  const int old_dp = dp;
+  int ea, value;
+
+  cross = false;
+  taken = false;
+
+  if(((GROUP1 >> (op & 0x1F)) & 1) && op != 0x89)
+  {
+    // STA
+    if((op >> 5) == 4)
+    {
+      writeM(address(mode), a);
+    }
+    else
+    {
+      value = operandM(mode);
+
+      switch(op >> 5)
+      {
+        case 0:
+          value |= a;
+          break;
+        case 1:
+          value &= a;
+          break;
+        case 2:
+          value ^= a;
+          break;
+        case 3:
+          adc(value);
+          break;
+        case 6:
+          compare(a, value, m8);
+          break;
+        case 7:
+          sbc(value);
+          break;
+      }
+
+      // ORA/AND/EOR/LDA
+      if((op >> 5) <= 2 || (op >> 5) == 5)
+      {
+        if(m8)
+          a = (a & 0xFF00) | (value & 0xFF);
+        else
+          a = value & 0xFFFF;
+
+        setNZ(a, m8);
+      }
+    }
+  }
+  else
+  {
+    switch(op)
+    {
+      // read-modify-write on memory
+      case 0x04: case 0x06: case 0x0C: case 0x0E:
+      case 0x14: case 0x16: case 0x1C: case 0x1E:
+      case 0x26: case 0x2E: case 0x36: case 0x3E:
+      case 0x46: case 0x4E: case 0x56: case 0x5E:
+      case 0x66: case 0x6E: case 0x76: case 0x7E:
+      case 0xC6: case 0xCE: case 0xD6: case 0xDE:
+      case 0xE6: case 0xEE: case 0xF6: case 0xFE:
+        ea = address(mode);
+        writeM(ea, shift(op, readM(ea)));
+        break;
+
+      // accumulator shifts
+      case 0x0A: case 0x2A: case 0x4A: case 0x6A:
+        value = shift(op, a);
+        a = m8 ? ((a & 0xFF00) | value) : value;
+        break;
+      case 0x1A:
+        value = shift(0xE0, a);
+        a = m8 ? ((a & 0xFF00) | value) : value;
+        break;
+      case 0x3A:
+        value = shift(0xC0, a);
+        a = m8 ? ((a & 0xFF00) | value) : value;
+        break;
+
+      // BIT
+      case 0x89:
+        value = operandM(mode);
+        setFlag(FLAG_Z, (value & a & (m8 ? 0xFF : 0xFFFF)) == 0);
+        break;
+      case 0x24: case 0x2C: case 0x34: case 0x3C:
+        value = operandM(mode);
+        setFlag(FLAG_Z, (value & a & (m8 ? 0xFF : 0xFFFF)) == 0);
+        setFlag(FLAG_N, (value & (m8 ? 0x80 : 0x8000)) != 0);
+        setFlag(FLAG_V, (value & (m8 ? 0x40 : 0x4000)) != 0);
+        break;
+
+      // index registers
+      case 0xA2: case 0xA6: case 0xAE: case 0xB6: case 0xBE:
+        x = operandX(mode);
+        setNZ(x, x8);
+        break;
+      case 0xA0: case 0xA4: case 0xAC: case 0xB4: case 0xBC:
+        y = operandX(mode);
+        setNZ(y, x8);
+        break;
+      case 0x86: case 0x8E: case 0x96:
+        writeX(address(mode), x);
+        break;
+      case 0x84: case 0x8C: case 0x94:
+        writeX(address(mode), y);
+        break;
+      case 0xE0: case 0xE4: case 0xEC:
+        compare(x, operandX(mode), x8);
+        break;
+      case 0xC0: case 0xC4: case 0xCC:
+        compare(y, operandX(mode), x8);
+        break;
+      case 0xE8:
+        x = (x + 1) & (x8 ? 0xFF : 0xFFFF);
+        setNZ(x, x8);
+        break;
+      case 0xC8:
+        y = (y + 1) & (x8 ? 0xFF : 0xFFFF);
+        setNZ(y, x8);
+        break;
+      case 0xCA:
+        x = (x - 1) & (x8 ? 0xFF : 0xFFFF);
+        setNZ(x, x8);
+        break;
+      case 0x88:
+        y = (y - 1) & (x8 ? 0xFF : 0xFFFF);
+        setNZ(y, x8);
+        break;
+
+      // STZ
+      case 0x64: case 0x74: case 0x9C: case 0x9E:
+        writeM(address(mode), 0);
+        break;
+
+      // branches
+      case 0x10:
+        branch((sr & FLAG_N) == 0);
+        break;
+      case 0x30:
+        branch((sr & FLAG_N) != 0);
+        break;
+      case 0x50:
+        branch((sr & FLAG_V) == 0);
+        break;
+      case 0x70:
+        branch((sr & FLAG_V) != 0);
+        break;
+      case 0x90:
+        branch((sr & FLAG_C) == 0);
+        break;
+      case 0xB0:
+        branch((sr & FLAG_C) != 0);
+        break;
+      case 0xD0:
+        branch((sr & FLAG_Z) == 0);
+        break;
+      case 0xF0:
+        branch((sr & FLAG_Z) != 0);
+        break;
+      case 0x80:
+        branch(true);
+        taken = false;
+        break;
+      case 0x82:
+        value = fetch16();
+        pc = (pc + value) & 0xFFFF;
+        break;
+
+      // jumps and calls
+      case 0x4C:
+        pc = fetch16();
+        break;
+      case 0x5C:
+        value = fetch24();
+        pc = value & 0xFFFF;
+        pb = value >> 16;
+        break;
+      case 0x6C:
+        pc = read16(fetch16());
+        break;
+      case 0x7C:
+        pc = read16((pb << 16) | ((fetch16() + x) & 0xFFFF));
+        break;
+      case 0xDC:
+        value = read24(fetch16());
+        pc = value & 0xFFFF;
+        pb = value >> 16;
+        break;
+      case 0x20:
+        value = fetch16();
+        push16(pc - 1);
+        pc = value;
+        break;
+      case 0xFC:
+        ea = (pb << 16) | ((fetch16() + x) & 0xFFFF);
+        push16(pc - 1);
+        pc = read16(ea);
+        break;
+      case 0x22:
+        value = fetch24();
+        push8(pb);
+        push16(pc - 1);
+        pc = value & 0xFFFF;
+        pb = value >> 16;
+        break;
+      case 0x60:
+        pc = (pull16() + 1) & 0xFFFF;
+        break;
+      case 0x6B:
+        pc = (pull16() + 1) & 0xFFFF;
+        pb = pull8();
+        break;
+      case 0x40:
+        setP(pull8());
+        pc = pull16();
+
+        if(e == false)
+          pb = pull8();
+        break;
+
+      // stack
+      case 0x48:
+        if(m8)
+          push8(a);
+        else
+          push16(a);
+        break;
+      case 0x68:
+        if(m8)
+          a = (a & 0xFF00) | pull8();
+        else
+          a = pull16();
+
+        setNZ(a, m8);
+        break;
+      case 0xDA:
+        if(x8)
+          push8(x);
+        else
+          push16(x);
+        break;
+      case 0xFA:
+        x = x8 ? pull8() : pull16();
+        setNZ(x, x8);
+        break;
+      case 0x5A:
+        if(x8)
+          push8(y);
+        else
+          push16(y);
+        break;
+      case 0x7A:
+        y = x8 ? pull8() : pull16();
+        setNZ(y, x8);
+        break;
+      case 0x08:
+        push8(sr);
+        break;
+      case 0x28:
+        setP(pull8());
+        break;
+      case 0x8B:
+        push8(db);
+        break;
+      case 0xAB:
+        db = pull8();
+        setNZ(db, true);
+        break;
+      case 0x0B:
+        push16(dp);
+        break;
+      case 0x2B:
+        dp = pull16();
+        setNZ(dp, false);
+        break;
+      case 0x4B:
+        push8(pb);
+        break;
+      case 0xF4:
+        push16(fetch16());
+        break;
+      case 0xD4:
+        push16(read16((dp + fetch8()) & 0xFFFF));
+        break;
+      case 0x62:
+        value = fetch16();
+        push16((pc + value) & 0xFFFF);
+        break;
+
+      // flags
+      case 0x18:
+        sr &= ~FLAG_C;
+        break;
+      case 0x38:
+        sr |= FLAG_C;
+        break;
+      case 0x58:
+        sr &= ~FLAG_I;
+        break;
+      case 0x78:
+        sr |= FLAG_I;
+        break;
+      case 0xB8:
+        sr &= ~FLAG_V;
+        break;
+      case 0xD8:
+        sr &= ~FLAG_D;
+        break;
+      case 0xF8:
+        sr |= FLAG_D;
+        break;
+      case 0xC2:
+        setP(sr & ~fetch8());
+        break;
+      case 0xE2:
+        setP(sr | fetch8());
+        break;
+      case 0xFB:
+      {
+        bool carry = (sr & FLAG_C) != 0;
+
+        setFlag(FLAG_C, e);
+        e = carry;
+
+        if(e == true)
+        {
+          sp = 0x100 | (sp & 0xFF);
+          setP(sr);
+        }
+
+        break;
+      }
+
+      // transfers
+      case 0xAA:
+        x = a & (x8 ? 0xFF : 0xFFFF);
+        setNZ(x, x8);
+        break;
+      case 0xA8:
+        y = a & (x8 ? 0xFF : 0xFFFF);
+        setNZ(y, x8);
+        break;
+      case 0x8A:
+        a = m8 ? ((a & 0xFF00) | (x & 0xFF)) : x;
+        setNZ(a, m8);
+        break;
+      case 0x98:
+        a = m8 ? ((a & 0xFF00) | (y & 0xFF)) : y;
+        setNZ(a, m8);
+        break;
+      case 0x9B:
+        y = x;
+        setNZ(y, x8);
+        break;
+      case 0xBB:
+        x = y;
+        setNZ(x, x8);
+        break;
+      case 0xBA:
+        x = sp & (x8 ? 0xFF : 0xFFFF);
+        setNZ(x, x8);
+        break;
+      case 0x9A:
+        sp = e ? (0x100 | (x & 0xFF)) : x;
+        break;
+      case 0x1B:
+        sp = e ? (0x100 | (a & 0xFF)) : a;
+        break;
+      case 0x3B:
+        a = sp;
+        setNZ(a, false);
+        break;
+      case 0x5B:
+        dp = a;
+        setNZ(dp, false);
+        break;
+      case 0x7B:
+        a = dp;
+        setNZ(a, false);
+        break;
+      case 0xEB:
+        a = ((a >> 8) | (a << 8)) & 0xFFFF;
+        setNZ(a, true);
+        break;
+
+      // block moves
+      case 0x44:
+        blockMove(-1);
+        break;
+      case 0x54:
+        blockMove(1);
+        break;
+
+      case 0xEA:
+        break;
+      case 0x42:
+        fetch8();
+        break;
+
+      // return control to the monitor
+      case 0x00:
+        stop_reason = STOP_BRK;
+        stop_address = start;
+        break;
+      case 0x02:
+        stop_reason = STOP_COP;
+        stop_address = start;
+        break;
+      case 0xDB:
+        stop_reason = STOP_STP;
+        stop_address = start;
+        break;
+      case 0xCB:
+        stop_reason = STOP_WAI;
+        stop_address = start;
+        break;
+    }
+  }
+
+  if(coverage != NULL)
+  {
+    coverage->execute(start);
+
+    if(Opcodes::table[op].flags & Opcodes::FLAG_BRANCH)
+      coverage->branch(start, taken);
+  }
+
+  if(trace != NULL)
+    trace->end(this, start, op);
+
+  cycles += Opcodes::cycles(op, m8, x8, old_e, old_dp, cross, taken);
+  instructions++;
+}
+
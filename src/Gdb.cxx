@@ -0,0 +1,812 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#ifndef WIN32
+  #include <csignal>
+  #include <arpa/inet.h>
+  #include <fcntl.h>
+  #include <netinet/in.h>
+  #include <netinet/tcp.h>
+  #include <sys/socket.h>
+  #include <unistd.h>
+#endif
+
+#include <FL/Fl.H>
+
+#include "Debugger.H"
+#include "Gdb.H"
+#include "Gui.H"
+#include "Monitor.H"
+#include "Terminal.H"
+
+namespace
+{
+  // seconds between socket polls
+  const double PERIOD = 0.02;
+
+  // most text kept while waiting for the monitor's prompt
+  const size_t HEARD = 256;
+
+  // memory is cached in lines while the program is stopped
+  const int LINE = 64;
+
+  // missing lines this close together are read as one
+  const int GAP = 2 * LINE;
+
+  // longest single read
+  const int LONGEST = 256;
+
+  // largest packet we accept or send
+  const int PACKET = 4096;
+
+  bool running = false;
+  int listener = -1;
+  int client = -1;
+  std::string in;
+  bool ack = true;
+  bool busy = false;
+  bool detached = false;
+
+  // the program was continued and has not stopped yet
+  bool continued = false;
+  // what the board printed since then, the monitor's prompt at the
+  // end means a breakpoint brought it back
+  std::string heard;
+
+  // raw board memory by line address, breakpoints still in place
+  std::map<int, std::vector<unsigned char> > cache;
+
+  // lines asked for by m packets and how many were already cached
+  int reads = 0;
+  int hits = 0;
+
+  int hex(int c)
+  {
+    if(c >= '0' && c <= '9')
+      return c - '0';
+
+    if(c >= 'a' && c <= 'f')
+      return c - 'a' + 10;
+
+    if(c >= 'A' && c <= 'F')
+      return c - 'A' + 10;
+
+    return -1;
+  }
+
+  std::string toHex(const unsigned char *data, int count)
+  {
+    static const char digits[] = "0123456789abcdef";
+    std::string s;
+
+    for(int i = 0; i < count; i++)
+    {
+      s += digits[data[i] >> 4];
+      s += digits[data[i] & 15];
+    }
+
+    return s;
+  }
+
+  bool fromHex(const char *s, unsigned char *data, int count)
+  {
+    for(int i = 0; i < count; i++)
+    {
+      const int hi = hex(s[i * 2]);
+      const int lo = hi < 0 ? -1 : hex(s[i * 2 + 1]);
+
+      if(lo < 0)
+        return false;
+
+      data[i] = (hi << 4) | lo;
+    }
+
+    return true;
+  }
+
+  void closeClient();
+
+  void send(const std::string &text)
+  {
+#ifndef WIN32
+    if(client < 0)
+      return;
+
+    int sum = 0;
+    char tail[4];
+
+    for(size_t i = 0; i < text.size(); i++)
+      sum += (unsigned char)text[i];
+
+    sprintf(tail, "#%02x", sum & 0xFF);
+
+    const std::string packet = "$" + text + tail;
+    size_t done = 0;
+
+    // replies are small, wait out a full socket buffer
+    while(done < packet.size())
+    {
+      const int sent = write(client, packet.data() + done,
+                             packet.size() - done);
+
+      if(sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK ||
+                      errno == EINTR))
+      {
+        usleep(1000);
+        continue;
+      }
+
+      // gdb went away in the middle of a reply
+      if(sent <= 0)
+      {
+        Gui::append("\nGDB connection lost.\n");
+        closeClient();
+        return;
+      }
+
+      done += sent;
+    }
+#endif
+  }
+
+  // 8 registers in Terminal order, 32-bit little-endian each
+  std::string packRegs(const int *r)
+  {
+    unsigned char data[32];
+
+    for(int i = 0; i < 8; i++)
+    {
+      data[i * 4 + 0] = r[i];
+      data[i * 4 + 1] = r[i] >> 8;
+      data[i * 4 + 2] = r[i] >> 16;
+      data[i * 4 + 3] = 0;
+    }
+
+    return toHex(data, sizeof(data));
+  }
+
+  // read the lines covering the ranges, missing lines close together
+  // are read in one go
+  bool fill(const std::vector<std::pair<int, int> > &ranges)
+  {
+    std::set<int> missing;
+
+    for(size_t i = 0; i < ranges.size(); i++)
+    {
+      const int first = ranges[i].first & ~(LINE - 1);
+      const int last = (ranges[i].first + ranges[i].second - 1) & ~(LINE - 1);
+
+      for(int line = first; line <= last; line += LINE)
+      {
+        if(cache.count(line) == 0)
+          missing.insert(line);
+      }
+    }
+
+    std::set<int>::iterator i = missing.begin();
+
+    while(i != missing.end())
+    {
+      const int start = *i;
+      int end = start + LINE;
+
+      for(++i; i != missing.end(); ++i)
+      {
+        if(*i - end > GAP || *i + LINE - start > LONGEST ||
+           (*i >> 16) != (start >> 16))
+        {
+          break;
+        }
+
+        end = *i + LINE;
+      }
+
+      unsigned char data[LONGEST];
+
+      if(Terminal::readMemory(start, data, end - start) != end - start)
+        return false;
+
+      for(int line = start; line < end; line += LINE)
+        cache[line].assign(data + line - start, data + line - start + LINE);
+    }
+
+    return true;
+  }
+
+  bool readCached(int address, unsigned char *data, int count)
+  {
+    for(int i = 0; i < count; i++)
+    {
+      const int a = (address + i) & 0xFFFFFF;
+      std::map<int, std::vector<unsigned char> >::iterator line =
+        cache.find(a & ~(LINE - 1));
+
+      if(line == cache.end())
+        return false;
+
+      data[i] = line->second[a & (LINE - 1)];
+    }
+
+    Debugger::unpatch(address, data, count);
+    return true;
+  }
+
+  bool parseRange(const char *s, int *address, int *count)
+  {
+    char *end;
+
+    *address = strtol(s, &end, 16);
+
+    if(*end != ',')
+      return false;
+
+    *count = strtol(end + 1, &end, 16);
+
+    return *address >= 0 && *count >= 0 &&
+           *address + *count <= 0x1000000 && *count <= PACKET / 2;
+  }
+
+  std::string readMemory(const std::string &packet)
+  {
+    int address, count;
+    unsigned char data[PACKET / 2];
+
+    if(parseRange(packet.c_str() + 1, &address, &count) == false)
+      return "E01";
+
+    if(count == 0)
+      return "";
+
+    for(int line = address & ~(LINE - 1); line < address + count; line += LINE)
+    {
+      reads++;
+
+      if(cache.count(line) > 0)
+        hits++;
+    }
+
+    std::vector<std::pair<int, int> > ranges;
+
+    ranges.push_back(std::make_pair(address, count));
+
+    if(fill(ranges) == false || readCached(address, data, count) == false)
+      return "E03";
+
+    return toHex(data, count);
+  }
+
+  // M with hex data, X with binary, either keeps the cache current
+  std::string writeMemory(const std::string &packet)
+  {
+    int address, count;
+    unsigned char data[PACKET];
+    const char *colon = strchr(packet.c_str(), ':');
+
+    if(colon == NULL ||
+       parseRange(packet.c_str() + 1, &address, &count) == false)
+    {
+      return "E01";
+    }
+
+    if(packet[0] == 'M')
+    {
+      if((int)strlen(colon + 1) < count * 2 ||
+         fromHex(colon + 1, data, count) == false)
+      {
+        return "E01";
+      }
+    }
+    else
+    {
+      const int offset = colon + 1 - packet.c_str();
+
+      if((int)packet.size() - offset < count)
+        return "E01";
+
+      memcpy(data, packet.data() + offset, count);
+    }
+
+    if(count == 0)
+      return "OK";
+
+    if(Terminal::uploadData(address, data, count) == false)
+      return "E03";
+
+    for(int i = 0; i < count; i++)
+    {
+      const int a = address + i;
+      std::map<int, std::vector<unsigned char> >::iterator line =
+        cache.find(a & ~(LINE - 1));
+
+      if(line != cache.end())
+        line->second[a & (LINE - 1)] = data[i];
+    }
+
+    return "OK";
+  }
+
+  std::string setRegs(const std::string &packet)
+  {
+    unsigned char data[32];
+    int r[8];
+
+    if(packet.size() < 65 || fromHex(packet.c_str() + 1, data, 32) == false)
+      return "E01";
+
+    for(int i = 0; i < 8; i++)
+      r[i] = data[i * 4] | (data[i * 4 + 1] << 8) | (data[i * 4 + 2] << 16);
+
+    Terminal::setRegs(r);
+    return "OK";
+  }
+
+  // single register, p n or P n=value
+  std::string oneReg(const std::string &packet)
+  {
+    char *end;
+    const int n = strtol(packet.c_str() + 1, &end, 16);
+    int r[8];
+
+    if(n < 0 || n >= 8 || Debugger::isStopped(r) == false)
+      return "E01";
+
+    if(packet[0] == 'p')
+      return packRegs(r).substr(n * 8, 8);
+
+    unsigned char data[4];
+
+    if(*end != '=' || fromHex(end + 1, data, 4) == false)
+      return "E01";
+
+    r[n] = data[0] | (data[1] << 8) | (data[2] << 16);
+    Terminal::setRegs(r);
+    return "OK";
+  }
+
+  // c and s may carry an address to resume at
+  bool resumeAt(const std::string &packet, int *r)
+  {
+    if(Debugger::isStopped(r) == false)
+      return false;
+
+    if(packet.size() > 1)
+    {
+      r[Monitor::REG_PC] = strtol(packet.c_str() + 1, NULL, 16) & 0xFFFFFF;
+      Terminal::setRegs(r);
+
+      if(Debugger::isStopped(r) == false)
+        return false;
+    }
+
+    return true;
+  }
+
+  std::string breakpoint(const std::string &packet)
+  {
+    if(packet.size() < 3 || packet[1] != '0')
+      return "";
+
+    const int address = strtol(packet.c_str() + 3, NULL, 16) & 0xFFFFFF;
+    bool ok;
+
+    cache.erase(address & ~(LINE - 1));
+
+    if(packet[0] == 'Z')
+      ok = Debugger::addBreakpoint(address);
+    else
+      ok = Debugger::removeBreakpoint(address);
+
+    return ok ? "OK" : "E03";
+  }
+
+  void handle(const std::string &packet)
+  {
+    int r[8];
+
+    if(packet.size() == 0)
+    {
+      send("");
+      return;
+    }
+
+    switch(packet[0])
+    {
+      case '?':
+        send("S05");
+        return;
+      case 'g':
+        send(Debugger::isStopped(r) ? packRegs(r) : "E03");
+        return;
+      case 'G':
+        send(setRegs(packet));
+        return;
+      case 'p':
+      case 'P':
+        send(oneReg(packet));
+        return;
+      case 'm':
+        send(readMemory(packet));
+        return;
+      case 'M':
+      case 'X':
+        send(writeMemory(packet));
+        return;
+      case 'Z':
+      case 'z':
+        send(breakpoint(packet));
+        return;
+      case 'c':
+        cache.clear();
+
+        if(resumeAt(packet, r) == false || Debugger::resume() == false)
+        {
+          send("E03");
+          return;
+        }
+
+        continued = true;
+        heard.clear();
+        return;
+      case 's':
+        cache.clear();
+
+        if(resumeAt(packet, r) == false ||
+           Debugger::stepInstruction(r) == false)
+        {
+          send("E03");
+          return;
+        }
+
+        send("S05");
+        return;
+      case 'H':
+        send("OK");
+        return;
+      case 'D':
+        send("OK");
+        detached = true;
+        return;
+      case 'k':
+        detached = true;
+        return;
+    }
+
+    if(packet.compare(0, 10, "qSupported") == 0)
+    {
+      char s[64];
+
+      sprintf(s, "PacketSize=%x;QStartNoAckMode+", PACKET);
+      send(s);
+    }
+    else if(packet == "QStartNoAckMode")
+    {
+      send("OK");
+      ack = false;
+    }
+    else if(packet == "qAttached")
+    {
+      send("1");
+    }
+    else
+    {
+      send("");
+    }
+  }
+
+  // complete packets in the input, acknowledged as they are taken
+  void collect(std::vector<std::string> &packets)
+  {
+#ifndef WIN32
+    size_t pos = 0;
+
+    while(pos < in.size())
+    {
+      const char c = in[pos];
+
+      if(c != '$')
+      {
+        // ^C cannot halt the board, the NMI button has to
+        if(c == 3)
+          Gui::append("\nGDB interrupt: press NMI on the board to stop it.\n");
+
+        pos++;
+        continue;
+      }
+
+      const size_t hash = in.find('#', pos);
+
+      if(hash == std::string::npos || hash + 3 > in.size())
+        break;
+
+      std::string body;
+      int sum = 0;
+
+      for(size_t i = pos + 1; i < hash; i++)
+      {
+        sum += (unsigned char)in[i];
+
+        if(in[i] == '}' && i + 1 < hash)
+        {
+          i++;
+          sum += (unsigned char)in[i];
+          body += (char)(in[i] ^ 0x20);
+        }
+        else
+        {
+          body += in[i];
+        }
+      }
+
+      const bool good = hex(in[hash + 1]) * 16 + hex(in[hash + 2]) ==
+                        (sum & 0xFF);
+
+      pos = hash + 3;
+
+      if(ack == true)
+      {
+        if(write(client, good ? "+" : "-", 1) < 0)
+          break;
+      }
+
+      if(good == true || ack == false)
+        packets.push_back(body);
+    }
+
+    in.erase(0, pos);
+#endif
+  }
+
+  // read ahead for every memory packet already waiting, so neighbouring
+  // requests share serial round trips
+  void prefetch(const std::vector<std::string> &packets)
+  {
+    std::vector<std::pair<int, int> > ranges;
+
+    for(size_t i = 0; i < packets.size(); i++)
+    {
+      int address, count;
+
+      if(packets[i][0] == 'm' &&
+         parseRange(packets[i].c_str() + 1, &address, &count) == true &&
+         count > 0)
+      {
+        ranges.push_back(std::make_pair(address, count));
+      }
+    }
+
+    if(ranges.size() > 1)
+      fill(ranges);
+  }
+
+  void hear(const char *data, int count)
+  {
+    if(continued == false)
+      return;
+
+    heard.append(data, count);
+
+    if(heard.size() > HEARD)
+      heard.erase(0, heard.size() - HEARD);
+  }
+
+  // nothing is typed until the prompt shows, so a running program's
+  // input is left alone
+  void checkStopped()
+  {
+    const size_t end = heard.find_last_not_of(" \n");
+    int r[8];
+
+    if(end == std::string::npos || (heard[end] != '.' && heard[end] != '>') ||
+       (end > 0 && heard[end - 1] != '\n'))
+    {
+      return;
+    }
+
+    heard.clear();
+
+    if(Debugger::isStopped(r) == true)
+    {
+      continued = false;
+      send("S05");
+    }
+  }
+
+  void closeClient()
+  {
+#ifndef WIN32
+    if(client >= 0)
+      close(client);
+#endif
+
+    client = -1;
+    in.clear();
+    cache.clear();
+    continued = false;
+    heard.clear();
+    detached = false;
+  }
+}
+
+// "3333" or "localhost:3333" listen on loopback only,
+// "0.0.0.0:3333" or another address must be asked for
+bool Gdb::start(const char *where)
+{
+#ifdef WIN32
+  fprintf(stderr, "The gdb server needs POSIX sockets.\n");
+  return false;
+#else
+  const char *colon = strrchr(where, ':');
+  struct sockaddr_in address;
+  int yes = 1;
+
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons(atoi(colon != NULL ? colon + 1 : where));
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  if(colon != NULL && strncmp(where, "localhost:", 10) != 0)
+  {
+    const std::string host(where, colon - where);
+
+    if(inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1)
+      return false;
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+  listener = socket(AF_INET, SOCK_STREAM, 0);
+
+  if(listener < 0)
+    return false;
+
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+  if(bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+     listen(listener, 1) != 0)
+  {
+    close(listener);
+    listener = -1;
+    return false;
+  }
+
+  fcntl(listener, F_SETFL, fcntl(listener, F_GETFL) | O_NONBLOCK);
+  running = true;
+  Terminal::addListener(hear);
+  Fl::add_timeout(PERIOD, poll);
+
+  return true;
+#endif
+}
+
+void Gdb::stop()
+{
+#ifndef WIN32
+  Fl::remove_timeout(poll);
+  Terminal::removeListener(hear);
+  closeClient();
+
+  if(listener >= 0)
+    close(listener);
+
+  listener = -1;
+  running = false;
+#endif
+}
+
+bool Gdb::isRunning()
+{
+  return running;
+}
+
+void Gdb::poll(void *)
+{
+#ifndef WIN32
+  // stepping waits in Fl::wait, which may call us again
+  if(busy == true)
+  {
+    Fl::repeat_timeout(PERIOD, poll);
+    return;
+  }
+
+  busy = true;
+
+  Terminal::Hold hold;
+
+  if(client < 0)
+  {
+    client = accept(listener, 0, 0);
+
+    if(client >= 0)
+    {
+      int yes = 1;
+
+      fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK);
+      setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+      ack = true;
+      reads = 0;
+      hits = 0;
+      Gui::append("\nGDB connected.\n");
+    }
+  }
+
+  if(client >= 0)
+  {
+    char s[4096];
+    bool closed = false;
+
+    while(true)
+    {
+      const int bytes = read(client, s, sizeof(s));
+
+      if(bytes == 0)
+        closed = true;
+
+      if(bytes <= 0)
+        break;
+
+      in.append(s, bytes);
+    }
+
+    std::vector<std::string> packets;
+
+    collect(packets);
+
+    // while the program runs only an interrupt is expected
+    if(continued == true)
+      checkStopped();
+
+    if(continued == false)
+    {
+      prefetch(packets);
+
+      for(size_t i = 0; i < packets.size() && detached == false &&
+                       client >= 0; i++)
+      {
+        handle(packets[i]);
+      }
+    }
+
+    if(client >= 0 && (closed == true || detached == true))
+    {
+      char text[256];
+
+      snprintf(text, sizeof(text),
+               "\nGDB disconnected, %d of %d memory lines from cache.\n",
+               hits, reads);
+      Gui::append(text);
+      closeClient();
+    }
+  }
+
+  busy = false;
+#endif
+
+  Fl::repeat_timeout(PERIOD, poll);
+}
+
@@ -21,8 +21,11 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
 // test comment
 
 #include <cmath>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <typeinfo>
+#include <vector>
 
 #include <FL/Fl_Box.H>
 #include <FL/Fl_Button.H>
@@ -31,14 +34,27 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
 #include <FL/Fl_Input.H>
 #include <FL/Fl_Light_Button.H>
 #include <FL/Fl_Menu_Bar.H>
+#include <FL/Fl_Tabs.H>
 #include <FL/Fl_Text_Display.H>
 #include <FL/Fl_Tooltip.H>
 #include <FL/Fl_Widget.H>
 
+#include "Agent.H"
+#include "Backtrace.H"
+#include "Benchmark.H"
+#include "Checkpoint.H"
+#include "Debugger.H"
 #include "Dialog.H"
 #include "Gui.H"
+#include "Lockstep.H"
+#include "Monitor.H"
+#include "Script.H"
 #include "Separator.H"
+#include "Snapshot.H"
+#include "Telemetry.H"
 #include "Terminal.H"
+#include "Trigger.H"
+#include "Watch.H"
 
 class MainWin;
 
@@ -53,9 +69,26 @@ namespace
   Fl_Group *top;
   Fl_Group *side;
 
-  Fl_Text_Buffer *server_text;
+  // console of the current tab
+  Fl_Text_Buffer *server_text = 0;
   Fl_Text_Display *server_display;
 
+  // one tab per board, each keeps its own scrollback and registers
+  struct Tab
+  {
+    Fl_Group *group;
+    Fl_Text_Display *display;
+    Fl_Text_Buffer *text;
+    int mode;
+    int regs[8];
+    bool has_regs;
+  };
+
+  Fl_Tabs *tabs;
+  std::vector<Tab *> tab_list;
+  int tab = 0;
+  int font_size = 14;
+
   Fl_Input *input_pc;
   Fl_Input *input_a;
   Fl_Input *input_x;
@@ -79,6 +112,105 @@ namespace
   Fl_Light_Button *light_z;
   Fl_Light_Button *light_c;
 
+  // add scrollback to a console
+  void appendText(Fl_Text_Buffer *buffer, Fl_Text_Display *display,
+                  const char *buf)
+  {
+    char text[4096];
+    strncpy(text, buf, sizeof(text) - 1);
+    text[sizeof(text) - 1] = '\0';
+
+    // convert carriage returns
+    for(size_t i = 0; i < sizeof(text); i++)
+    {
+      if(text[i] == '\0')
+        break;
+
+      if(text[i] == 13)
+        text[i] = '\n';
+    }
+
+    buffer->append(text);
+
+    int lines = buffer->count_lines(0, buffer->length());
+
+    // limit scrollback buffer to 1000 lines
+    while(lines > 1000)
+    {
+      buffer->remove(buffer->line_start(1), buffer->line_end(1) + 1);
+      lines--;
+    }
+
+    // scroll display to bottom
+    display->insert_position(buffer->length());
+    display->show_insert_position();
+  }
+
+  Tab *newTab(const char *label)
+  {
+    Tab *t = new Tab();
+
+    tabs->begin();
+
+    t->group = new Fl_Group(tabs->x(), tabs->y() + 24,
+                            tabs->w(), tabs->h() - 24);
+    t->group->copy_label(label);
+
+    t->text = new Fl_Text_Buffer();
+    t->display = new Fl_Text_Display(t->group->x(), t->group->y(),
+                                      t->group->w(), t->group->h());
+    t->display->box(FL_UP_BOX);
+    t->display->scrollbar_width(18);
+    t->display->textsize(font_size);
+    t->display->textfont(FL_COURIER);
+    t->display->wrap_mode(Fl_Text_Display::WRAP_AT_BOUNDS, 0);
+    t->display->buffer(t->text);
+    t->display->cursor_style(Fl_Text_Display::BLOCK_CURSOR);
+    t->display->show_cursor();
+
+    t->group->resizable(t->display);
+    t->group->end();
+
+    tabs->end();
+
+    t->mode = mode;
+    t->has_regs = false;
+    tab_list.push_back(t);
+
+    return t;
+  }
+
+  void setFont(int size)
+  {
+    font_size = size;
+
+    for(size_t i = 0; i < tab_list.size(); i++)
+    {
+      tab_list[i]->display->textsize(size);
+      tab_list[i]->display->buffer(0);
+      tab_list[i]->display->buffer(tab_list[i]->text);
+      tab_list[i]->display->redraw();
+    }
+  }
+
+  // the user clicked a tab
+  void tabsCallback(Fl_Widget *, void *)
+  {
+    for(size_t i = 0; i < tab_list.size(); i++)
+    {
+      if(tab_list[i]->group == tabs->value())
+      {
+        Terminal::selectBoard(i);
+        break;
+      }
+    }
+  }
+
+  void newBoard()
+  {
+    Terminal::addBoard();
+  }
+
   // quit program
   void quit()
   {
@@ -175,11 +307,65 @@ void Gui::init()
     (Fl_Callback *)Dialog::connect, 0, 0);
   menubar->add("&File/&Disconnect", 0,
     (Fl_Callback *)Terminal::disconnect, 0, FL_MENU_DIVIDER);
+  menubar->add("&File/&New Board Tab", 0,
+    (Fl_Callback *)newBoard, 0, 0);
+  menubar->add("&File/Close Board &Tab", 0,
+    (Fl_Callback *)Terminal::removeBoard, 0, FL_MENU_DIVIDER);
   menubar->add("&File/&Upload Program...", 0,
-    (Fl_Callback *)Terminal::upload, 0, FL_MENU_DIVIDER);
+    (Fl_Callback *)Terminal::upload, 0, 0);
+  menubar->add("&File/&Run Script...", 0,
+    (Fl_Callback *)Script::begin, 0, FL_MENU_DIVIDER);
   menubar->add("&File/&Quit...", 0,
     (Fl_Callback *)quit, 0, 0);
 
+  menubar->add("&Debug/&Compare With Emulator...", 0,
+    (Fl_Callback *)Lockstep::begin, 0, 0);
+  menubar->add("&Debug/Bench&mark...", 0,
+    (Fl_Callback *)Benchmark::begin, 0, 0);
+  menubar->add("&Debug/RAM T&est...", 0,
+    (Fl_Callback *)Dialog::ramTest, 0, 0);
+  menubar->add("&Debug/&Profile...", 0,
+    (Fl_Callback *)Dialog::profile, 0, FL_MENU_DIVIDER);
+  menubar->add("&Debug/Install &Agent...", 0,
+    (Fl_Callback *)Dialog::installAgent, 0, 0);
+  menubar->add("&Debug/Remo&ve Agent", 0,
+    (Fl_Callback *)Agent::remove, 0, FL_MENU_DIVIDER);
+  menubar->add("&Debug/&Toggle Breakpoint", FL_F + 9,
+    (Fl_Callback *)Debugger::toggleBreakpoint, 0, 0);
+  menubar->add("&Debug/C&lear Breakpoints", 0,
+    (Fl_Callback *)Debugger::clearBreakpoints, 0, FL_MENU_DIVIDER);
+  menubar->add("&Debug/&Refresh", 0,
+    (Fl_Callback *)Debugger::refresh, 0, 0);
+  menubar->add("&Debug/Co&ntinue", FL_F + 5,
+    (Fl_Callback *)Debugger::go, 0, 0);
+  menubar->add("&Debug/Step &Into", FL_F + 11,
+    (Fl_Callback *)Debugger::stepInto, 0, 0);
+  menubar->add("&Debug/Step &Over", FL_F + 10,
+    (Fl_Callback *)Debugger::stepOver, 0, 0);
+  menubar->add("&Debug/&Step N...", 0,
+    (Fl_Callback *)Dialog::stepCount, 0, FL_MENU_DIVIDER);
+  menubar->add("&Debug/&Backtrace", 0,
+    (Fl_Callback *)Backtrace::show, 0, 0);
+  menubar->add("&Debug/&Watch", 0,
+    (Fl_Callback *)Watch::show, 0, 0);
+  menubar->add("&Debug/Snaps&hot", 0,
+    (Fl_Callback *)Snapshot::show, 0, FL_MENU_DIVIDER);
+  menubar->add("&Debug/Save Chec&kpoint...", 0,
+    (Fl_Callback *)Dialog::checkpoint, 0, 0);
+  menubar->add("&Debug/Loa&d Checkpoint...", 0,
+    (Fl_Callback *)Checkpoint::restore, 0, 0);
+
+  menubar->add("&Telemetry/&Load Layouts...", 0,
+    (Fl_Callback *)Telemetry::begin, 0, 0);
+  menubar->add("&Telemetry/Load &Format Strings...", 0,
+    (Fl_Callback *)Telemetry::loadFormats, 0, FL_MENU_DIVIDER);
+  menubar->add("&Telemetry/&Start Log...", 0,
+    (Fl_Callback *)Telemetry::startLog, 0, 0);
+  menubar->add("&Telemetry/S&top Log", 0,
+    (Fl_Callback *)Telemetry::stopLog, 0, FL_MENU_DIVIDER);
+  menubar->add("&Telemetry/Tri&gger Capture...", 0,
+    (Fl_Callback *)Trigger::show, 0, 0);
+
   menubar->add("&Options/&Board Model/W65C265SXB", 0,
     (Fl_Callback *)setMode265, 0, FL_MENU_RADIO);
   menubar->add("&Options/&Board Model/W65C134SXB", 0,
@@ -197,8 +383,6 @@ void Gui::init()
   menubar->add("&Help/&About...", 0,
     (Fl_Callback *)Dialog::about, 0, 0);
 
-  server_text = new Fl_Text_Buffer();
-
   top = new Fl_Group(0, menubar->h(),
                      window->w(), window->h() - menubar->h());
 
@@ -354,19 +538,18 @@ void Gui::init()
   side->resizable(0);
   side->end();
 
-  server_display = new Fl_Text_Display(top->x() + side->w(), top->y(),
-                                       top->w() - side->w(), top->h());
+  tabs = new Fl_Tabs(top->x() + side->w(), top->y(),
+                     top->w() - side->w(), top->h());
+  tabs->callback(tabsCallback);
+  tabs->end();
 
-  server_display->box(FL_UP_BOX);
-  server_display->scrollbar_width(18);
-  server_display->textsize(14);
-  server_display->textfont(FL_COURIER);
-  server_display->wrap_mode(Fl_Text_Display::WRAP_AT_BOUNDS, 0);
-  server_display->buffer(server_text);
-  server_display->cursor_style(Fl_Text_Display::BLOCK_CURSOR);
-  server_display->show_cursor();
+  // the first board
+  Tab *t = newTab("Not Connected");
+  server_text = t->text;
+  server_display = t->display;
+  tabs->resizable(t->group);
 
-  top->resizable(server_display);
+  top->resizable(tabs);
   top->end();
 
   window->size_range(512, 384, 0, 0, 0, 0, 0);
@@ -420,91 +603,165 @@ void Gui::append(const char *buf)
   if(strlen(buf) < 1)
     return;
 
-  char text[4096];
-  memcpy(text, buf, sizeof(text));
-  
-  // convert carriage returns
-  for(int i = 0; i < sizeof(text); i++)
+  // headless scripts print to the terminal instead
+  if(server_text == 0)
   {
-    if(text[i] == '\0')
-      break;
+    fputs(buf, stdout);
+    fflush(stdout);
+    return;
+  }
 
-    if(text[i] == 13)
-      text[i] = '\n';
+  appendText(server_text, server_display, buf);
+  Fl::check();
+}
+
+// output from a board in the background
+void Gui::appendTo(int index, const char *buf)
+{
+  if(index == tab)
+  {
+    append(buf);
+    return;
   }
 
-  server_text->append(text);
+  if(index < 0 || index >= (int)tab_list.size() || strlen(buf) < 1)
+    return;
+
+  appendText(tab_list[index]->text, tab_list[index]->display, buf);
+}
 
-  int lines = server_text->count_lines(0, server_text->length());
+void Gui::addTab(const char *label)
+{
+  newTab(label);
+  tabs->redraw();
+}
+
+void Gui::removeTab(int index)
+{
+  if(index < 0 || index >= (int)tab_list.size() || tab_list.size() < 2)
+    return;
 
-  // limit scrollback buffer to 1000 lines
-  while(lines > 1000)
+  Tab *t = tab_list[index];
+
+  tab_list.erase(tab_list.begin() + index);
+  tabs->remove(t->group);
+  t->display->buffer(0);
+  Fl::delete_widget(t->group);
+  delete t->text;
+  delete t;
+
+  if(tab > index)
+    tab--;
+
+  if(tab >= (int)tab_list.size())
+    tab = tab_list.size() - 1;
+
+  server_text = tab_list[tab]->text;
+  server_display = tab_list[tab]->display;
+  tabs->resizable(tab_list[tab]->group);
+  tabs->redraw();
+}
+
+// show a board's console, board model and registers
+void Gui::selectTab(int index)
+{
+  if(index < 0 || index >= (int)tab_list.size())
+    return;
+
+  tab = index;
+
+  Tab *t = tab_list[tab];
+
+  server_text = t->text;
+  server_display = t->display;
+  tabs->value(t->group);
+  tabs->resizable(t->group);
+
+  if(t->mode == MODE_134)
+  {
+    setMode134();
+    clearMenuItem("&Options/&Board Model/W65C265SXB");
+    setMenuItem("&Options/&Board Model/W65C134SXB");
+  }
+  else
   {
-    server_text->remove(server_text->line_start(1),
-                        server_text->line_end(1) + 1);
-    lines--;
+    setMode265();
+    clearMenuItem("&Options/&Board Model/W65C134SXB");
+    setMenuItem("&Options/&Board Model/W65C265SXB");
   }
 
-  // scroll display to bottom
-  server_display->insert_position(server_text->length());
-  server_display->show_insert_position();
-  Fl::check();
+  if(t->has_regs == true)
+  {
+    int regs[8];
+
+    memcpy(regs, t->regs, sizeof(regs));
+    setRegs(regs);
+  }
+}
+
+void Gui::setTabLabel(int index, const char *label)
+{
+  if(index < 0 || index >= (int)tab_list.size())
+    return;
+
+  tab_list[index]->group->copy_label(label);
+  tabs->redraw();
 }
 
 void Gui::checkPC()
 {
   int num;
   sscanf(input_pc->value(), "%06X", &num);
-  Terminal::changeReg(Terminal::REG_PC, num);
+  Terminal::changeReg(Monitor::REG_PC, num);
 }
 
 void Gui::checkA()
 {
   int num;
   sscanf(input_a->value(), "%04X", &num);
-  Terminal::changeReg(Terminal::REG_A, num);
+  Terminal::changeReg(Monitor::REG_A, num);
 }
 
 void Gui::checkX()
 {
   int num;
   sscanf(input_x->value(), "%04X", &num);
-  Terminal::changeReg(Terminal::REG_X, num);
+  Terminal::changeReg(Monitor::REG_X, num);
 }
 
 void Gui::checkY()
 {
   int num;
   sscanf(input_y->value(), "%04X", &num);
-  Terminal::changeReg(Terminal::REG_Y, num);
+  Terminal::changeReg(Monitor::REG_Y, num);
 }
 
 void Gui::checkSP()
 {
   int num;
   sscanf(input_sp->value(), "%04X", &num);
-  Terminal::changeReg(Terminal::REG_SP, num);
+  Terminal::changeReg(Monitor::REG_SP, num);
 }
 
 void Gui::checkDP()
 {
   int num;
   sscanf(input_dp->value(), "%04X", &num);
-  Terminal::changeReg(Terminal::REG_DP, num);
+  Terminal::changeReg(Monitor::REG_DP, num);
 }
 
 void Gui::checkSR()
 {
   int num;
   sscanf(input_sr->value(), "%02X", &num);
-  Terminal::changeReg(Terminal::REG_SR, num);
+  Terminal::changeReg(Monitor::REG_SR, num);
 }
 
 void Gui::checkDB()
 {
   int num;
   sscanf(input_db->value(), "%02X", &num);
-  Terminal::changeReg(Terminal::REG_DB, num);
+  Terminal::changeReg(Monitor::REG_DB, num);
 }
 
 void Gui::checkGet()
@@ -546,7 +803,7 @@ void Gui::checkToggles()
   num <<= 1;
   num |= light_c->value();
 
-  Terminal::changeReg(Terminal::REG_SR, num);
+  Terminal::changeReg(Monitor::REG_SR, num);
 }
 
 void Gui::setToggles(int num)
@@ -563,65 +820,101 @@ void Gui::setToggles(int num)
 
 void Gui::updateRegs(char *s)
 {
-  int pc, a, x, y, sp, dp, sr, db;
-  char buf[256];
+  int regs[8];
+
+  memset(regs, 0, sizeof(regs));
 
   if(mode == MODE_265)
   {
     sscanf(s, "  %06X %04X %04X %04X %04X %04X %02X %02X",
-           &pc, &a, &x, &y, &sp, &dp, &sr, &db);
+           &regs[Monitor::REG_PC], &regs[Monitor::REG_A],
+           &regs[Monitor::REG_X], &regs[Monitor::REG_Y],
+           &regs[Monitor::REG_SP], &regs[Monitor::REG_DP],
+           &regs[Monitor::REG_SR], &regs[Monitor::REG_DB]);
+  }
+  else if(mode == MODE_134)
+  {
+    sscanf(s + 20, "%04X %02X %02X %02X %02X %02X",
+           &regs[Monitor::REG_PC], &regs[Monitor::REG_SR],
+           &regs[Monitor::REG_A], &regs[Monitor::REG_X],
+           &regs[Monitor::REG_Y], &regs[Monitor::REG_SP]);
+  }
+
+  setRegs(regs);
+}
+
+// show register values, in Monitor REG_ order
+void Gui::setRegs(const int *regs)
+{
+  if(tab_list.size() > 0)
+  {
+    memcpy(tab_list[tab]->regs, regs, sizeof(tab_list[tab]->regs));
+    tab_list[tab]->has_regs = true;
+  }
+
+  char buf[256];
 
-    snprintf(buf, sizeof(buf), "%06X", pc);
+  if(mode == MODE_265)
+  {
+    snprintf(buf, sizeof(buf), "%06X", regs[Monitor::REG_PC]);
     input_pc->value(buf);
 
-    snprintf(buf, sizeof(buf), "%04X", a);
+    snprintf(buf, sizeof(buf), "%04X", regs[Monitor::REG_A]);
     input_a->value(buf);
 
-    snprintf(buf, sizeof(buf), "%04X", x);
+    snprintf(buf, sizeof(buf), "%04X", regs[Monitor::REG_X]);
     input_x->value(buf);
 
-    snprintf(buf, sizeof(buf), "%04X", y);
+    snprintf(buf, sizeof(buf), "%04X", regs[Monitor::REG_Y]);
     input_y->value(buf);
 
-    snprintf(buf, sizeof(buf), "%04X", sp);
+    snprintf(buf, sizeof(buf), "%04X", regs[Monitor::REG_SP]);
     input_sp->value(buf);
 
-    snprintf(buf, sizeof(buf), "%02X", dp);
+    snprintf(buf, sizeof(buf), "%02X", regs[Monitor::REG_DP]);
     input_dp->value(buf);
 
-    snprintf(buf, sizeof(buf), "%02X", sr);
+    snprintf(buf, sizeof(buf), "%02X", regs[Monitor::REG_SR]);
     input_sr->value(buf);
 
-    snprintf(buf, sizeof(buf), "%02X", db);
+    snprintf(buf, sizeof(buf), "%02X", regs[Monitor::REG_DB]);
     input_db->value(buf);
 
-    setToggles(sr);
+    setToggles(regs[Monitor::REG_SR]);
   }
   else if(mode == MODE_134)
   {
-    sscanf(s + 20, "%04X %02X %02X %02X %02X %02X",
-           &pc, &sr, &a, &x, &y, &sp);
-
-    snprintf(buf, sizeof(buf), "%04X", pc);
+    snprintf(buf, sizeof(buf), "%04X", regs[Monitor::REG_PC]);
     input_pc->value(buf);
 
-    snprintf(buf, sizeof(buf), "%02X", sr);
+    snprintf(buf, sizeof(buf), "%02X", regs[Monitor::REG_SR]);
     input_sr->value(buf);
 
-    snprintf(buf, sizeof(buf), "%02X", a);
+    snprintf(buf, sizeof(buf), "%02X", regs[Monitor::REG_A]);
     input_a->value(buf);
 
-    snprintf(buf, sizeof(buf), "%02X", x);
+    snprintf(buf, sizeof(buf), "%02X", regs[Monitor::REG_X]);
     input_x->value(buf);
 
-    snprintf(buf, sizeof(buf), "%02X", y);
+    snprintf(buf, sizeof(buf), "%02X", regs[Monitor::REG_Y]);
     input_y->value(buf);
 
-    snprintf(buf, sizeof(buf), "%02X", sp);
+    snprintf(buf, sizeof(buf), "%02X", regs[Monitor::REG_SP]);
     input_sp->value(buf);
 
-    setToggles(sr);
+    setToggles(regs[Monitor::REG_SR]);
   }
+
+  Backtrace::update(regs);
+}
+
+// address typed in the side panel
+int Gui::getAddress()
+{
+  int address = 0;
+
+  sscanf(input_address->value(), "%06X", &address);
+  return address;
 }
 
 void Gui::flashCursor(bool show)
@@ -673,6 +966,13 @@ void Gui::setMode265()
   input_db->activate();
 
   mode = MODE_265;
+
+  if(tab_list.size() > 0 && tab_list[tab]->mode != mode)
+  {
+    tab_list[tab]->mode = mode;
+    tab_list[tab]->has_regs = false;
+  }
+
   window->redraw();
 }
 
@@ -717,31 +1017,29 @@ void Gui::setMode134()
   input_db->deactivate();
 
   mode = MODE_134;
+
+  if(tab_list.size() > 0 && tab_list[tab]->mode != mode)
+  {
+    tab_list[tab]->mode = mode;
+    tab_list[tab]->has_regs = false;
+  }
+
   window->redraw();
 }
 
 void Gui::setFontSmall()
 {
-  server_display->textsize(10);
-  server_display->buffer(0);
-  server_display->buffer(server_text);
-  server_display->redraw();
+  setFont(10);
 }
 
 void Gui::setFontMedium()
 {
-  server_display->textsize(14);
-  server_display->buffer(0);
-  server_display->buffer(server_text);
-  server_display->redraw();
+  setFont(14);
 }
 
 void Gui::setFontLarge()
 {
-  server_display->textsize(18);
-  server_display->buffer(0);
-  server_display->buffer(server_text);
-  server_display->redraw();
+  setFont(18);
 }
 
 void Gui::setCancelled(bool value)
@@ -0,0 +1,126 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <chrono>
+
+#include <FL/Fl.H>
+
+#include "Gui.H"
+#include "Harness.H"
+#include "Terminal.H"
+
+int Harness::Code::here()
+{
+  return base + bytes.size();
+}
+
+void Harness::Code::label(const char *name)
+{
+  labels[name] = here();
+}
+
+// the base address until the second pass
+int Harness::Code::at(const char *name)
+{
+  return labels.count(name) > 0 ? labels[name] : base;
+}
+
+void Harness::Code::op(int a)
+{
+  bytes.push_back(a);
+}
+
+void Harness::Code::op8(int a, int b)
+{
+  op(a);
+  op(b & 0xFF);
+}
+
+void Harness::Code::op16(int a, int b)
+{
+  op8(a, b);
+  op((b >> 8) & 0xFF);
+}
+
+void Harness::Code::op24(int a, int b)
+{
+  op16(a, b);
+  op((b >> 16) & 0xFF);
+}
+
+void Harness::Code::branch(int a, const char *name)
+{
+  op8(a, at(name) - (here() + 2));
+}
+
+// wait without blocking the gui, escape cancels; without the gui
+// nothing else reads the port, so it is drained here
+bool Harness::wait(double seconds)
+{
+  std::chrono::steady_clock::time_point begin =
+    std::chrono::steady_clock::now();
+
+  while(std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - begin).count() < seconds)
+  {
+    if(Fl::first_window() == 0)
+      Terminal::drain();
+
+    Fl::wait(0.05);
+
+    if(Gui::getCancelled() == true)
+    {
+      Gui::setCancelled(false);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// upload the code at its base address
+bool Harness::install(const Code &code)
+{
+  if(code.bytes.size() == 0)
+    return false;
+
+  return Terminal::uploadData(code.base, &code.bytes[0], code.bytes.size());
+}
+
+// call with JSL, the monitor answers again once the routine returns;
+// false if it did not within seconds or escape was pressed
+bool Harness::call(int address, int seconds)
+{
+  int regs[8];
+
+  Terminal::jsl(address);
+
+  for(int i = 0; i < seconds; i++)
+  {
+    if(wait(1.0) == false)
+      return false;
+
+    if(Terminal::readRegs(regs) == true)
+      return true;
+  }
+
+  return false;
+}
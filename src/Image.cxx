@@ -0,0 +1,348 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+  #define strcasecmp _stricmp
+#else
+  #include <strings.h>
+#endif
+
+#include "Image.H"
+
+namespace
+{
+  // returns -1 if the characters are not a hex pair
+  int hexByte(const char *s)
+  {
+    int value = 0;
+
+    for(int i = 0; i < 2; i++)
+    {
+      char c = s[i];
+
+      value <<= 4;
+
+      if(c >= '0' && c <= '9')
+        value |= c - '0';
+      else if(c >= 'A' && c <= 'F')
+        value |= c - 'A' + 10;
+      else if(c >= 'a' && c <= 'f')
+        value |= c - 'a' + 10;
+      else
+        return -1;
+    }
+
+    return value;
+  }
+
+  // parse "count" hex pairs, returns false on malformed input
+  bool hexBytes(const char *s, unsigned char *dest, int count)
+  {
+    for(int i = 0; i < count; i++)
+    {
+      int value = hexByte(s + i * 2);
+
+      if(value < 0)
+        return false;
+
+      dest[i] = value;
+    }
+
+    return true;
+  }
+
+  // extension including the dot, or an empty string
+  const char *extension(const char *filename)
+  {
+    const char *dot = strrchr(filename, '.');
+    const char *slash = strrchr(filename, '/');
+    const char *backslash = strrchr(filename, '\\');
+
+    if(dot == NULL || (slash != NULL && slash > dot) ||
+       (backslash != NULL && backslash > dot))
+    {
+      return "";
+    }
+
+    return dot;
+  }
+
+  // tell the monitor the upload is complete
+  void finish(Image::Sink sink, void *data)
+  {
+    sink("S804000000FB\n", data);
+  }
+
+  // hand over records converted from a whole file, false if cancelled
+  bool sendAll(const std::vector<std::string> &records, Image::Sink sink,
+               void *data)
+  {
+    for(size_t i = 0; i < records.size(); i++)
+    {
+      // still leave the monitor's loader
+      if(sink(records[i].c_str(), data) == false)
+      {
+        finish(sink, data);
+        return false;
+      }
+    }
+
+    finish(sink, data);
+
+    return true;
+  }
+}
+
+bool Image::isSupported(const char *filename)
+{
+  const char *ext = extension(filename);
+
+  return strcasecmp(ext, ".hex") == 0 || strcasecmp(ext, ".srec") == 0;
+}
+
+// pick a converter based on the file extension
+bool Image::convert(const char *filename, Sink sink, void *data)
+{
+  const char *ext = extension(filename);
+
+  if(strcasecmp(ext, ".hex") == 0)
+    return convertHex(filename, sink, data);
+  else if(strcasecmp(ext, ".srec") == 0)
+    return convertSrec(filename, sink, data);
+
+  return false;
+}
+
+// intel hex, extended linear address records select the bank; the
+// whole file is checked before anything is sent
+bool Image::convertHex(const char *filename, Sink sink, void *data)
+{
+  std::vector<std::string> records;
+  int bank = 0;
+  bool ok = true;
+  char line[1024];
+  unsigned char bytes[256];
+  char s[600];
+
+  FILE *fp = fopen(filename, "r");
+
+  if(fp == NULL)
+    return false;
+
+  while(fgets(line, sizeof(line), fp))
+  {
+    const char *p = strchr(line, ':');
+
+    if(p == NULL)
+      continue;
+
+    p++;
+
+    int count = hexByte(p);
+
+    if(count < 0 || hexBytes(p + 8, bytes, count) == false)
+    {
+      ok = false;
+      break;
+    }
+
+    int address = (hexByte(p + 2) << 8) | hexByte(p + 4);
+    int code = hexByte(p + 6);
+    int checksum = hexByte(p + 8 + count * 2);
+
+    if(address < 0 || code < 0 || checksum < 0)
+    {
+      ok = false;
+      break;
+    }
+
+    // all bytes of the record including the checksum sum to zero
+    checksum += count + (address >> 8) + (address & 0xFF) + code;
+
+    for(int i = 0; i < count; i++)
+      checksum += bytes[i];
+
+    if((checksum & 0xFF) != 0)
+    {
+      ok = false;
+      break;
+    }
+
+    // end of file
+    if(code == 0x01 || count == 0)
+      break;
+
+    if(code == 0x04 && count >= 2)
+    {
+      bank = bytes[1];
+    }
+    else if(code == 0x02 && count >= 2)
+    {
+      bank = ((bytes[0] << 8 | bytes[1]) >> 12) & 0xFF;
+    }
+    else if(code == 0x00)
+    {
+      makeRecord(s, (bank << 16) | address, bytes, count);
+      records.push_back(s);
+    }
+  }
+
+  fclose(fp);
+
+  if(ok == false)
+    return false;
+
+  return sendAll(records, sink, data);
+}
+
+// motorola s-records, re-sent as S2 regardless of the address size
+bool Image::convertSrec(const char *filename, Sink sink, void *data)
+{
+  std::vector<std::string> records;
+  char line[1024];
+  unsigned char bytes[256];
+  char s[600];
+
+  FILE *fp = fopen(filename, "r");
+
+  if(fp == NULL)
+    return false;
+
+  while(fgets(line, sizeof(line), fp))
+  {
+    if(line[0] != 'S')
+      continue;
+
+    int code = line[1] - '0';
+
+    // header
+    if(code == 0)
+      continue;
+
+    // start address or record count, end of data
+    if(code < 1 || code > 3)
+      break;
+
+    int count = hexByte(line + 2);
+
+    if(count < 0 || hexBytes(line + 4, bytes, count) == false)
+      break;
+
+    int size = code + 1;
+    int address = 0;
+
+    count -= size + 1;
+
+    if(count <= 0)
+      break;
+
+    for(int i = 0; i < size; i++)
+      address = (address << 8) | bytes[i];
+
+    makeRecord(s, address & 0xFFFFFF, bytes + size, count);
+    records.push_back(s);
+  }
+
+  fclose(fp);
+
+  return sendAll(records, sink, data);
+}
+
+// bytes built in memory, such as code generated for the board
+bool Image::convertData(int address, const unsigned char *bytes, int count,
+                        Sink sink, void *data)
+{
+  char s[600];
+
+  for(int i = 0; i < count; i += 32)
+  {
+    const int size = count - i < 32 ? count - i : 32;
+
+    makeRecord(s, (address + i) & 0xFFFFFF, bytes + i, size);
+
+    // still leave the monitor's loader
+    if(sink(s, data) == false)
+    {
+      finish(sink, data);
+      return false;
+    }
+  }
+
+  finish(sink, data);
+
+  return true;
+}
+
+// scattered single bytes, address to value, one record each and a
+// single end record for all of them
+bool Image::convertBytes(const std::map<int, int> &bytes, Sink sink,
+                         void *data)
+{
+  char s[600];
+
+  for(std::map<int, int>::const_iterator i = bytes.begin();
+      i != bytes.end(); ++i)
+  {
+    const unsigned char value = i->second;
+
+    makeRecord(s, i->first & 0xFFFFFF, &value, 1);
+
+    if(sink(s, data) == false)
+    {
+      finish(sink, data);
+      return false;
+    }
+  }
+
+  finish(sink, data);
+
+  return true;
+}
+
+// format one S2 record terminated by a newline
+void Image::makeRecord(char *s, int address, const unsigned char *bytes,
+                       int count)
+{
+  int checksum = count + 4;
+
+  checksum += (address >> 16) & 0xFF;
+  checksum += (address >> 8) & 0xFF;
+  checksum += address & 0xFF;
+
+  sprintf(s, "S2%02X%06X", count + 4, address & 0xFFFFFF);
+
+  int index = 10;
+
+  for(int i = 0; i < count; i++)
+  {
+    sprintf(s + index, "%02X", bytes[i]);
+    index += 2;
+    checksum += bytes[i];
+  }
+
+  sprintf(s + index, "%02X\n", 0xFF - (checksum & 0xFF));
+}
+
@@ -0,0 +1,366 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "Json.H"
+
+namespace
+{
+  // nesting allowed in a request
+  const int DEPTH = 32;
+
+  const Json none;
+
+  void skipSpace(const char *&s)
+  {
+    while(*s == ' ' || *s == '\t' || *s == '\r' || *s == '\n')
+      s++;
+  }
+
+  // code points are stored as UTF-8
+  void putUtf8(std::string &out, int c)
+  {
+    if(c < 0x80)
+    {
+      out += (char)c;
+    }
+    else if(c < 0x800)
+    {
+      out += (char)(0xC0 | (c >> 6));
+      out += (char)(0x80 | (c & 0x3F));
+    }
+    else
+    {
+      out += (char)(0xE0 | (c >> 12));
+      out += (char)(0x80 | ((c >> 6) & 0x3F));
+      out += (char)(0x80 | (c & 0x3F));
+    }
+  }
+
+  bool parseString(const char *&s, std::string &out)
+  {
+    out.clear();
+
+    if(*s != '"')
+      return false;
+
+    s++;
+
+    while(*s != '"')
+    {
+      if(*s == 0)
+        return false;
+
+      if(*s != '\\')
+      {
+        out += *s++;
+        continue;
+      }
+
+      s++;
+
+      switch(*s)
+      {
+        case 'b':
+          out += '\b';
+          break;
+        case 'f':
+          out += '\f';
+          break;
+        case 'n':
+          out += '\n';
+          break;
+        case 'r':
+          out += '\r';
+          break;
+        case 't':
+          out += '\t';
+          break;
+        case 'u':
+        {
+          char hex[5];
+
+          for(int i = 0; i < 4; i++)
+          {
+            if(s[i + 1] == 0)
+              return false;
+
+            hex[i] = s[i + 1];
+          }
+
+          hex[4] = 0;
+          putUtf8(out, strtol(hex, 0, 16));
+          s += 4;
+          break;
+        }
+        case 0:
+          return false;
+        default:
+          out += *s;
+          break;
+      }
+
+      s++;
+    }
+
+    s++;
+    return true;
+  }
+}
+
+Json::Json()
+: type(TYPE_NULL),
+  flag(false),
+  number(0)
+{
+}
+
+Json::~Json()
+{
+}
+
+bool Json::parse(const std::string &source)
+{
+  const char *s = source.c_str();
+
+  if(parseValue(s, 0) == false)
+    return false;
+
+  skipSpace(s);
+  return *s == 0;
+}
+
+bool Json::has(const char *name) const
+{
+  return type == TYPE_OBJECT && members.count(name) > 0;
+}
+
+// missing members read as null
+const Json &Json::get(const char *name) const
+{
+  if(has(name) == false)
+    return none;
+
+  return members.find(name)->second;
+}
+
+std::string Json::dump() const
+{
+  char s[64];
+  std::string result;
+
+  switch(type)
+  {
+    case TYPE_BOOL:
+      return flag == true ? "true" : "false";
+    case TYPE_NUMBER:
+      snprintf(s, sizeof(s), "%.17g", number);
+      return s;
+    case TYPE_STRING:
+      return quote(text);
+    case TYPE_ARRAY:
+      result = "[";
+
+      for(size_t i = 0; i < items.size(); i++)
+        result += (i > 0 ? "," : "") + items[i].dump();
+
+      return result + "]";
+    case TYPE_OBJECT:
+      result = "{";
+
+      for(std::map<std::string, Json>::const_iterator i = members.begin();
+          i != members.end(); ++i)
+      {
+        if(result.size() > 1)
+          result += ",";
+
+        result += quote(i->first) + ":" + i->second.dump();
+      }
+
+      return result + "}";
+  }
+
+  return "null";
+}
+
+// bytes that aren't printable ASCII are escaped, so board output that
+// isn't valid UTF-8 still makes valid JSON
+std::string Json::quote(const std::string &text)
+{
+  std::string result = "\"";
+  char s[8];
+
+  for(size_t i = 0; i < text.size(); i++)
+  {
+    const unsigned char c = text[i];
+
+    switch(c)
+    {
+      case '"':
+        result += "\\\"";
+        break;
+      case '\\':
+        result += "\\\\";
+        break;
+      case '\n':
+        result += "\\n";
+        break;
+      case '\r':
+        result += "\\r";
+        break;
+      case '\t':
+        result += "\\t";
+        break;
+      default:
+        if(c < 0x20 || c >= 0x7F)
+        {
+          snprintf(s, sizeof(s), "\\u%04x", c);
+          result += s;
+        }
+        else
+        {
+          result += c;
+        }
+        break;
+    }
+  }
+
+  return result + "\"";
+}
+
+bool Json::parseValue(const char *&s, int depth)
+{
+  if(depth > DEPTH)
+    return false;
+
+  skipSpace(s);
+
+  items.clear();
+  members.clear();
+  text.clear();
+
+  if(*s == '{')
+  {
+    type = TYPE_OBJECT;
+    s++;
+    skipSpace(s);
+
+    if(*s == '}')
+    {
+      s++;
+      return true;
+    }
+
+    while(true)
+    {
+      std::string name;
+
+      skipSpace(s);
+
+      if(parseString(s, name) == false)
+        return false;
+
+      skipSpace(s);
+
+      if(*s++ != ':' || members[name].parseValue(s, depth + 1) == false)
+        return false;
+
+      skipSpace(s);
+
+      if(*s == '}')
+      {
+        s++;
+        return true;
+      }
+
+      if(*s++ != ',')
+        return false;
+    }
+  }
+
+  if(*s == '[')
+  {
+    type = TYPE_ARRAY;
+    s++;
+    skipSpace(s);
+
+    if(*s == ']')
+    {
+      s++;
+      return true;
+    }
+
+    while(true)
+    {
+      items.push_back(Json());
+
+      if(items.back().parseValue(s, depth + 1) == false)
+        return false;
+
+      skipSpace(s);
+
+      if(*s == ']')
+      {
+        s++;
+        return true;
+      }
+
+      if(*s++ != ',')
+        return false;
+    }
+  }
+
+  if(*s == '"')
+  {
+    type = TYPE_STRING;
+    return parseString(s, text);
+  }
+
+  if(strncmp(s, "true", 4) == 0 || strncmp(s, "false", 5) == 0)
+  {
+    type = TYPE_BOOL;
+    flag = *s == 't';
+    s += flag == true ? 4 : 5;
+    return true;
+  }
+
+  if(strncmp(s, "null", 4) == 0)
+  {
+    type = TYPE_NULL;
+    s += 4;
+    return true;
+  }
+
+  char *end;
+
+  number = strtod(s, &end);
+
+  if(end == s)
+    return false;
+
+  type = TYPE_NUMBER;
+  s = end;
+  return true;
+}
+
@@ -0,0 +1,178 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include "easysxb.h"
+#include "Monitor.H"
+#include "Session.H"
+
+#ifndef PACKAGE_STRING
+  #define PACKAGE_STRING "EasySXB Development Version"
+#endif
+
+struct easysxb_session
+{
+  Session session;
+};
+
+namespace
+{
+  // callbacks of one upload running on the worker thread, owned by it
+  struct Upload
+  {
+    easysxb_progress_cb progress;
+    easysxb_done_cb done;
+    void *user;
+  };
+
+  int status(bool ok)
+  {
+    return ok ? 0 : -1;
+  }
+
+  void progressed(int done, int total, void *data)
+  {
+    Upload *u = (Upload *)data;
+
+    if(u->progress != 0)
+      u->progress(done, total, u->user);
+  }
+
+  // the C callback takes an int
+  void uploaded(bool ok, void *data)
+  {
+    Upload *u = (Upload *)data;
+
+    if(u->done != 0)
+      u->done(ok ? 1 : 0, u->user);
+
+    delete u;
+  }
+}
+
+const char *easysxb_version(void)
+{
+  return PACKAGE_STRING;
+}
+
+easysxb_session *easysxb_open(const char *port, int board)
+{
+  easysxb_session *s = new easysxb_session;
+
+  if(s->session.open(port, board == EASYSXB_134 ?
+                           Monitor::MODE_134 : Monitor::MODE_265) == false)
+  {
+    delete s;
+    return 0;
+  }
+
+  return s;
+}
+
+void easysxb_close(easysxb_session *s)
+{
+  delete s;
+}
+
+void easysxb_set_receive(easysxb_session *s, easysxb_receive_cb callback,
+                         void *user)
+{
+  s->session.setReceiver(callback, user);
+}
+
+void easysxb_set_flow_control(easysxb_session *s, int on)
+{
+  s->session.setFlowControl(on != 0);
+}
+
+int easysxb_read(easysxb_session *s, unsigned char *data, int count,
+                 int timeout_ms)
+{
+  return s->session.read(data, count, timeout_ms);
+}
+
+int easysxb_write(easysxb_session *s, const unsigned char *data, int count)
+{
+  return status(s->session.write(data, count));
+}
+
+int easysxb_send(easysxb_session *s, const char *text)
+{
+  return status(s->session.send(text));
+}
+
+// the enums match Monitor's REG_ order
+int easysxb_get_regs(easysxb_session *s, int regs[8])
+{
+  return status(s->session.getRegs(regs));
+}
+
+int easysxb_set_regs(easysxb_session *s, const int regs[8])
+{
+  return status(s->session.setRegs(regs));
+}
+
+int easysxb_read_memory(easysxb_session *s, int address, unsigned char *data,
+                        int count)
+{
+  return s->session.readMemory(address, data, count);
+}
+
+int easysxb_write_memory(easysxb_session *s, int address,
+                         const unsigned char *data, int count)
+{
+  return status(s->session.writeMemory(address, data, count));
+}
+
+int easysxb_upload(easysxb_session *s, const char *filename,
+                   easysxb_progress_cb progress, void *user)
+{
+  return status(s->session.upload(filename, progress, user));
+}
+
+int easysxb_upload_async(easysxb_session *s, const char *filename,
+                         easysxb_progress_cb progress, easysxb_done_cb done,
+                         void *user)
+{
+  Upload *u = new Upload;
+
+  u->progress = progress;
+  u->done = done;
+  u->user = user;
+
+  if(s->session.uploadAsync(filename, progressed, uploaded, u) == false)
+  {
+    delete u;
+    return -1;
+  }
+
+  return 0;
+}
+
+int easysxb_jml(easysxb_session *s, int address)
+{
+  return status(s->session.jml(address));
+}
+
+int easysxb_jsl(easysxb_session *s, int address)
+{
+  return status(s->session.jsl(address));
+}
+
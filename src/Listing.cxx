@@ -0,0 +1,343 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_MSC_VER)
+  #define strncasecmp _strnicmp
+#else
+  #include <strings.h>
+#endif
+
+#include "Listing.H"
+
+namespace
+{
+  // directives that emit data rather than instructions
+  const char *data_directives[] =
+  {
+    "db", "dw", "dl", "dc8", "dc16", "dc32", "ds",
+    ".db", ".dw", ".dl", ".dc8", ".dc16", ".dc32", ".ds",
+    ".ascii", ".asciiz", ".byte", ".word", ".binfile", ".align",
+    0
+  };
+
+  bool isIdentifier(char c)
+  {
+    return isalnum((unsigned char)c) || c == '_' || c == '.';
+  }
+
+  const char *skipSpace(const char *s)
+  {
+    while(*s == ' ' || *s == '\t')
+      s++;
+
+    return s;
+  }
+
+  // "0x1000:" at the start of an instruction line
+  bool parseAddress(const char *s, int *address, const char **end)
+  {
+    s = skipSpace(s);
+
+    if(s[0] != '0' || (s[1] != 'x' && s[1] != 'X'))
+      return false;
+
+    char *p;
+    long value = strtol(s + 2, &p, 16);
+
+    if(p == s + 2 || *p != ':')
+      return false;
+
+    *address = value & 0xFFFFFF;
+    *end = p + 1;
+    return true;
+  }
+
+  // bytes are printed as "0x78" or "78"
+  int parseByte(const char *s, const char **end)
+  {
+    const char *p = s;
+
+    if(p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+      p += 2;
+
+    if(!isxdigit((unsigned char)p[0]) || !isxdigit((unsigned char)p[1]) ||
+       isIdentifier(p[2]))
+    {
+      return -1;
+    }
+
+    *end = p + 2;
+    return (int)strtol(std::string(p, 2).c_str(), NULL, 16);
+  }
+
+  bool isData(const char *text)
+  {
+    char word[32];
+    int len = 0;
+
+    text = skipSpace(text);
+
+    // skip a label on the same line
+    const char *colon = strchr(text, ':');
+
+    if(colon != NULL)
+    {
+      const char *p = text;
+
+      while(isIdentifier(*p))
+        p++;
+
+      if(p == colon)
+        text = skipSpace(colon + 1);
+    }
+
+    while(isIdentifier(text[len]) && len < 31)
+    {
+      word[len] = tolower(text[len]);
+      len++;
+    }
+
+    word[len] = '\0';
+
+    for(int i = 0; data_directives[i]; i++)
+      if(strcmp(word, data_directives[i]) == 0)
+        return true;
+
+    return false;
+  }
+
+  bool compareSymbols(const Listing::Symbol &a, const Listing::Symbol &b)
+  {
+    return a.address < b.address;
+  }
+}
+
+Listing::Listing()
+{
+}
+
+Listing::~Listing()
+{
+}
+
+// source lines may carry a "123:" line number prefix, otherwise they
+// are numbered in order; instruction lines belong to the line above
+bool Listing::load(const char *filename)
+{
+  char buf[4096];
+  std::vector<std::string> pending;
+
+  FILE *fp = fopen(filename, "r");
+
+  if(fp == NULL)
+    return false;
+
+  lines.clear();
+  instructions.clear();
+  symbols.clear();
+  sorted.clear();
+
+  // the listing sits next to the source it was assembled from
+  source = filename;
+
+  size_t dot = source.rfind('.');
+
+  if(dot != std::string::npos && source.find('/', dot) == std::string::npos)
+    source.erase(dot);
+
+  source += ".asm";
+
+  while(fgets(buf, sizeof(buf), fp))
+  {
+    buf[strcspn(buf, "\r\n")] = '\0';
+
+    const char *p;
+    int address;
+
+    if(parseAddress(buf, &address, &p))
+    {
+      Instruction ins;
+      int value;
+
+      ins.address = address;
+      ins.length = 0;
+      ins.opcode = -1;
+      ins.line = (int)lines.size() - 1;
+      ins.data = ins.line >= 0 && isData(lines[ins.line].text.c_str());
+
+      while(true)
+      {
+        p = skipSpace(p);
+        value = parseByte(p, &p);
+
+        if(value < 0)
+          break;
+
+        if(ins.opcode < 0)
+          ins.opcode = value;
+
+        ins.length++;
+      }
+
+      if(ins.length == 0)
+        continue;
+
+      if(ins.line >= 0)
+      {
+        if(lines[ins.line].count == 0)
+          lines[ins.line].first = instructions.size();
+
+        lines[ins.line].count++;
+      }
+
+      // labels waiting for an address
+      for(size_t i = 0; i < pending.size(); i++)
+      {
+        Symbol sym;
+
+        sym.name = pending[i];
+        sym.address = address;
+        sym.label = true;
+        symbols.push_back(sym);
+      }
+
+      pending.clear();
+      instructions.push_back(ins);
+      continue;
+    }
+
+    Line line;
+
+    line.first = 0;
+    line.count = 0;
+    line.number = lines.size() + 1;
+    p = buf;
+
+    const char *q = skipSpace(buf);
+
+    if(isdigit((unsigned char)*q))
+    {
+      char *end;
+      long number = strtol(q, &end, 10);
+
+      if(*end == ':')
+      {
+        line.number = number;
+        p = end + 1;
+
+        if(*p == ' ')
+          p++;
+      }
+    }
+
+    line.text = p;
+    lines.push_back(line);
+
+    // "label:" and "name equ 0x1234"
+    q = skipSpace(p);
+
+    const char *r = q;
+
+    while(isIdentifier(*r))
+      r++;
+
+    if(r > q && *r == ':' && *q != '.')
+    {
+      pending.push_back(std::string(q, r - q));
+    }
+    else if(r > q)
+    {
+      const char *s = skipSpace(r);
+
+      if(strncasecmp(s, "equ", 3) == 0 && isspace((unsigned char)s[3]))
+      {
+        Symbol sym;
+
+        sym.name = std::string(q, r - q);
+        sym.address = (int)strtol(skipSpace(s + 3), NULL, 0) & 0xFFFFFF;
+        sym.label = false;
+        symbols.push_back(sym);
+      }
+    }
+  }
+
+  fclose(fp);
+
+  std::stable_sort(symbols.begin(), symbols.end(), compareSymbols);
+
+  for(size_t i = 0; i < instructions.size(); i++)
+    sorted.push_back(std::make_pair(instructions[i].address, (int)i));
+
+  std::sort(sorted.begin(), sorted.end());
+
+  return true;
+}
+
+// index of the instruction containing an address, or -1
+int Listing::find(int address) const
+{
+  int lo = 0;
+  int hi = (int)sorted.size() - 1;
+
+  while(lo <= hi)
+  {
+    int mid = (lo + hi) / 2;
+    const Instruction &ins = instructions[sorted[mid].second];
+
+    if(address < ins.address)
+      hi = mid - 1;
+    else if(address >= ins.address + ins.length)
+      lo = mid + 1;
+    else
+      return sorted[mid].second;
+  }
+
+  return -1;
+}
+
+// nearest label at or below an address, equates only match exactly
+const Listing::Symbol *Listing::symbolize(int address, int *offset) const
+{
+  const Symbol *best = NULL;
+
+  for(size_t i = 0; i < symbols.size(); i++)
+  {
+    const Symbol &sym = symbols[i];
+
+    if(sym.address > address)
+      break;
+
+    if(sym.label == true || sym.address == address)
+      best = &sym;
+  }
+
+  if(best != NULL && offset != NULL)
+    *offset = address - best->address;
+
+  return best;
+}
+
@@ -0,0 +1,500 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <FL/Fl.H>
+#include <FL/Fl_Native_File_Chooser.H>
+
+#include "Dialog.H"
+#include "Emulator.H"
+#include "Gui.H"
+#include "Lockstep.H"
+#include "Monitor.H"
+#include "Terminal.H"
+#include "Trace.H"
+
+#if defined(_MSC_VER)
+#define strcasecmp _stricmp
+#endif
+
+namespace
+{
+  // default emulator budget for one call
+  const long long MAX_CYCLES = 100000000;
+
+  // ranges this close together are read with one command
+  const int MERGE_GAP = 16;
+
+  // I/O reads have side effects on the board, never compared
+  const int IO_START = 0xDF00;
+  const int IO_END = 0xDFFF;
+
+  struct Range
+  {
+    int start;
+    int end;
+  };
+
+  struct Plan
+  {
+    char image[1024];
+    std::vector<int> calls;
+    std::vector<Range> ranges;
+    long long cycles;
+  };
+
+  struct Difference
+  {
+    int address;
+    int board;
+    int emulator;
+  };
+
+  char load_dir[256];
+
+  bool compareRange(const Range &a, const Range &b)
+  {
+    return a.start < b.start;
+  }
+
+  // plan files:
+  //   image led_blink.hex   (relative to the plan)
+  //   memory 0000 01FF      (inclusive, compared after every call)
+  //   cycles 1000000        (emulator budget per call)
+  //   call 1000             (one checkpoint per call)
+  bool parsePlan(const char *filename, Plan &plan)
+  {
+    FILE *fp = fopen(filename, "r");
+
+    if(fp == NULL)
+      return false;
+
+    plan.image[0] = '\0';
+    plan.cycles = MAX_CYCLES;
+
+    char line[1024];
+    char dir[1024];
+
+    strcpy(dir, filename);
+
+    char *slash = strrchr(dir, '/');
+
+    if(slash != NULL)
+      slash[1] = '\0';
+    else
+      dir[0] = '\0';
+
+    while(fgets(line, sizeof(line), fp) != NULL)
+    {
+      char *comment = strchr(line, '#');
+
+      if(comment != NULL)
+        *comment = '\0';
+
+      char word[256];
+      char arg[768];
+      int start, end;
+      long long cycles;
+
+      if(sscanf(line, "%255s", word) != 1)
+        continue;
+
+      if(strcmp(word, "image") == 0 && sscanf(line, "%*s %767s", arg) == 1)
+      {
+        if(arg[0] == '/')
+          snprintf(plan.image, sizeof(plan.image), "%s", arg);
+        else
+          snprintf(plan.image, sizeof(plan.image), "%s%s", dir, arg);
+      }
+      else if(strcmp(word, "call") == 0 && sscanf(line, "%*s %x", &start) == 1)
+      {
+        plan.calls.push_back(start & 0xFFFFFF);
+      }
+      else if(strcmp(word, "memory") == 0 &&
+              sscanf(line, "%*s %x %x", &start, &end) == 2 && end >= start)
+      {
+        Range range;
+
+        range.start = start & 0xFFFFFF;
+        range.end = end & 0xFFFFFF;
+        plan.ranges.push_back(range);
+      }
+      else if(strcmp(word, "cycles") == 0 &&
+              sscanf(line, "%*s %lld", &cycles) == 1)
+      {
+        plan.cycles = cycles;
+      }
+    }
+
+    fclose(fp);
+    return true;
+  }
+
+  // fewer, larger reads cost less than many small round trips
+  void mergeRanges(std::vector<Range> &ranges)
+  {
+    std::vector<Range> merged;
+
+    std::sort(ranges.begin(), ranges.end(), compareRange);
+
+    for(size_t i = 0; i < ranges.size(); i++)
+    {
+      if(merged.size() > 0 &&
+         ranges[i].start <= merged.back().end + MERGE_GAP)
+      {
+        merged.back().end = std::max(merged.back().end, ranges[i].end);
+      }
+      else
+      {
+        merged.push_back(ranges[i]);
+      }
+    }
+
+    ranges = merged;
+  }
+
+  bool isIO(int address)
+  {
+    return address >= IO_START && address <= IO_END;
+  }
+
+  // all ranges back to back, one batch per checkpoint
+  bool readBoard(const std::vector<Range> &ranges,
+                 std::vector<unsigned char> &memory)
+  {
+    memory.clear();
+
+    for(size_t i = 0; i < ranges.size(); i++)
+    {
+      const int count = ranges[i].end - ranges[i].start + 1;
+      const size_t pos = memory.size();
+
+      memory.resize(pos + count);
+
+      if(Terminal::readMemory(ranges[i].start, &memory[pos], count) != count)
+        return false;
+    }
+
+    return true;
+  }
+
+  // the monitor only answers once the call has returned to it,
+  // give up well after the time the emulator needed
+  bool waitBoard(long long cycles, int *regs)
+  {
+    const double timeout = (double)cycles / Emulator::FCLK * 4 + 2.0;
+
+    std::chrono::steady_clock::time_point begin =
+      std::chrono::steady_clock::now();
+
+    while(std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - begin).count() < timeout)
+    {
+      if(Terminal::readRegs(regs) == true)
+        return true;
+
+      Fl::wait(0.05);
+    }
+
+    return false;
+  }
+
+  void compareRegs(const int *board, const Emulator &emu,
+                   std::string &report, int *count)
+  {
+    const char *names[] = { "PC", "A", "X", "Y", "SP", "DP", "SR", "DB" };
+    int regs[8];
+    char s[256];
+
+    regs[Monitor::REG_A] = emu.a;
+    regs[Monitor::REG_X] = emu.x;
+    regs[Monitor::REG_Y] = emu.y;
+    regs[Monitor::REG_SP] = emu.sp;
+    regs[Monitor::REG_DP] = emu.dp;
+    regs[Monitor::REG_SR] = emu.sr;
+    regs[Monitor::REG_DB] = emu.db;
+
+    // the board's PC is the monitor's, skip it
+    for(int i = Monitor::REG_A; i <= Monitor::REG_DB; i++)
+    {
+      if(regs[i] != board[i])
+      {
+        sprintf(s, "  %s: board %04X, emulator %04X\n",
+                names[i], board[i], regs[i]);
+        report += s;
+        (*count)++;
+      }
+    }
+  }
+}
+
+void Lockstep::begin()
+{
+  if(Terminal::isConnected() == false)
+  {
+    Dialog::message("Error", "Not Connected.");
+    return;
+  }
+
+  if(Gui::getMode() != Gui::MODE_265)
+  {
+    Dialog::message("Error", "The emulator models the W65C265SXB only.");
+    return;
+  }
+
+  Fl_Native_File_Chooser fc;
+  fc.title("Compare With Emulator");
+  fc.filter("Plan File\t*.txt\n");
+  fc.options(Fl_Native_File_Chooser::PREVIEW);
+  fc.type(Fl_Native_File_Chooser::BROWSE_FILE);
+  fc.directory(load_dir);
+
+  switch(fc.show())
+  {
+    case -1:
+    case 1:
+      return;
+    default:
+      strcpy(load_dir, fc.filename());
+      if(strrchr(load_dir, '/') != NULL)
+        strrchr(load_dir, '/')[1] = '\0';
+      break;
+  }
+
+  run(fc.filename());
+}
+
+// returns true when every checkpoint matched
+bool Lockstep::run(const char *filename)
+{
+  Terminal::Hold hold;
+
+  Plan plan;
+
+  if(parsePlan(filename, plan) == false)
+  {
+    Dialog::message("Error", "Could not open plan file.");
+    return false;
+  }
+
+  if(plan.image[0] == '\0' || plan.calls.size() == 0)
+  {
+    Dialog::message("Error", "Plan needs an image and at least one call.");
+    return false;
+  }
+
+  mergeRanges(plan.ranges);
+
+  Emulator *emu = new Emulator();
+
+  if(emu->upload(plan.image) == false)
+  {
+    Dialog::message("Error", "Could not open file.");
+    delete emu;
+    return false;
+  }
+
+  const char *ext = strrchr(plan.image, '.');
+
+  if(ext != NULL && strcasecmp(ext, ".srec") == 0)
+    Terminal::uploadSrec(plan.image);
+  else
+    Terminal::uploadHex(plan.image);
+
+  // start both from the board's registers and memory
+  int regs[8];
+  std::vector<unsigned char> memory;
+
+  if(Terminal::readRegs(regs) == false || readBoard(plan.ranges, memory) == false)
+  {
+    Dialog::message("Error", "No response from the board.");
+    delete emu;
+    return false;
+  }
+
+  emu->a = regs[Monitor::REG_A];
+  emu->x = regs[Monitor::REG_X];
+  emu->y = regs[Monitor::REG_Y];
+  emu->sp = regs[Monitor::REG_SP];
+  emu->dp = regs[Monitor::REG_DP];
+  emu->sr = regs[Monitor::REG_SR];
+  emu->db = regs[Monitor::REG_DB];
+
+  size_t pos = 0;
+
+  for(size_t i = 0; i < plan.ranges.size(); i++)
+  {
+    for(int address = plan.ranges[i].start;
+        address <= plan.ranges[i].end; address++, pos++)
+    {
+      if(isIO(address) == false)
+        emu->write8(address, memory[pos]);
+    }
+  }
+
+  // the trace tells which instruction wrote a differing byte
+  std::string trace_name = filename;
+
+  trace_name += ".trace";
+
+  TraceWriter writer;
+
+  if(writer.open(trace_name.c_str()) == true)
+    emu->trace = &writer;
+
+  std::vector<Difference> differences;
+  std::string report;
+  std::string details;
+  char s[256];
+  int failed_call = -1;
+  int count = 0;
+
+  Gui::append("\nComparing with emulator.\n");
+
+  for(size_t i = 0; i < plan.calls.size(); i++)
+  {
+    const int address = plan.calls[i];
+    const long long before = emu->cycles;
+
+    emu->jsl(address);
+    emu->run(plan.cycles);
+
+    Terminal::jsl(address);
+
+    const bool answered = waitBoard(emu->cycles - before, regs);
+
+    sprintf(s, "Checkpoint %d, JSL %02X:%04X, %lld cycles: ",
+            (int)i + 1, address >> 16, address & 0xFFFF,
+            emu->cycles - before);
+    report = s;
+
+    if(emu->stop_reason != Emulator::STOP_RETURN)
+    {
+      report += "emulator did not return.\n";
+      failed_call = i;
+      break;
+    }
+
+    if(answered == false || readBoard(plan.ranges, memory) == false)
+    {
+      report += "no response from the board.\n";
+      failed_call = i;
+      break;
+    }
+
+    count = 0;
+    details.clear();
+    compareRegs(regs, *emu, details, &count);
+
+    pos = 0;
+
+    for(size_t j = 0; j < plan.ranges.size(); j++)
+    {
+      for(int address = plan.ranges[j].start;
+          address <= plan.ranges[j].end; address++, pos++)
+      {
+        // reading I/O in the emulator has side effects
+        if(isIO(address) == true)
+          continue;
+
+        const int value = emu->read8(address);
+
+        if(memory[pos] != value)
+        {
+          Difference diff;
+
+          diff.address = address;
+          diff.board = memory[pos];
+          diff.emulator = value;
+          differences.push_back(diff);
+          count++;
+        }
+      }
+    }
+
+    if(count > 0)
+    {
+      failed_call = i;
+      break;
+    }
+
+    report += "match.\n";
+    Gui::append(report.c_str());
+  }
+
+  emu->trace = NULL;
+  writer.close();
+
+  if(failed_call >= 0)
+  {
+    TraceReader reader;
+    const bool traced = reader.open(trace_name.c_str());
+
+    if(count > 0)
+    {
+      sprintf(s, "%d difference%s.\n", count, count == 1 ? "" : "s");
+      report += s;
+      report += details;
+    }
+
+    for(size_t i = 0; i < differences.size(); i++)
+    {
+      const Difference &diff = differences[i];
+      TraceReader::Record rec;
+      TraceReader::Access access;
+
+      sprintf(s, "  $%02X:%04X: board %02X, emulator %02X",
+              diff.address >> 16, diff.address & 0xFFFF,
+              diff.board, diff.emulator);
+      report += s;
+
+      if(traced == true &&
+         reader.lastWrite(diff.address, emu->cycles + 1, &rec, &access))
+      {
+        sprintf(s, ", written by %02X:%04X (op %02X) at cycle %lld\n",
+                rec.pc >> 16, rec.pc & 0xFFFF, rec.opcode, rec.cycle);
+      }
+      else
+      {
+        sprintf(s, ", not written by the emulator\n");
+      }
+
+      report += s;
+    }
+
+    Gui::append(report.c_str());
+  }
+  else
+  {
+    Gui::append("All checkpoints match.\n");
+  }
+
+  delete emu;
+  return failed_call < 0;
+}
+
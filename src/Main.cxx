@@ -18,6 +18,9 @@ along with EasySXB; if not, write to the Free Software
 Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
 */
 
+#include <cstdlib>
+#include <cstring>
+
 #include "FL/Fl.H"
 #include <FL/Fl_Native_File_Chooser.H>
 
@@ -42,9 +45,17 @@ enum    		/* permitted values for its `has_arg' field...	*/
 #include <getopt.h>
 #endif
 
+#include "Analyzer.H"
 #include "Dialog.H"
+#include "Gdb.H"
 #include "Gui.H"
+#include "Regress.H"
+#include "Ring.H"
+#include "Rpc.H"
+#include "Share.H"
+#include "Script.H"
 #include "Terminal.H"
+#include "Trace.H"
 
 namespace
 {
@@ -53,6 +64,18 @@ namespace
     OPTION_PORT,
     OPTION_FILE,
     OPTION_THEME,
+    OPTION_REGRESS,
+    OPTION_BLESS,
+    OPTION_COVERAGE,
+    OPTION_TRACE,
+    OPTION_AUDIO,
+    OPTION_QUERY,
+    OPTION_CYCLES,
+    OPTION_SCRIPT,
+    OPTION_RPC,
+    OPTION_SHARE,
+    OPTION_RING,
+    OPTION_GDB,
     OPTION_VERSION,
     OPTION_HELP
   };
@@ -64,6 +87,18 @@ namespace
     { "port",      required_argument, &verbose_flag, OPTION_PORT   },
     { "file",      required_argument, &verbose_flag, OPTION_FILE   },
     { "theme",     required_argument, &verbose_flag, OPTION_THEME   },
+    { "regress",   required_argument, &verbose_flag, OPTION_REGRESS },
+    { "bless",     no_argument,       &verbose_flag, OPTION_BLESS   },
+    { "coverage",  required_argument, &verbose_flag, OPTION_COVERAGE },
+    { "trace",     no_argument,       &verbose_flag, OPTION_TRACE   },
+    { "audio",     no_argument,       &verbose_flag, OPTION_AUDIO   },
+    { "query",     required_argument, &verbose_flag, OPTION_QUERY   },
+    { "cycles",    required_argument, &verbose_flag, OPTION_CYCLES  },
+    { "script",    required_argument, &verbose_flag, OPTION_SCRIPT  },
+    { "rpc",       required_argument, &verbose_flag, OPTION_RPC     },
+    { "share",     required_argument, &verbose_flag, OPTION_SHARE   },
+    { "ring",      required_argument, &verbose_flag, OPTION_RING    },
+    { "gdb",       required_argument, &verbose_flag, OPTION_GDB     },
     { "version",   no_argument,       &verbose_flag, OPTION_VERSION },
     { "help",      no_argument,       &verbose_flag, OPTION_HELP    },
     { 0, 0, 0, 0 }
@@ -75,6 +110,18 @@ namespace
     " --port        specify port\n"
     " --file        connect and upload .hex or .srec file\n"
     " --theme       select theme (light or dark)\n"
+    " --regress     run the emulator regression manifest and exit\n"
+    " --bless       write golden files instead of comparing\n"
+    " --coverage    write lcov coverage of the regression run to a file\n"
+    " --trace       record an instruction trace of each regression test\n"
+    " --audio       render the tone generators of each regression test\n"
+    " --query       search a trace: write ADDR [before CYCLE], exec ADDR\n"
+    " --cycles      estimate cycle counts from a listing and its image\n"
+    " --script      connect to --port and run a script without the gui\n"
+    " --rpc         serve JSON-RPC on a Unix socket without the gui\n"
+    " --share       share the board console on TCP ports or socket paths\n"
+    " --ring        publish received bytes in a shared memory ring\n"
+    " --gdb         serve the gdb remote protocol on a TCP port\n"
     " --version     show version\n"
     "\n";
 
@@ -105,7 +152,28 @@ int main(int argc, char *argv[])
   // parse command line
   int option_index = 0;
   char file_string[1024];
+  char regress_string[1024];
+  char coverage_string[1024];
+  char query_string[1024];
+  char cycles_string[1024];
+  char script_string[1024];
+  char rpc_string[1024];
+  char share_string[1024];
+  char ring_string[1024];
+  char gdb_string[1024];
   bool upload = false;
+  bool regress = false;
+  bool bless = false;
+  bool coverage = false;
+  bool trace = false;
+  bool audio = false;
+  bool query = false;
+  bool cycles = false;
+  bool script = false;
+  bool rpc = false;
+  bool share = false;
+  bool ring = false;
+  bool gdb = false;
 
 #ifdef WIN32
   strcpy(Terminal::port_string, "COM1");
@@ -146,6 +214,51 @@ int main(int argc, char *argv[])
             }
             printf("\nUnknown theme: \"%s\"\n", optarg);
             return 0;
+          case OPTION_REGRESS:
+            strncpy(regress_string, optarg, 1024);
+            regress = true;
+            break;
+          case OPTION_BLESS:
+            bless = true;
+            break;
+          case OPTION_COVERAGE:
+            strncpy(coverage_string, optarg, 1024);
+            coverage = true;
+            break;
+          case OPTION_TRACE:
+            trace = true;
+            break;
+          case OPTION_AUDIO:
+            audio = true;
+            break;
+          case OPTION_QUERY:
+            strncpy(query_string, optarg, 1024);
+            query = true;
+            break;
+          case OPTION_CYCLES:
+            strncpy(cycles_string, optarg, 1024);
+            cycles = true;
+            break;
+          case OPTION_SCRIPT:
+            strncpy(script_string, optarg, 1024);
+            script = true;
+            break;
+          case OPTION_RPC:
+            strncpy(rpc_string, optarg, 1024);
+            rpc = true;
+            break;
+          case OPTION_SHARE:
+            strncpy(share_string, optarg, 1024);
+            share = true;
+            break;
+          case OPTION_RING:
+            strncpy(ring_string, optarg, 1024);
+            ring = true;
+            break;
+          case OPTION_GDB:
+            strncpy(gdb_string, optarg, 1024);
+            gdb = true;
+            break;
           case OPTION_HELP:
             printf("%s\n", help_string);
             return 0;
@@ -169,8 +282,94 @@ int main(int argc, char *argv[])
       }
     }
   }
+
+  // headless trace search, the remaining arguments form the query
+  if(query == true)
+    return Trace::query(query_string, argc - optind, argv + optind);
 #endif
 
+  // headless static analysis
+  if(cycles == true)
+    return Analyzer::run(cycles_string);
+
+  // headless regression run
+  if(regress == true)
+    return Regress::run(regress_string, bless,
+                        coverage ? coverage_string : 0, trace, audio);
+
+  // shared memory receive ring, NAME or NAME:KB
+  if(ring == true)
+  {
+    char *colon = strchr(ring_string, ':');
+    int kb = 1024;
+
+    if(colon != 0)
+    {
+      *colon = '\0';
+      kb = atoi(colon + 1);
+    }
+
+    if(Ring::open(ring_string, kb * 1024) == false)
+    {
+      printf("Could not open receive ring \"%s\".\n", ring_string);
+      return 1;
+    }
+
+    atexit(Ring::close);
+  }
+
+  // headless board automation
+  if(script == true)
+  {
+    Terminal::connect();
+
+    if(Terminal::isConnected() == false)
+      return 1;
+
+    return Script::run(script_string);
+  }
+
+  // headless control socket, shared console and gdb server, all served
+  // by one loop
+  if(rpc == true || share == true || gdb == true)
+  {
+    if(rpc == true && Rpc::start(rpc_string) == false)
+    {
+      printf("Could not open control socket \"%s\".\n", rpc_string);
+      return 1;
+    }
+
+    // these own the serial port for their whole life
+    if(share == true || gdb == true)
+    {
+      Terminal::connect();
+
+      if(Terminal::isConnected() == false)
+        return 1;
+    }
+
+    if(share == true && Share::start(share_string) == false)
+    {
+      printf("Could not share session on \"%s\".\n", share_string);
+      return 1;
+    }
+
+    if(gdb == true && Gdb::start(gdb_string) == false)
+    {
+      printf("Could not start gdb server on \"%s\".\n", gdb_string);
+      return 1;
+    }
+
+    while(Rpc::isRunning() == true || Share::isRunning() == true ||
+          Gdb::isRunning() == true)
+    {
+      Fl::wait(0.1);
+      Terminal::drain();
+    }
+
+    return 0;
+  }
+
   // fltk related inits
   Fl::visual(FL_DOUBLE | FL_RGB);
   Fl::scheme("gtk+");
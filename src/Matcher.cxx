@@ -0,0 +1,166 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <queue>
+
+#include "Matcher.H"
+
+Matcher::Matcher()
+{
+  clear();
+}
+
+Matcher::~Matcher()
+{
+}
+
+void Matcher::clear()
+{
+  patterns.clear();
+  delta.clear();
+  output.clear();
+  state = 0;
+}
+
+// returns the pattern id reported by feed()
+int Matcher::add(const std::string &pattern)
+{
+  patterns.push_back(pattern);
+  return patterns.size() - 1;
+}
+
+// trie of the patterns, with failure links folded into the transitions
+void Matcher::build()
+{
+  std::vector<int> fail(1, 0);
+
+  delta.assign(ALPHABET, -1);
+  output.assign(1, -1);
+  state = 0;
+
+  for(size_t i = 0; i < patterns.size(); i++)
+  {
+    const std::string &p = patterns[i];
+    int s = 0;
+
+    if(p.size() == 0)
+      continue;
+
+    for(size_t j = 0; j < p.size(); j++)
+    {
+      const int c = (unsigned char)p[j];
+
+      if(delta[s * ALPHABET + c] < 0)
+      {
+        delta[s * ALPHABET + c] = output.size();
+        delta.insert(delta.end(), ALPHABET, -1);
+        output.push_back(-1);
+        fail.push_back(0);
+      }
+
+      s = delta[s * ALPHABET + c];
+    }
+
+    if(output[s] < 0)
+      output[s] = i;
+  }
+
+  // breadth first, so every failure state is complete before it's used
+  std::queue<int> queue;
+
+  for(int c = 0; c < ALPHABET; c++)
+  {
+    if(delta[c] < 0)
+    {
+      delta[c] = 0;
+    }
+    else
+    {
+      fail[delta[c]] = 0;
+      queue.push(delta[c]);
+    }
+  }
+
+  while(queue.empty() == false)
+  {
+    const int s = queue.front();
+
+    queue.pop();
+
+    if(output[fail[s]] >= 0 &&
+       (output[s] < 0 || output[fail[s]] < output[s]))
+    {
+      output[s] = output[fail[s]];
+    }
+
+    for(int c = 0; c < ALPHABET; c++)
+    {
+      const int t = delta[s * ALPHABET + c];
+
+      if(t < 0)
+      {
+        delta[s * ALPHABET + c] = delta[fail[s] * ALPHABET + c];
+      }
+      else
+      {
+        fail[t] = delta[fail[s] * ALPHABET + c];
+        queue.push(t);
+      }
+    }
+  }
+}
+
+// forget partial matches
+void Matcher::reset()
+{
+  state = 0;
+}
+
+// returns the id of the first pattern completed in the data, with the
+// offset just past it in end, or -1 once all of it is consumed; the
+// state carries over to the next call
+int Matcher::feed(const char *data, int count, int *end)
+{
+  if(delta.size() == 0)
+    return -1;
+
+  for(int i = 0; i < count; i++)
+  {
+    state = delta[state * ALPHABET + (unsigned char)data[i]];
+
+    if(output[state] >= 0)
+    {
+      const int id = output[state];
+
+      *end = i + 1;
+      state = 0;
+      return id;
+    }
+  }
+
+  return -1;
+}
+
+bool Matcher::empty() const
+{
+  return patterns.size() == 0;
+}
+
@@ -0,0 +1,177 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "Monitor.H"
+
+// ask for the registers
+void Monitor::regsCommand(char *s, int mode)
+{
+  strcpy(s, mode == MODE_265 ? "| " : "R");
+}
+
+// registers from a filtered reply, in REG_ order
+bool Monitor::parseRegs(const char *s, int mode, int *regs)
+{
+  if(mode == MODE_265)
+  {
+    return sscanf(s, "  %06X %04X %04X %04X %04X %04X %02X %02X",
+                  &regs[REG_PC], &regs[REG_A],
+                  &regs[REG_X], &regs[REG_Y],
+                  &regs[REG_SP], &regs[REG_DP],
+                  &regs[REG_SR], &regs[REG_DB]) == 8;
+  }
+  else if(mode == MODE_134)
+  {
+    regs[REG_DP] = 0;
+    regs[REG_DB] = 0;
+
+    return strlen(s) > 20 &&
+           sscanf(s + 20, "%04X %02X %02X %02X %02X %02X",
+                  &regs[REG_PC], &regs[REG_SR],
+                  &regs[REG_A], &regs[REG_X],
+                  &regs[REG_Y], &regs[REG_SP]) == 6;
+  }
+
+  return false;
+}
+
+// every register in one command, followed by "R" to show them
+void Monitor::setRegsCommand(char *s, int mode, const int *regs)
+{
+  if(mode == MODE_265)
+  {
+    sprintf(s, "|P%02X:%04X|A%04X|X%04X|Y%04X|S%04X|D%04X|F%02X|B%02X",
+            regs[REG_PC] >> 16, regs[REG_PC] & 0xFFFF,
+            regs[REG_A], regs[REG_X],
+            regs[REG_Y], regs[REG_SP],
+            regs[REG_DP], regs[REG_SR],
+            regs[REG_DB]);
+  }
+  else
+  {
+    // fields advance once all their digits are typed
+    sprintf(s, "A%04X%02X%02X%02X%02X%02X", regs[REG_PC] & 0xFFFF,
+            regs[REG_SR] & 0xFF, regs[REG_A] & 0xFF,
+            regs[REG_X] & 0xFF, regs[REG_Y] & 0xFF,
+            regs[REG_SP] & 0xFF);
+  }
+}
+
+// one command for the whole range, the monitor streams the lines
+void Monitor::dumpCommand(char *s, int mode, int address, int count)
+{
+  const int end = address + count - 1;
+
+  if(mode == MODE_265)
+  {
+    sprintf(s, "M%02X%04X%02X%04X", address >> 16, address & 0xFFFF,
+            end >> 16, end & 0xFFFF);
+  }
+  else
+  {
+    sprintf(s, "M%04X%04X", address & 0xFFFF, end & 0xFFFF);
+  }
+}
+
+// parse one line of a monitor memory dump, "00:1000 A9 FF 8D ..."
+void Monitor::parseDump(const char *s, int address, unsigned char *data,
+                        std::vector<bool> &seen)
+{
+  int line = 0;
+  int digits = 0;
+
+  while(*s == ' ' || *s == '.' || *s == '>')
+    s++;
+
+  while(isxdigit(*s) || (*s == ':' && digits == 2))
+  {
+    if(*s != ':')
+    {
+      line = (line << 4) | (isdigit(*s) ? *s - '0' : toupper(*s) - 'A' + 10);
+      digits++;
+    }
+
+    s++;
+  }
+
+  if(digits < 4 || (*s != ' ' && *s != ':'))
+    return;
+
+  // the 134 only shows 16-bit addresses
+  if(digits == 4)
+    line |= address & 0xFF0000;
+
+  while(true)
+  {
+    while(*s == ' ' || *s == ':')
+      s++;
+
+    // stop at the ascii column
+    if(!isxdigit(s[0]) || !isxdigit(s[1]) ||
+       (s[2] != ' ' && s[2] != 0))
+    {
+      break;
+    }
+
+    const int offset = line - address;
+
+    if(offset >= 0 && offset < (int)seen.size())
+    {
+      data[offset] = strtol(std::string(s, 2).c_str(), 0, 16);
+      seen[offset] = true;
+    }
+
+    line++;
+    s += 2;
+  }
+}
+
+// G jumps, J calls as a subroutine
+void Monitor::jumpCommand(char *s, int mode, int address, bool call)
+{
+  if(mode == MODE_265)
+    sprintf(s, "%c%02X%04X", call ? 'J' : 'G', address >> 16, address & 0xFFFF);
+  else
+    sprintf(s, "%c%04X", call ? 'J' : 'G', address & 0xFFFF);
+}
+
+// keep what register replies are made of
+void Monitor::filterResult(char *dest, const char *src)
+{
+  int j = 0;
+
+  for(int i = 0; src[i] != 0; i++)
+  {
+    const char c = src[i];
+
+    if((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || c == ' ')
+      dest[j++] = c;
+  }
+
+  dest[j] = '\0';
+}
+
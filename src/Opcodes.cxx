@@ -0,0 +1,479 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <cstdio>
+
+#include "Opcodes.H"
+
+using namespace Opcodes;
+
+// base cycle counts assume 8-bit registers, an aligned direct page,
+// no page crossing and a branch that is not taken
+const Opcode Opcodes::table[256] =
+{
+    { "BRK", MODE_IMM8, 7, FLAG_STOP },
+    { "ORA", MODE_DPINDX, 6, FLAG_M },
+    { "COP", MODE_IMM8, 7, FLAG_STOP },
+    { "ORA", MODE_SR, 4, FLAG_M },
+    { "TSB", MODE_DP, 5, FLAG_M | FLAG_RMW },
+    { "ORA", MODE_DP, 3, FLAG_M },
+    { "ASL", MODE_DP, 5, FLAG_M | FLAG_RMW },
+    { "ORA", MODE_DPINDL, 6, FLAG_M },
+    { "PHP", MODE_IMP, 3, 0 },
+    { "ORA", MODE_IMM_M, 2, FLAG_M },
+    { "ASL", MODE_ACC, 2, 0 },
+    { "PHD", MODE_IMP, 4, 0 },
+    { "TSB", MODE_ABS, 6, FLAG_M | FLAG_RMW },
+    { "ORA", MODE_ABS, 4, FLAG_M },
+    { "ASL", MODE_ABS, 6, FLAG_M | FLAG_RMW },
+    { "ORA", MODE_LONG, 5, FLAG_M },
+    { "BPL", MODE_REL, 2, FLAG_BRANCH },
+    { "ORA", MODE_DPINDY, 5, FLAG_M | FLAG_READ },
+    { "ORA", MODE_DPIND, 5, FLAG_M },
+    { "ORA", MODE_SRINDY, 7, FLAG_M },
+    { "TRB", MODE_DP, 5, FLAG_M | FLAG_RMW },
+    { "ORA", MODE_DPX, 4, FLAG_M },
+    { "ASL", MODE_DPX, 6, FLAG_M | FLAG_RMW },
+    { "ORA", MODE_DPINDLY, 6, FLAG_M },
+    { "CLC", MODE_IMP, 2, 0 },
+    { "ORA", MODE_ABSY, 4, FLAG_M | FLAG_READ },
+    { "INC", MODE_ACC, 2, 0 },
+    { "TCS", MODE_IMP, 2, 0 },
+    { "TRB", MODE_ABS, 6, FLAG_M | FLAG_RMW },
+    { "ORA", MODE_ABSX, 4, FLAG_M | FLAG_READ },
+    { "ASL", MODE_ABSX, 7, FLAG_M | FLAG_RMW },
+    { "ORA", MODE_LONGX, 5, FLAG_M },
+    { "JSR", MODE_ABS, 6, FLAG_CALL },
+    { "AND", MODE_DPINDX, 6, FLAG_M },
+    { "JSL", MODE_LONG, 8, FLAG_CALL },
+    { "AND", MODE_SR, 4, FLAG_M },
+    { "BIT", MODE_DP, 3, FLAG_M },
+    { "AND", MODE_DP, 3, FLAG_M },
+    { "ROL", MODE_DP, 5, FLAG_M | FLAG_RMW },
+    { "AND", MODE_DPINDL, 6, FLAG_M },
+    { "PLP", MODE_IMP, 4, 0 },
+    { "AND", MODE_IMM_M, 2, FLAG_M },
+    { "ROL", MODE_ACC, 2, 0 },
+    { "PLD", MODE_IMP, 5, 0 },
+    { "BIT", MODE_ABS, 4, FLAG_M },
+    { "AND", MODE_ABS, 4, FLAG_M },
+    { "ROL", MODE_ABS, 6, FLAG_M | FLAG_RMW },
+    { "AND", MODE_LONG, 5, FLAG_M },
+    { "BMI", MODE_REL, 2, FLAG_BRANCH },
+    { "AND", MODE_DPINDY, 5, FLAG_M | FLAG_READ },
+    { "AND", MODE_DPIND, 5, FLAG_M },
+    { "AND", MODE_SRINDY, 7, FLAG_M },
+    { "BIT", MODE_DPX, 4, FLAG_M },
+    { "AND", MODE_DPX, 4, FLAG_M },
+    { "ROL", MODE_DPX, 6, FLAG_M | FLAG_RMW },
+    { "AND", MODE_DPINDLY, 6, FLAG_M },
+    { "SEC", MODE_IMP, 2, 0 },
+    { "AND", MODE_ABSY, 4, FLAG_M | FLAG_READ },
+    { "DEC", MODE_ACC, 2, 0 },
+    { "TSC", MODE_IMP, 2, 0 },
+    { "BIT", MODE_ABSX, 4, FLAG_M | FLAG_READ },
+    { "AND", MODE_ABSX, 4, FLAG_M | FLAG_READ },
+    { "ROL", MODE_ABSX, 7, FLAG_M | FLAG_RMW },
+    { "AND", MODE_LONGX, 5, FLAG_M },
+    { "RTI", MODE_IMP, 6, FLAG_RETURN },
+    { "EOR", MODE_DPINDX, 6, FLAG_M },
+    { "WDM", MODE_IMM8, 2, 0 },
+    { "EOR", MODE_SR, 4, FLAG_M },
+    { "MVP", MODE_BLOCK, 7, 0 },
+    { "EOR", MODE_DP, 3, FLAG_M },
+    { "LSR", MODE_DP, 5, FLAG_M | FLAG_RMW },
+    { "EOR", MODE_DPINDL, 6, FLAG_M },
+    { "PHA", MODE_IMP, 3, FLAG_M },
+    { "EOR", MODE_IMM_M, 2, FLAG_M },
+    { "LSR", MODE_ACC, 2, 0 },
+    { "PHK", MODE_IMP, 3, 0 },
+    { "JMP", MODE_ABS, 3, FLAG_JUMP },
+    { "EOR", MODE_ABS, 4, FLAG_M },
+    { "LSR", MODE_ABS, 6, FLAG_M | FLAG_RMW },
+    { "EOR", MODE_LONG, 5, FLAG_M },
+    { "BVC", MODE_REL, 2, FLAG_BRANCH },
+    { "EOR", MODE_DPINDY, 5, FLAG_M | FLAG_READ },
+    { "EOR", MODE_DPIND, 5, FLAG_M },
+    { "EOR", MODE_SRINDY, 7, FLAG_M },
+    { "MVN", MODE_BLOCK, 7, 0 },
+    { "EOR", MODE_DPX, 4, FLAG_M },
+    { "LSR", MODE_DPX, 6, FLAG_M | FLAG_RMW },
+    { "EOR", MODE_DPINDLY, 6, FLAG_M },
+    { "CLI", MODE_IMP, 2, 0 },
+    { "EOR", MODE_ABSY, 4, FLAG_M | FLAG_READ },
+    { "PHY", MODE_IMP, 3, FLAG_X },
+    { "TCD", MODE_IMP, 2, 0 },
+    { "JML", MODE_LONG, 4, FLAG_JUMP },
+    { "EOR", MODE_ABSX, 4, FLAG_M | FLAG_READ },
+    { "LSR", MODE_ABSX, 7, FLAG_M | FLAG_RMW },
+    { "EOR", MODE_LONGX, 5, FLAG_M },
+    { "RTS", MODE_IMP, 6, FLAG_RETURN },
+    { "ADC", MODE_DPINDX, 6, FLAG_M },
+    { "PER", MODE_RELL, 6, 0 },
+    { "ADC", MODE_SR, 4, FLAG_M },
+    { "STZ", MODE_DP, 3, FLAG_M },
+    { "ADC", MODE_DP, 3, FLAG_M },
+    { "ROR", MODE_DP, 5, FLAG_M | FLAG_RMW },
+    { "ADC", MODE_DPINDL, 6, FLAG_M },
+    { "PLA", MODE_IMP, 4, FLAG_M },
+    { "ADC", MODE_IMM_M, 2, FLAG_M },
+    { "ROR", MODE_ACC, 2, 0 },
+    { "RTL", MODE_IMP, 6, FLAG_RETURN },
+    { "JMP", MODE_ABSIND, 5, FLAG_JUMP },
+    { "ADC", MODE_ABS, 4, FLAG_M },
+    { "ROR", MODE_ABS, 6, FLAG_M | FLAG_RMW },
+    { "ADC", MODE_LONG, 5, FLAG_M },
+    { "BVS", MODE_REL, 2, FLAG_BRANCH },
+    { "ADC", MODE_DPINDY, 5, FLAG_M | FLAG_READ },
+    { "ADC", MODE_DPIND, 5, FLAG_M },
+    { "ADC", MODE_SRINDY, 7, FLAG_M },
+    { "STZ", MODE_DPX, 4, FLAG_M },
+    { "ADC", MODE_DPX, 4, FLAG_M },
+    { "ROR", MODE_DPX, 6, FLAG_M | FLAG_RMW },
+    { "ADC", MODE_DPINDLY, 6, FLAG_M },
+    { "SEI", MODE_IMP, 2, 0 },
+    { "ADC", MODE_ABSY, 4, FLAG_M | FLAG_READ },
+    { "PLY", MODE_IMP, 4, FLAG_X },
+    { "TDC", MODE_IMP, 2, 0 },
+    { "JMP", MODE_ABSINDX, 6, FLAG_JUMP },
+    { "ADC", MODE_ABSX, 4, FLAG_M | FLAG_READ },
+    { "ROR", MODE_ABSX, 7, FLAG_M | FLAG_RMW },
+    { "ADC", MODE_LONGX, 5, FLAG_M },
+    { "BRA", MODE_REL, 3, FLAG_JUMP },
+    { "STA", MODE_DPINDX, 6, FLAG_M },
+    { "BRL", MODE_RELL, 4, FLAG_JUMP },
+    { "STA", MODE_SR, 4, FLAG_M },
+    { "STY", MODE_DP, 3, FLAG_X },
+    { "STA", MODE_DP, 3, FLAG_M },
+    { "STX", MODE_DP, 3, FLAG_X },
+    { "STA", MODE_DPINDL, 6, FLAG_M },
+    { "DEY", MODE_IMP, 2, 0 },
+    { "BIT", MODE_IMM_M, 2, FLAG_M },
+    { "TXA", MODE_IMP, 2, 0 },
+    { "PHB", MODE_IMP, 3, 0 },
+    { "STY", MODE_ABS, 4, FLAG_X },
+    { "STA", MODE_ABS, 4, FLAG_M },
+    { "STX", MODE_ABS, 4, FLAG_X },
+    { "STA", MODE_LONG, 5, FLAG_M },
+    { "BCC", MODE_REL, 2, FLAG_BRANCH },
+    { "STA", MODE_DPINDY, 6, FLAG_M },
+    { "STA", MODE_DPIND, 5, FLAG_M },
+    { "STA", MODE_SRINDY, 7, FLAG_M },
+    { "STY", MODE_DPX, 4, FLAG_X },
+    { "STA", MODE_DPX, 4, FLAG_M },
+    { "STX", MODE_DPY, 4, FLAG_X },
+    { "STA", MODE_DPINDLY, 6, FLAG_M },
+    { "TYA", MODE_IMP, 2, 0 },
+    { "STA", MODE_ABSY, 5, FLAG_M },
+    { "TXS", MODE_IMP, 2, 0 },
+    { "TXY", MODE_IMP, 2, 0 },
+    { "STZ", MODE_ABS, 4, FLAG_M },
+    { "STA", MODE_ABSX, 5, FLAG_M },
+    { "STZ", MODE_ABSX, 5, FLAG_M },
+    { "STA", MODE_LONGX, 5, FLAG_M },
+    { "LDY", MODE_IMM_X, 2, FLAG_X },
+    { "LDA", MODE_DPINDX, 6, FLAG_M },
+    { "LDX", MODE_IMM_X, 2, FLAG_X },
+    { "LDA", MODE_SR, 4, FLAG_M },
+    { "LDY", MODE_DP, 3, FLAG_X },
+    { "LDA", MODE_DP, 3, FLAG_M },
+    { "LDX", MODE_DP, 3, FLAG_X },
+    { "LDA", MODE_DPINDL, 6, FLAG_M },
+    { "TAY", MODE_IMP, 2, 0 },
+    { "LDA", MODE_IMM_M, 2, FLAG_M },
+    { "TAX", MODE_IMP, 2, 0 },
+    { "PLB", MODE_IMP, 4, 0 },
+    { "LDY", MODE_ABS, 4, FLAG_X },
+    { "LDA", MODE_ABS, 4, FLAG_M },
+    { "LDX", MODE_ABS, 4, FLAG_X },
+    { "LDA", MODE_LONG, 5, FLAG_M },
+    { "BCS", MODE_REL, 2, FLAG_BRANCH },
+    { "LDA", MODE_DPINDY, 5, FLAG_M | FLAG_READ },
+    { "LDA", MODE_DPIND, 5, FLAG_M },
+    { "LDA", MODE_SRINDY, 7, FLAG_M },
+    { "LDY", MODE_DPX, 4, FLAG_X },
+    { "LDA", MODE_DPX, 4, FLAG_M },
+    { "LDX", MODE_DPY, 4, FLAG_X },
+    { "LDA", MODE_DPINDLY, 6, FLAG_M },
+    { "CLV", MODE_IMP, 2, 0 },
+    { "LDA", MODE_ABSY, 4, FLAG_M | FLAG_READ },
+    { "TSX", MODE_IMP, 2, 0 },
+    { "TYX", MODE_IMP, 2, 0 },
+    { "LDY", MODE_ABSX, 4, FLAG_X | FLAG_READ },
+    { "LDA", MODE_ABSX, 4, FLAG_M | FLAG_READ },
+    { "LDX", MODE_ABSY, 4, FLAG_X | FLAG_READ },
+    { "LDA", MODE_LONGX, 5, FLAG_M },
+    { "CPY", MODE_IMM_X, 2, FLAG_X },
+    { "CMP", MODE_DPINDX, 6, FLAG_M },
+    { "REP", MODE_IMM8, 3, 0 },
+    { "CMP", MODE_SR, 4, FLAG_M },
+    { "CPY", MODE_DP, 3, FLAG_X },
+    { "CMP", MODE_DP, 3, FLAG_M },
+    { "DEC", MODE_DP, 5, FLAG_M | FLAG_RMW },
+    { "CMP", MODE_DPINDL, 6, FLAG_M },
+    { "INY", MODE_IMP, 2, 0 },
+    { "CMP", MODE_IMM_M, 2, FLAG_M },
+    { "DEX", MODE_IMP, 2, 0 },
+    { "WAI", MODE_IMP, 3, FLAG_STOP },
+    { "CPY", MODE_ABS, 4, FLAG_X },
+    { "CMP", MODE_ABS, 4, FLAG_M },
+    { "DEC", MODE_ABS, 6, FLAG_M | FLAG_RMW },
+    { "CMP", MODE_LONG, 5, FLAG_M },
+    { "BNE", MODE_REL, 2, FLAG_BRANCH },
+    { "CMP", MODE_DPINDY, 5, FLAG_M | FLAG_READ },
+    { "CMP", MODE_DPIND, 5, FLAG_M },
+    { "CMP", MODE_SRINDY, 7, FLAG_M },
+    { "PEI", MODE_DPIND, 6, 0 },
+    { "CMP", MODE_DPX, 4, FLAG_M },
+    { "DEC", MODE_DPX, 6, FLAG_M | FLAG_RMW },
+    { "CMP", MODE_DPINDLY, 6, FLAG_M },
+    { "CLD", MODE_IMP, 2, 0 },
+    { "CMP", MODE_ABSY, 4, FLAG_M | FLAG_READ },
+    { "PHX", MODE_IMP, 3, FLAG_X },
+    { "STP", MODE_IMP, 3, FLAG_STOP },
+    { "JML", MODE_ABSINDL, 6, FLAG_JUMP },
+    { "CMP", MODE_ABSX, 4, FLAG_M | FLAG_READ },
+    { "DEC", MODE_ABSX, 7, FLAG_M | FLAG_RMW },
+    { "CMP", MODE_LONGX, 5, FLAG_M },
+    { "CPX", MODE_IMM_X, 2, FLAG_X },
+    { "SBC", MODE_DPINDX, 6, FLAG_M },
+    { "SEP", MODE_IMM8, 3, 0 },
+    { "SBC", MODE_SR, 4, FLAG_M },
+    { "CPX", MODE_DP, 3, FLAG_X },
+    { "SBC", MODE_DP, 3, FLAG_M },
+    { "INC", MODE_DP, 5, FLAG_M | FLAG_RMW },
+    { "SBC", MODE_DPINDL, 6, FLAG_M },
+    { "INX", MODE_IMP, 2, 0 },
+    { "SBC", MODE_IMM_M, 2, FLAG_M },
+    { "NOP", MODE_IMP, 2, 0 },
+    { "XBA", MODE_IMP, 3, 0 },
+    { "CPX", MODE_ABS, 4, FLAG_X },
+    { "SBC", MODE_ABS, 4, FLAG_M },
+    { "INC", MODE_ABS, 6, FLAG_M | FLAG_RMW },
+    { "SBC", MODE_LONG, 5, FLAG_M },
+    { "BEQ", MODE_REL, 2, FLAG_BRANCH },
+    { "SBC", MODE_DPINDY, 5, FLAG_M | FLAG_READ },
+    { "SBC", MODE_DPIND, 5, FLAG_M },
+    { "SBC", MODE_SRINDY, 7, FLAG_M },
+    { "PEA", MODE_ABS, 5, 0 },
+    { "SBC", MODE_DPX, 4, FLAG_M },
+    { "INC", MODE_DPX, 6, FLAG_M | FLAG_RMW },
+    { "SBC", MODE_DPINDLY, 6, FLAG_M },
+    { "SED", MODE_IMP, 2, 0 },
+    { "SBC", MODE_ABSY, 4, FLAG_M | FLAG_READ },
+    { "PLX", MODE_IMP, 4, FLAG_X },
+    { "XCE", MODE_IMP, 2, 0 },
+    { "JSR", MODE_ABSINDX, 8, FLAG_CALL },
+    { "SBC", MODE_ABSX, 4, FLAG_M | FLAG_READ },
+    { "INC", MODE_ABSX, 7, FLAG_M | FLAG_RMW },
+    { "SBC", MODE_LONGX, 5, FLAG_M }
+};
+
+// instruction length in bytes for the given M and X flag states
+// (m and x are true when the corresponding register is 8-bit)
+int Opcodes::length(int op, bool m, bool x)
+{
+  switch(table[op & 0xFF].mode)
+  {
+    case MODE_IMP:
+    case MODE_ACC:
+      return 1;
+    case MODE_IMM_M:
+      return m ? 2 : 3;
+    case MODE_IMM_X:
+      return x ? 2 : 3;
+    case MODE_ABS:
+    case MODE_ABSX:
+    case MODE_ABSY:
+    case MODE_ABSIND:
+    case MODE_ABSINDX:
+    case MODE_ABSINDL:
+    case MODE_RELL:
+    case MODE_BLOCK:
+      return 3;
+    case MODE_LONG:
+    case MODE_LONGX:
+      return 4;
+    default:
+      return 2;
+  }
+}
+
+// cycle count for one execution of an instruction
+// m, x: register widths are 8-bit
+// e: emulation mode
+// dp: direct page register (low byte adds a cycle when non-zero)
+// cross: an indexed access or taken branch crossed a page
+// taken: a conditional branch was taken
+int Opcodes::cycles(int op, bool m, bool x, bool e, int dp,
+                    bool cross, bool taken)
+{
+  const Opcode *code = &table[op & 0xFF];
+  int count = code->cycles;
+
+  if((code->flags & FLAG_M) && m == false)
+    count += (code->flags & FLAG_RMW) ? 2 : 1;
+
+  if((code->flags & FLAG_X) && x == false)
+    count++;
+
+  switch(code->mode)
+  {
+    case MODE_DP:
+    case MODE_DPX:
+    case MODE_DPY:
+    case MODE_DPIND:
+    case MODE_DPINDX:
+    case MODE_DPINDY:
+    case MODE_DPINDL:
+    case MODE_DPINDLY:
+      if((dp & 0xFF) != 0)
+        count++;
+      break;
+  }
+
+  // 16-bit index registers always pay the indexing penalty
+  if((code->flags & FLAG_READ) && (cross == true || x == false))
+    count++;
+
+  if(code->flags & FLAG_BRANCH)
+  {
+    if(taken == true)
+    {
+      count++;
+
+      if(e == true && cross == true)
+        count++;
+    }
+  }
+  else if(code->mode == MODE_REL && e == true && cross == true)
+  {
+    // BRA
+    count++;
+  }
+
+  // BRK, COP and RTI move the program bank in native mode
+  if(e == false && (op == 0x00 || op == 0x02 || op == 0x40))
+    count++;
+
+  return count;
+}
+
+
+// one instruction as text, returns its length
+// bytes must hold at least four bytes starting at the opcode
+int Opcodes::disassemble(char *s, int address, const unsigned char *bytes,
+                         bool m, bool x)
+{
+  const Opcode *code = &table[bytes[0]];
+  const int len = length(bytes[0], m, x);
+  const int b = bytes[1];
+  const int w = bytes[1] | (bytes[2] << 8);
+  const int l = w | (bytes[3] << 16);
+  const int next = (address & 0xFFFF) + len;
+
+  switch(code->mode)
+  {
+    case MODE_IMP:
+      sprintf(s, "%s", code->name);
+      break;
+    case MODE_ACC:
+      sprintf(s, "%s A", code->name);
+      break;
+    case MODE_IMM_M:
+    case MODE_IMM_X:
+    case MODE_IMM8:
+      if(len == 3)
+        sprintf(s, "%s #$%04X", code->name, w);
+      else
+        sprintf(s, "%s #$%02X", code->name, b);
+      break;
+    case MODE_DP:
+      sprintf(s, "%s $%02X", code->name, b);
+      break;
+    case MODE_DPX:
+      sprintf(s, "%s $%02X,X", code->name, b);
+      break;
+    case MODE_DPY:
+      sprintf(s, "%s $%02X,Y", code->name, b);
+      break;
+    case MODE_DPIND:
+      sprintf(s, "%s ($%02X)", code->name, b);
+      break;
+    case MODE_DPINDX:
+      sprintf(s, "%s ($%02X,X)", code->name, b);
+      break;
+    case MODE_DPINDY:
+      sprintf(s, "%s ($%02X),Y", code->name, b);
+      break;
+    case MODE_DPINDL:
+      sprintf(s, "%s [$%02X]", code->name, b);
+      break;
+    case MODE_DPINDLY:
+      sprintf(s, "%s [$%02X],Y", code->name, b);
+      break;
+    case MODE_ABS:
+      sprintf(s, "%s $%04X", code->name, w);
+      break;
+    case MODE_ABSX:
+      sprintf(s, "%s $%04X,X", code->name, w);
+      break;
+    case MODE_ABSY:
+      sprintf(s, "%s $%04X,Y", code->name, w);
+      break;
+    case MODE_ABSIND:
+      sprintf(s, "%s ($%04X)", code->name, w);
+      break;
+    case MODE_ABSINDX:
+      sprintf(s, "%s ($%04X,X)", code->name, w);
+      break;
+    case MODE_ABSINDL:
+      sprintf(s, "%s [$%04X]", code->name, w);
+      break;
+    case MODE_LONG:
+      sprintf(s, "%s $%06X", code->name, l);
+      break;
+    case MODE_LONGX:
+      sprintf(s, "%s $%06X,X", code->name, l);
+      break;
+    case MODE_SR:
+      sprintf(s, "%s $%02X,S", code->name, b);
+      break;
+    case MODE_SRINDY:
+      sprintf(s, "%s ($%02X,S),Y", code->name, b);
+      break;
+    case MODE_REL:
+      sprintf(s, "%s $%04X", code->name, (next + (signed char)b) & 0xFFFF);
+      break;
+    case MODE_RELL:
+      sprintf(s, "%s $%04X", code->name, (next + (short)w) & 0xFFFF);
+      break;
+    case MODE_BLOCK:
+      // operand bytes are destination then source bank
+      sprintf(s, "%s $%02X,$%02X", code->name, bytes[2], b);
+      break;
+    default:
+      sprintf(s, "%s", code->name);
+      break;
+  }
+
+  return len;
+}
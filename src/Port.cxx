@@ -0,0 +1,207 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <cstring>
+
+#ifndef WIN32
+  #include <fcntl.h>
+  #include <poll.h>
+  #include <termios.h>
+  #include <unistd.h>
+#endif
+
+#include "Port.H"
+
+Port::Port()
+{
+#ifdef WIN32
+  hserial = INVALID_HANDLE_VALUE;
+#else
+  fd = -1;
+#endif
+}
+
+Port::~Port()
+{
+  close();
+}
+
+bool Port::open(const char *name)
+{
+  close();
+
+#ifdef WIN32
+  DCB dcb;
+  COMMTIMEOUTS timeouts;
+
+  hserial = CreateFile(name, GENERIC_READ | GENERIC_WRITE,
+                       0, NULL, OPEN_EXISTING, 0, NULL);
+
+  if(hserial == INVALID_HANDLE_VALUE)
+    return false;
+
+  GetCommState(hserial, &dcb);
+
+  dcb.BaudRate = CBR_9600;
+  dcb.ByteSize = 8;
+  dcb.StopBits = ONESTOPBIT;
+  dcb.Parity = NOPARITY;
+  dcb.fOutX = FALSE;
+  dcb.fInX = FALSE;
+  dcb.fOutxCtsFlow = TRUE;
+  dcb.fRtsControl = RTS_CONTROL_HANDSHAKE;
+  dcb.fOutxDsrFlow = FALSE;
+  dcb.fDtrControl = DTR_CONTROL_DISABLE;
+
+  memset(&timeouts, 0, sizeof(timeouts));
+
+  timeouts.ReadIntervalTimeout = MAXDWORD;
+  timeouts.ReadTotalTimeoutConstant = 0;
+  timeouts.ReadTotalTimeoutMultiplier = 0;
+  timeouts.WriteTotalTimeoutConstant = 0;
+  timeouts.WriteTotalTimeoutMultiplier = 0;
+
+  if(SetCommState(hserial, &dcb) == 0 ||
+     SetCommTimeouts(hserial, &timeouts) == 0)
+  {
+    close();
+    return false;
+  }
+#else
+  struct termios term;
+
+  fd = ::open(name, O_RDWR | O_NOCTTY | O_NONBLOCK | O_NDELAY);
+
+  if(fd == -1)
+    return false;
+
+  memset(&term, 0, sizeof(term));
+
+  //term.c_cflag = B9600 | CRTSCTS | CS8 | CREAD| CLOCAL;
+  term.c_cflag = B9600 | CS8 | CREAD| CLOCAL;
+  term.c_iflag = IGNPAR | IXOFF | IXON | IXANY;
+  term.c_oflag = 0;
+  term.c_lflag = 0;
+  term.c_cc[VTIME] = 0;
+  term.c_cc[VMIN] = 1;
+  term.c_cc[VSTART] = 0x11;
+  term.c_cc[VSTOP] = 0x13;
+  tcflush(fd, TCIFLUSH);
+  tcsetattr(fd, TCSANOW, &term);
+#endif
+
+  return true;
+}
+
+void Port::close()
+{
+#ifdef WIN32
+  if(hserial != INVALID_HANDLE_VALUE)
+    CloseHandle(hserial);
+
+  hserial = INVALID_HANDLE_VALUE;
+#else
+  if(fd != -1)
+    ::close(fd);
+
+  fd = -1;
+#endif
+}
+
+bool Port::isOpen()
+{
+#ifdef WIN32
+  return hserial != INVALID_HANDLE_VALUE;
+#else
+  return fd != -1;
+#endif
+}
+
+// xon/xoff is on after open, binary transfers need it off
+void Port::setFlowControl(bool on)
+{
+#ifndef WIN32
+  struct termios term;
+
+  if(tcgetattr(fd, &term) != 0)
+    return;
+
+  if(on == true)
+    term.c_iflag |= IXOFF | IXON | IXANY;
+  else
+    term.c_iflag &= ~(IXOFF | IXON | IXANY);
+
+  tcsetattr(fd, TCSANOW, &term);
+#endif
+}
+
+// block until there is something to read or ms have passed
+bool Port::wait(int ms)
+{
+#ifdef WIN32
+  // reads return at once, so just pace the caller
+  Sleep(ms < 4 ? ms : 4);
+  return true;
+#else
+  struct pollfd p;
+
+  p.fd = fd;
+  p.events = POLLIN;
+  p.revents = 0;
+
+  return ::poll(&p, 1, ms) > 0;
+#endif
+}
+
+// returns the bytes read, 0 if nothing is waiting
+int Port::read(void *data, int count)
+{
+#ifdef WIN32
+  DWORD bytes = 0;
+
+  if(ReadFile(hserial, data, count, &bytes, NULL) == 0)
+    return 0;
+
+  return bytes;
+#else
+  const int bytes = ::read(fd, data, count);
+
+  return bytes > 0 ? bytes : 0;
+#endif
+}
+
+// returns the bytes written, 0 if the port would block
+int Port::write(const void *data, int count)
+{
+#ifdef WIN32
+  DWORD bytes = 0;
+
+  if(WriteFile(hserial, data, count, &bytes, NULL) == 0)
+    return 0;
+
+  return bytes;
+#else
+  const int bytes = ::write(fd, data, count);
+
+  return bytes > 0 ? bytes : 0;
+#endif
+}
+
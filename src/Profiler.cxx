@@ -0,0 +1,344 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Dialog.H"
+#include "Emulator.H"
+#include "Gui.H"
+#include "Harness.H"
+#include "Listing.H"
+#include "Profiler.H"
+#include "Terminal.H"
+
+namespace
+{
+  // ring buffer entries, 4 bytes each: PCL, PCH, PB, 0
+  const int SAMPLES = 1024;
+
+  // layout of the uploaded block
+  const int INDEX = 0;
+  const int COUNT = 2;
+  const int CODE = 4;
+  const int BUFFER = 0x100;
+
+  // timer registers
+  const int TER = 0xDF43;
+  const int TIFR = 0xDF44;
+  const int TIER = 0xDF46;
+  const int T2LL = 0xDF54;
+  const int T2LH = 0xDF55;
+
+  // timer 2 counts FCLK / 16
+  const int T2_CLOCK = Emulator::FCLK / 16;
+
+  // lines shown in each table
+  const int TOP = 16;
+
+  struct Entry
+  {
+    std::string name;
+    int count;
+  };
+
+  bool compareEntry(const Entry &a, const Entry &b)
+  {
+    return a.count > b.count;
+  }
+
+  // interrupt handler, it may land with any register widths
+  // and only uses long addressing so the data bank is irrelevant
+  int emitHandler(Harness::Code &code, int base)
+  {
+    const int start = code.here();
+
+    code.op8(0xC2, 0x30);                   // rep #$30
+    code.op(0x48);                          // pha
+    code.op(0xDA);                          // phx
+    code.op24(0xAF, base + INDEX);          // lda >INDEX
+    code.op(0xAA);                          // tax
+    code.op8(0xA3, 0x06);                   // lda 6,s (PCL, PCH)
+    code.op24(0x9F, base + BUFFER);         // sta >BUFFER,x
+    code.op8(0xA3, 0x08);                   // lda 8,s (PB)
+    code.op16(0x29, 0x00FF);                // and #$00FF
+    code.op24(0x9F, base + BUFFER + 2);     // sta >BUFFER+2,x
+    code.op(0x8A);                          // txa
+    code.op(0x18);                          // clc
+    code.op16(0x69, 4);                     // adc #4
+    code.op16(0x29, SAMPLES * 4 - 1);       // and #MASK
+    code.op24(0x8F, base + INDEX);          // sta >INDEX
+    code.op24(0xAF, base + COUNT);          // lda >COUNT
+    code.op(0x1A);                          // inc
+    code.op(0xF0);                          // beq, keep it saturated
+    code.op(0x04);
+    code.op24(0x8F, base + COUNT);          // sta >COUNT
+    code.op8(0xE2, 0x20);                   // sep #$20
+    code.op8(0xA9, 0x04);                   // lda #$04
+    code.op24(0x8F, TIFR);                  // sta >TIFR
+    code.op8(0xC2, 0x20);                   // rep #$20
+    code.op(0xFA);                          // plx
+    code.op(0x68);                          // pla
+    code.op(0x40);                          // rti
+
+    return start;
+  }
+
+  // called with JSL, loads the period and enables the interrupt
+  int emitStart(Harness::Code &code, int base, int latch)
+  {
+    const int start = code.here();
+
+    code.op(0x08);                          // php
+    code.op8(0xC2, 0x20);                   // rep #$20
+    code.op16(0xA9, 0);                     // lda #0
+    code.op24(0x8F, base + INDEX);          // sta >INDEX
+    code.op24(0x8F, base + COUNT);          // sta >COUNT
+    code.op8(0xE2, 0x20);                   // sep #$20
+    code.op8(0xA9, latch & 0xFF);           // lda #<latch
+    code.op24(0x8F, T2LL);                  // sta >T2LL
+    code.op8(0xA9, latch >> 8);             // lda #>latch
+    code.op24(0x8F, T2LH);                  // sta >T2LH
+    code.op8(0xA9, 0x04);                   // lda #$04
+    code.op24(0x8F, TIFR);                  // sta >TIFR
+    code.op24(0xAF, TIER);                  // lda >TIER
+    code.op8(0x09, 0x04);                   // ora #$04
+    code.op24(0x8F, TIER);                  // sta >TIER
+    code.op24(0xAF, TER);                   // lda >TER
+    code.op8(0x09, 0x04);                   // ora #$04
+    code.op24(0x8F, TER);                   // sta >TER
+    code.op(0x28);                          // plp
+    code.op(0x6B);                          // rtl
+
+    return start;
+  }
+
+  int emitStop(Harness::Code &code)
+  {
+    const int start = code.here();
+
+    code.op(0x08);                          // php
+    code.op8(0xE2, 0x20);                   // sep #$20
+    code.op24(0xAF, TER);                   // lda >TER
+    code.op8(0x29, 0xFB);                   // and #$FB
+    code.op24(0x8F, TER);                   // sta >TER
+    code.op24(0xAF, TIER);                  // lda >TIER
+    code.op8(0x29, 0xFB);                   // and #$FB
+    code.op24(0x8F, TIER);                  // sta >TIER
+    code.op(0x28);                          // plp
+    code.op(0x6B);                          // rtl
+
+    return start;
+  }
+
+  void printTable(const char *title, std::vector<Entry> &entries, int total)
+  {
+    char s[256];
+
+    std::sort(entries.begin(), entries.end(), compareEntry);
+
+    sprintf(s, "\n%s\n", title);
+    Gui::append(s);
+
+    for(int i = 0; i < (int)entries.size() && i < TOP; i++)
+    {
+      const int percent = entries[i].count * 100 / total;
+      char bar[64];
+      const int width = entries[i].count * 40 / entries[0].count;
+
+      memset(bar, '#', width);
+      bar[width] = '\0';
+
+      sprintf(s, "%6d %3d%%  %-24.24s %s\n",
+              entries[i].count, percent, entries[i].name.c_str(), bar);
+      Gui::append(s);
+    }
+  }
+}
+
+// profile a JSL to address, sampling rate times a second for at most
+// seconds, with the code and ring buffer at base and the handler
+// reached through a JML written at vector
+bool Profiler::run(int address, int rate, int seconds, int vector, int base,
+                   const char *listing_name)
+{
+  Terminal::Hold hold;
+
+  if(Terminal::isConnected() == false)
+  {
+    Dialog::message("Error", "Not Connected.");
+    return false;
+  }
+
+  if(rate < T2_CLOCK / 65536 + 1 || rate > 10000)
+  {
+    Dialog::message("Error", "Sample rate must be between 4 and 10000 Hz.");
+    return false;
+  }
+
+  Harness::Code code;
+
+  code.base = base;
+  code.bytes.resize(CODE, 0);
+
+  const int handler = emitHandler(code, base);
+  const int start = emitStart(code, base, T2_CLOCK / rate - 1);
+  const int stop = emitStop(code);
+
+  if(code.here() > base + BUFFER)
+  {
+    Dialog::message("Error", "Profiler code does not fit.");
+    return false;
+  }
+
+  unsigned char jml[4];
+
+  jml[0] = 0x5C;
+  jml[1] = handler & 0xFF;
+  jml[2] = (handler >> 8) & 0xFF;
+  jml[3] = (handler >> 16) & 0xFF;
+
+  Gui::append("\nInstalling profiler.\n");
+
+  if(Harness::install(code) == false ||
+     Terminal::uploadData(vector, jml, sizeof(jml)) == false)
+  {
+    return false;
+  }
+
+  Terminal::jsl(start);
+  Harness::wait(0.5);
+
+  Gui::append("\nProfiling, ESC to stop waiting.\n");
+
+  if(Harness::call(address, seconds) == false)
+  {
+    // in case the monitor answers after all, otherwise the timer
+    // keeps interrupting into the handler until a reset
+    Terminal::jsl(stop);
+    Dialog::message("Error", "The program did not return to the monitor. "
+                    "Reset the board to stop the sample timer.");
+    return false;
+  }
+
+  Terminal::jsl(stop);
+  Harness::wait(0.5);
+
+  unsigned char header[4];
+
+  if(Terminal::readMemory(base, header, sizeof(header)) != sizeof(header))
+  {
+    Dialog::message("Error", "Could not read the sample buffer.");
+    return false;
+  }
+
+  const int count = header[COUNT] | (header[COUNT + 1] << 8);
+  const int used = std::min(count, SAMPLES);
+  char s[256];
+
+  if(used == 0)
+  {
+    Gui::append("No samples, interrupts may be disabled.\n");
+    return true;
+  }
+
+  // one read for the whole filled part of the ring
+  std::vector<unsigned char> samples(used * 4);
+
+  if(Terminal::readMemory(base + BUFFER, &samples[0], used * 4) != used * 4)
+  {
+    Dialog::message("Error", "Could not read the sample buffer.");
+    return false;
+  }
+
+  Listing listing;
+  const bool symbols = listing_name != NULL && listing_name[0] != '\0' &&
+                       listing.load(listing_name);
+
+  std::map<int, int> by_address;
+  std::map<std::string, int> by_symbol;
+
+  for(int i = 0; i < used; i++)
+  {
+    const int pc = samples[i * 4] | (samples[i * 4 + 1] << 8) |
+                   (samples[i * 4 + 2] << 16);
+
+    by_address[pc]++;
+
+    const Listing::Symbol *sym = symbols ? listing.symbolize(pc, 0) : 0;
+
+    if(sym != NULL)
+      by_symbol[sym->name]++;
+    else if(pc >= 0xE000 && pc <= 0xFFFF)
+      by_symbol["(monitor)"]++;
+    else
+      by_symbol["(unknown)"]++;
+  }
+
+  std::vector<Entry> entries;
+
+  for(std::map<std::string, int>::iterator i = by_symbol.begin();
+      i != by_symbol.end(); ++i)
+  {
+    Entry entry;
+
+    entry.name = i->first;
+    entry.count = i->second;
+    entries.push_back(entry);
+  }
+
+  sprintf(s, "\n%d samples at %d Hz%s.\n", used, rate,
+          count > SAMPLES ? " (oldest samples overwritten)" : "");
+  Gui::append(s);
+  printTable("By symbol:", entries, used);
+
+  entries.clear();
+
+  for(std::map<int, int>::iterator i = by_address.begin();
+      i != by_address.end(); ++i)
+  {
+    Entry entry;
+    int offset = 0;
+    const Listing::Symbol *sym = symbols ? listing.symbolize(i->first, &offset) : 0;
+
+    if(sym != NULL && offset != 0)
+      sprintf(s, "%02X:%04X %s+%d", i->first >> 16, i->first & 0xFFFF,
+              sym->name.c_str(), offset);
+    else if(sym != NULL)
+      sprintf(s, "%02X:%04X %s", i->first >> 16, i->first & 0xFFFF,
+              sym->name.c_str());
+    else
+      sprintf(s, "%02X:%04X", i->first >> 16, i->first & 0xFFFF);
+
+    entry.name = s;
+    entry.count = i->second;
+    entries.push_back(entry);
+  }
+
+  printTable("By address:", entries, used);
+
+  return true;
+}
+
@@ -0,0 +1,56 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include "Queue.H"
+
+Queue::Queue()
+{
+  busy = false;
+}
+
+void Queue::post(const Job &job)
+{
+  jobs.push_back(job);
+}
+
+void Queue::run()
+{
+  if(busy == true)
+    return;
+
+  busy = true;
+
+  while(jobs.size() > 0)
+  {
+    Job job = jobs.front();
+
+    jobs.pop_front();
+    job();
+  }
+
+  busy = false;
+}
+
+int Queue::pending()
+{
+  return jobs.size();
+}
+
@@ -0,0 +1,431 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+#include "Dialog.H"
+#include "Emulator.H"
+#include "Gui.H"
+#include "Harness.H"
+#include "RamTest.H"
+#include "Terminal.H"
+
+namespace
+{
+  // tester variables and results at the start of the buffer
+  const int NFAIL = 0x00;
+  const int MASK = 0x02;
+  const int PAT = 0x03;
+  const int TMP = 0x04;
+  const int SAVE = 0x06;
+  const int TIMES = 0x10;
+  const int FAILS = 0x40;
+  const int CODE = 0x140;
+
+  // failures kept, each is address (2), bit mask and test
+  const int MAX_FAILS = 64;
+
+  // largest block copied by the speed tests
+  const int MAX_BLOCK = 4096;
+
+  enum
+  {
+    TEST_WALK = 1,
+    TEST_ADDRESS = 2
+  };
+
+  enum
+  {
+    COPY_MVN,
+    COPY_MVP,
+    COPY_LONG8,
+    COPY_LONG16,
+    COPY_ABS16,
+    COPY_METHODS
+  };
+
+  const char *methods[] =
+  {
+    "MVN",
+    "MVP",
+    "LDA/STA long,X 8-bit",
+    "LDA/STA long,X 16-bit",
+    "LDA/STA abs,X 16-bit"
+  };
+
+  // timer registers
+  const int TCR = 0xDF42;
+  const int TER = 0xDF43;
+  const int TIFR = 0xDF44;
+  const int T2LL = 0xDF54;
+  const int T2CL = 0xDF64;
+  const int T2CH = 0xDF65;
+
+  const int T2_PRESCALE = 16;
+
+  // restart timer 2 from $FFFF, 8-bit accumulator
+  void startTimer(Harness::Code &c)
+  {
+    c.op8(0xA9, 0xFF);                      // lda #$FF
+    c.op24(0x8F, T2LL);                     // sta >T2LL
+    c.op24(0x8F, T2CH);                     // sta >T2CH
+    c.op8(0xA9, 0x04);                      // lda #$04
+    c.op24(0x8F, TIFR);                     // sta >TIFR
+  }
+
+  // store the count and underflow flag for one copy method
+  void stopTimer(Harness::Code &c, int base, int method)
+  {
+    c.op8(0xC2, 0x20);                      // rep #$20
+    c.op24(0xAF, T2CL);                     // lda >T2CL
+    c.op24(0x8F, base + TIMES + method * 4); // sta >TIMES+n
+    c.op8(0xE2, 0x20);                      // sep #$20
+    c.op24(0xAF, TIFR);                     // lda >TIFR
+    c.op8(0x29, 0x04);                      // and #$04
+    c.op24(0x8F, base + TIMES + method * 4 + 2); // sta >TIMES+n+2
+  }
+
+  // called with JSL; 8-bit accumulator and 16-bit index registers
+  // throughout, each byte of the range is reached as bank|X
+  void emit(Harness::Code &c, int base, int start, int end, int block)
+  {
+    const int bank = start & 0xFF0000;
+    const int first = start & 0xFFFF;
+    const int stop = (end + 1) & 0xFFFF;
+    const int src = first;
+    const int dst = first + block;
+
+    c.op(0x08);                             // php
+    c.op(0x78);                             // sei
+    c.op(0x8B);                             // phb
+    c.op8(0xE2, 0x20);                      // sep #$20
+    c.op8(0xC2, 0x10);                      // rep #$10
+    c.op24(0xAF, TCR);                      // lda >TCR
+    c.op24(0x8F, base + SAVE);              // sta >SAVE
+    c.op24(0xAF, TER);                      // lda >TER
+    c.op24(0x8F, base + SAVE + 1);          // sta >SAVE+1
+    c.op8(0xA9, 0x18);                      // lda #$18
+    c.op24(0x8F, TCR);                      // sta >TCR
+    c.op24(0xAF, TER);                      // lda >TER
+    c.op8(0x09, 0x04);                      // ora #$04
+    c.op24(0x8F, TER);                      // sta >TER
+    c.op8(0xA9, 0);                         // lda #0
+    c.op24(0x8F, base + NFAIL);             // sta >NFAIL
+    c.op24(0x8F, base + NFAIL + 1);         // sta >NFAIL+1
+
+    // walking ones, each bit of each byte on its own
+    c.op16(0xA2, first);                    // ldx #first
+    c.label("walk");
+    c.op8(0xA9, 0);                         // lda #0
+    c.op24(0x8F, base + MASK);              // sta >MASK
+    c.op8(0xA9, 1);                         // lda #1
+    c.op24(0x8F, base + PAT);               // sta >PAT
+    c.label("bit");
+    c.op24(0x9F, bank);                     // sta >BANK,x
+    c.op24(0xBF, bank);                     // lda >BANK,x
+    c.op24(0x4F, base + PAT);               // eor >PAT
+    c.op24(0x0F, base + MASK);              // ora >MASK
+    c.op24(0x8F, base + MASK);              // sta >MASK
+    c.op24(0xAF, base + PAT);               // lda >PAT
+    c.op(0x0A);                             // asl
+    c.op24(0x8F, base + PAT);               // sta >PAT
+    c.branch(0xD0, "bit");                  // bne bit
+    c.op24(0xAF, base + MASK);              // lda >MASK
+    c.branch(0xF0, "walked");               // beq walked
+    c.op8(0xA9, TEST_WALK);                 // lda #TEST_WALK
+    c.op16(0x20, c.at("fail"));             // jsr fail
+    c.label("walked");
+    c.op(0xE8);                             // inx
+    c.op16(0xE0, stop);                     // cpx #stop
+    c.branch(0xD0, "walk");                 // bne walk
+
+    // address in address, catches shorted or open address lines
+    c.op16(0xA2, first);                    // ldx #first
+    c.label("fill");
+    c.op16(0x20, c.at("pattern"));          // jsr pattern
+    c.op24(0x9F, bank);                     // sta >BANK,x
+    c.op(0xE8);                             // inx
+    c.op16(0xE0, stop);                     // cpx #stop
+    c.branch(0xD0, "fill");                 // bne fill
+    c.op16(0xA2, first);                    // ldx #first
+    c.label("check");
+    c.op16(0x20, c.at("pattern"));          // jsr pattern
+    c.op24(0x5F, bank);                     // eor >BANK,x
+    c.branch(0xF0, "checked");              // beq checked
+    c.op24(0x8F, base + MASK);              // sta >MASK
+    c.op8(0xA9, TEST_ADDRESS);              // lda #TEST_ADDRESS
+    c.op16(0x20, c.at("fail"));             // jsr fail
+    c.label("checked");
+    c.op(0xE8);                             // inx
+    c.op16(0xE0, stop);                     // cpx #stop
+    c.branch(0xD0, "check");                // bne check
+
+    // block copies, the first half of the block to the second
+    startTimer(c);
+    c.op8(0xC2, 0x30);                      // rep #$30
+    c.op16(0xA9, block - 1);                // lda #block-1
+    c.op16(0xA2, src);                      // ldx #src
+    c.op16(0xA0, dst);                      // ldy #dst
+    c.op8(0x54, bank >> 16);                // mvn bank,bank
+    c.op(bank >> 16);
+    c.op8(0xE2, 0x20);                      // sep #$20
+    stopTimer(c, base, COPY_MVN);
+
+    startTimer(c);
+    c.op8(0xC2, 0x30);                      // rep #$30
+    c.op16(0xA9, block - 1);                // lda #block-1
+    c.op16(0xA2, src + block - 1);          // ldx #src+block-1
+    c.op16(0xA0, dst + block - 1);          // ldy #dst+block-1
+    c.op8(0x44, bank >> 16);                // mvp bank,bank
+    c.op(bank >> 16);
+    c.op8(0xE2, 0x20);                      // sep #$20
+    stopTimer(c, base, COPY_MVP);
+
+    startTimer(c);
+    c.op16(0xA2, 0);                        // ldx #0
+    c.label("long8");
+    c.op24(0xBF, bank | src);               // lda >SRC,x
+    c.op24(0x9F, bank | dst);               // sta >DST,x
+    c.op(0xE8);                             // inx
+    c.op16(0xE0, block);                    // cpx #block
+    c.branch(0xD0, "long8");                // bne long8
+    stopTimer(c, base, COPY_LONG8);
+
+    startTimer(c);
+    c.op8(0xC2, 0x20);                      // rep #$20
+    c.op16(0xA2, 0);                        // ldx #0
+    c.label("long16");
+    c.op24(0xBF, bank | src);               // lda >SRC,x
+    c.op24(0x9F, bank | dst);               // sta >DST,x
+    c.op(0xE8);                             // inx
+    c.op(0xE8);                             // inx
+    c.op16(0xE0, block);                    // cpx #block
+    c.branch(0xD0, "long16");               // bne long16
+    c.op8(0xE2, 0x20);                      // sep #$20
+    stopTimer(c, base, COPY_LONG16);
+
+    c.op8(0xA9, bank >> 16);                // lda #bank
+    c.op(0x48);                             // pha
+    c.op(0xAB);                             // plb
+    startTimer(c);
+    c.op8(0xC2, 0x20);                      // rep #$20
+    c.op16(0xA2, 0);                        // ldx #0
+    c.label("abs16");
+    c.op16(0xBD, src);                      // lda SRC,x
+    c.op16(0x9D, dst);                      // sta DST,x
+    c.op(0xE8);                             // inx
+    c.op(0xE8);                             // inx
+    c.op16(0xE0, block);                    // cpx #block
+    c.branch(0xD0, "abs16");                // bne abs16
+    c.op8(0xE2, 0x20);                      // sep #$20
+    stopTimer(c, base, COPY_ABS16);
+
+    c.op24(0xAF, base + SAVE);              // lda >SAVE
+    c.op24(0x8F, TCR);                      // sta >TCR
+    c.op24(0xAF, base + SAVE + 1);          // lda >SAVE+1
+    c.op24(0x8F, TER);                      // sta >TER
+    c.op(0xAB);                             // plb
+    c.op(0x28);                             // plp
+    c.op(0x6B);                             // rtl
+
+    // expected byte for address X: low ^ high ^ bank
+    c.label("pattern");
+    c.op8(0xC2, 0x20);                      // rep #$20
+    c.op(0x8A);                             // txa
+    c.op8(0xE2, 0x20);                      // sep #$20
+    c.op24(0x8F, base + TMP);               // sta >TMP
+    c.op(0xEB);                             // xba
+    c.op24(0x4F, base + TMP);               // eor >TMP
+    c.op8(0x49, bank >> 16);                // eor #bank
+    c.op(0x60);                             // rts
+
+    // record test A at address X with the bits in MASK
+    c.label("fail");
+    c.op24(0x8F, base + TMP);               // sta >TMP
+    c.op(0xDA);                             // phx
+    c.op8(0xC2, 0x20);                      // rep #$20
+    c.op24(0xAF, base + NFAIL);             // lda >NFAIL
+    c.op16(0xC9, MAX_FAILS);                // cmp #MAX_FAILS
+    c.branch(0xB0, "full");                 // bcs full
+    c.op(0x0A);                             // asl
+    c.op(0x0A);                             // asl
+    c.op(0xAA);                             // tax
+    c.op8(0xA3, 0x01);                      // lda 1,s
+    c.op24(0x9F, base + FAILS);             // sta >FAILS,x
+    c.op8(0xE2, 0x20);                      // sep #$20
+    c.op24(0xAF, base + MASK);              // lda >MASK
+    c.op24(0x9F, base + FAILS + 2);         // sta >FAILS+2,x
+    c.op24(0xAF, base + TMP);               // lda >TMP
+    c.op24(0x9F, base + FAILS + 3);         // sta >FAILS+3,x
+    c.op8(0xC2, 0x20);                      // rep #$20
+    c.label("full");
+    c.op24(0xAF, base + NFAIL);             // lda >NFAIL
+    c.op(0x1A);                             // inc
+    c.op24(0x8F, base + NFAIL);             // sta >NFAIL
+    c.op8(0xE2, 0x20);                      // sep #$20
+    c.op(0xFA);                             // plx
+    c.op(0x60);                             // rts
+  }
+
+  void build(Harness::Code &code, int base, int start, int end, int block)
+  {
+    for(int pass = 0; pass < 2; pass++)
+    {
+      code.bytes.assign(CODE, 0);
+      code.base = base;
+      emit(code, base, start, end, block);
+    }
+  }
+
+  std::string report(const unsigned char *data, int start, int block)
+  {
+    std::string text;
+    char s[256];
+    const int bank = start & 0xFF0000;
+    const int count = data[NFAIL] | (data[NFAIL + 1] << 8);
+
+    if(count == 0)
+    {
+      text += "No failures.\n";
+    }
+    else
+    {
+      snprintf(s, sizeof(s), "%d failure%s, bits that differ:\n", count,
+               count == 1 ? "" : "s");
+      text += s;
+    }
+
+    for(int i = 0; i < count && i < MAX_FAILS; i++)
+    {
+      const unsigned char *p = data + FAILS + i * 4;
+
+      snprintf(s, sizeof(s), "  %02X:%04X  %02X  %s\n", bank >> 16,
+               p[0] | (p[1] << 8), p[2],
+               p[3] == TEST_WALK ? "walking ones" : "address in address");
+      text += s;
+    }
+
+    if(count > MAX_FAILS)
+      text += "  ...\n";
+
+    snprintf(s, sizeof(s), "\nCopying %d bytes:\n", block);
+    text += s;
+
+    for(int i = 0; i < COPY_METHODS; i++)
+    {
+      const unsigned char *p = data + TIMES + i * 4;
+      const int ticks = 0xFFFF - (p[0] | (p[1] << 8));
+      const double cycles = (double)ticks * T2_PRESCALE;
+
+      if(p[2] != 0 || ticks == 0)
+      {
+        snprintf(s, sizeof(s), "  %-24s timer overflow\n", methods[i]);
+      }
+      else
+      {
+        snprintf(s, sizeof(s), "  %-24s %8.0f bytes/s  %5.2f cycles/byte\n",
+                 methods[i], block * Emulator::FCLK / cycles,
+                 cycles / block);
+      }
+
+      text += s;
+    }
+
+    return text;
+  }
+}
+
+// test a range of RAM (destroying it) from code placed at base
+bool RamTest::run(int start, int end, int base)
+{
+  Terminal::Hold hold;
+
+  if(Terminal::isConnected() == false)
+  {
+    Dialog::message("Error", "Not Connected.");
+    return false;
+  }
+
+  if(Gui::getMode() != Gui::MODE_265)
+  {
+    Dialog::message("Error", "The RAM test uses the W65C265 timers.");
+    return false;
+  }
+
+  if(end <= start || (start & 0xFF0000) != (end & 0xFF0000) ||
+     end - start + 1 < 4)
+  {
+    Dialog::message("Error", "The range must be within one bank.");
+    return false;
+  }
+
+  Harness::Code code;
+  const int block = std::min(MAX_BLOCK, (end - start + 1) / 2) & ~1;
+
+  build(code, base, start, end, block);
+
+  if(base + (int)code.bytes.size() > start && base <= end)
+  {
+    Dialog::message("Error", "The tester overlaps the range.");
+    return false;
+  }
+
+  Gui::append("\nInstalling RAM tester.\n");
+
+  if(Harness::install(code) == false)
+    return false;
+
+  Gui::append("Testing, ESC to stop waiting.\n");
+
+  // about 200 cycles per byte tested
+  const int seconds = 5 + (int)((long long)(end - start + 1) * 200 /
+                                Emulator::FCLK);
+
+  if(Harness::call(base + CODE, seconds) == false)
+  {
+    Dialog::message("Error", "The tester did not return to the monitor.");
+    return false;
+  }
+
+  // only as much of the failure table as was used
+  unsigned char data[CODE];
+  unsigned char header[2];
+
+  if(Terminal::readMemory(base, header, 2) != 2)
+  {
+    Dialog::message("Error", "Could not read the results.");
+    return false;
+  }
+
+  const int used = std::min(header[0] | (header[1] << 8), MAX_FAILS);
+
+  if(Terminal::readMemory(base, data, FAILS + used * 4) != FAILS + used * 4)
+  {
+    Dialog::message("Error", "Could not read the results.");
+    return false;
+  }
+
+  Gui::append(report(data, start, block).c_str());
+  return true;
+}
+
@@ -0,0 +1,520 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Audio.H"
+#include "Coverage.H"
+#include "Emulator.H"
+#include "Listing.H"
+#include "Regress.H"
+#include "Trace.H"
+
+namespace
+{
+  struct Test
+  {
+    char image[1024];
+    char golden[1024];
+    int start;
+    long long cycles;
+    std::vector<unsigned char> input;
+    Coverage *coverage;
+
+    std::string output;
+    bool passed;
+    char message[512];
+    double ms;
+  };
+
+  const char *stop_names[] =
+  {
+    "end",
+    "brk",
+    "cop",
+    "stp",
+    "wai",
+    "return",
+    "monitor"
+  };
+
+  // sample rate of rendered tone generator audio
+  const int AUDIO_RATE = 44100;
+
+  // replace the file extension
+  void changeExtension(char *dest, const char *src, const char *ext)
+  {
+    strcpy(dest, src);
+
+    char *dot = strrchr(dest, '.');
+    char *slash = strrchr(dest, '/');
+
+    if(dot != NULL && (slash == NULL || dot > slash))
+      *dot = '\0';
+
+    strcat(dest, ext);
+  }
+
+  // each line: image start-address cycle-budget [input bytes...]
+  bool parseManifest(const char *filename, std::vector<Test> &tests)
+  {
+    char dir[1024];
+    char line[4096];
+
+    FILE *fp = fopen(filename, "r");
+
+    if(fp == NULL)
+      return false;
+
+    strcpy(dir, filename);
+
+    char *slash = strrchr(dir, '/');
+
+    if(slash != NULL)
+      slash[1] = '\0';
+    else
+      dir[0] = '\0';
+
+    while(fgets(line, sizeof(line), fp))
+    {
+      char *token = strtok(line, " \t\r\n");
+
+      if(token == NULL || token[0] == '#')
+        continue;
+
+      Test test;
+
+      snprintf(test.image, sizeof(test.image), "%s%s", dir, token);
+      changeExtension(test.golden, test.image, ".golden");
+
+      token = strtok(NULL, " \t\r\n");
+      test.start = token ? (int)strtol(token, NULL, 16) : 0x1000;
+
+      token = strtok(NULL, " \t\r\n");
+      test.cycles = token ? atoll(token) : 1000000;
+
+      while((token = strtok(NULL, " \t\r\n")) != NULL)
+        test.input.push_back((unsigned char)strtol(token, NULL, 16));
+
+      test.coverage = NULL;
+      test.passed = false;
+      test.message[0] = '\0';
+      test.ms = 0;
+      tests.push_back(test);
+    }
+
+    fclose(fp);
+    return true;
+  }
+
+  // everything the program did, one event per line
+  void report(Emulator &emu, std::string &output)
+  {
+    char s[256];
+
+    for(size_t i = 0; i < emu.events.size(); i++)
+    {
+      const Emulator::Event &ev = emu.events[i];
+
+      switch(ev.type)
+      {
+        case Emulator::EVENT_UART:
+          snprintf(s, sizeof(s), "%010lld uart %02X\n", ev.cycle, ev.value);
+          break;
+        case Emulator::EVENT_PORT:
+          snprintf(s, sizeof(s), "%010lld port %04X %02X\n",
+                   ev.cycle, ev.address, ev.value);
+          break;
+        case Emulator::EVENT_TONE:
+          snprintf(s, sizeof(s), "%010lld tone %d %04X\n",
+                   ev.cycle, ev.address, ev.value);
+          break;
+      }
+
+      output += s;
+    }
+
+    if(emu.overflow == true)
+      output += "overflow\n";
+
+    snprintf(s, sizeof(s), "%010lld %s %02X:%04X\n", emu.cycles,
+             stop_names[emu.stop_reason], emu.pb, emu.pc);
+    output += s;
+  }
+
+  bool readFile(const char *filename, std::string &text)
+  {
+    char buf[4096];
+    size_t bytes;
+
+    FILE *fp = fopen(filename, "rb");
+
+    if(fp == NULL)
+      return false;
+
+    while((bytes = fread(buf, 1, sizeof(buf), fp)) > 0)
+      text.append(buf, bytes);
+
+    fclose(fp);
+    return true;
+  }
+
+  bool writeFile(const char *filename, const std::string &text)
+  {
+    FILE *fp = fopen(filename, "wb");
+
+    if(fp == NULL)
+      return false;
+
+    fwrite(text.data(), 1, text.size(), fp);
+    fclose(fp);
+    return true;
+  }
+
+  // describe the first line that differs
+  void difference(Test &test, const std::string &expected)
+  {
+    size_t pos = 0;
+    int line = 1;
+
+    while(pos < expected.size() && pos < test.output.size() &&
+          expected[pos] == test.output[pos])
+    {
+      if(expected[pos] == '\n')
+        line++;
+
+      pos++;
+    }
+
+    size_t start = pos;
+
+    while(start > 0 && expected[start - 1] != '\n')
+      start--;
+
+    std::string want = expected.substr(start,
+                         expected.find('\n', start) - start);
+    std::string got = test.output.substr(start,
+                         test.output.find('\n', start) - start);
+
+    snprintf(test.message, sizeof(test.message),
+             "line %d: expected \"%s\", got \"%s\"",
+             line, want.c_str(), got.c_str());
+  }
+
+  // rendered audio against the blessed reference, with a couple of
+  // counts of slack for floating point differences between hosts
+  bool compareAudio(Test &test, const std::string &rendered,
+                    const std::string &expected)
+  {
+    const size_t header = 44;
+
+    if(rendered.size() != expected.size() || rendered.size() < header ||
+       rendered.compare(0, header, expected, 0, header) != 0)
+    {
+      snprintf(test.message, sizeof(test.message),
+               "audio length or format differs from the golden render");
+      return false;
+    }
+
+    for(size_t i = header; i + 1 < rendered.size(); i += 2)
+    {
+      const int a = (short)((unsigned char)rendered[i] |
+                            (unsigned char)rendered[i + 1] << 8);
+      const int b = (short)((unsigned char)expected[i] |
+                            (unsigned char)expected[i + 1] << 8);
+
+      if(abs(a - b) > 2)
+      {
+        snprintf(test.message, sizeof(test.message),
+                 "audio differs from the golden render at sample %d",
+                 (int)((i - header) / 2));
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  void runTest(Test &test, bool bless, bool trace, bool audio)
+  {
+    std::chrono::steady_clock::time_point begin =
+      std::chrono::steady_clock::now();
+
+    Emulator *emu = new Emulator();
+
+    emu->coverage = test.coverage;
+
+    TraceWriter *writer = NULL;
+
+    if(trace == true)
+    {
+      char name[1024];
+
+      changeExtension(name, test.image, ".trace");
+      writer = new TraceWriter();
+
+      if(writer->open(name) == true)
+        emu->trace = writer;
+    }
+
+    if(emu->upload(test.image) == false)
+    {
+      snprintf(test.message, sizeof(test.message), "could not load image");
+      delete writer;
+      delete emu;
+      return;
+    }
+
+    if(test.input.size() > 0)
+      emu->input(&test.input[0], test.input.size());
+
+    emu->jml(test.start);
+    emu->run(test.cycles);
+    report(*emu, test.output);
+
+    char wav[1024];
+    char reference[1024];
+    bool tones = false;
+
+    if(audio == true)
+    {
+      changeExtension(wav, test.image, ".wav");
+      changeExtension(reference, test.image, ".golden.wav");
+      Audio::render(emu->events, emu->cycles, wav, AUDIO_RATE);
+
+      for(size_t i = 0; i < emu->events.size(); i++)
+        if(emu->events[i].type == Emulator::EVENT_TONE)
+          tones = true;
+    }
+
+    delete writer;
+    delete emu;
+
+    test.ms = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - begin).count();
+
+    if(bless == true)
+    {
+      test.passed = writeFile(test.golden, test.output);
+
+      if(test.passed == false)
+        snprintf(test.message, sizeof(test.message),
+                 "could not write golden file");
+
+      // only tests that play something get a reference render
+      if(test.passed == true && tones == true)
+      {
+        std::string rendered;
+
+        test.passed = readFile(wav, rendered) == true &&
+                      writeFile(reference, rendered) == true;
+
+        if(test.passed == false)
+          snprintf(test.message, sizeof(test.message),
+                   "could not write golden audio");
+      }
+
+      return;
+    }
+
+    std::string expected;
+
+    if(readFile(test.golden, expected) == false)
+    {
+      snprintf(test.message, sizeof(test.message),
+               "no golden file (run with --bless)");
+      return;
+    }
+
+    test.passed = (expected == test.output);
+
+    // keep the actual output around for inspection
+    if(test.passed == false)
+    {
+      char actual[1024];
+
+      difference(test, expected);
+      changeExtension(actual, test.image, ".actual");
+      writeFile(actual, test.output);
+      return;
+    }
+
+    // the render must match too where a reference was blessed
+    std::string expected_audio;
+
+    if(audio == true && readFile(reference, expected_audio) == true)
+    {
+      std::string rendered;
+
+      readFile(wav, rendered);
+      test.passed = compareAudio(test, rendered, expected_audio);
+    }
+  }
+
+  // annotated listing next to each image plus one lcov tracefile
+  void writeCoverage(std::vector<Test> &tests, const char *filename)
+  {
+    FILE *fp = fopen(filename, "w");
+
+    if(fp == NULL)
+    {
+      printf("Could not write coverage file \"%s\".\n", filename);
+      return;
+    }
+
+    for(size_t i = 0; i < tests.size(); i++)
+    {
+      Test &test = tests[i];
+
+      if(test.coverage == NULL)
+        continue;
+
+      // several runs of one image share a report
+      for(size_t j = i + 1; j < tests.size(); j++)
+      {
+        if(tests[j].coverage != NULL &&
+           strcmp(test.image, tests[j].image) == 0)
+        {
+          test.coverage->merge(tests[j].coverage);
+          delete tests[j].coverage;
+          tests[j].coverage = NULL;
+        }
+      }
+
+      Listing listing;
+      char name[1024];
+
+      changeExtension(name, test.image, ".lst");
+
+      if(listing.load(name) == false)
+      {
+        printf("No listing for %s, coverage skipped.\n", test.image);
+        continue;
+      }
+
+      changeExtension(name, test.image, ".cov");
+      test.coverage->writeListing(listing, name);
+
+      const char *base = strrchr(test.image, '/');
+
+      test.coverage->writeLcov(listing, fp, base ? base + 1 : test.image);
+    }
+
+    fclose(fp);
+  }
+
+  void worker(std::vector<Test> *tests, std::atomic<int> *next,
+              bool bless, bool trace, bool audio)
+  {
+    while(true)
+    {
+      int i = (*next)++;
+
+      if(i >= (int)tests->size())
+        break;
+
+      runTest((*tests)[i], bless, trace, audio);
+    }
+  }
+}
+
+// returns a process exit code
+int Regress::run(const char *manifest, bool bless, const char *coverage,
+                 bool trace, bool audio)
+{
+  std::vector<Test> tests;
+
+  if(parseManifest(manifest, tests) == false)
+  {
+    printf("Could not open manifest \"%s\".\n", manifest);
+    return 1;
+  }
+
+  if(coverage != NULL)
+  {
+    for(size_t i = 0; i < tests.size(); i++)
+      tests[i].coverage = new Coverage();
+  }
+
+  std::chrono::steady_clock::time_point begin =
+    std::chrono::steady_clock::now();
+
+  int jobs = std::thread::hardware_concurrency();
+
+  if(jobs < 1)
+    jobs = 1;
+
+  if(jobs > (int)tests.size())
+    jobs = tests.size();
+
+  std::atomic<int> next(0);
+  std::vector<std::thread> threads;
+
+  for(int i = 0; i < jobs; i++)
+    threads.push_back(std::thread(worker, &tests, &next, bless, trace,
+                                  audio));
+
+  for(int i = 0; i < jobs; i++)
+    threads[i].join();
+
+  int failed = 0;
+
+  for(size_t i = 0; i < tests.size(); i++)
+  {
+    Test &test = tests[i];
+
+    if(test.passed == true)
+    {
+      printf("%s  %s (%.1f ms)\n", bless ? "BLESS" : "PASS ",
+             test.image, test.ms);
+    }
+    else
+    {
+      printf("FAIL   %s: %s\n", test.image, test.message);
+      failed++;
+    }
+  }
+
+  double seconds = std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - begin).count();
+
+  printf("\n%d passed, %d failed in %.2f s using %d thread%s.\n",
+         (int)tests.size() - failed, failed, seconds, jobs,
+         jobs == 1 ? "" : "s");
+
+  if(coverage != NULL)
+  {
+    writeCoverage(tests, coverage);
+
+    for(size_t i = 0; i < tests.size(); i++)
+      delete tests[i].coverage;
+  }
+
+  return failed > 0 ? 1 : 0;
+}
+
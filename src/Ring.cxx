@@ -0,0 +1,201 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+
+#ifndef WIN32
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+#include "Ring.H"
+
+namespace
+{
+  const int HEADER = 64;
+
+  struct Header
+  {
+    char magic[4];
+    unsigned int version;
+    unsigned int header;
+    unsigned int size;
+    unsigned long long reserve;
+    unsigned long long commit;
+    unsigned long long start;
+  };
+
+  std::string name;
+  Header *header = 0;
+  unsigned char *data = 0;
+  unsigned int size = 0;
+  unsigned long long offset = 0;
+
+  unsigned long long now()
+  {
+#ifdef WIN32
+    return 0;
+#else
+    // served from the vdso, no system call
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+  }
+
+  // copy into the ring, wrapping at the end
+  void put(const void *src, int count)
+  {
+    const unsigned char *p = (const unsigned char *)src;
+
+    while(count > 0)
+    {
+      const unsigned int at = offset & (size - 1);
+      int part = size - at;
+
+      if(part > count)
+        part = count;
+
+      memcpy(data + at, p, part);
+      p += part;
+      offset += part;
+      count -= part;
+    }
+  }
+}
+
+// size in bytes is rounded up to a power of two, at least 64 KB
+bool Ring::open(const char *ring_name, int bytes)
+{
+#ifdef WIN32
+  fprintf(stderr, "The receive ring needs POSIX shared memory.\n");
+  return false;
+#else
+  close();
+
+  size = 65536;
+
+  while((int)size < bytes && size < 0x40000000)
+    size *= 2;
+
+  name = ring_name;
+
+  if(name.size() == 0 || name[0] != '/')
+    name = "/" + name;
+
+  const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+  if(fd < 0)
+    return false;
+
+  if(ftruncate(fd, HEADER + size) != 0)
+  {
+    ::close(fd);
+    shm_unlink(name.c_str());
+    return false;
+  }
+
+  void *map = mmap(0, HEADER + size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fd, 0);
+
+  ::close(fd);
+
+  if(map == MAP_FAILED)
+  {
+    shm_unlink(name.c_str());
+    return false;
+  }
+
+  header = (Header *)map;
+  data = (unsigned char *)map + HEADER;
+  offset = 0;
+
+  header->version = 1;
+  header->header = HEADER;
+  header->size = size;
+  header->reserve = 0;
+  header->commit = 0;
+  header->start = now();
+
+  // readers check the magic last
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(header->magic, "SXBR", 4);
+
+  return true;
+#endif
+}
+
+void Ring::close()
+{
+#ifndef WIN32
+  if(header == 0)
+    return;
+
+  munmap(header, HEADER + size);
+  shm_unlink(name.c_str());
+  header = 0;
+  data = 0;
+#endif
+}
+
+bool Ring::isOpen()
+{
+  return header != 0;
+}
+
+// called with every chunk read from the port, before any filtering
+void Ring::publish(const char *bytes, int count)
+{
+#ifndef WIN32
+  if(header == 0 || count <= 0)
+    return;
+
+  // a chunk larger than the ring keeps its newest part
+  if(count > (int)size - 16)
+  {
+    bytes += count - (size - 16);
+    count = size - 16;
+  }
+
+  const unsigned long long end = offset + 16 + ((count + 7) & ~7);
+  const unsigned int record[2] = { (unsigned int)count, 0 };
+  const unsigned long long stamp = now();
+  const unsigned char pad[8] = { 0 };
+
+  // readers see the space claimed before it is overwritten
+  __atomic_store_n(&header->reserve, end, __ATOMIC_RELEASE);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+  put(record, sizeof(record));
+  put(&stamp, sizeof(stamp));
+  put(bytes, count);
+  put(pad, end - offset);
+
+  __atomic_store_n(&header->commit, end, __ATOMIC_RELEASE);
+#endif
+}
+
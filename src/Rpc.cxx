@@ -0,0 +1,657 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifndef WIN32
+  #include <csignal>
+  #include <fcntl.h>
+  #include <sys/socket.h>
+  #include <sys/un.h>
+  #include <unistd.h>
+#endif
+
+#include <FL/Fl.H>
+
+#include "Gui.H"
+#include "Image.H"
+#include "Json.H"
+#include "Rpc.H"
+#include "Terminal.H"
+
+namespace
+{
+  // seconds between socket polls
+  const double PERIOD = 0.02;
+
+  // longest request line, and most unsent output, before a client is
+  // dropped
+  const int LONGEST = 1 << 20;
+
+  // longest text for one send, the monitor's input is typed by hand
+  const int LONGEST_SEND = 4096;
+
+  // upload records between progress notifications
+  const int PROGRESS = 16;
+
+  // JSON-RPC error codes
+  const int PARSE_ERROR = -32700;
+  const int INVALID_REQUEST = -32600;
+  const int NO_METHOD = -32601;
+  const int INVALID_PARAMS = -32602;
+  const int FAILED = -32000;
+
+  struct Client
+  {
+    int id;
+    int fd;
+    std::string in;
+    std::string out;
+    bool console;
+    bool closed;
+  };
+
+  bool running = false;
+  int listener = -1;
+  std::string socket_path;
+  std::vector<Client> clients;
+  int next_id = 1;
+
+  Client *find(int id)
+  {
+    for(size_t i = 0; i < clients.size(); i++)
+      if(clients[i].id == id && clients[i].closed == false)
+        return &clients[i];
+
+    return 0;
+  }
+
+  void flush(Client &client)
+  {
+#ifndef WIN32
+    while(client.out.size() > 0 && client.closed == false)
+    {
+      const int sent = write(client.fd, client.out.data(), client.out.size());
+
+      if(sent <= 0)
+        break;
+
+      client.out.erase(0, sent);
+    }
+
+    if((int)client.out.size() > LONGEST)
+      client.closed = true;
+#endif
+  }
+
+  void send(int id, const std::string &message)
+  {
+    Client *client = find(id);
+
+    if(client == 0)
+      return;
+
+    client->out += message + "\n";
+    flush(*client);
+  }
+
+  void reply(int client, const std::string &id, const std::string &result)
+  {
+    send(client, "{\"jsonrpc\":\"2.0\",\"id\":" + id + ",\"result\":" +
+         result + "}");
+  }
+
+  void error(int client, const std::string &id, int code, const char *text)
+  {
+    char s[64];
+
+    snprintf(s, sizeof(s), "%d", code);
+    send(client, "{\"jsonrpc\":\"2.0\",\"id\":" + id +
+         ",\"error\":{\"code\":" + s + ",\"message\":" +
+         Json::quote(text) + "}}");
+  }
+
+  void notify(int client, const char *method, const std::string &params)
+  {
+    send(client, std::string("{\"jsonrpc\":\"2.0\",\"method\":\"") + method +
+         "\",\"params\":" + params + "}");
+  }
+
+  // console text to every subscribed client
+  void console(const char *data, int count)
+  {
+    const std::string message = "{\"jsonrpc\":\"2.0\",\"method\":\"console\","
+      "\"params\":{\"text\":" + Json::quote(std::string(data, count)) + "}}\n";
+
+    for(size_t i = 0; i < clients.size(); i++)
+    {
+      if(clients[i].console == true && clients[i].closed == false)
+      {
+        clients[i].out += message;
+        flush(clients[i]);
+      }
+    }
+  }
+
+  std::string hex(const unsigned char *data, int count)
+  {
+    std::string result;
+    char s[4];
+
+    for(int i = 0; i < count; i++)
+    {
+      sprintf(s, "%02X", data[i]);
+      result += s;
+    }
+
+    return result;
+  }
+
+  bool unhex(const std::string &text, std::vector<unsigned char> &data)
+  {
+    data.clear();
+
+    if((text.size() & 1) != 0)
+      return false;
+
+    for(size_t i = 0; i < text.size(); i += 2)
+    {
+      char *end;
+      const std::string digits = text.substr(i, 2);
+      const long value = strtol(digits.c_str(), &end, 16);
+
+      if(*end != 0)
+        return false;
+
+      data.push_back(value);
+    }
+
+    return true;
+  }
+
+  const char *reg_names[8] = { "pc", "a", "x", "y", "sp", "dp", "sr", "db" };
+
+  struct Upload
+  {
+    int client;
+    int done;
+    int total;
+  };
+
+  // like the terminal's upload, with progress notifications
+  bool sendRecord(const char *s, void *data)
+  {
+    Upload *upload = (Upload *)data;
+    char params[64];
+
+    Terminal::sendString(s);
+    Terminal::drain();
+    upload->done++;
+
+    if((upload->done % PROGRESS) == 0 || upload->done == upload->total)
+    {
+      snprintf(params, sizeof(params), "{\"done\":%d,\"total\":%d}",
+               upload->done, upload->total);
+      notify(upload->client, "progress", params);
+    }
+
+    return true;
+  }
+
+  struct Verify
+  {
+    int address;
+    std::vector<unsigned char> data;
+    int first_bad;
+  };
+
+  // compares each run of contiguous records with one read
+  bool checkRun(Verify &verify)
+  {
+    const int count = verify.data.size();
+    std::vector<unsigned char> board(count);
+
+    if(count == 0 || verify.first_bad >= 0)
+      return true;
+
+    if(Terminal::readMemory(verify.address, &board[0], count) != count)
+      return false;
+
+    for(int i = 0; i < count; i++)
+    {
+      if(board[i] != verify.data[i])
+      {
+        verify.first_bad = verify.address + i;
+        break;
+      }
+    }
+
+    return true;
+  }
+
+  // S2 records: type, count, 24-bit address, data, checksum
+  bool verifyRecord(const char *s, void *data)
+  {
+    Verify *verify = (Verify *)data;
+    unsigned int count, address, value;
+
+    if(s[0] != 'S' || s[1] != '2' ||
+       sscanf(s + 2, "%2x%6x", &count, &address) != 2 || count < 4)
+    {
+      return true;
+    }
+
+    if((int)address != verify->address + (int)verify->data.size())
+    {
+      if(checkRun(*verify) == false)
+        return false;
+
+      verify->address = address;
+      verify->data.clear();
+    }
+
+    for(unsigned int i = 0; i < count - 4; i++)
+    {
+      if(sscanf(s + 10 + i * 2, "%2x", &value) != 1)
+        return false;
+
+      verify->data.push_back(value);
+    }
+
+    return true;
+  }
+
+  int countLines(const char *filename)
+  {
+    FILE *fp = fopen(filename, "r");
+    char line[1024];
+    int lines = 0;
+
+    if(fp == NULL)
+      return 0;
+
+    while(fgets(line, sizeof(line), fp) != NULL)
+      lines++;
+
+    fclose(fp);
+    return lines;
+  }
+
+  void handle(int client, const std::string &line)
+  {
+    Json request;
+
+    if(request.parse(line) == false)
+    {
+      error(client, "null", PARSE_ERROR, "Parse error.");
+      return;
+    }
+
+    const std::string id = request.get("id").dump();
+    const std::string method = request.get("method").text;
+    const Json &params = request.get("params");
+    const bool notification = request.has("id") == false;
+
+    if(request.type != Json::TYPE_OBJECT || method.size() == 0)
+    {
+      error(client, id, INVALID_REQUEST, "Invalid request.");
+      return;
+    }
+
+    const int address = (int)params.get("address").number;
+    std::string result = "true";
+    const char *failure = 0;
+
+    if(method == "connect")
+    {
+      if(params.get("port").type == Json::TYPE_STRING)
+      {
+        snprintf(Terminal::port_string, sizeof(Terminal::port_string), "%s",
+                 params.get("port").text.c_str());
+      }
+
+      if(Terminal::isConnected() == false)
+        Terminal::connect();
+
+      if(Terminal::isConnected() == false)
+        failure = "Could not open serial port.";
+    }
+    else if(method == "disconnect")
+    {
+      Terminal::disconnect();
+    }
+    else if(Terminal::isConnected() == false && method != "subscribe" &&
+            method != "quit")
+    {
+      failure = "Not connected.";
+    }
+    else if(method == "upload" || method == "verify")
+    {
+      const std::string &file = params.get("file").text;
+
+      if(Image::isSupported(file.c_str()) == false)
+      {
+        error(client, id, INVALID_PARAMS, "Expected a .hex or .srec file.");
+        return;
+      }
+
+      if(method == "upload")
+      {
+        Upload upload;
+
+        upload.client = client;
+        upload.done = 0;
+        upload.total = countLines(file.c_str());
+
+        if(Image::convert(file.c_str(), sendRecord, &upload) == false)
+          failure = "Could not open file.";
+      }
+      else
+      {
+        Verify verify;
+        char s[64];
+
+        verify.address = -1;
+        verify.first_bad = -1;
+
+        if(Image::convert(file.c_str(), verifyRecord, &verify) == false ||
+           checkRun(verify) == false)
+        {
+          failure = "Could not verify.";
+        }
+        else if(verify.first_bad >= 0)
+        {
+          snprintf(s, sizeof(s), "{\"match\":false,\"address\":%d}",
+                   verify.first_bad);
+          result = s;
+        }
+        else
+        {
+          result = "{\"match\":true}";
+        }
+      }
+    }
+    else if(method == "read")
+    {
+      const int count = (int)params.get("count").number;
+      std::vector<unsigned char> data(count > 0 ? count : 1);
+
+      if(count < 1 || count > 0x10000)
+        failure = "Invalid count.";
+      else if(Terminal::readMemory(address, &data[0], count) != count)
+        failure = "Could not read memory.";
+      else
+        result = "{\"data\":\"" + hex(&data[0], count) + "\"}";
+    }
+    else if(method == "write")
+    {
+      std::vector<unsigned char> data;
+
+      if(unhex(params.get("data").text, data) == false || data.size() == 0)
+        failure = "Data must be hex digits.";
+      else if(Terminal::uploadData(address, &data[0], data.size()) == false)
+        failure = "Could not write memory.";
+    }
+    else if(method == "getRegs" || method == "setRegs")
+    {
+      int regs[8];
+      char s[32];
+
+      if(Terminal::readRegs(regs) == false)
+      {
+        failure = "Could not read the registers.";
+      }
+      else if(method == "getRegs")
+      {
+        result = "{";
+
+        for(int i = 0; i < 8; i++)
+        {
+          snprintf(s, sizeof(s), "%s\"%s\":%d", i > 0 ? "," : "",
+                   reg_names[i], regs[i]);
+          result += s;
+        }
+
+        result += "}";
+      }
+      else
+      {
+        // registers not named keep their values
+        for(int i = 0; i < 8; i++)
+          if(params.get(reg_names[i]).type == Json::TYPE_NUMBER)
+            regs[i] = (int)params.get(reg_names[i]).number;
+
+        Terminal::setRegs(regs);
+      }
+    }
+    else if(method == "jml")
+    {
+      Terminal::jml(address);
+    }
+    else if(method == "jsl")
+    {
+      Terminal::jsl(address);
+    }
+    else if(method == "send")
+    {
+      const std::string &text = params.get("text").text;
+
+      if((int)text.size() > LONGEST_SEND)
+      {
+        error(client, id, INVALID_PARAMS, "Text is too long.");
+        return;
+      }
+
+      Terminal::sendString(text.c_str());
+    }
+    else if(method == "subscribe")
+    {
+      Client *c = find(client);
+
+      if(c != 0)
+        c->console = params.get("console").type != Json::TYPE_BOOL ||
+                     params.get("console").flag == true;
+    }
+    else if(method == "quit")
+    {
+      reply(client, id, result);
+      Rpc::stop();
+      return;
+    }
+    else
+    {
+      error(client, id, NO_METHOD, "Method not found.");
+      return;
+    }
+
+    if(notification == true)
+      return;
+
+    if(failure != 0)
+      error(client, id, FAILED, failure);
+    else
+      reply(client, id, result);
+  }
+
+  void accept()
+  {
+#ifndef WIN32
+    while(true)
+    {
+      const int fd = ::accept(listener, 0, 0);
+
+      if(fd < 0)
+        break;
+
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+      Client client;
+
+      client.id = next_id++;
+      client.fd = fd;
+      client.console = false;
+      client.closed = false;
+      clients.push_back(client);
+    }
+#endif
+  }
+
+  // complete lines become jobs in arrival order
+  void receive(Client &client)
+  {
+#ifndef WIN32
+    char s[4096];
+
+    while(true)
+    {
+      const int bytes = read(client.fd, s, sizeof(s));
+
+      if(bytes == 0)
+        client.closed = true;
+
+      if(bytes <= 0)
+        break;
+
+      client.in.append(s, bytes);
+    }
+
+    size_t end;
+
+    while((end = client.in.find('\n')) != std::string::npos)
+    {
+      const std::string line = client.in.substr(0, end);
+      const int id = client.id;
+
+      client.in.erase(0, end + 1);
+
+      if(line.find_first_not_of(" \t\r") != std::string::npos)
+        Terminal::post([id, line]() { handle(id, line); });
+    }
+
+    if((int)client.in.size() > LONGEST)
+      client.closed = true;
+#endif
+  }
+}
+
+bool Rpc::start(const char *path)
+{
+#ifdef WIN32
+  fprintf(stderr, "The control socket needs Unix domain sockets.\n");
+  return false;
+#else
+  struct sockaddr_un address;
+
+  if(strlen(path) >= sizeof(address.sun_path))
+    return false;
+
+  // a client that goes away mid-reply must not end the process
+  signal(SIGPIPE, SIG_IGN);
+
+  listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  if(listener < 0)
+    return false;
+
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, path);
+  unlink(path);
+
+  if(bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+     listen(listener, 8) != 0)
+  {
+    close(listener);
+    listener = -1;
+    return false;
+  }
+
+  fcntl(listener, F_SETFL, fcntl(listener, F_GETFL) | O_NONBLOCK);
+  socket_path = path;
+  running = true;
+  Terminal::addListener(console);
+  Fl::add_timeout(PERIOD, poll);
+
+  return true;
+#endif
+}
+
+void Rpc::stop()
+{
+#ifndef WIN32
+  if(running == false)
+    return;
+
+  Fl::remove_timeout(poll);
+  Terminal::removeListener(console);
+
+  for(size_t i = 0; i < clients.size(); i++)
+  {
+    flush(clients[i]);
+    close(clients[i].fd);
+  }
+
+  clients.clear();
+  close(listener);
+  unlink(socket_path.c_str());
+  listener = -1;
+  running = false;
+#endif
+}
+
+bool Rpc::isRunning()
+{
+  return running;
+}
+
+void Rpc::poll(void *)
+{
+  accept();
+
+  for(size_t i = 0; i < clients.size(); i++)
+    receive(clients[i]);
+
+  Terminal::runJobs();
+
+  if(running == false)
+    return;
+
+  for(size_t i = 0; i < clients.size(); i++)
+  {
+    flush(clients[i]);
+
+    if(clients[i].closed == true)
+    {
+#ifndef WIN32
+      close(clients[i].fd);
+#endif
+      clients.erase(clients.begin() + i);
+      i--;
+    }
+  }
+
+  Fl::repeat_timeout(PERIOD, poll);
+}
+
@@ -0,0 +1,538 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <FL/Fl.H>
+#include <FL/Fl_Native_File_Chooser.H>
+
+#include "Dialog.H"
+#include "Gui.H"
+#include "Harness.H"
+#include "Matcher.H"
+#include "Script.H"
+#include "Terminal.H"
+
+namespace
+{
+  // received text kept between expects
+  const int BACKLOG = 65536;
+
+  char load_dir[256];
+
+  bool running = false;
+
+  Matcher matcher;
+  bool expecting = false;
+  int matched = -1;
+
+  // text not yet consumed by an expect
+  std::string unseen;
+
+  std::string directory;
+  std::string filename;
+  int line_number;
+
+  void listen(const char *data, int count)
+  {
+    if(expecting == true && matched < 0)
+    {
+      int end;
+
+      matched = matcher.feed(data, count, &end);
+
+      if(matched < 0)
+        return;
+
+      data += end;
+      count -= end;
+    }
+
+    unseen.append(data, count);
+
+    if((int)unseen.size() > BACKLOG)
+      unseen.erase(0, unseen.size() - BACKLOG);
+  }
+
+  void fail(const char *message)
+  {
+    char s[1024];
+
+    snprintf(s, sizeof(s), "\n%s:%d: %s\n", filename.c_str(), line_number,
+             message);
+    Gui::append(s);
+  }
+
+  const char *skipSpace(const char *s)
+  {
+    while(*s == ' ' || *s == '\t')
+      s++;
+
+    return s;
+  }
+
+  // "text" with C escapes, including \xHH
+  bool parseString(const char *&s, std::string &out)
+  {
+    s = skipSpace(s);
+    out.clear();
+
+    if(*s != '"')
+      return false;
+
+    s++;
+
+    while(*s != '"')
+    {
+      if(*s == 0 || *s == '\n')
+        return false;
+
+      if(*s != '\\')
+      {
+        out += *s++;
+        continue;
+      }
+
+      s++;
+
+      switch(*s)
+      {
+        case 'n':
+          out += '\n';
+          break;
+        case 'r':
+          out += '\r';
+          break;
+        case 't':
+          out += '\t';
+          break;
+        case 'x':
+        {
+          char hex[3] = { 0, 0, 0 };
+          int digits = 0;
+
+          while(digits < 2 && isxdigit((unsigned char)s[1 + digits]))
+          {
+            hex[digits] = s[1 + digits];
+            digits++;
+          }
+
+          if(digits == 0)
+            return false;
+
+          out += (char)strtol(hex, 0, 16);
+          s += digits;
+          break;
+        }
+        case 0:
+          return false;
+        default:
+          out += *s;
+          break;
+      }
+
+      s++;
+    }
+
+    s++;
+    return true;
+  }
+
+  std::string path(const char *name)
+  {
+    if(name[0] == '/' || name[0] == '\\' ||
+       (name[0] != 0 && name[1] == ':'))
+    {
+      return name;
+    }
+
+    return directory + name;
+  }
+
+  // expect SECONDS "pattern" ... !"pattern" ...
+  // succeeds on the first plain pattern, fails on a ! pattern or timeout
+  bool expect(const char *s)
+  {
+    double seconds;
+    int used = 0;
+    std::vector<bool> bad;
+    std::vector<std::string> patterns;
+
+    if(sscanf(s, "%lf%n", &seconds, &used) != 1)
+    {
+      fail("expect needs a timeout in seconds.");
+      return false;
+    }
+
+    s += used;
+    matcher.clear();
+
+    while(*skipSpace(s) != 0)
+    {
+      std::string pattern;
+
+      s = skipSpace(s);
+      bad.push_back(*s == '!');
+
+      if(*s == '!')
+        s++;
+
+      if(parseString(s, pattern) == false || pattern.size() == 0)
+      {
+        fail("expect patterns are quoted strings.");
+        return false;
+      }
+
+      patterns.push_back(pattern);
+      matcher.add(pattern);
+    }
+
+    if(patterns.size() == 0)
+    {
+      fail("expect needs a pattern.");
+      return false;
+    }
+
+    matcher.build();
+
+    // text that arrived since the last expect counts too
+    std::string old;
+
+    old.swap(unseen);
+    expecting = true;
+    matched = -1;
+    listen(old.data(), old.size());
+
+    std::chrono::steady_clock::time_point begin =
+      std::chrono::steady_clock::now();
+
+    while(matched < 0 && std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - begin).count() < seconds)
+    {
+      if(Harness::wait(0.05) == false)
+        break;
+    }
+
+    expecting = false;
+
+    char message[1024];
+
+    if(matched < 0)
+    {
+      snprintf(message, sizeof(message), "timed out waiting for \"%s\"%s",
+               patterns[0].c_str(), patterns.size() > 1 ? " ..." : "");
+      fail(message);
+      return false;
+    }
+
+    if(bad[matched] == true)
+    {
+      snprintf(message, sizeof(message), "received \"%s\"",
+               patterns[matched].c_str());
+      fail(message);
+      return false;
+    }
+
+    return true;
+  }
+
+  bool readBytes(int address, int count, std::vector<unsigned char> &data)
+  {
+    data.resize(count);
+
+    if(Terminal::readMemory(address, &data[0], count) != count)
+    {
+      fail("could not read memory.");
+      return false;
+    }
+
+    return true;
+  }
+
+  bool execute(const char *line)
+  {
+    char command[32];
+    int used = 0;
+
+    line = skipSpace(line);
+
+    if(*line == '#' || *line == 0 ||
+       sscanf(line, "%31s%n", command, &used) != 1)
+    {
+      return true;
+    }
+
+    const char *args = skipSpace(line + used);
+
+    if(strcmp(command, "send") == 0)
+    {
+      std::string text;
+
+      if(parseString(args, text) == false)
+      {
+        fail("send needs a quoted string.");
+        return false;
+      }
+
+      Terminal::sendString(text.c_str());
+      return true;
+    }
+
+    if(strcmp(command, "expect") == 0)
+      return expect(args);
+
+    if(strcmp(command, "echo") == 0)
+    {
+      std::string text;
+
+      if(parseString(args, text) == false)
+      {
+        fail("echo needs a quoted string.");
+        return false;
+      }
+
+      Gui::append(("\n" + text + "\n").c_str());
+      return true;
+    }
+
+    if(strcmp(command, "wait") == 0)
+      return Harness::wait(atof(args));
+
+    if(strcmp(command, "upload") == 0)
+    {
+      const std::string name = path(args);
+      const char *ext = strrchr(name.c_str(), '.');
+      FILE *fp = fopen(name.c_str(), "r");
+
+      if(fp == NULL)
+      {
+        fail("could not open file.");
+        return false;
+      }
+
+      fclose(fp);
+
+      if(ext != NULL && strcmp(ext, ".hex") == 0)
+      {
+        Terminal::uploadHex(name.c_str());
+      }
+      else if(ext != NULL && strcmp(ext, ".srec") == 0)
+      {
+        Terminal::uploadSrec(name.c_str());
+      }
+      else
+      {
+        fail("only .hex and .srec files can be uploaded.");
+        return false;
+      }
+
+      unseen.clear();
+      return true;
+    }
+
+    int address, count;
+
+    if(strcmp(command, "jump") == 0 || strcmp(command, "call") == 0)
+    {
+      if(sscanf(args, "%x", &address) != 1)
+      {
+        fail("expected a hex address.");
+        return false;
+      }
+
+      if(command[0] == 'j')
+        Terminal::jml(address);
+      else
+        Terminal::jsl(address);
+
+      return true;
+    }
+
+    // read ADDRESS COUNT, shown as a dump
+    if(strcmp(command, "read") == 0)
+    {
+      std::vector<unsigned char> data;
+
+      if(sscanf(args, "%x %d", &address, &count) != 2 || count < 1)
+      {
+        fail("read needs a hex address and a count.");
+        return false;
+      }
+
+      if(readBytes(address, count, data) == false)
+        return false;
+
+      std::string dump;
+      char s[16];
+
+      for(int i = 0; i < count; i++)
+      {
+        if((i & 15) == 0)
+        {
+          sprintf(s, "\n%02X:%04X", (address + i) >> 16,
+                  (address + i) & 0xFFFF);
+          dump += s;
+        }
+
+        sprintf(s, " %02X", data[i]);
+        dump += s;
+      }
+
+      Gui::append((dump + "\n").c_str());
+      return true;
+    }
+
+    // assert ADDRESS BYTE ...
+    if(strcmp(command, "assert") == 0)
+    {
+      std::vector<unsigned char> expected;
+      std::vector<unsigned char> data;
+
+      if(sscanf(args, "%x%n", &address, &used) != 1)
+      {
+        fail("assert needs a hex address and bytes.");
+        return false;
+      }
+
+      args += used;
+
+      int value;
+
+      while(sscanf(args, "%x%n", &value, &used) == 1)
+      {
+        expected.push_back(value);
+        args += used;
+      }
+
+      if(expected.size() == 0)
+      {
+        fail("assert needs a hex address and bytes.");
+        return false;
+      }
+
+      if(readBytes(address, expected.size(), data) == false)
+        return false;
+
+      for(size_t i = 0; i < data.size(); i++)
+      {
+        if(data[i] != expected[i])
+        {
+          char s[256];
+
+          snprintf(s, sizeof(s), "%02X:%04X is %02X, expected %02X.",
+                   (address + (int)i) >> 16, (address + (int)i) & 0xFFFF,
+                   data[i], expected[i]);
+          fail(s);
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    fail("unknown command.");
+    return false;
+  }
+}
+
+void Script::begin()
+{
+  if(Terminal::isConnected() == false)
+  {
+    Dialog::message("Error", "Not Connected.");
+    return;
+  }
+
+  if(running == true)
+    return;
+
+  Fl_Native_File_Chooser fc;
+  fc.title("Run Script");
+  fc.filter("Script\t*.txt\n");
+  fc.options(Fl_Native_File_Chooser::PREVIEW);
+  fc.type(Fl_Native_File_Chooser::BROWSE_FILE);
+  fc.directory(load_dir);
+
+  switch(fc.show())
+  {
+    case -1:
+    case 1:
+      return;
+    default:
+      strcpy(load_dir, fc.filename());
+      if(strrchr(load_dir, '/') != NULL)
+        strrchr(load_dir, '/')[1] = '\0';
+      break;
+  }
+
+  run(fc.filename());
+}
+
+// returns a process exit code, 0 when every command succeeded
+int Script::run(const char *name)
+{
+  Terminal::Hold hold;
+
+  FILE *fp = fopen(name, "r");
+
+  if(fp == NULL)
+  {
+    Dialog::message("Error", "Could not open script.");
+    return 1;
+  }
+
+  filename = name;
+  directory = name;
+
+  const size_t slash = directory.find_last_of("/\\");
+
+  directory = slash == std::string::npos ? "" : directory.substr(0, slash + 1);
+
+  running = true;
+  unseen.clear();
+  line_number = 0;
+  Terminal::addListener(listen);
+
+  char line[1024];
+  bool ok = true;
+
+  while(ok == true && fgets(line, sizeof(line), fp) != NULL)
+  {
+    line_number++;
+    line[strcspn(line, "\r\n")] = 0;
+    ok = execute(line);
+  }
+
+  fclose(fp);
+  Terminal::removeListener(listen);
+  running = false;
+
+  Gui::append(ok == true ? "\nScript passed.\n" : "\nScript failed.\n");
+
+  return ok == true ? 0 : 1;
+}
+
@@ -0,0 +1,484 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+#include "Image.H"
+#include "Monitor.H"
+#include "Session.H"
+
+namespace
+{
+  // unread bytes kept for read() when there is no receiver
+  const int INBOX = 65536;
+
+  // a reply is over once the line has been quiet this long (ms)
+  const int REPLY_QUIET = 100;
+  const int DUMP_QUIET = 250;
+
+  // longest a reply may keep going
+  const int REPLY_LONGEST = 5000;
+
+  void delay(int ms)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+  }
+
+  bool countRecord(const char *, void *data)
+  {
+    (*(int *)data)++;
+    return true;
+  }
+}
+
+Session::Session()
+  : mode(Monitor::MODE_265),
+    stopping(false),
+    uploading(false),
+    receiver(0),
+    receiver_data(0),
+    capturing(false),
+    received(0),
+    progress(0),
+    progress_data(0),
+    records(0),
+    total(0)
+{
+}
+
+Session::~Session()
+{
+  close();
+}
+
+// mode is Monitor::MODE_265 or MODE_134
+bool Session::open(const char *name, int board_mode)
+{
+  close();
+
+  if(port.open(name) == false)
+    return false;
+
+  mode = board_mode;
+  stopping = false;
+  inbox.clear();
+  reader = std::thread(&Session::loop, this);
+
+  return true;
+}
+
+// an upload in progress stops at its next record
+void Session::close()
+{
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+
+  arrived.notify_all();
+
+  // a done callback may close its own session
+  if(worker.joinable())
+  {
+    if(std::this_thread::get_id() == worker.get_id())
+      worker.detach();
+    else
+      worker.join();
+  }
+
+  if(reader.joinable())
+    reader.join();
+
+  port.close();
+}
+
+bool Session::isOpen()
+{
+  return port.isOpen() && stopping == false;
+}
+
+void Session::setReceiver(Receiver function, void *data)
+{
+  std::lock_guard<std::mutex> guard(lock);
+
+  receiver = function;
+  receiver_data = data;
+}
+
+void Session::setFlowControl(bool on)
+{
+  port.setFlowControl(on);
+}
+
+// the reader thread, replies go to the command waiting for them,
+// everything goes to the receiver
+void Session::loop()
+{
+  char buf[1024];
+
+  while(stopping == false)
+  {
+    if(port.wait(100) == false)
+      continue;
+
+    const int bytes = port.read(buf, sizeof(buf));
+
+    if(bytes <= 0)
+    {
+      delay(10);
+      continue;
+    }
+
+    Receiver function;
+    void *data;
+
+    {
+      std::lock_guard<std::mutex> guard(lock);
+
+      if(capturing == true)
+      {
+        reply.append(buf, bytes);
+      }
+      else if(receiver == 0)
+      {
+        inbox.append(buf, bytes);
+
+        if((int)inbox.size() > INBOX)
+          inbox.erase(0, inbox.size() - INBOX);
+      }
+
+      received += bytes;
+      function = receiver;
+      data = receiver_data;
+    }
+
+    arrived.notify_all();
+
+    if(function != 0)
+      function(buf, bytes, data);
+  }
+}
+
+// raw bytes not taken by a receiver, waits up to ms (forever if negative),
+// returns -1 once closed
+int Session::read(unsigned char *data, int count, int ms)
+{
+  std::unique_lock<std::mutex> guard(lock);
+
+  if(ms < 0)
+  {
+    arrived.wait(guard, [this]() { return inbox.size() > 0 || stopping; });
+  }
+  else
+  {
+    arrived.wait_for(guard, std::chrono::milliseconds(ms),
+                     [this]() { return inbox.size() > 0 || stopping; });
+  }
+
+  if(inbox.size() == 0)
+    return stopping ? -1 : 0;
+
+  if(count > (int)inbox.size())
+    count = inbox.size();
+
+  memcpy(data, inbox.data(), count);
+  inbox.erase(0, count);
+
+  return count;
+}
+
+// binary transfer, no carriage return conversion
+bool Session::write(const unsigned char *data, int count)
+{
+  int sent = 0;
+  int tries = 0;
+
+  while(sent < count && tries < 100)
+  {
+    const int bytes = port.write(data + sent, count - sent);
+
+    if(bytes > 0)
+    {
+      sent += bytes;
+      tries = 0;
+    }
+    else
+    {
+      delay(4);
+      tries++;
+    }
+  }
+
+  return sent == count;
+}
+
+// text for the monitor, newlines become carriage returns
+bool Session::send(const char *text)
+{
+  std::string s = text;
+
+  for(size_t i = 0; i < s.size(); i++)
+  {
+    if(s[i] == '\n')
+      s[i] = 13;
+  }
+
+  const bool ok = write((const unsigned char *)s.data(), s.size());
+
+  delay(16);
+  return ok;
+}
+
+void Session::begin()
+{
+  std::lock_guard<std::mutex> guard(lock);
+
+  reply.clear();
+  capturing = true;
+}
+
+void Session::end(std::string &text)
+{
+  std::lock_guard<std::mutex> guard(lock);
+
+  text.swap(reply);
+  reply.clear();
+  capturing = false;
+}
+
+// wait until nothing has arrived for ms
+bool Session::quiet(int ms)
+{
+  std::unique_lock<std::mutex> guard(lock);
+  const std::chrono::steady_clock::time_point deadline =
+    std::chrono::steady_clock::now() + std::chrono::milliseconds(REPLY_LONGEST);
+
+  while(stopping == false && std::chrono::steady_clock::now() < deadline)
+  {
+    const unsigned long long last = received;
+
+    if(arrived.wait_for(guard, std::chrono::milliseconds(ms),
+                        [&]() { return received != last || stopping; })
+       == false)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool Session::getRegs(int *regs)
+{
+  std::lock_guard<std::mutex> guard(command);
+  char s[8];
+  std::string text;
+
+  Monitor::regsCommand(s, mode);
+  begin();
+  send(s);
+  quiet(REPLY_QUIET);
+  end(text);
+
+  std::vector<char> result(text.size() + 1);
+
+  Monitor::filterResult(&result[0], text.c_str());
+  return Monitor::parseRegs(&result[0], mode, regs);
+}
+
+bool Session::setRegs(const int *regs)
+{
+  std::lock_guard<std::mutex> guard(command);
+  char s[256];
+  std::string text;
+
+  Monitor::setRegsCommand(s, mode, regs);
+  begin();
+
+  const bool ok = send(s) && send("R");
+
+  quiet(REPLY_QUIET);
+  end(text);
+
+  return ok;
+}
+
+// returns the number of bytes received
+int Session::readMemory(int address, unsigned char *data, int count)
+{
+  if(count <= 0)
+    return 0;
+
+  std::lock_guard<std::mutex> guard(command);
+  char s[256];
+  std::vector<bool> seen(count, false);
+  std::string text;
+  int got = 0;
+
+  Monitor::dumpCommand(s, mode, address, count);
+  begin();
+  send(s);
+
+  {
+    std::unique_lock<std::mutex> wait(lock);
+    size_t parsed = 0;
+    size_t examined = 0;
+
+    // lines are parsed as they arrive, stop once everything is seen
+    // or the line goes quiet
+    while(got < count && stopping == false)
+    {
+      if(arrived.wait_for(wait, std::chrono::milliseconds(DUMP_QUIET),
+                          [&]() { return reply.size() > examined ||
+                                         stopping; }) == false)
+      {
+        break;
+      }
+
+      examined = reply.size();
+
+      while(true)
+      {
+        const size_t eol = reply.find_first_of("\r\n", parsed);
+
+        if(eol == std::string::npos)
+          break;
+
+        Monitor::parseDump(reply.substr(parsed, eol - parsed).c_str(),
+                           address, data, seen);
+        parsed = eol + 1;
+      }
+
+      got = 0;
+
+      for(int i = 0; i < count; i++)
+        got += seen[i] ? 1 : 0;
+    }
+
+    if(got < count && parsed < reply.size())
+    {
+      Monitor::parseDump(reply.substr(parsed).c_str(), address, data, seen);
+
+      got = 0;
+
+      for(int i = 0; i < count; i++)
+        got += seen[i] ? 1 : 0;
+    }
+  }
+
+  end(text);
+  return got;
+}
+
+// S-records, one at a time
+bool Session::sendRecord(const char *s, void *data)
+{
+  Session *session = (Session *)data;
+
+  if(session->send(s) == false)
+    return false;
+
+  session->records++;
+
+  if(session->progress != 0)
+    session->progress(session->records, session->total,
+                      session->progress_data);
+
+  return session->stopping == false;
+}
+
+bool Session::writeMemory(int address, const unsigned char *data, int count)
+{
+  std::lock_guard<std::mutex> guard(command);
+
+  progress = 0;
+  return Image::convertData(address, data, count, sendRecord, this);
+}
+
+// .hex or .srec file through the monitor's S-record loader
+bool Session::upload(const char *filename, Progress function, void *data)
+{
+  std::lock_guard<std::mutex> guard(command);
+
+  total = 0;
+  records = 0;
+
+  if(Image::convert(filename, countRecord, &total) == false)
+    return false;
+
+  progress = function;
+  progress_data = data;
+
+  const bool ok = Image::convert(filename, sendRecord, this);
+
+  progress = 0;
+  return ok;
+}
+
+// the same on a worker thread, done is called on it at the end
+bool Session::uploadAsync(const char *filename, Progress function, Done done,
+                          void *data)
+{
+  // one at a time, and never from its own done callback
+  if(uploading == true || std::this_thread::get_id() == worker.get_id())
+    return false;
+
+  if(worker.joinable())
+    worker.join();
+
+  const std::string name = filename;
+
+  uploading = true;
+
+  worker = std::thread([=]()
+  {
+    const bool ok = upload(name.c_str(), function, data);
+
+    // the session may be gone once done returns
+    uploading = false;
+
+    if(done != 0)
+      done(ok, data);
+  });
+
+  return true;
+}
+
+bool Session::jml(int address)
+{
+  std::lock_guard<std::mutex> guard(command);
+  char s[256];
+
+  Monitor::jumpCommand(s, mode, address, false);
+  return send(s);
+}
+
+bool Session::jsl(int address)
+{
+  std::lock_guard<std::mutex> guard(command);
+  char s[256];
+
+  Monitor::jumpCommand(s, mode, address, true);
+  return send(s);
+}
+
@@ -0,0 +1,355 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifndef WIN32
+  #include <csignal>
+  #include <arpa/inet.h>
+  #include <fcntl.h>
+  #include <netinet/in.h>
+  #include <netinet/tcp.h>
+  #include <sys/socket.h>
+  #include <sys/un.h>
+  #include <unistd.h>
+#endif
+
+#include <FL/Fl.H>
+
+#include "Gui.H"
+#include "Share.H"
+#include "Terminal.H"
+
+namespace
+{
+  // seconds between socket polls
+  const double PERIOD = 0.02;
+
+  // output a client may fall behind by before it is dropped
+  const int BACKLOG = 65536;
+
+  struct Client
+  {
+    int fd;
+    std::string out;
+    bool closed;
+  };
+
+  bool running = false;
+  std::vector<int> listeners;
+  std::vector<std::string> paths;
+  std::vector<Client> clients;
+
+  void flush(Client &client)
+  {
+#ifndef WIN32
+    if(client.closed == true)
+      return;
+
+    while(client.out.size() > 0)
+    {
+      const int sent = write(client.fd, client.out.data(), client.out.size());
+
+      if(sent <= 0)
+        break;
+
+      client.out.erase(0, sent);
+    }
+
+    // a slow viewer never holds up the others
+    if((int)client.out.size() > BACKLOG)
+    {
+      client.closed = true;
+      Gui::append("\nShared session: dropped a slow client.\n");
+    }
+#endif
+  }
+
+  // everything the board sends goes to every client at once
+  void console(const char *data, int count)
+  {
+    for(size_t i = 0; i < clients.size(); i++)
+    {
+      if(clients[i].closed == false)
+      {
+        clients[i].out.append(data, count);
+        flush(clients[i]);
+      }
+    }
+  }
+
+  // most typed text handed to the terminal at once
+  const size_t CHUNK = 1024;
+
+  // typed text is sent in turn with every other queued transaction,
+  // CR LF from terminal programs becomes one carriage return
+  void type(const std::string &text)
+  {
+    std::string line;
+
+    for(size_t i = 0; i < text.size(); i++)
+    {
+      if(text[i] == '\r' && i + 1 < text.size() && text[i + 1] == '\n')
+        continue;
+
+      if(text[i] != 0)
+        line += text[i];
+    }
+
+    // a long paste goes out in pieces, paced like typing
+    for(size_t i = 0; i < line.size(); i += CHUNK)
+      Terminal::sendString(line.substr(i, CHUNK).c_str());
+  }
+
+#ifndef WIN32
+  // "7000" or "host:7000" listen on TCP, anything else is a socket path;
+  // only loopback unless another address ("0.0.0.0:7000") is given
+  int openListener(const char *where)
+  {
+    const char *colon = strrchr(where, ':');
+    const char *port = colon != NULL ? colon + 1 : where;
+    int fd;
+
+    if(strspn(port, "0123456789") == strlen(port) && strlen(port) > 0)
+    {
+      struct sockaddr_in address;
+      int yes = 1;
+
+      memset(&address, 0, sizeof(address));
+      address.sin_family = AF_INET;
+      address.sin_port = htons(atoi(port));
+      address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+      if(colon != NULL && strncmp(where, "localhost:", 10) != 0)
+      {
+        const std::string host(where, colon - where);
+
+        if(inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1)
+          return -1;
+      }
+
+      fd = socket(AF_INET, SOCK_STREAM, 0);
+
+      if(fd < 0)
+        return -1;
+
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+      if(bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0)
+      {
+        close(fd);
+        return -1;
+      }
+    }
+    else
+    {
+      struct sockaddr_un address;
+
+      if(strlen(where) >= sizeof(address.sun_path))
+        return -1;
+
+      memset(&address, 0, sizeof(address));
+      address.sun_family = AF_UNIX;
+      strcpy(address.sun_path, where);
+      unlink(where);
+      fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+      if(fd < 0)
+        return -1;
+
+      if(bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0)
+      {
+        close(fd);
+        return -1;
+      }
+
+      paths.push_back(where);
+    }
+
+    if(listen(fd, 16) != 0)
+    {
+      close(fd);
+      return -1;
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+  }
+#endif
+
+  void acceptClients()
+  {
+#ifndef WIN32
+    for(size_t i = 0; i < listeners.size(); i++)
+    {
+      while(true)
+      {
+        const int fd = ::accept(listeners[i], 0, 0);
+        int yes = 1;
+
+        if(fd < 0)
+          break;
+
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+        // console echo is small and should go out at once
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+        Client client;
+
+        client.fd = fd;
+        client.closed = false;
+        clients.push_back(client);
+      }
+    }
+#endif
+  }
+
+  void receive(Client &client)
+  {
+#ifndef WIN32
+    char s[1024];
+    std::string text;
+
+    while(true)
+    {
+      const int bytes = read(client.fd, s, sizeof(s));
+
+      if(bytes == 0)
+        client.closed = true;
+
+      if(bytes <= 0)
+        break;
+
+      text.append(s, bytes);
+    }
+
+    if(text.size() > 0)
+      Terminal::post([text]() { type(text); });
+#endif
+  }
+}
+
+// comma separated TCP ports and socket paths
+bool Share::start(const char *where)
+{
+#ifdef WIN32
+  fprintf(stderr, "Sharing a session needs POSIX sockets.\n");
+  return false;
+#else
+  std::string list = where;
+  size_t pos = 0;
+
+  signal(SIGPIPE, SIG_IGN);
+
+  while(pos <= list.size())
+  {
+    size_t end = list.find(',', pos);
+
+    if(end == std::string::npos)
+      end = list.size();
+
+    const std::string item = list.substr(pos, end - pos);
+
+    pos = end + 1;
+
+    if(item.size() == 0)
+      continue;
+
+    const int fd = openListener(item.c_str());
+
+    if(fd < 0)
+    {
+      stop();
+      return false;
+    }
+
+    listeners.push_back(fd);
+  }
+
+  if(listeners.size() == 0)
+    return false;
+
+  running = true;
+  Terminal::addListener(console);
+  Fl::add_timeout(PERIOD, poll);
+
+  return true;
+#endif
+}
+
+void Share::stop()
+{
+#ifndef WIN32
+  Fl::remove_timeout(poll);
+  Terminal::removeListener(console);
+
+  for(size_t i = 0; i < clients.size(); i++)
+    close(clients[i].fd);
+
+  for(size_t i = 0; i < listeners.size(); i++)
+    close(listeners[i]);
+
+  for(size_t i = 0; i < paths.size(); i++)
+    unlink(paths[i].c_str());
+
+  clients.clear();
+  listeners.clear();
+  paths.clear();
+  running = false;
+#endif
+}
+
+bool Share::isRunning()
+{
+  return running;
+}
+
+void Share::poll(void *)
+{
+  acceptClients();
+
+  for(size_t i = 0; i < clients.size(); i++)
+    receive(clients[i]);
+
+  Terminal::runJobs();
+
+  for(size_t i = 0; i < clients.size(); i++)
+  {
+    flush(clients[i]);
+
+    if(clients[i].closed == true)
+    {
+#ifndef WIN32
+      close(clients[i].fd);
+#endif
+      clients.erase(clients.begin() + i);
+      i--;
+    }
+  }
+
+  Fl::repeat_timeout(PERIOD, poll);
+}
+
@@ -0,0 +1,415 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <FL/Fl.H>
+#include <FL/Fl_Button.H>
+#include <FL/Fl_Double_Window.H>
+#include <FL/Fl_Input.H>
+#include <FL/Fl_Text_Buffer.H>
+#include <FL/Fl_Text_Display.H>
+
+#include "Agent.H"
+#include "Dialog.H"
+#include "Listing.H"
+#include "Snapshot.H"
+#include "Terminal.H"
+
+namespace
+{
+  // unit checked against the agent's CRC before fetching
+  const int PAGE = 256;
+
+  // unchanged bytes this close together don't split a range
+  const int GAP = 4;
+
+  // bytes printed per changed range
+  const int SHOWN = 8;
+
+  struct Range
+  {
+    int address;
+    int count;
+  };
+
+  Fl_Double_Window *window = 0;
+  Fl_Input *input_listing;
+  Fl_Input *input_ranges;
+  Fl_Button *button_take;
+  Fl_Button *button_diff;
+  Fl_Text_Buffer *text;
+  Fl_Text_Display *display;
+
+  Listing listing;
+  bool have_listing = false;
+
+  std::vector<Range> ranges;
+  std::string ranges_text;
+
+  // latest contents of each range, and the one diffs are taken against
+  std::vector<std::vector<unsigned char> > known;
+  std::vector<std::vector<unsigned char> > baseline;
+
+  int pages_read;
+  int pages_skipped;
+
+  // "start-end" pairs in hex, split at bank boundaries
+  bool parseRanges(const char *s)
+  {
+    std::vector<Range> parsed;
+
+    while(*s != 0)
+    {
+      int first, last, used = 0;
+
+      while(*s == ' ' || *s == ',')
+        s++;
+
+      if(*s == 0)
+        break;
+
+      if(sscanf(s, "%x-%x%n", &first, &last, &used) != 2 ||
+         first > last || last > 0xFFFFFF)
+      {
+        return false;
+      }
+
+      s += used;
+
+      while(first <= last)
+      {
+        Range range;
+
+        range.address = first;
+        range.count = std::min(last, first | 0xFFFF) - first + 1;
+        parsed.push_back(range);
+        first += range.count;
+      }
+    }
+
+    if(parsed.size() == 0)
+      return false;
+
+    ranges = parsed;
+    return true;
+  }
+
+  // reads the range, skipping pages whose CRC on the board matches
+  // what we already have; neighbouring stale pages go in one read
+  bool fetch(const Range &range, std::vector<unsigned char> &data)
+  {
+    const bool check = (int)data.size() == range.count &&
+                       Agent::enter() == true;
+    std::vector<bool> stale;
+
+    data.resize(range.count);
+
+    for(int pos = 0; pos < range.count; pos += PAGE)
+    {
+      const int size = std::min(PAGE, range.count - pos);
+      const bool same = check == true &&
+        Agent::crc(range.address + pos, size) == Agent::crc16(&data[pos], size);
+
+      stale.push_back(!same);
+
+      if(same == true)
+        pages_skipped++;
+      else
+        pages_read++;
+    }
+
+    size_t page = 0;
+
+    while(page < stale.size())
+    {
+      if(stale[page] == false)
+      {
+        page++;
+        continue;
+      }
+
+      size_t last = page;
+
+      while(last < stale.size() && stale[last] == true)
+        last++;
+
+      const int first = page * PAGE;
+      const int count = std::min((int)last * PAGE, range.count) - first;
+
+      if(Terminal::readMemory(range.address + first, &data[first], count) !=
+         count)
+      {
+        data.clear();
+        return false;
+      }
+
+      page = last;
+    }
+
+    return true;
+  }
+
+  bool fetchAll()
+  {
+    if(Terminal::isConnected() == false)
+    {
+      Dialog::message("Error", "Not connected.");
+      return false;
+    }
+
+    if(ranges_text != input_ranges->value())
+    {
+      if(parseRanges(input_ranges->value()) == false)
+      {
+        Dialog::message("Error", "Ranges are hex start-end pairs.");
+        return false;
+      }
+
+      ranges_text = input_ranges->value();
+      known.clear();
+      baseline.clear();
+    }
+
+    known.resize(ranges.size());
+    pages_read = 0;
+    pages_skipped = 0;
+
+    for(size_t i = 0; i < ranges.size(); i++)
+    {
+      if(fetch(ranges[i], known[i]) == false)
+      {
+        known.clear();
+        Dialog::message("Error", "Could not read memory.");
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  std::string name(int address)
+  {
+    int offset = 0;
+    const Listing::Symbol *sym =
+      have_listing == true ? listing.symbolize(address, &offset) : 0;
+
+    if(sym == 0)
+      return "";
+
+    std::string result = sym->name;
+
+    if(offset > 0)
+    {
+      char s[32];
+
+      sprintf(s, "+%d", offset);
+      result += s;
+    }
+
+    return result;
+  }
+
+  std::string bytes(const unsigned char *p, int count)
+  {
+    std::string result;
+    char s[8];
+
+    for(int i = 0; i < count && i < SHOWN; i++)
+    {
+      sprintf(s, "%02X ", p[i]);
+      result += s;
+    }
+
+    if(count > SHOWN)
+      result += "...";
+
+    return result;
+  }
+
+  // a word at a time, looking at single bytes only where words differ
+  void compare(const unsigned char *a, const unsigned char *b, int count,
+               std::vector<Range> &changed)
+  {
+    int i = 0;
+
+    while(i < count)
+    {
+      if(i + 8 <= count)
+      {
+        unsigned long long x, y;
+
+        memcpy(&x, a + i, 8);
+        memcpy(&y, b + i, 8);
+
+        if(x == y)
+        {
+          i += 8;
+          continue;
+        }
+      }
+
+      const int end = std::min(i + 8, count);
+
+      for(; i < end; i++)
+      {
+        if(a[i] == b[i])
+          continue;
+
+        if(changed.size() > 0 &&
+           changed.back().address + changed.back().count + GAP >= i)
+        {
+          changed.back().count = i - changed.back().address + 1;
+        }
+        else
+        {
+          Range range;
+
+          range.address = i;
+          range.count = 1;
+          changed.push_back(range);
+        }
+      }
+    }
+  }
+
+  void report()
+  {
+    std::string result;
+    char s[512];
+    int total = 0;
+
+    for(size_t i = 0; i < ranges.size(); i++)
+    {
+      std::vector<Range> changed;
+
+      compare(&baseline[i][0], &known[i][0], ranges[i].count, changed);
+
+      for(size_t j = 0; j < changed.size(); j++)
+      {
+        const int offset = changed[j].address;
+        const int address = ranges[i].address + offset;
+
+        snprintf(s, sizeof(s), "%02X:%04X %5d  %-20s %s-> %s\n",
+                 address >> 16, address & 0xFFFF, changed[j].count,
+                 name(address).c_str(),
+                 bytes(&baseline[i][offset], changed[j].count).c_str(),
+                 bytes(&known[i][offset], changed[j].count).c_str());
+        result += s;
+        total += changed[j].count;
+      }
+    }
+
+    snprintf(s, sizeof(s), "%d bytes differ, %d pages read, %d unchanged "
+             "on the board.\n", total, pages_read, pages_skipped);
+    result += s;
+    text->text(result.c_str());
+  }
+
+  void loadListing()
+  {
+    have_listing = false;
+
+    if(input_listing->value()[0] == 0)
+      return;
+
+    if(listing.load(input_listing->value()) == false)
+    {
+      Dialog::message("Error", "Could not load listing.");
+      return;
+    }
+
+    have_listing = true;
+  }
+
+  void init()
+  {
+    window = new Fl_Double_Window(480, 320, "Snapshot");
+    input_listing = new Fl_Input(64, 8, 480 - 64 - 8, 24, "Listing:");
+    input_listing->when(FL_WHEN_ENTER_KEY | FL_WHEN_NOT_CHANGED);
+    input_listing->callback((Fl_Callback *)loadListing);
+    input_listing->tooltip("naken_asm listing for symbols, Enter loads it");
+    input_ranges = new Fl_Input(64, 40, 480 - 64 - 8 - 144, 24, "Ranges:");
+    input_ranges->value("000200-007FFF");
+    input_ranges->tooltip("hex start-end pairs separated by commas");
+    button_take = new Fl_Button(480 - 8 - 136, 40, 64, 24, "Snapshot");
+    button_take->callback((Fl_Callback *)Snapshot::take);
+    button_diff = new Fl_Button(480 - 8 - 64, 40, 64, 24, "Diff");
+    button_diff->callback((Fl_Callback *)Snapshot::diff);
+    text = new Fl_Text_Buffer();
+    display = new Fl_Text_Display(8, 72, 480 - 16, 320 - 80);
+    display->buffer(text);
+    display->textfont(FL_COURIER);
+    display->textsize(12);
+    window->resizable(display);
+    window->end();
+  }
+}
+
+void Snapshot::show()
+{
+  if(window == 0)
+    init();
+
+  window->show();
+}
+
+// the ranges as they are now become what later diffs compare against
+void Snapshot::take()
+{
+  if(fetchAll() == false)
+    return;
+
+  baseline = known;
+
+  char s[256];
+
+  snprintf(s, sizeof(s), "Snapshot taken, %d pages read, %d unchanged on "
+           "the board.\n", pages_read, pages_skipped);
+  text->text(s);
+}
+
+// changed ranges since the snapshot
+void Snapshot::diff()
+{
+  if(baseline.size() == 0)
+  {
+    Dialog::message("Error", "Take a snapshot first.");
+    return;
+  }
+
+  if(fetchAll() == false)
+    return;
+
+  if(baseline.size() != known.size())
+  {
+    Dialog::message("Error", "Ranges changed, take a new snapshot.");
+    return;
+  }
+
+  report();
+}
+
@@ -0,0 +1,779 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <FL/Fl.H>
+#include <FL/Fl_Double_Window.H>
+#include <FL/Fl_Native_File_Chooser.H>
+#include <FL/Fl_Text_Buffer.H>
+#include <FL/Fl_Text_Display.H>
+
+#include "Agent.H"
+#include "Dialog.H"
+#include "Emulator.H"
+#include "Gui.H"
+#include "Listing.H"
+#include "Telemetry.H"
+#include "Terminal.H"
+
+namespace
+{
+  // longest encoded frame, anything longer was not a frame
+  const int MAX_FRAME = 256;
+
+  // record id of log messages: a 16-bit format id and its arguments
+  const int LOG_ID = 0;
+
+  // labels of format strings in a listing start with this
+  const char *FORMAT_PREFIX = "fmt_";
+
+  enum
+  {
+    TYPE_U8,
+    TYPE_S8,
+    TYPE_U16,
+    TYPE_S16,
+    TYPE_U24,
+    TYPE_U32,
+    TYPE_S32
+  };
+
+  struct Field
+  {
+    std::string name;
+    int type;
+    int size;
+    double scale;
+  };
+
+  struct Record
+  {
+    std::string name;
+    std::vector<Field> fields;
+    int size;
+    std::string latest;
+    int count;
+    bool logged;
+  };
+
+  std::map<int, Record> records;
+  std::map<int, std::string> formats;
+  bool enabled = false;
+
+  int good = 0;
+  int bad = 0;
+  int unknown = 0;
+
+  FILE *log_file = NULL;
+  std::chrono::steady_clock::time_point log_start;
+
+  Fl_Double_Window *window = 0;
+  Fl_Text_Buffer *text;
+  Fl_Text_Display *display;
+
+  char load_dir[256];
+
+  bool parseType(const char *s, Field &field)
+  {
+    const char *names[] = { "u8", "s8", "u16", "s16", "u24", "u32", "s32" };
+    const int sizes[] = { 1, 1, 2, 2, 3, 4, 4 };
+
+    for(int i = 0; i < 7; i++)
+    {
+      if(strcmp(s, names[i]) == 0)
+      {
+        field.type = i;
+        field.size = sizes[i];
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  // little-endian, as the 65xx stores them
+  double value(const Field &field, const unsigned char *p)
+  {
+    long long v = 0;
+
+    for(int i = field.size - 1; i >= 0; i--)
+      v = (v << 8) | p[i];
+
+    switch(field.type)
+    {
+      case TYPE_S8:
+        v = (signed char)v;
+        break;
+      case TYPE_S16:
+        v = (short)v;
+        break;
+      case TYPE_S32:
+        v = (int)v;
+        break;
+    }
+
+    return v * field.scale;
+  }
+
+  bool cobsDecode(const std::vector<unsigned char> &in,
+                  std::vector<unsigned char> &out)
+  {
+    size_t i = 0;
+
+    out.clear();
+
+    while(i < in.size())
+    {
+      const int code = in[i++];
+
+      if(code == 0)
+        return false;
+
+      for(int j = 1; j < code; j++)
+      {
+        if(i >= in.size())
+          return false;
+
+        out.push_back(in[i++]);
+      }
+
+      if(code < 0xFF && i < in.size())
+        out.push_back(0);
+    }
+
+    return true;
+  }
+
+  void updateWindow()
+  {
+    if(window == 0 || window->shown() == 0)
+      return;
+
+    std::string s;
+    char line[256];
+
+    snprintf(line, sizeof(line), "%d frames, %d bad, %d unknown%s\n\n",
+             good, bad, unknown, log_file != NULL ? ", logging" : "");
+    s += line;
+
+    for(std::map<int, Record>::iterator i = records.begin();
+        i != records.end(); ++i)
+    {
+      snprintf(line, sizeof(line), "%-12s %6d  ", i->second.name.c_str(),
+               i->second.count);
+      s += line;
+      s += i->second.latest;
+      s += "\n";
+    }
+
+    text->text(s.c_str());
+  }
+
+  void logRecord(Record &record, const std::vector<double> &values)
+  {
+    if(log_file == NULL)
+      return;
+
+    // a header comment the first time each record appears
+    if(record.logged == false)
+    {
+      fprintf(log_file, "# %s,time", record.name.c_str());
+
+      for(size_t i = 0; i < record.fields.size(); i++)
+        fprintf(log_file, ",%s", record.fields[i].name.c_str());
+
+      fprintf(log_file, "\n");
+      record.logged = true;
+    }
+
+    const double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - log_start).count();
+
+    fprintf(log_file, "%s,%.3f", record.name.c_str(), seconds);
+
+    for(size_t i = 0; i < values.size(); i++)
+      fprintf(log_file, ",%.10g", values[i]);
+
+    fprintf(log_file, "\n");
+  }
+
+  // printf conversions take 16-bit arguments, 8-bit with hh, 32-bit
+  // with l, and %s a zero-terminated string, all little-endian
+  std::string render(const std::string &format, const unsigned char *args,
+                     int count)
+  {
+    std::string out;
+    int pos = 0;
+
+    for(size_t i = 0; i < format.size(); i++)
+    {
+      if(format[i] != '%')
+      {
+        out += format[i];
+        continue;
+      }
+
+      std::string spec = "%";
+      int size = 2;
+      char s[256];
+
+      i++;
+
+      while(i < format.size() && strchr("-+ #0123456789.", format[i]) != 0)
+        spec += format[i++];
+
+      if(format.compare(i, 2, "hh") == 0)
+      {
+        size = 1;
+        i += 2;
+      }
+      else if(format.compare(i, 2, "ll") == 0)
+      {
+        size = 4;
+        i += 2;
+      }
+      else if(i < format.size() && (format[i] == 'h' || format[i] == 'l'))
+      {
+        size = format[i] == 'h' ? 2 : 4;
+        i++;
+      }
+
+      if(i >= format.size())
+        break;
+
+      const char conversion = format[i];
+
+      if(conversion == '%')
+      {
+        out += '%';
+        continue;
+      }
+
+      if(conversion == 's')
+      {
+        std::string arg;
+
+        while(pos < count && args[pos] != 0)
+          arg += args[pos++];
+
+        pos++;
+        snprintf(s, sizeof(s), (spec + "s").c_str(), arg.c_str());
+        out += s;
+        continue;
+      }
+
+      if(conversion == 'c')
+        size = 1;
+
+      if(pos + size > count)
+      {
+        out += "<?>";
+        break;
+      }
+
+      long long value = 0;
+
+      for(int j = size - 1; j >= 0; j--)
+        value = (value << 8) | args[pos + j];
+
+      pos += size;
+
+      switch(conversion)
+      {
+        case 'd':
+        case 'i':
+          // sign extend
+          value = (value ^ (1LL << (size * 8 - 1))) - (1LL << (size * 8 - 1));
+          snprintf(s, sizeof(s), (spec + "lld").c_str(), value);
+          break;
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+          snprintf(s, sizeof(s), (spec + "ll" + conversion).c_str(), value);
+          break;
+        case 'c':
+          snprintf(s, sizeof(s), (spec + "c").c_str(), (int)value);
+          break;
+        default:
+          snprintf(s, sizeof(s), "%s%c", spec.c_str(), conversion);
+          break;
+      }
+
+      out += s;
+    }
+
+    return out;
+  }
+
+  // payload is the record id, its fields and a CRC-16 of both
+  bool decode(const std::vector<unsigned char> &payload, std::string &text)
+  {
+    if(payload.size() < 3)
+      return false;
+
+    const int size = payload.size() - 2;
+    const int crc = payload[size] | (payload[size + 1] << 8);
+
+    if(Agent::crc16(&payload[0], size) != crc)
+      return false;
+
+    // log messages are printed as if the board had sent the text
+    if(payload[0] == LOG_ID && size >= 3 && formats.size() > 0)
+    {
+      const int id = payload[1] | (payload[2] << 8);
+
+      if(formats.count(id) == 0)
+      {
+        char s[64];
+
+        snprintf(s, sizeof(s), "<format %04X?>\n", id);
+        text += s;
+        unknown++;
+        return true;
+      }
+
+      text += render(formats[id], &payload[3], size - 3);
+      good++;
+      return true;
+    }
+
+    if(records.count(payload[0]) == 0 ||
+       records[payload[0]].size != size - 1)
+    {
+      unknown++;
+      return true;
+    }
+
+    Record &record = records[payload[0]];
+    std::vector<double> values;
+    const unsigned char *p = &payload[1];
+    char s[64];
+
+    record.latest.clear();
+
+    for(size_t i = 0; i < record.fields.size(); i++)
+    {
+      const Field &field = record.fields[i];
+
+      values.push_back(value(field, p));
+      snprintf(s, sizeof(s), "%s=%.10g ", field.name.c_str(), values.back());
+      record.latest += s;
+      p += field.size;
+    }
+
+    record.count++;
+    good++;
+    logRecord(record, values);
+
+    return true;
+  }
+
+  void init()
+  {
+    window = new Fl_Double_Window(480, 240, "Telemetry");
+    text = new Fl_Text_Buffer();
+    display = new Fl_Text_Display(8, 8, 480 - 16, 240 - 16);
+    display->buffer(text);
+    display->textfont(FL_COURIER);
+    display->textsize(12);
+    window->resizable(display);
+    window->end();
+  }
+}
+
+// choose a layout file and show the decoded records
+void Telemetry::begin()
+{
+  Fl_Native_File_Chooser fc;
+  fc.title("Load Record Layouts");
+  fc.filter("Layout File\t*.txt\n");
+  fc.options(Fl_Native_File_Chooser::PREVIEW);
+  fc.type(Fl_Native_File_Chooser::BROWSE_FILE);
+  fc.directory(load_dir);
+
+  switch(fc.show())
+  {
+    case -1:
+    case 1:
+      return;
+    default:
+      strcpy(load_dir, fc.filename());
+      if(strrchr(load_dir, '/') != NULL)
+        strrchr(load_dir, '/')[1] = '\0';
+      break;
+  }
+
+  if(load(fc.filename()) == false)
+  {
+    Dialog::message("Error", "Could not load record layouts.");
+    return;
+  }
+
+  if(window == 0)
+    init();
+
+  window->show();
+  updateWindow();
+}
+
+void Telemetry::startLog()
+{
+  Fl_Native_File_Chooser fc;
+  fc.title("Log Telemetry");
+  fc.filter("CSV File\t*.csv\n");
+  fc.options(Fl_Native_File_Chooser::SAVEAS_CONFIRM);
+  fc.type(Fl_Native_File_Chooser::BROWSE_SAVE_FILE);
+  fc.directory(load_dir);
+
+  switch(fc.show())
+  {
+    case -1:
+    case 1:
+      return;
+  }
+
+  stopLog();
+  log_file = fopen(fc.filename(), "w");
+
+  if(log_file == NULL)
+  {
+    Dialog::message("Error", "Could not create log file.");
+    return;
+  }
+
+  for(std::map<int, Record>::iterator i = records.begin();
+      i != records.end(); ++i)
+  {
+    i->second.logged = false;
+  }
+
+  log_start = std::chrono::steady_clock::now();
+  updateWindow();
+}
+
+void Telemetry::stopLog()
+{
+  if(log_file != NULL)
+  {
+    fclose(log_file);
+    log_file = NULL;
+    updateWindow();
+  }
+}
+
+// choose a listing or a format file for log messages
+void Telemetry::loadFormats()
+{
+  Fl_Native_File_Chooser fc;
+  fc.title("Load Format Strings");
+  fc.filter("Listing\t*.lst\nFormat File\t*.txt\n");
+  fc.options(Fl_Native_File_Chooser::PREVIEW);
+  fc.type(Fl_Native_File_Chooser::BROWSE_FILE);
+  fc.directory(load_dir);
+
+  switch(fc.show())
+  {
+    case -1:
+    case 1:
+      return;
+    default:
+      strcpy(load_dir, fc.filename());
+      if(strrchr(load_dir, '/') != NULL)
+        strrchr(load_dir, '/')[1] = '\0';
+      break;
+  }
+
+  if(readFormats(fc.filename()) == false)
+  {
+    Dialog::message("Error", "Could not load format strings.");
+    return;
+  }
+
+  char s[256];
+
+  snprintf(s, sizeof(s), "\n%d format strings loaded.\n",
+           (int)formats.size());
+  Gui::append(s);
+}
+
+// format ids are the 16-bit addresses of "fmt_" labels, with the strings
+// read from the image next to the listing; other files have one format
+// per line: a hex id, a space and the text with C escapes
+bool Telemetry::readFormats(const char *filename)
+{
+  std::map<int, std::string> loaded;
+  const char *ext = strrchr(filename, '.');
+
+  if(ext != NULL && strcmp(ext, ".lst") == 0)
+  {
+    Listing listing;
+    Emulator *emu = new Emulator();
+    const char *exts[] = { ".hex", ".srec", 0 };
+    bool image = false;
+
+    for(int i = 0; exts[i] != 0 && image == false; i++)
+    {
+      std::string name(filename, ext - filename);
+
+      image = emu->upload((name + exts[i]).c_str());
+    }
+
+    if(image == false || listing.load(filename) == false)
+    {
+      delete emu;
+      return false;
+    }
+
+    for(size_t i = 0; i < listing.symbols.size(); i++)
+    {
+      const Listing::Symbol &sym = listing.symbols[i];
+      std::string text;
+
+      if(sym.name.compare(0, strlen(FORMAT_PREFIX), FORMAT_PREFIX) != 0)
+        continue;
+
+      for(int j = 0; j < 255; j++)
+      {
+        const int c = emu->read8(sym.address + j);
+
+        if(c == 0)
+          break;
+
+        text += c;
+      }
+
+      loaded[sym.address & 0xFFFF] = text;
+    }
+
+    delete emu;
+  }
+  else
+  {
+    FILE *fp = fopen(filename, "r");
+
+    if(fp == NULL)
+      return false;
+
+    char line[1024];
+
+    while(fgets(line, sizeof(line), fp) != NULL)
+    {
+      int id, skip = 0;
+
+      if(line[0] == '#' || sscanf(line, "%x %n", &id, &skip) != 1)
+        continue;
+
+      std::string text;
+
+      for(const char *p = line + skip; *p != 0 && *p != '\n' && *p != '\r';
+          p++)
+      {
+        if(*p != '\\' || p[1] == 0)
+        {
+          text += *p;
+          continue;
+        }
+
+        p++;
+
+        switch(*p)
+        {
+          case 'n':
+            text += '\n';
+            break;
+          case 'r':
+            text += '\r';
+            break;
+          case 't':
+            text += '\t';
+            break;
+          default:
+            text += *p;
+            break;
+        }
+      }
+
+      loaded[id & 0xFFFF] = text;
+    }
+
+    fclose(fp);
+  }
+
+  formats = loaded;
+  enabled = records.size() > 0 || formats.size() > 0;
+
+  // frames are binary, keep XON/XOFF from eating bytes of them
+  Terminal::updateFlowControl();
+
+  return formats.size() > 0;
+}
+
+// layout files:
+//   record 1 adc        (id 1..255 and a name)
+//   u16 channel0        (u8 s8 u16 s16 u24 u32 s32, little-endian)
+//   s16 temp 0.1        (optional scale)
+bool Telemetry::load(const char *filename)
+{
+  FILE *fp = fopen(filename, "r");
+
+  if(fp == NULL)
+    return false;
+
+  std::map<int, Record> loaded;
+  Record *record = NULL;
+  char line[1024];
+
+  while(fgets(line, sizeof(line), fp) != NULL)
+  {
+    char *comment = strchr(line, '#');
+
+    if(comment != NULL)
+      *comment = '\0';
+
+    char word[256];
+    char name[256];
+    int id;
+    double scale;
+
+    if(sscanf(line, "%255s", word) != 1)
+      continue;
+
+    if(strcmp(word, "record") == 0 &&
+       sscanf(line, "%*s %d %255s", &id, name) == 2 && id > 0 && id < 256)
+    {
+      record = &loaded[id];
+      record->name = name;
+      record->size = 0;
+      record->count = 0;
+      record->logged = false;
+      continue;
+    }
+
+    Field field;
+
+    if(record == NULL || parseType(word, field) == false ||
+       sscanf(line, "%*s %255s", name) != 1)
+    {
+      fclose(fp);
+      return false;
+    }
+
+    field.name = name;
+    field.scale = sscanf(line, "%*s %*s %lf", &scale) == 1 ? scale : 1.0;
+    record->fields.push_back(field);
+    record->size += field.size;
+  }
+
+  fclose(fp);
+
+  records = loaded;
+  enabled = records.size() > 0 || formats.size() > 0;
+  good = bad = unknown = 0;
+
+  Terminal::updateFlowControl();
+
+  return records.size() > 0;
+}
+
+Telemetry::Stream::Stream()
+{
+  in_frame = false;
+}
+
+bool Telemetry::isEnabled()
+{
+  return enabled;
+}
+
+// pull frames out of received bytes, leaving the text in place with
+// log messages expanded
+void Telemetry::filter(std::string &buf, Stream &stream)
+{
+  if(enabled == false)
+    return;
+
+  bool &in_frame = stream.in_frame;
+  std::vector<unsigned char> &frame = stream.frame;
+
+  std::string text;
+  bool changed = false;
+
+  for(size_t i = 0; i < buf.size(); i++)
+  {
+    const unsigned char c = buf[i];
+
+    if(in_frame == false)
+    {
+      if(c == 0)
+      {
+        in_frame = true;
+        frame.clear();
+      }
+      else
+      {
+        text += c;
+      }
+
+      continue;
+    }
+
+    if(c != 0)
+    {
+      frame.push_back(c);
+
+      // never closed, give the bytes back to the console
+      if((int)frame.size() > MAX_FRAME)
+      {
+        text.append(frame.begin(), frame.end());
+        frame.clear();
+        in_frame = false;
+      }
+
+      continue;
+    }
+
+    // back to back frames share nothing, an empty frame is a restart
+    if(frame.size() == 0)
+      continue;
+
+    std::vector<unsigned char> payload;
+
+    if(cobsDecode(frame, payload) == false || decode(payload, text) == false)
+      bad++;
+
+    changed = true;
+    frame.clear();
+    in_frame = false;
+  }
+
+  if(changed == true)
+    updateWindow();
+
+  buf.swap(text);
+}
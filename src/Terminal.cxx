@@ -22,14 +22,13 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
 #include <cctype>
 #include <cstdio>
 #include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
 
 #ifndef WIN32
   #include <unistd.h>
   #include <string.h>
-  #include <sys/socket.h>
-  #include <sys/time.h>
-  #include <fcntl.h>
-  #include <termios.h>
 #endif
 
 #if defined(_MSC_VER)
@@ -39,8 +38,15 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
 #include <FL/Fl.H>
 #include <FL/Fl_Native_File_Chooser.H>
 
+#include "Agent.H"
+#include "Debugger.H"
 #include "Dialog.H"
 #include "Gui.H"
+#include "Image.H"
+#include "Monitor.H"
+#include "Ring.H"
+#include "Session.H"
+#include "Telemetry.H"
 #include "Terminal.H"
 
 // for Visual Studio
@@ -50,20 +56,50 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
 
 namespace
 {
-  bool connected = false;
   int flash;
-  char buf[4096];
+  std::string buf;
   int buf_pos;
 
-#ifdef WIN32
-  HANDLE hserial;
-  DCB dcb;
-  COMMTIMEOUTS timeouts;
-#else
-  struct termios term;
-  int fd;
-  struct timeval tv;
-#endif
+  // one per tab, its session's thread keeps reading the port while
+  // the board is in the background
+  struct Board
+  {
+    Session session;
+    bool connected;
+
+    // module state put aside while another board is current
+    Agent::State agent;
+    std::map<int, int> breakpoints;
+
+    Queue queue;
+
+    // a telemetry frame may span two reads
+    Telemetry::Stream telemetry;
+  };
+
+  std::vector<Board *> boards;
+
+  // a listener hears the board that was current when it was added
+  struct Watcher
+  {
+    Terminal::Listener listener;
+    Board *board;
+  };
+
+  std::vector<Watcher> listeners;
+  int current = 0;
+  int held = 0;
+
+  Board &board()
+  {
+    if(boards.size() == 0)
+    {
+      boards.push_back(new Board());
+      boards[0]->connected = false;
+    }
+
+    return *boards[current];
+  }
 
   // store previous directory paths
   char load_dir[256];
@@ -95,91 +131,134 @@ namespace
     usleep(ms * 1000);
 #endif
   }
-}
 
-namespace Terminal
-{
-  char port_string[256];
-}
+  // everything a board has sent so far, cleaned up for the console
+  void collect(Board &b)
+  {
+    char raw[4096];
+    int count = 0;
 
-void Terminal::connect()
-{
-#ifdef WIN32
-  // correct port name
-  char buf[256];
-  sprintf(buf, "\\\\.\\%s", Items::device->value());
-  strcpy(buf, port_string);
+    if(b.connected == true)
+    {
+      while(1)
+      {
+        const int bytes = b.session.read((unsigned char *)raw + count,
+                                         256, 0);
 
-  hserial = CreateFile(port_string, GENERIC_READ | GENERIC_WRITE,
-                       0, NULL, OPEN_EXISTING, 0, NULL);
+        if(bytes <= 0)
+          break;
 
-  if(hserial == INVALID_HANDLE_VALUE)
-  {
-    Dialog::message("Error", "Could not open serial port.");
-    return;
-  }
+        delay(16);
+
+        count += bytes;
+        if(count > 2048)
+          break;
+      }
+    }
+
+    // external readers get the raw bytes
+    Ring::publish(raw, count);
+
+    // binary telemetry frames never reach the console, log messages
+    // arrive here already formatted and may outgrow what was read
+    buf.assign(raw, count);
+    Telemetry::filter(buf, b.telemetry);
+
+    // a stray zero would end the text early
+    int length = 0;
+
+    for(size_t i = 0; i < buf.size(); i++)
+    {
+      if(buf[i] == 13)
+        buf[length++] = '\n';
+      else if(buf[i] != 0)
+        buf[length++] = buf[i];
+    }
 
-  GetCommState(hserial, &dcb);
+    buf.resize(length);
+    buf_pos = length;
 
-  dcb.BaudRate = CBR_9600;
-  dcb.ByteSize = 8;
-  dcb.StopBits = ONESTOPBIT;
-  dcb.Parity = NOPARITY;
-  dcb.fOutX = FALSE;
-  dcb.fInX = FALSE;
-  dcb.fOutxCtsFlow = TRUE;
-  dcb.fRtsControl = RTS_CONTROL_HANDSHAKE;
-  dcb.fOutxDsrFlow = FALSE;
-  dcb.fDtrControl = DTR_CONTROL_DISABLE;
+    if(buf_pos > 0)
+    {
+      for(size_t i = 0; i < listeners.size(); i++)
+        if(listeners[i].board == &b)
+          listeners[i].listener(buf.c_str(), buf_pos);
+    }
+  }
 
-  if(SetCommState(hserial, &dcb) == 0)
+  // make another board current, putting the old one's state aside
+  void use(int index)
   {
-    CloseHandle(hserial);
-    Dialog::message("Error", "Could not open serial port.");
-    return;
+    if(index != current)
+    {
+      boards[current]->agent = Agent::getState();
+      Debugger::swapBreakpoints(boards[current]->breakpoints);
+
+      current = index;
+
+      Agent::setState(boards[current]->agent);
+      Debugger::swapBreakpoints(boards[current]->breakpoints);
+      Terminal::updateFlowControl();
+    }
+
+    Gui::selectTab(current);
   }
 
-  memset(&timeouts, 0, sizeof(timeouts));
+  // the tab the user clicked goes back while an operation runs
+  bool refuse()
+  {
+    if(held == 0)
+      return false;
+
+    Gui::selectTab(current);
+    Dialog::message("Busy", "Wait for the current operation to finish.");
+
+    return true;
+  }
 
-  timeouts.ReadIntervalTimeout = MAXDWORD;
-  timeouts.ReadTotalTimeoutConstant = 0;
-  timeouts.ReadTotalTimeoutMultiplier = 0;
-  timeouts.WriteTotalTimeoutConstant = 0;
-  timeouts.WriteTotalTimeoutMultiplier = 0;
+  // escape was pressed during the last upload
+  bool cancelled = false;
 
-  if(SetCommTimeouts(hserial, &timeouts) == 0)
+  // send one converted record and echo the monitor's response
+  bool sendRecord(const char *s, void *)
   {
-    CloseHandle(hserial);
-    Dialog::message("Error", "Could not open serial port.");
-    return;
+    Terminal::sendString(s);
+
+    // update terminal
+    Terminal::getData();
+    Gui::append(buf.c_str());
+
+    // cancel operation with escape key
+    Fl::check();
+    if(Gui::getCancelled() == true)
+    {
+      Gui::setCancelled(false);
+      cancelled = true;
+      return false;
+    }
+
+    return true;
   }
-#else
-  fd = open(port_string, O_RDWR | O_NOCTTY | O_NONBLOCK | O_NDELAY);
+}
 
-  if(fd == -1)
+namespace Terminal
+{
+  char port_string[256];
+}
+
+void Terminal::connect()
+{
+  if(board().session.open(port_string, Gui::getMode()) == false)
   {
     Dialog::message("Error", "Could not open serial port.");
     return;
   }
 
-  memset(&term, 0, sizeof(term));
-
-  //term.c_cflag = B9600 | CRTSCTS | CS8 | CREAD| CLOCAL;
-  term.c_cflag = B9600 | CS8 | CREAD| CLOCAL;
-  term.c_iflag = IGNPAR | IXOFF | IXON | IXANY;
-  term.c_oflag = 0;
-  term.c_lflag = 0;
-  term.c_cc[VTIME] = 0;
-  term.c_cc[VMIN] = 1;
-  tcflush(fd, TCIFLUSH);
-  tcsetattr(fd, TCSANOW, &term);
-
-  tv.tv_sec = 0;
-  tv.tv_usec = 100000;
-#endif
-
   flash = 0;
-  connected = true;
+  board().connected = true;
+  Agent::forget();
+  updateFlowControl();
+  Gui::setTabLabel(current, port_string);
 
   Gui::append("\nConnected to SXB at 9600 baud.\n");
   delay(1000);
@@ -187,14 +266,12 @@ void Terminal::connect()
 
 void Terminal::disconnect()
 {
-  if(connected == true)
+  if(board().connected == true)
   {
-#ifdef WIN32
-    CloseHandle(hserial);
-#else
-    close(fd);
-#endif
-    connected = false;
+    board().session.close();
+    board().connected = false;
+    Agent::forget();
+    Gui::setTabLabel(current, "Not Connected");
     Gui::append("\nConnection Closed.\n");
     Dialog::message("Disconnected", "Connection Closed.");
   }
@@ -202,170 +279,153 @@ void Terminal::disconnect()
 
 bool Terminal::isConnected()
 {
-  return connected;
+  return board().connected;
 }
 
 void Terminal::sendChar(char c)
 {
-#ifdef WIN32
-  DWORD bytes;
+  // the monitor only listens once the agent has returned
+  Agent::leave();
 
-  if(connected == true)
+  if(board().connected == true)
   {
     // convert carriage return
     if(c == '\n')
       c = 13;
 
-    WriteFile(hserial, &c, 1, &bytes, NULL);
+    board().session.write((const unsigned char *)&c, 1);
     delay(16);
   }
-#else
-  if(connected == true)
-  {
-    // convert carriage return
-    if(c == '\n')
-      c = 13;
-
-    int temp = write(fd, &c, 1);
-    delay(16);
-  }
-#endif
 }
 
 char Terminal::getChar()
 {
   char c;
-  int tries = 0;
 
-#ifdef WIN32
-  DWORD bytes;
-
-  if(connected == true)
+  if(board().connected == true)
   {
-    while(1)
-    {
-      BOOL temp = ReadFile(hserial, &c, 1, &bytes, NULL);
-      delay(16);
+    const int bytes = board().session.read((unsigned char *)&c, 1, 0);
+    delay(16);
 
-      if(temp == 0 || bytes == 0)
-        return -1;
-      else
-        return c;
-    }
+    if(bytes == 1)
+      return c;
   }
-#else
-  if(connected == true)
-  {
-    while(1)
-    {
-      int temp = read(fd, &c, 1);
-      delay(16);
 
-      if(temp <= 0)
-        return -1;
-      else
-        return c;
-    }
-  }
-#endif
+  return -1;
 }
 
 void Terminal::sendString(const char *s)
 {
-  if(connected == true)
-  {
-    memset(buf, 0, sizeof(buf));
-    strncpy(buf, s, strlen(s));
+  Agent::leave();
 
-    for(int i = 0; i < strlen(buf); i++)
-    {
-      if(buf[i] == '\n')
-        buf[i] = 13;
-    }
-
-#ifdef WIN32
-    DWORD bytes;
-
-    WriteFile(hserial, buf, strlen(buf), &bytes, NULL);
-    delay(16);
-#else
-    int temp = write(fd, buf, strlen(buf));
-    delay(16);
-#endif
-  }
+  // converts newlines, any length
+  if(board().connected == true)
+    board().session.send(s);
 }
 
-void Terminal::getResult(char *s)
+void Terminal::getResult(char *s, int size)
 {
-  if(connected == true)
+  if(board().connected == true)
   {
     getData();
-    int j = 0;
-
-    for(int i = 0; i < strlen(buf); i++)
-    {
-      char c = buf[i];
-
-      if(c >= '0' && c <= '9' || c >= 'A' && c <= 'Z' || c == ' ')
-        s[j++] = c;
-    }
 
-    s[j] = '\0';
+    // the console text has no fixed limit, the caller's buffer does
+    std::vector<char> result(buf.size() + 1);
+    Monitor::filterResult(&result[0], buf.c_str());
+    snprintf(s, size, "%s", &result[0]);
   }
 }
 
 void Terminal::getData()
 {
-  memset(buf, 0, sizeof(buf));
-  buf_pos = 0;
+  collect(board());
+}
 
-#ifdef WIN32
-  DWORD bytes;
+void Terminal::addListener(Listener listener)
+{
+  removeListener(listener);
 
-  if(connected == true)
-  {
-    while(1)
-    {
-      BOOL temp = ReadFile(hserial, buf + buf_pos, 256, &bytes, NULL);
-      delay(16);
+  Watcher watcher;
 
-      if(temp == 0 || bytes == 0)
-        break;
+  watcher.listener = listener;
+  watcher.board = &board();
+  listeners.push_back(watcher);
+}
 
-      buf_pos += bytes;
-      if(buf_pos > 2048)
-        break;
+void Terminal::removeListener(Listener listener)
+{
+  for(size_t i = 0; i < listeners.size(); i++)
+  {
+    if(listeners[i].listener == listener)
+    {
+      listeners.erase(listeners.begin() + i);
+      break;
     }
   }
-#else
-  int bytes;
+}
+
+// binary transfer, no carriage return conversion
+bool Terminal::sendData(const unsigned char *data, int count)
+{
+  if(board().connected == false)
+    return false;
+
+  return board().session.write(data, count);
+}
 
-  if(connected == true)
+// XON/XOFF would eat 0x11 and 0x13 in binary replies, so it is
+// only on while the board talks to us in text
+void Terminal::updateFlowControl()
+{
+  if(board().connected == true)
   {
-    while(1)
-    {
-      bytes = read(fd, buf + buf_pos, 256);
-      delay(16);
+    board().session.setFlowControl(Agent::isActive() == false &&
+                                   Telemetry::isEnabled() == false);
+  }
+}
 
-      if(bytes <= 0)
-        break;
+// wait for count bytes, giving up after ms of silence
+int Terminal::receiveData(unsigned char *data, int count, int ms)
+{
+  if(board().connected == false)
+    return 0;
 
-      buf_pos += bytes;
-      if(buf_pos > 2048)
-        break;
+  int received = 0;
+  int idle = 0;
+
+  while(received < count && idle < ms)
+  {
+    const int bytes = board().session.read(data + received,
+                                           count - received, 0);
+
+    if(bytes > 0)
+    {
+      received += bytes;
+      idle = 0;
+    }
+    else
+    {
+      delay(4);
+      idle += 4;
     }
   }
-#endif
 
-  for(int i = 0; i < sizeof(buf); i++)
-    if(buf[i] == 13)
-      buf[i] = '\n';
+  return received;
 }
 
 void Terminal::receive(void *data)
 {
-  getData();
-  Gui::append(buf);
+  drain();
+
+  // boards in the background keep their own tabs up to date
+  for(int i = 0; i < (int)boards.size(); i++)
+  {
+    if(i == current || boards[i]->connected == false)
+      continue;
+
+    collect(*boards[i]);
+    Gui::appendTo(i, buf.c_str());
+  }
 
   // cause cursor to flash
   flash++;
@@ -378,9 +438,16 @@ void Terminal::receive(void *data)
   Fl::repeat_timeout(.1, Terminal::receive, data);
 }
 
+// show whatever has arrived
+void Terminal::drain()
+{
+  getData();
+  Gui::append(buf.c_str());
+}
+
 void Terminal::changeReg(int reg, int num)
 {
-  if(connected == false)
+  if(board().connected == false)
     return;
 
   char s[256];
@@ -389,35 +456,35 @@ void Terminal::changeReg(int reg, int num)
   {
     switch(reg)
     {
-      case REG_PC:
+      case Monitor::REG_PC:
         sprintf(s, "|P%02X:%04X", num >> 16, num & 0xFFFF);
         sendString(s);
         break;
-      case REG_A:
+      case Monitor::REG_A:
         sprintf(s, "|A%04X", num);
         sendString(s);
         break;
-      case REG_X:
+      case Monitor::REG_X:
         sprintf(s, "|X%04X", num);
         sendString(s);
         break;
-      case REG_Y:
+      case Monitor::REG_Y:
         sprintf(s, "|Y%04X", num);
         sendString(s);
         break;
-      case REG_SP:
+      case Monitor::REG_SP:
         sprintf(s, "|S%04X", num);
         sendString(s);
         break;
-      case REG_DP:
+      case Monitor::REG_DP:
         sprintf(s, "|D%04X", num);
         sendString(s);
         break;
-      case REG_SR:
+      case Monitor::REG_SR:
         sprintf(s, "|F%02X", num);
         sendString(s);
         break;
-      case REG_DB:
+      case Monitor::REG_DB:
         sprintf(s, "|B%02X", num);
         sendString(s);
         break;
@@ -425,34 +492,34 @@ void Terminal::changeReg(int reg, int num)
 
     sendString("R");
 
-    if(reg == REG_SR)
+    if(reg == Monitor::REG_SR)
       Gui::setToggles(num);
   }
   else if(Gui::getMode() == Gui::MODE_134)
   {
     switch(reg)
     {
-      case REG_PC:
+      case Monitor::REG_PC:
         sprintf(s, "A%04X     ", num & 0xFFFF);
         sendString(s);
         break;
-      case REG_SR:
+      case Monitor::REG_SR:
         sprintf(s, "A %02X    ", num & 0xFF);
         sendString(s);
         break;
-      case REG_A:
+      case Monitor::REG_A:
         sprintf(s, "A  %02X   ", num);
         sendString(s);
         break;
-      case REG_X:
+      case Monitor::REG_X:
         sprintf(s, "A   %02X  ", num);
         sendString(s);
         break;
-      case REG_Y:
+      case Monitor::REG_Y:
         sprintf(s, "A    %02X ", num);
         sendString(s);
         break;
-      case REG_SP:
+      case Monitor::REG_SP:
         sprintf(s, "A     %02X", num);
         sendString(s);
         break;
@@ -460,77 +527,152 @@ void Terminal::changeReg(int reg, int num)
 
     sendString("R");
 
-    if(reg == REG_SR)
+    if(reg == Monitor::REG_SR)
       Gui::setToggles(num);
   }
 }
 
+// every register in one monitor command, in REG_ order
+void Terminal::setRegs(const int *regs)
+{
+  if(board().connected == false)
+    return;
+
+  char s[256];
+
+  Monitor::setRegsCommand(s, Gui::getMode(), regs);
+  sendString(s);
+  sendString("R");
+  Gui::setToggles(regs[Monitor::REG_SR]);
+}
+
 void Terminal::updateRegs()
 {
-  if(connected == false)
+  if(board().connected == false)
     return;
 
   char s[256];
   memset(s, 0, sizeof(s));
   delay(1000);
 
-  if(Gui::getMode() == Gui::MODE_265)
+  char command[8];
+
+  Monitor::regsCommand(command, Gui::getMode());
+  sendString(command);
+  delay(16);
+  getResult(s, sizeof(s));
+  Gui::updateRegs(s);
+}
+
+// read the registers without touching the gui, in REG_ order
+bool Terminal::readRegs(int *regs)
+{
+  if(board().connected == false)
+    return false;
+
+  char s[4096];
+  char command[8];
+  memset(s, 0, sizeof(s));
+
+  Monitor::regsCommand(command, Gui::getMode());
+  sendString(command);
+  delay(16);
+  getResult(s, sizeof(s));
+
+  return Monitor::parseRegs(s, Gui::getMode(), regs);
+}
+
+// dump a range with the monitor's memory display command,
+// returns the number of bytes received
+int Terminal::readMemory(int address, unsigned char *data, int count)
+{
+  if(board().connected == false || count <= 0)
+    return 0;
+
+  // much faster through the agent when it is resident
+  if(Agent::enter() == true)
+    return Agent::read(address, data, count);
+
+  char s[256];
+
+  Monitor::dumpCommand(s, Gui::getMode(), address, count);
+  sendString(s);
+
+  std::vector<bool> seen(count, false);
+  std::string line;
+  int received = 0;
+  int idle = 0;
+
+  // stop once everything arrived or the line goes quiet
+  while(received < count && idle < 16)
   {
-    sendString("| ");
-    delay(16);
-    getResult(s);
-    Gui::updateRegs(s);
+    getData();
+
+    if(buf_pos == 0)
+    {
+      idle++;
+      continue;
+    }
+
+    idle = 0;
+
+    for(int i = 0; i < buf_pos; i++)
+    {
+      if(buf[i] == '\n')
+      {
+        Monitor::parseDump(line.c_str(), address, data, seen);
+        line.clear();
+      }
+      else
+      {
+        line += buf[i];
+      }
+    }
+
+    received = 0;
+
+    for(int i = 0; i < count; i++)
+      received += seen[i] ? 1 : 0;
   }
-  else if(Gui::getMode() == Gui::MODE_134)
+
+  if(received < count && line.size() > 0)
   {
-    sendString("R");
-    delay(16);
-    getResult(s);
-    Gui::updateRegs(s);
+    Monitor::parseDump(line.c_str(), address, data, seen);
+
+    received = 0;
+
+    for(int i = 0; i < count; i++)
+      received += seen[i] ? 1 : 0;
   }
+
+  return received;
 }
 
 void Terminal::jml(int address)
 {
-  if(connected == false)
+  if(board().connected == false)
     return;
 
   char s[256];
 
-  if(Gui::getMode() == Gui::MODE_265)
-  {
-    sprintf(s, "G%02X%04X", address >> 16, address & 0xFFFF);
-    sendString(s);
-  }
-  else if(Gui::getMode() == Gui::MODE_134)
-  {
-    sprintf(s, "G%04X", address & 0xFFFF);
-    sendString(s);
-  }
+  Monitor::jumpCommand(s, Gui::getMode(), address, false);
+  sendString(s);
 }
 
 void Terminal::jsl(int address)
 {
-  if(connected == false)
+  if(board().connected == false)
     return;
 
   char s[256];
 
-  if(Gui::getMode() == Gui::MODE_265)
-  {
-    sprintf(s, "J%02X%04X", address >> 16, address & 0xFFFF);
-    sendString(s);
-  }
-  else if(Gui::getMode() == Gui::MODE_134)
-  {
-    sprintf(s, "J%04X", address & 0xFFFF);
-    sendString(s);
-  }
+  Monitor::jumpCommand(s, Gui::getMode(), address, true);
+  sendString(s);
 }
 
 void Terminal::upload()
 {
-  if(connected == false)
+  if(board().connected == false)
   {
     Dialog::message("Error", "Not Connected.");
     return;
@@ -562,215 +704,184 @@ void Terminal::upload()
   else Dialog::message("Upload Error", "Only .hex and .srec file extentions are supported.");
 }
 
-//FIXME fscanf return value should be checked
 void Terminal::uploadHex(const char *filename)
 {
-  int segment = 0;
-  int address = 0;
-  int code = 0;
-  int value = 0;
-  int count = 0;
-  int temp;
-  int ret;
-  char s[256];
+  Hold hold;
 
-  FILE *fp = fopen(filename, "r");
+  Gui::append("\nUploading Program, ESC to cancel.\n");
+  cancelled = false;
 
-  if(fp == NULL)
-  {
-    Dialog::message("Error", "Could not open file.\n");
-    return;
-  }
+  if(Image::convertHex(filename, sendRecord, 0) == false && cancelled == false)
+    Dialog::message("Error", "Could not open file, or a record is corrupt.\n");
+}
+
+void Terminal::uploadSrec(const char *filename)
+{
+  Hold hold;
 
   Gui::append("\nUploading Program, ESC to cancel.\n");
+  cancelled = false;
 
-  while(1)
-  {
-    temp = fgetc(fp);
-    if(temp == EOF)
-      break;
+  if(Image::convertSrec(filename, sendRecord, 0) == false && cancelled == false)
+    Dialog::message("Error", "Could not open file.\n");
+}
 
-    // start of line
-    if(temp == ':')
-    {
-      segment = 0;
-      ret = fscanf(fp, "%02X", &count);
+// send generated code or data through the monitor's S-record loader
+bool Terminal::uploadData(int address, const unsigned char *data, int count)
+{
+  Hold hold;
 
-      // last line
-      if(count == 0)
-      {
-        break;
-      }
-      else
-      {
-        ret = fscanf(fp, "%04X", &address);
-        ret = fscanf(fp, "%02X", &code);
-
-        if(code == 0x04)
-        {
-          segment = address;
-        }
-        else if(code == 0x00)
-        {
-          int checksum = 0;
-
-          // address
-          sprintf(s, "S2%02X%02X%02X%02X", count + 4,
-                  segment, (address >> 8) & 0xFF, address & 0xFF);
-          checksum += count + 4;
-          checksum += address >> 8;
-          checksum += address & 0xFF;
-
-          // data
-          int index = 10;
-          for(int i = 0; i < count; i++)
-          {
-            ret = fscanf(fp, "%02X", &value);
-            sprintf(s + index, "%02X", value);
-            index += 2;
-            checksum += value;
-          }
-
-          // checksum
-          sprintf(s + index, "%02X\n", 0xFF - (checksum & 0xFF));
-          sendString(s);
-
-          // update terminal
-          getData();
-          Gui::append(buf);
-        }
-      }
+  if(board().connected == false)
+    return false;
 
-      // skip to next line
-      while(1)
-      {
-        temp = fgetc(fp);
-        if(temp == '\n')
-          break;
-      }
+  if(Agent::enter() == true)
+    return Agent::write(address, data, count);
 
-      // cancel operation with escape key
-      Fl::check();
-      if(Gui::getCancelled() == true)
-      {
-        Gui::setCancelled(false);
-        break;
-      }
+  return Image::convertData(address, data, count, sendRecord, 0);
+}
+
+// scattered single bytes, such as breakpoints, in one transfer
+bool Terminal::uploadBytes(const std::map<int, int> &bytes)
+{
+  Hold hold;
+
+  if(board().connected == false)
+    return false;
+
+  if(bytes.size() == 0)
+    return true;
+
+  if(Agent::enter() == true)
+  {
+    for(std::map<int, int>::const_iterator i = bytes.begin();
+        i != bytes.end(); ++i)
+    {
+      const unsigned char value = i->second;
+
+      if(Agent::write(i->first, &value, 1) == false)
+        return false;
     }
+
+    return true;
   }
 
-  sprintf(s, "S804000000FB\n");
-  sendString(s);
+  return Image::convertBytes(bytes, sendRecord, 0);
+}
+
+// start another board in a new tab
+int Terminal::addBoard()
+{
+  board();
+
+  if(refuse() == true)
+    return current;
+
+  Board *b = new Board();
+  b->connected = false;
+  b->agent = Agent::getState();
+  b->agent.resident = false;
+  b->agent.active = false;
+  boards.push_back(b);
 
-  fclose(fp);
+  const int index = boards.size() - 1;
+  Gui::addTab("Not Connected");
+  selectBoard(index);
+
+  return index;
 }
 
-//FIXME fscanf return value should be checked
-void Terminal::uploadSrec(const char *filename)
+void Terminal::selectBoard(int index)
 {
-  int address = 0;
-  int code = 0;
-  int value = 0;
-  int count = 0;
-  int temp;
-  char prefix[8];
-  int ret;
-  char s[256];
+  board();
 
-  FILE *fp = fopen(filename, "r");
+  if(index < 0 || index >= (int)boards.size())
+    return;
 
-  if(fp == NULL)
-  {
-    Dialog::message("Error", "Could not open file.\n");
+  if(index != current && refuse() == true)
     return;
-  }
 
-  Gui::append("\nUploading Program, ESC to cancel.\n");
+  use(index);
+}
 
-  while(1)
-  {
-    // get code from prefix
-    prefix[0] = fgetc(fp);
-    if(prefix[0] == EOF)
-      break;
+// disconnect and close the current tab, the last one always stays
+void Terminal::removeBoard()
+{
+  board();
 
-    prefix[1] = fgetc(fp);
-    if(prefix[1] == EOF)
-      break;
+  if(boards.size() < 2 || refuse() == true)
+    return;
 
-    code = prefix[1] - '0';
-    if(code < 0 || code > 2)
-      break;
+  disconnect();
+  Debugger::swapBreakpoints(boards[current]->breakpoints);
 
-    ret = fscanf(fp, "%02X", &count);
+  for(size_t i = listeners.size(); i-- > 0; )
+    if(listeners[i].board == boards[current])
+      listeners.erase(listeners.begin() + i);
 
-    if(code == 1)
-      count -= 3;
-    else if(code == 2)
-      count -= 4;
+  delete boards[current];
+  boards.erase(boards.begin() + current);
+  Gui::removeTab(current);
 
-    // last line
-    if(count == 0)
-    {
-      break;
-    }
-    else if(code > 0)
-    {
-      if(code == 1)
-        ret = fscanf(fp, "%04X", &address);
-      else if(code == 2)
-        ret = fscanf(fp, "%06X", &address);
-      else
-        break;
+  if(current >= (int)boards.size())
+    current = boards.size() - 1;
 
-      int checksum = 0;
+  Agent::setState(boards[current]->agent);
+  Debugger::swapBreakpoints(boards[current]->breakpoints);
+  Gui::selectTab(current);
+}
 
-      // address
-      sprintf(s, "S2%02X%02X%02X%02X", count + 4,
-              (address >> 16) & 0xFF, (address >> 8) & 0xFF, address & 0xFF);
-      checksum += count + 4;
-      checksum += address >> 8;
-      checksum += address & 0xFF;
+int Terminal::getBoard()
+{
+  return current;
+}
 
-      // data
-      int index = 10;
-      for(int i = 0; i < count; i++)
-      {
-        ret = fscanf(fp, "%02X", &value);
-        sprintf(s + index, "%02X", value);
-        index += 2;
-        checksum += value;
-      }
+int Terminal::countBoards()
+{
+  board();
+  return boards.size();
+}
 
-      // checksum
-      sprintf(s + index, "%02X\n", 0xFF - (checksum & 0xFF));
-      sendString(s);
+Terminal::Hold::Hold()
+{
+  held++;
+}
 
-      // update terminal
-      getData();
-      Gui::append(buf);
-    }
+Terminal::Hold::~Hold()
+{
+  held--;
+}
 
-    // skip to next line
-    while(1)
-    {
-      temp = fgetc(fp);
-      if(temp == '\n')
-        break;
-    }
+bool Terminal::isHeld()
+{
+  return held > 0;
+}
 
-    // cancel operation with escape key
-    Fl::check();
-    if(Gui::getCancelled() == true)
-    {
-      Gui::setCancelled(false);
-      break;
-    }
-  }
+void Terminal::post(const Queue::Job &job)
+{
+  board().queue.post(job);
+}
 
-  sprintf(s, "S804000000FB\n");
-  sendString(s);
+// each board's jobs run with that board current, then the user's
+// board comes back
+void Terminal::runJobs()
+{
+  board();
 
-  fclose(fp);
-}
+  if(held > 0)
+    return;
+
+  const int previous = current;
+
+  for(size_t i = 0; i < boards.size(); i++)
+  {
+    if(boards[i]->queue.pending() == 0)
+      continue;
+
+    Hold hold;
 
+    use(i);
+    boards[i]->queue.run();
+  }
+
+  use(previous);
+}
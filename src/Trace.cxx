@@ -0,0 +1,870 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "Emulator.H"
+#include "Trace.H"
+
+namespace
+{
+  const char *magic = "SXBTRACE";
+  const char *index_magic = "SXBINDEX";
+  const int VERSION = 1;
+
+  // instructions per compressed block
+  const int BLOCK_RECORDS = 8192;
+
+  // shortest match worth encoding and how far back to look
+  const int MIN_MATCH = 4;
+  const int WINDOW = 65536;
+  const int HASH_BITS = 14;
+
+  // record flag byte, low bits are the access count
+  const int ACCESS_MASK = 7;
+  const int REGISTERS = 8;
+
+  // header is magic + version + block size, trailer is offset + count + magic
+  const int HEADER_SIZE = 16;
+  const int TRAILER_SIZE = 20;
+  const int ENTRY_SIZE = 5 * 8 + 3 * 4 + 8 * 4 + 4 * 4 + 2 * 128;
+
+  void put32(std::vector<unsigned char> &out, int value)
+  {
+    for(int i = 0; i < 4; i++)
+      out.push_back((value >> (i * 8)) & 0xFF);
+  }
+
+  void put64(std::vector<unsigned char> &out, long long value)
+  {
+    for(int i = 0; i < 8; i++)
+      out.push_back((value >> (i * 8)) & 0xFF);
+  }
+
+  int get32(const unsigned char *p)
+  {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+  }
+
+  long long get64(const unsigned char *p)
+  {
+    return (long long)((unsigned long long)(unsigned int)get32(p) |
+                       ((unsigned long long)(unsigned int)get32(p + 4) << 32));
+  }
+
+  void putVarint(std::vector<unsigned char> &out, unsigned long long value)
+  {
+    while(value >= 0x80)
+    {
+      out.push_back((value & 0x7F) | 0x80);
+      value >>= 7;
+    }
+
+    out.push_back(value);
+  }
+
+  // returns false when the data runs out
+  bool getVarint(const unsigned char *&p, const unsigned char *end,
+                 unsigned long long *value)
+  {
+    int shift = 0;
+
+    *value = 0;
+
+    while(p < end && shift < 64)
+    {
+      const int c = *p++;
+
+      *value |= (unsigned long long)(c & 0x7F) << shift;
+
+      if((c & 0x80) == 0)
+        return true;
+
+      shift += 7;
+    }
+
+    return false;
+  }
+
+  unsigned long long zigzag(long long value)
+  {
+    return ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63);
+  }
+
+  long long unzigzag(unsigned long long value)
+  {
+    return (long long)(value >> 1) ^ -(long long)(value & 1);
+  }
+
+  // 1024-bit filters with two probes, one set per block
+  int hash1(int address)
+  {
+    return ((unsigned int)address * 0x9E3779B1u) >> 22;
+  }
+
+  int hash2(int address)
+  {
+    return ((unsigned int)address * 0x85EBCA77u) >> 22;
+  }
+
+  void bloomAdd(unsigned char *bloom, int address)
+  {
+    const int h1 = hash1(address);
+    const int h2 = hash2(address);
+
+    bloom[h1 >> 3] |= 1 << (h1 & 7);
+    bloom[h2 >> 3] |= 1 << (h2 & 7);
+  }
+
+  bool bloomTest(const unsigned char *bloom, int address)
+  {
+    const int h1 = hash1(address);
+    const int h2 = hash2(address);
+
+    return (bloom[h1 >> 3] & (1 << (h1 & 7))) &&
+           (bloom[h2 >> 3] & (1 << (h2 & 7)));
+  }
+
+  int hash4(const unsigned char *p)
+  {
+    const unsigned int value = p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
+
+    return (value * 2654435761u) >> (32 - HASH_BITS);
+  }
+
+  // LZ77 with varint literal runs, match lengths and offsets
+  // each sequence: literals, literal bytes, match length, offset
+  void compress(const std::vector<unsigned char> &in,
+                std::vector<unsigned char> &out)
+  {
+    std::vector<int> table(1 << HASH_BITS, -1);
+    const unsigned char *src = in.size() > 0 ? &in[0] : 0;
+    const int size = in.size();
+    int anchor = 0;
+    int i = 0;
+
+    out.clear();
+
+    while(i + MIN_MATCH <= size)
+    {
+      const int h = hash4(src + i);
+      const int candidate = table[h];
+
+      table[h] = i;
+
+      if(candidate < 0 || i - candidate >= WINDOW ||
+         memcmp(src + candidate, src + i, MIN_MATCH) != 0)
+      {
+        i++;
+        continue;
+      }
+
+      int length = MIN_MATCH;
+
+      while(i + length < size && src[candidate + length] == src[i + length])
+        length++;
+
+      putVarint(out, i - anchor);
+      out.insert(out.end(), src + anchor, src + i);
+      putVarint(out, length - MIN_MATCH + 1);
+      putVarint(out, i - candidate);
+
+      i += length;
+      anchor = i;
+
+      if(i - 2 >= 0 && i + 2 <= size - MIN_MATCH)
+        table[hash4(src + i - 2)] = i - 2;
+    }
+
+    // final literal run, a zero match length ends the block
+    putVarint(out, size - anchor);
+    out.insert(out.end(), src + anchor, src + size);
+    putVarint(out, 0);
+  }
+
+  bool decompress(const std::vector<unsigned char> &in,
+                  std::vector<unsigned char> &out, int size)
+  {
+    const unsigned char *p = in.size() > 0 ? &in[0] : 0;
+    const unsigned char *end = p + in.size();
+    unsigned long long literals, length, offset;
+
+    out.resize(size);
+
+    int pos = 0;
+
+    while(true)
+    {
+      if(getVarint(p, end, &literals) == false ||
+         literals > (unsigned long long)(end - p) ||
+         pos + literals > (unsigned long long)size)
+      {
+        return false;
+      }
+
+      if(literals > 0)
+        memcpy(&out[pos], p, literals);
+
+      p += literals;
+      pos += literals;
+
+      if(getVarint(p, end, &length) == false)
+        return false;
+
+      if(length == 0)
+        break;
+
+      length += MIN_MATCH - 1;
+
+      if(getVarint(p, end, &offset) == false || offset == 0 ||
+         offset > (unsigned long long)pos ||
+         pos + length > (unsigned long long)size)
+      {
+        return false;
+      }
+
+      // byte at a time, matches may overlap their own output
+      for(unsigned long long i = 0; i < length; i++, pos++)
+        out[pos] = out[pos - offset];
+    }
+
+    return pos == size;
+  }
+
+  bool seek(FILE *fp, long long offset, int whence)
+  {
+#ifdef WIN32
+    return _fseeki64(fp, offset, whence) == 0;
+#else
+    return fseeko(fp, offset, whence) == 0;
+#endif
+  }
+
+  bool parseHex(const char *s, int *value)
+  {
+    char *end;
+
+    if(*s == '$')
+      s++;
+
+    *value = strtol(s, &end, 16);
+    return *s != 0 && *end == 0;
+  }
+
+  void printRecord(const TraceReader::Record &rec)
+  {
+    printf("%12lld  %02X:%04X  op %02X  A=%04X X=%04X Y=%04X S=%04X "
+           "D=%04X B=%02X P=%02X%s\n",
+           rec.cycle, rec.pc >> 16, rec.pc & 0xFFFF, rec.opcode,
+           rec.a, rec.x, rec.y, rec.sp, rec.dp, rec.db, rec.sr,
+           rec.e ? " E" : "");
+  }
+}
+
+TraceWriter::TraceWriter()
+{
+  fp = NULL;
+  records = 0;
+  bytes = 0;
+  block_records = 0;
+  blocks = 0;
+  access_count = 0;
+}
+
+TraceWriter::~TraceWriter()
+{
+  close();
+}
+
+bool TraceWriter::open(const char *filename)
+{
+  close();
+
+  fp = fopen(filename, "wb");
+
+  if(fp == NULL)
+    return false;
+
+  std::vector<unsigned char> header(magic, magic + 8);
+
+  put32(header, VERSION);
+  put32(header, BLOCK_RECORDS);
+  fwrite(&header[0], 1, header.size(), fp);
+
+  records = 0;
+  bytes = HEADER_SIZE;
+  block_records = 0;
+  blocks = 0;
+  index.clear();
+  raw.clear();
+
+  prev_cycle = 0;
+  memset(prev, 0, sizeof(prev));
+  prev_access = 0;
+
+  return true;
+}
+
+// writes the last block, the index and the trailer
+void TraceWriter::close()
+{
+  if(fp == NULL)
+    return;
+
+  flush();
+
+  std::vector<unsigned char> trailer;
+
+  put64(trailer, bytes);
+  put32(trailer, blocks);
+  trailer.insert(trailer.end(), index_magic, index_magic + 8);
+
+  if(index.size() > 0)
+    fwrite(&index[0], 1, index.size(), fp);
+
+  fwrite(&trailer[0], 1, trailer.size(), fp);
+  bytes += index.size() + trailer.size();
+
+  fclose(fp);
+  fp = NULL;
+}
+
+// called after each instruction with its address and opcode
+void TraceWriter::end(const Emulator *emu, int pc, int opcode)
+{
+  if(fp == NULL)
+    return;
+
+  if(block_records == 0)
+  {
+    // blocks decode on their own starting from this state
+    base_cycle = prev_cycle;
+    first_cycle = start;
+    first_record = records;
+    memcpy(base, prev, sizeof(base));
+    prev_access = 0;
+    pc_min = 0xFFFFFF;
+    pc_max = 0;
+    write_min = 0xFFFFFF;
+    write_max = 0;
+    memset(pc_bloom, 0, sizeof(pc_bloom));
+    memset(write_bloom, 0, sizeof(write_bloom));
+  }
+
+  int state[REGISTERS];
+
+  state[0] = pc;
+  state[1] = emu->a;
+  state[2] = emu->x;
+  state[3] = emu->y;
+  state[4] = emu->sp;
+  state[5] = emu->dp;
+  state[6] = emu->sr | (emu->e ? 0x100 : 0);
+  state[7] = emu->db;
+
+  int mask = 0;
+
+  for(int i = 1; i < REGISTERS; i++)
+  {
+    if(state[i] != prev[i])
+      mask |= 1 << i;
+  }
+
+  int flags = access_count < ACCESS_MASK ? access_count : ACCESS_MASK;
+
+  if(mask != 0)
+    flags |= 8;
+
+  raw.push_back(flags);
+  putVarint(raw, zigzag(pc - prev[0]));
+  raw.push_back(opcode);
+  putVarint(raw, start - prev_cycle);
+
+  if(mask != 0)
+  {
+    raw.push_back(mask);
+
+    for(int i = 1; i < REGISTERS; i++)
+    {
+      if(mask & (1 << i))
+        putVarint(raw, zigzag(state[i] - prev[i]));
+    }
+  }
+
+  if(access_count >= ACCESS_MASK)
+    putVarint(raw, access_count);
+
+  for(int i = 0; i < access_count; i++)
+  {
+    const int address = access_address[i];
+
+    putVarint(raw, (zigzag(address - prev_access) << 1) |
+                   (access_write[i] ? 1 : 0));
+    raw.push_back(access_value[i]);
+    prev_access = address;
+
+    if(access_write[i] == true)
+    {
+      if(address < write_min)
+        write_min = address;
+
+      if(address > write_max)
+        write_max = address;
+
+      bloomAdd(write_bloom, address);
+    }
+  }
+
+  if(pc < pc_min)
+    pc_min = pc;
+
+  if(pc > pc_max)
+    pc_max = pc;
+
+  bloomAdd(pc_bloom, pc);
+
+  memcpy(prev, state, sizeof(prev));
+  prev_cycle = start;
+  last_cycle = start;
+  records++;
+  block_records++;
+
+  if(block_records >= BLOCK_RECORDS)
+    flush();
+}
+
+void TraceWriter::flush()
+{
+  if(block_records == 0)
+    return;
+
+  compress(raw, packed);
+  fwrite(&packed[0], 1, packed.size(), fp);
+
+  put64(index, bytes);
+  put32(index, packed.size());
+  put32(index, raw.size());
+  put32(index, block_records);
+  put64(index, base_cycle);
+  put64(index, first_cycle);
+  put64(index, last_cycle);
+  put64(index, first_record);
+
+  for(int i = 0; i < REGISTERS; i++)
+    put32(index, base[i]);
+
+  put32(index, pc_min);
+  put32(index, pc_max);
+  put32(index, write_min);
+  put32(index, write_max);
+  index.insert(index.end(), pc_bloom, pc_bloom + sizeof(pc_bloom));
+  index.insert(index.end(), write_bloom, write_bloom + sizeof(write_bloom));
+
+  bytes += packed.size();
+  blocks++;
+  block_records = 0;
+  raw.clear();
+}
+
+TraceReader::TraceReader()
+{
+  fp = NULL;
+}
+
+TraceReader::~TraceReader()
+{
+  close();
+}
+
+// loads the block index from the end of the file
+bool TraceReader::open(const char *filename)
+{
+  close();
+
+  fp = fopen(filename, "rb");
+
+  if(fp == NULL)
+    return false;
+
+  unsigned char header[HEADER_SIZE];
+  unsigned char trailer[TRAILER_SIZE];
+
+  if(fread(header, 1, HEADER_SIZE, fp) != (size_t)HEADER_SIZE ||
+     memcmp(header, magic, 8) != 0 || get32(header + 8) != VERSION ||
+     seek(fp, -TRAILER_SIZE, SEEK_END) == false ||
+     fread(trailer, 1, TRAILER_SIZE, fp) != (size_t)TRAILER_SIZE ||
+     memcmp(trailer + 12, index_magic, 8) != 0)
+  {
+    close();
+    return false;
+  }
+
+  const long long offset = get64(trailer);
+  const int count = get32(trailer + 8);
+  std::vector<unsigned char> index((size_t)count * ENTRY_SIZE + 1);
+
+  if(seek(fp, offset, SEEK_SET) == false ||
+     fread(&index[0], ENTRY_SIZE, count, fp) != (size_t)count)
+  {
+    close();
+    return false;
+  }
+
+  blocks.resize(count);
+
+  for(int i = 0; i < count; i++)
+  {
+    const unsigned char *p = &index[(size_t)i * ENTRY_SIZE];
+    Block &block = blocks[i];
+
+    block.offset = get64(p);
+    block.size = get32(p + 8);
+    block.raw_size = get32(p + 12);
+    block.count = get32(p + 16);
+    block.base_cycle = get64(p + 20);
+    block.first_cycle = get64(p + 28);
+    block.last_cycle = get64(p + 36);
+    block.first_record = get64(p + 44);
+    p += 52;
+
+    for(int j = 0; j < REGISTERS; j++, p += 4)
+      block.base[j] = get32(p);
+
+    block.pc_min = get32(p);
+    block.pc_max = get32(p + 4);
+    block.write_min = get32(p + 8);
+    block.write_max = get32(p + 12);
+    memcpy(block.pc_bloom, p + 16, 128);
+    memcpy(block.write_bloom, p + 144, 128);
+  }
+
+  return true;
+}
+
+void TraceReader::close()
+{
+  if(fp != NULL)
+    fclose(fp);
+
+  fp = NULL;
+  blocks.clear();
+}
+
+bool TraceReader::decode(int n, std::vector<Record> &records,
+                         std::vector<Access> &accesses)
+{
+  const Block &block = blocks[n];
+
+  records.clear();
+  accesses.clear();
+  packed.resize(block.size + 1);
+
+  if(seek(fp, block.offset, SEEK_SET) == false ||
+     fread(&packed[0], 1, block.size, fp) != (size_t)block.size)
+  {
+    return false;
+  }
+
+  packed.resize(block.size);
+
+  if(decompress(packed, raw, block.raw_size) == false)
+    return false;
+
+  const unsigned char *p = raw.size() > 0 ? &raw[0] : 0;
+  const unsigned char *end = p + raw.size();
+  long long cycle = block.base_cycle;
+  int state[REGISTERS];
+  int prev_access = 0;
+  unsigned long long value;
+
+  memcpy(state, block.base, sizeof(state));
+  records.resize(block.count);
+
+  for(int i = 0; i < block.count; i++)
+  {
+    if(end - p < 2)
+      return false;
+
+    const int flags = *p++;
+    int count = flags & ACCESS_MASK;
+
+    if(getVarint(p, end, &value) == false || p >= end)
+      return false;
+
+    state[0] += unzigzag(value);
+
+    const int opcode = *p++;
+
+    if(getVarint(p, end, &value) == false)
+      return false;
+
+    cycle += value;
+
+    if(flags & 8)
+    {
+      if(p >= end)
+        return false;
+
+      const int mask = *p++;
+
+      for(int j = 1; j < REGISTERS; j++)
+      {
+        if(mask & (1 << j))
+        {
+          if(getVarint(p, end, &value) == false)
+            return false;
+
+          state[j] += unzigzag(value);
+        }
+      }
+    }
+
+    if(count == ACCESS_MASK)
+    {
+      if(getVarint(p, end, &value) == false)
+        return false;
+
+      count = value;
+    }
+
+    Record &rec = records[i];
+
+    rec.cycle = cycle;
+    rec.index = block.first_record + i;
+    rec.pc = state[0];
+    rec.opcode = opcode;
+    rec.a = state[1];
+    rec.x = state[2];
+    rec.y = state[3];
+    rec.sp = state[4];
+    rec.dp = state[5];
+    rec.sr = state[6] & 0xFF;
+    rec.e = (state[6] & 0x100) != 0;
+    rec.db = state[7];
+    rec.first_access = accesses.size();
+    rec.access_count = count;
+
+    for(int j = 0; j < count; j++)
+    {
+      Access access;
+
+      if(getVarint(p, end, &value) == false || p >= end)
+        return false;
+
+      prev_access += unzigzag(value >> 1);
+      access.address = prev_access;
+      access.write = (value & 1) != 0;
+      access.value = *p++;
+      accesses.push_back(access);
+    }
+  }
+
+  return true;
+}
+
+// most recent write to an address by an instruction starting before cycle
+bool TraceReader::lastWrite(int address, long long before,
+                            Record *rec, Access *access)
+{
+  std::vector<Record> records;
+  std::vector<Access> accesses;
+
+  // last block starting before the cycle
+  int low = 0;
+  int high = blocks.size();
+
+  while(low < high)
+  {
+    const int mid = (low + high) / 2;
+
+    if(blocks[mid].first_cycle < before)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  for(int i = low - 1; i >= 0; i--)
+  {
+    const Block &block = blocks[i];
+
+    if(address < block.write_min || address > block.write_max ||
+       bloomTest(block.write_bloom, address) == false)
+    {
+      continue;
+    }
+
+    if(decode(i, records, accesses) == false)
+      return false;
+
+    for(int j = records.size() - 1; j >= 0; j--)
+    {
+      const Record &r = records[j];
+
+      if(r.cycle >= before)
+        continue;
+
+      for(int k = r.access_count - 1; k >= 0; k--)
+      {
+        const Access &a = accesses[r.first_access + k];
+
+        if(a.write == true && a.address == address)
+        {
+          *rec = r;
+          *access = a;
+          return true;
+        }
+      }
+    }
+  }
+
+  return false;
+}
+
+// every execution of the instruction at a 24-bit address
+void TraceReader::executions(int pc, std::vector<Record> &result)
+{
+  std::vector<Record> records;
+  std::vector<Access> accesses;
+
+  result.clear();
+
+  for(int i = 0; i < (int)blocks.size(); i++)
+  {
+    const Block &block = blocks[i];
+
+    if(pc < block.pc_min || pc > block.pc_max ||
+       bloomTest(block.pc_bloom, pc) == false)
+    {
+      continue;
+    }
+
+    if(decode(i, records, accesses) == false)
+      return;
+
+    for(size_t j = 0; j < records.size(); j++)
+    {
+      if(records[j].pc == pc)
+        result.push_back(records[j]);
+    }
+  }
+}
+
+long long TraceReader::instructions() const
+{
+  if(blocks.size() == 0)
+    return 0;
+
+  return blocks.back().first_record + blocks.back().count;
+}
+
+long long TraceReader::cycles() const
+{
+  if(blocks.size() == 0)
+    return 0;
+
+  return blocks.back().last_cycle;
+}
+
+int TraceReader::blockCount() const
+{
+  return blocks.size();
+}
+
+// easysxb --query file.trace [write ADDR [before CYCLE] | exec ADDR]
+int Trace::query(const char *filename, int argc, char **argv)
+{
+  TraceReader reader;
+
+  if(reader.open(filename) == false)
+  {
+    printf("Could not open trace \"%s\".\n", filename);
+    return 1;
+  }
+
+  std::chrono::steady_clock::time_point begin =
+    std::chrono::steady_clock::now();
+
+  int address;
+
+  if(argc == 0)
+  {
+    printf("%lld instructions, %lld cycles, %d blocks.\n",
+           reader.instructions(), reader.cycles(), reader.blockCount());
+    return 0;
+  }
+  else if(strcmp(argv[0], "write") == 0 && (argc == 2 || argc == 4) &&
+          parseHex(argv[1], &address) == true)
+  {
+    long long before = reader.cycles() + 1;
+
+    if(argc == 4)
+    {
+      if(strcmp(argv[2], "before") != 0)
+      {
+        printf("Unknown query.\n");
+        return 1;
+      }
+
+      before = atoll(argv[3]);
+    }
+
+    TraceReader::Record rec;
+    TraceReader::Access access;
+
+    if(reader.lastWrite(address, before, &rec, &access) == true)
+    {
+      printf("$%06X = %02X written by:\n", address, access.value);
+      printRecord(rec);
+    }
+    else
+    {
+      printf("No write to $%06X before cycle %lld.\n", address, before);
+    }
+  }
+  else if(strcmp(argv[0], "exec") == 0 && argc == 2 &&
+          parseHex(argv[1], &address) == true)
+  {
+    std::vector<TraceReader::Record> result;
+
+    reader.executions(address, result);
+
+    for(size_t i = 0; i < result.size(); i++)
+      printRecord(result[i]);
+
+    printf("%d execution%s of $%06X.\n", (int)result.size(),
+           result.size() == 1 ? "" : "s", address);
+  }
+  else
+  {
+    printf("Unknown query.\n");
+    return 1;
+  }
+
+  printf("Query took %.2f ms.\n", std::chrono::duration<double, std::milli>(
+                                    std::chrono::steady_clock::now() -
+                                    begin).count());
+
+  return 0;
+}
+
@@ -0,0 +1,358 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <FL/Fl.H>
+#include <FL/Fl_Box.H>
+#include <FL/Fl_Check_Button.H>
+#include <FL/Fl_Double_Window.H>
+#include <FL/Fl_Input.H>
+#include <FL/Fl_Int_Input.H>
+#include <FL/Fl_Light_Button.H>
+
+#include "Dialog.H"
+#include "Gui.H"
+#include "Matcher.H"
+#include "Snapshot.H"
+#include "Terminal.H"
+#include "Trigger.H"
+
+namespace
+{
+  Fl_Double_Window *window = 0;
+  Fl_Input *input_patterns;
+  Fl_Int_Input *input_before;
+  Fl_Int_Input *input_after;
+  Fl_Input *input_directory;
+  Fl_Check_Button *check_once;
+  Fl_Check_Button *check_snapshot;
+  Fl_Light_Button *button_arm;
+  Fl_Box *status;
+
+  Matcher matcher;
+  std::vector<std::string> patterns;
+
+  // the last bytes received, oldest at ring_pos once full
+  std::vector<char> ring;
+  int ring_pos;
+  bool ring_full;
+
+  // bytes saved after a match, -1 once matching has stopped
+  int after;
+
+  // capture in progress and what it still needs
+  std::string capture;
+  int remaining;
+  int fired;
+
+  int captures;
+
+  void updateStatus()
+  {
+    char s[128];
+
+    if(button_arm->value() == 0)
+      snprintf(s, sizeof(s), "%d captures", captures);
+    else if(remaining > 0)
+      snprintf(s, sizeof(s), "triggered, %d bytes to go", remaining);
+    else
+      snprintf(s, sizeof(s), "armed, %d captures", captures);
+
+    status->copy_label(s);
+  }
+
+  void record(const char *data, int count)
+  {
+    const int size = ring.size();
+
+    if(count >= size)
+    {
+      memcpy(&ring[0], data + count - size, size);
+      ring_pos = 0;
+      ring_full = true;
+      return;
+    }
+
+    const int first = std::min(count, size - ring_pos);
+
+    memcpy(&ring[ring_pos], data, first);
+    memcpy(&ring[0], data + first, count - first);
+
+    if(ring_pos + count >= size)
+      ring_full = true;
+
+    ring_pos = (ring_pos + count) % size;
+  }
+
+  std::string history()
+  {
+    if(ring_full == false)
+      return std::string(&ring[0], ring_pos);
+
+    return std::string(&ring[ring_pos], ring.size() - ring_pos) +
+           std::string(&ring[0], ring_pos);
+  }
+
+  // pausing and snapshots use the port, so they wait until the receive
+  // call that found the trigger is over
+  void afterCapture(void *)
+  {
+    if(check_snapshot->value() != 0)
+    {
+      Snapshot::show();
+      Snapshot::take();
+    }
+
+    if(check_once->value() != 0)
+    {
+      Trigger::disarm();
+      Dialog::message("Trigger", "Captured, trigger disarmed.");
+    }
+  }
+
+  void save()
+  {
+    char name[64];
+    char s[1024];
+    const time_t now = time(0);
+    std::string path = input_directory->value();
+
+    if(path.size() > 0 && path[path.size() - 1] != '/')
+      path += '/';
+
+    strftime(name, sizeof(name), "trigger-%Y%m%d-%H%M%S", localtime(&now));
+    snprintf(s, sizeof(s), "%s%s-%d.txt", path.c_str(), name, captures + 1);
+
+    FILE *fp = fopen(s, "w");
+
+    if(fp == NULL)
+    {
+      Gui::append("\nCould not write trigger capture.\n");
+      return;
+    }
+
+    fprintf(fp, "# trigger \"%s\"\n", patterns[fired].c_str());
+    fwrite(capture.data(), 1, capture.size(), fp);
+    fclose(fp);
+
+    captures++;
+
+    // no more matches until disarmed
+    if(check_once->value() != 0)
+      after = -1;
+
+    char message[1100];
+
+    snprintf(message, sizeof(message), "\nTrigger \"%s\" saved to %s.\n",
+             patterns[fired].c_str(), s);
+    Gui::append(message);
+    Fl::add_timeout(0, afterCapture);
+  }
+
+  // called with every received chunk while armed
+  void listen(const char *data, int count)
+  {
+    while(count > 0)
+    {
+      if(remaining > 0)
+      {
+        const int take = std::min(count, remaining);
+
+        capture.append(data, take);
+        record(data, take);
+        remaining -= take;
+        data += take;
+        count -= take;
+
+        if(remaining == 0)
+          save();
+
+        continue;
+      }
+
+      if(after < 0 || matcher.empty() == true)
+      {
+        record(data, count);
+        return;
+      }
+
+      int end;
+      const int id = matcher.feed(data, count, &end);
+
+      if(id < 0)
+      {
+        record(data, count);
+        break;
+      }
+
+      record(data, end);
+      data += end;
+      count -= end;
+
+      // the ring ends with the match
+      fired = id;
+      capture = history();
+      remaining = after;
+
+      if(remaining == 0)
+        save();
+    }
+
+    updateStatus();
+  }
+
+  // "a|b|c", with \| for a literal bar
+  bool parsePatterns(const char *s)
+  {
+    std::string pattern;
+
+    patterns.clear();
+    matcher.clear();
+
+    for(; ; s++)
+    {
+      if(*s == '\\' && s[1] == '|')
+      {
+        pattern += '|';
+        s++;
+        continue;
+      }
+
+      if(*s == '|' || *s == 0)
+      {
+        if(pattern.size() > 0)
+        {
+          patterns.push_back(pattern);
+          matcher.add(pattern);
+        }
+
+        pattern.clear();
+
+        if(*s == 0)
+          break;
+
+        continue;
+      }
+
+      pattern += *s;
+    }
+
+    matcher.build();
+    return patterns.size() > 0;
+  }
+
+  void armCb()
+  {
+    if(button_arm->value() != 0)
+      Trigger::arm();
+    else
+      Trigger::disarm();
+  }
+
+  void init()
+  {
+    int y1 = 8;
+
+    window = new Fl_Double_Window(384, 0, "Trigger");
+    input_patterns = new Fl_Input(96, y1, 384 - 96 - 8, 24, "Patterns:");
+    input_patterns->tooltip("text to watch for, alternatives separated\n"
+                            "by |, \\| for a bar");
+    y1 += 32;
+    input_before = new Fl_Int_Input(96, y1, 64, 24, "Before (KB):");
+    input_before->value("4");
+    input_after = new Fl_Int_Input(384 - 8 - 64, y1, 64, 24, "After (KB):");
+    input_after->value("1");
+    y1 += 32;
+    input_directory = new Fl_Input(96, y1, 384 - 96 - 8, 24, "Directory:");
+    input_directory->value(".");
+    input_directory->tooltip("captures are saved here with a timestamp");
+    y1 += 32;
+    check_once = new Fl_Check_Button(96, y1, 128, 24, "Disarm after one");
+    check_once->tooltip("stop at the first capture");
+    check_snapshot = new Fl_Check_Button(232, y1, 144, 24, "Take snapshot");
+    check_snapshot->tooltip("take a memory snapshot after each capture");
+    y1 += 32;
+    button_arm = new Fl_Light_Button(96, y1, 64, 24, "Arm");
+    button_arm->callback((Fl_Callback *)armCb);
+    status = new Fl_Box(168, y1, 384 - 168 - 8, 24, "");
+    status->align(FL_ALIGN_LEFT | FL_ALIGN_INSIDE);
+    y1 += 32;
+    window->size(384, y1);
+    window->end();
+  }
+}
+
+void Trigger::show()
+{
+  if(window == 0)
+    init();
+
+  updateStatus();
+  window->show();
+}
+
+// only an armed trigger listens to the stream
+void Trigger::arm()
+{
+  const int before = atoi(input_before->value());
+  const int size = atoi(input_after->value());
+
+  if(parsePatterns(input_patterns->value()) == false ||
+     before < 1 || size < 0)
+  {
+    button_arm->value(0);
+    Dialog::message("Error", "Enter patterns and buffer sizes.");
+    return;
+  }
+
+  ring.assign(before * 1024, 0);
+  ring_pos = 0;
+  ring_full = false;
+  after = size * 1024;
+  remaining = 0;
+  matcher.reset();
+  button_arm->value(1);
+  Terminal::addListener(listen);
+  updateStatus();
+}
+
+void Trigger::disarm()
+{
+  Terminal::removeListener(listen);
+
+  // keep what was caught so far
+  if(remaining > 0)
+  {
+    remaining = 0;
+    save();
+  }
+
+  button_arm->value(0);
+  updateStatus();
+}
+
@@ -0,0 +1,459 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <FL/Fl.H>
+#include <FL/Fl_Box.H>
+#include <FL/Fl_Button.H>
+#include <FL/Fl_Double_Window.H>
+#include <FL/Fl_Hold_Browser.H>
+#include <FL/Fl_Input.H>
+#include <FL/Fl_Int_Input.H>
+#include <FL/Fl_Light_Button.H>
+
+#include "Dialog.H"
+#include "Listing.H"
+#include "Terminal.H"
+#include "Watch.H"
+
+namespace
+{
+  // gaps this small are read through rather than starting a new transfer
+  const int GAP = 16;
+
+  // longest single transfer
+  const int LONGEST = 256;
+
+  struct Type
+  {
+    const char *name;
+    int size;
+    bool sign;
+  };
+
+  const Type types[] =
+  {
+    { "u8", 1, false },
+    { "s8", 1, true },
+    { "u16", 2, false },
+    { "s16", 2, true },
+    { "u24", 3, false },
+    { "u32", 4, false },
+    { "s32", 4, true },
+    { 0, 0, false }
+  };
+
+  struct Item
+  {
+    std::string name;
+    int address;
+    int type;
+    int count;
+    std::vector<unsigned char> value;
+    bool valid;
+    bool changed;
+  };
+
+  struct Read
+  {
+    int address;
+    int count;
+  };
+
+  Fl_Double_Window *window = 0;
+  Fl_Input *input_listing;
+  Fl_Input *input_watch;
+  Fl_Int_Input *input_rate;
+  Fl_Light_Button *button_poll;
+  Fl_Button *button_remove;
+  Fl_Box *status;
+  Fl_Hold_Browser *browser;
+
+  Listing listing;
+  bool have_listing = false;
+
+  std::vector<Item> items;
+  std::vector<Read> reads;
+
+  // a slow read must not start another one
+  bool busy = false;
+
+  // the board polling started on, other tabs are left alone
+  int board = 0;
+
+  int bytes(const Item &item)
+  {
+    return types[item.type].size * item.count;
+  }
+
+  // merge the watches into sorted contiguous reads, never crossing a bank
+  void plan()
+  {
+    std::vector<std::pair<int, int> > ranges;
+
+    reads.clear();
+
+    for(size_t i = 0; i < items.size(); i++)
+    {
+      ranges.push_back(std::make_pair(items[i].address,
+                                      items[i].address + bytes(items[i])));
+    }
+
+    std::sort(ranges.begin(), ranges.end());
+
+    for(size_t i = 0; i < ranges.size(); i++)
+    {
+      const int first = ranges[i].first;
+      const int end = ranges[i].second;
+
+      if(reads.size() > 0)
+      {
+        Read &last = reads.back();
+        const int last_end = last.address + last.count;
+
+        if(first <= last_end + GAP &&
+           std::max(end, last_end) - last.address <= LONGEST &&
+           (first >> 16) == ((std::max(end, last_end) - 1) >> 16) &&
+           (first >> 16) == (last.address >> 16))
+        {
+          last.count = std::max(end, last_end) - last.address;
+          continue;
+        }
+      }
+
+      Read read;
+
+      read.address = first;
+      read.count = end - first;
+      reads.push_back(read);
+    }
+  }
+
+  std::string format(const Item &item)
+  {
+    const Type &type = types[item.type];
+    std::string result;
+    char s[64];
+
+    if(item.valid == false)
+      return "--";
+
+    for(int i = 0; i < item.count; i++)
+    {
+      const unsigned char *p = &item.value[i * type.size];
+      long long value = 0;
+
+      for(int j = type.size - 1; j >= 0; j--)
+        value = (value << 8) | p[j];
+
+      const long long hex = value;
+
+      // sign extend
+      if(type.sign == true)
+      {
+        const long long top = 1LL << (type.size * 8 - 1);
+
+        value = (value ^ top) - top;
+      }
+
+      snprintf(s, sizeof(s), "%s$%0*llX (%lld)", i > 0 ? ", " : "",
+               type.size * 2, hex, value);
+      result += s;
+    }
+
+    return result;
+  }
+
+  void updateBrowser()
+  {
+    if(window == 0)
+      return;
+
+    const int selected = browser->value();
+
+    browser->clear();
+
+    for(size_t i = 0; i < items.size(); i++)
+    {
+      const Item &item = items[i];
+      char s[512];
+
+      // changed values in red until the next poll
+      snprintf(s, sizeof(s), "@f%s@.%-16s %02X:%04X %-3s %s",
+               item.changed == true ? "@C1" : "", item.name.c_str(),
+               item.address >> 16, item.address & 0xFFFF,
+               types[item.type].name, format(item).c_str());
+      browser->add(s);
+    }
+
+    if(selected > 0 && selected <= browser->size())
+      browser->value(selected);
+
+    int total = 0;
+
+    for(size_t i = 0; i < reads.size(); i++)
+      total += reads[i].count;
+
+    char s[64];
+
+    snprintf(s, sizeof(s), "%d reads, %d bytes", (int)reads.size(), total);
+    status->copy_label(s);
+  }
+
+  // every read of a poll, then every watch is cut from the results
+  void refresh()
+  {
+    if(busy == true || Terminal::isHeld() == true ||
+       Terminal::isConnected() == false)
+    {
+      return;
+    }
+
+    if(Terminal::getBoard() != board)
+    {
+      status->copy_label("paused while another board is current");
+      return;
+    }
+
+    busy = true;
+
+    std::vector<std::vector<unsigned char> > data(reads.size());
+    std::vector<bool> ok(reads.size());
+
+    for(size_t i = 0; i < reads.size(); i++)
+    {
+      data[i].resize(reads[i].count);
+      ok[i] = Terminal::readMemory(reads[i].address, &data[i][0],
+                                   reads[i].count) == reads[i].count;
+    }
+
+    for(size_t i = 0; i < items.size(); i++)
+    {
+      Item &item = items[i];
+      const int size = bytes(item);
+      size_t j = 0;
+
+      while(j < reads.size() &&
+            (item.address < reads[j].address ||
+             item.address + size > reads[j].address + reads[j].count))
+      {
+        j++;
+      }
+
+      if(j == reads.size() || ok[j] == false)
+      {
+        item.changed = item.valid;
+        item.valid = false;
+        continue;
+      }
+
+      std::vector<unsigned char> value(data[j].begin() +
+                                       (item.address - reads[j].address),
+                                       data[j].begin() +
+                                       (item.address - reads[j].address) +
+                                       size);
+
+      item.changed = item.valid == true && value != item.value;
+      item.value = value;
+      item.valid = true;
+    }
+
+    updateBrowser();
+    busy = false;
+  }
+
+  int rate()
+  {
+    const int ms = atoi(input_rate->value());
+
+    return ms < 50 ? 50 : ms;
+  }
+
+  void pollCb()
+  {
+    Fl::remove_timeout(Watch::poll);
+    board = Terminal::getBoard();
+
+    if(button_poll->value() != 0)
+      Fl::add_timeout(rate() / 1000.0, Watch::poll);
+  }
+
+  void addCb()
+  {
+    if(Watch::add(input_watch->value()) == false)
+    {
+      Dialog::message("Error", "Unknown symbol or type.");
+      return;
+    }
+
+    input_watch->value("");
+    board = Terminal::getBoard();
+    refresh();
+  }
+
+  void removeCb()
+  {
+    const int line = browser->value();
+
+    if(line < 1 || line > (int)items.size())
+      return;
+
+    items.erase(items.begin() + line - 1);
+    plan();
+    updateBrowser();
+  }
+
+  void loadListing()
+  {
+    have_listing = false;
+
+    if(input_listing->value()[0] == 0)
+      return;
+
+    if(listing.load(input_listing->value()) == false)
+    {
+      Dialog::message("Error", "Could not load listing.");
+      return;
+    }
+
+    have_listing = true;
+  }
+
+  void init()
+  {
+    window = new Fl_Double_Window(480, 320, "Watch");
+    input_listing = new Fl_Input(64, 8, 480 - 64 - 8, 24, "Listing:");
+    input_listing->when(FL_WHEN_ENTER_KEY | FL_WHEN_NOT_CHANGED);
+    input_listing->callback((Fl_Callback *)loadListing);
+    input_listing->tooltip("naken_asm listing for symbols, Enter loads it");
+    input_watch = new Fl_Input(64, 40, 480 - 64 - 8 - 72, 24, "Watch:");
+    input_watch->when(FL_WHEN_ENTER_KEY | FL_WHEN_NOT_CHANGED);
+    input_watch->callback((Fl_Callback *)addCb);
+    input_watch->tooltip("symbol or hex address, type (u8 s8 u16 s16 u24 "
+                         "u32 s32) and count, Enter adds it");
+    button_remove = new Fl_Button(480 - 8 - 64, 40, 64, 24, "Remove");
+    button_remove->callback((Fl_Callback *)removeCb);
+    input_rate = new Fl_Int_Input(64, 72, 64, 24, "Every:");
+    input_rate->value("500");
+    input_rate->tooltip("milliseconds between polls");
+    input_rate->callback((Fl_Callback *)pollCb);
+    button_poll = new Fl_Light_Button(136, 72, 64, 24, "Poll");
+    button_poll->callback((Fl_Callback *)pollCb);
+    status = new Fl_Box(208, 72, 480 - 208 - 8, 24, "");
+    status->align(FL_ALIGN_LEFT | FL_ALIGN_INSIDE);
+    browser = new Fl_Hold_Browser(8, 104, 480 - 16, 320 - 112);
+    window->resizable(browser);
+    window->end();
+  }
+}
+
+void Watch::show()
+{
+  if(window == 0)
+    init();
+
+  updateBrowser();
+  window->show();
+  pollCb();
+}
+
+// "name [type] [count]" where name is a symbol or a hex address
+bool Watch::add(const char *text)
+{
+  char name[256], type[16];
+  int count = 1;
+
+  strcpy(type, "u8");
+
+  if(sscanf(text, "%255s %15s %d", name, type, &count) < 1 ||
+     count < 1 || count > 64)
+  {
+    return false;
+  }
+
+  Item item;
+
+  item.name = name;
+  item.type = -1;
+  item.count = count;
+  item.valid = false;
+  item.changed = false;
+
+  for(int i = 0; types[i].name != 0; i++)
+    if(strcmp(type, types[i].name) == 0)
+      item.type = i;
+
+  if(item.type < 0)
+    return false;
+
+  bool found = false;
+
+  if(have_listing == true)
+  {
+    for(size_t i = 0; i < listing.symbols.size(); i++)
+    {
+      if(listing.symbols[i].name == item.name)
+      {
+        item.address = listing.symbols[i].address;
+        found = true;
+        break;
+      }
+    }
+  }
+
+  if(found == false)
+  {
+    char *end;
+
+    item.address = strtol(name, &end, 16);
+
+    if(*end != 0 || item.address < 0 || item.address > 0xFFFFFF)
+      return false;
+  }
+
+  if((item.address & 0xFFFF) + bytes(item) > 0x10000)
+    return false;
+
+  items.push_back(item);
+  plan();
+  updateBrowser();
+
+  return true;
+}
+
+// timer callback while polling is on
+void Watch::poll(void *)
+{
+  if(window == 0 || window->shown() == 0)
+    return;
+
+  refresh();
+
+  if(button_poll->value() != 0)
+    Fl::repeat_timeout(rate() / 1000.0, Watch::poll);
+}
+
@@ -0,0 +1,108 @@
+/*
+Copyright (c) 2016 Joe Davisson.
+
+This file is part of EasySXB.
+
+EasySXB is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+EasySXB is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with EasySXB; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#ifndef EASYSXB_H
+#define EASYSXB_H
+
+/* C interface to a W65C265SXB or W65C134SXB board, no gui needed.
+   Functions returning int give 0 on success and -1 on failure unless
+   noted. Calls on one session may come from any thread, board commands
+   run one at a time. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct easysxb_session easysxb_session;
+
+enum
+{
+  EASYSXB_265,
+  EASYSXB_134
+};
+
+/* registers in easysxb_get_regs and easysxb_set_regs */
+enum
+{
+  EASYSXB_PC,
+  EASYSXB_A,
+  EASYSXB_X,
+  EASYSXB_Y,
+  EASYSXB_SP,
+  EASYSXB_DP,
+  EASYSXB_SR,
+  EASYSXB_DB
+};
+
+/* called on the session's reader thread with every byte received */
+typedef void (*easysxb_receive_cb)(const char *data, int count, void *user);
+typedef void (*easysxb_progress_cb)(int done, int total, void *user);
+typedef void (*easysxb_done_cb)(int ok, void *user);
+
+const char *easysxb_version(void);
+
+easysxb_session *easysxb_open(const char *port, int board);
+void easysxb_close(easysxb_session *session);
+
+void easysxb_set_receive(easysxb_session *session,
+                         easysxb_receive_cb callback, void *user);
+
+/* xon/xoff flow control is on after opening, turn it off to pass
+   arbitrary binary data */
+void easysxb_set_flow_control(easysxb_session *session, int on);
+
+/* raw bytes, easysxb_read only sees them while no receive callback is set,
+   waits up to timeout_ms (forever if negative), returns the count */
+int easysxb_read(easysxb_session *session, unsigned char *data, int count,
+                 int timeout_ms);
+int easysxb_write(easysxb_session *session, const unsigned char *data,
+                  int count);
+
+/* text for the monitor, newlines are sent as carriage returns */
+int easysxb_send(easysxb_session *session, const char *text);
+
+int easysxb_get_regs(easysxb_session *session, int regs[8]);
+int easysxb_set_regs(easysxb_session *session, const int regs[8]);
+
+/* returns the number of bytes read */
+int easysxb_read_memory(easysxb_session *session, int address,
+                        unsigned char *data, int count);
+int easysxb_write_memory(easysxb_session *session, int address,
+                         const unsigned char *data, int count);
+
+/* .hex or .srec file, the async form returns at once and calls done on
+   a worker thread; it returns -1 while another one runs or when called
+   from done, which may close the session */
+int easysxb_upload(easysxb_session *session, const char *filename,
+                   easysxb_progress_cb progress, void *user);
+int easysxb_upload_async(easysxb_session *session, const char *filename,
+                         easysxb_progress_cb progress, easysxb_done_cb done,
+                         void *user);
+
+int easysxb_jml(easysxb_session *session, int address);
+int easysxb_jsl(easysxb_session *session, int address);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+